@@ -0,0 +1,196 @@
+/**
+ * @file analysis.c
+ * @author Faris Soliman
+ * This file contains the analysis of a finished game. Every position of the game is searched
+ * on its own, with its own budget, so the positions are spread over a thread pool and the
+ * analysis takes about as long as the game has positions divided by the number of workers.
+ * Every worker keeps its own search, cleared before every position, so a node budget gives
+ * the same report whatever the number of workers. With a solved position cache, the searches
+ * share it with each other and with later runs, and positions solved there are not searched.
+ *
+ * The value of a move that was played is read off the search of the position after it, so
+ * each move is compared with the best move of its position at no extra cost.
+*/
+#include <stdlib.h>
+#include "analysis.h"
+#include "pool.h"
+
+typedef struct {
+    game* g;
+    search** searches;
+    unsigned long max_nodes;
+    long time_ms;
+    search_result* results;
+} analysis_context;
+
+typedef struct {
+    analysis_context* c;
+    size_t position;
+} analysis_job;
+
+/**
+ * Searches one position of the game: the position before the move of the same index, or the
+ * final position for the index past the last move.
+ * @param arg The analysis_job.
+ * @param worker The worker running the job.
+*/
+void static analyze_position(void* arg, int worker) {
+    analysis_job* job = arg;
+    analysis_context* c = job->c;
+    search_result* result = &c->results[job->position];
+
+    game* p = game_create(c->g->board->size, c->g->type);
+    if (p == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < job->position; i++) {
+        game_place_stone(p, c->g->moves[i].x, c->g->moves[i].y);
+    }
+
+    if (p->state == GAME_STATE_PLAYING) {
+        search* s = c->searches[worker];
+        search_clear(s);
+        search_prepare(s, c->time_ms);
+        *result = search_run(s, p, SEARCH_MAX_DEPTH, c->max_nodes);
+        if (result->x == SEARCH_NO_MOVE) {
+            result->depth = 0;
+            search_predict(s, p, &result->x, &result->y);
+        }
+    }
+    game_delete(p);
+}
+
+/**
+ * Converts the score of a position to the score of the move that led to it, for the player
+ * who made the move. A win or loss is one ply further away from the earlier position.
+ * @param score The score of the later position, for the player to move there.
+ * @return The score of the move.
+*/
+int static move_score(int score) {
+    score = -score;
+    if (score > SEARCH_WIN_BOUND) {
+        return score - 1;
+    }
+    if (score < -SEARCH_WIN_BOUND) {
+        return score + 1;
+    }
+    return score;
+}
+
+/**
+ * Decides whether a move was a blunder or missed a forced win. A move that throws away less
+ * than ANALYSIS_MARGIN is not a blunder: a four the search of one position has not answered
+ * yet swings the score by about that much, so smaller losses are mostly the horizon.
+ * @param m The analysed move, with its scores filled in.
+ * @return ANALYSIS_GOOD, ANALYSIS_BLUNDER or ANALYSIS_MISSED_WIN.
+*/
+unsigned char static judge(analysis_move* m) {
+    if (!m->known || m->depth == 0 || (m->x == m->best_x && m->y == m->best_y)) {
+        return ANALYSIS_GOOD;
+    }
+    if (m->best > SEARCH_WIN_BOUND && m->played <= SEARCH_WIN_BOUND) {
+        return ANALYSIS_MISSED_WIN;
+    }
+    if (m->best < -SEARCH_WIN_BOUND || m->played > SEARCH_WIN_BOUND) {
+        return ANALYSIS_GOOD;
+    }
+    if (m->played < -SEARCH_WIN_BOUND || m->best - m->played >= ANALYSIS_MARGIN) {
+        return ANALYSIS_BLUNDER;
+    }
+    return ANALYSIS_GOOD;
+}
+
+/**
+ * Analyses every move of a game.
+ * @param g The game.
+ * @param threads The number of workers.
+ * @param max_nodes The node budget of every position, or 0 for none.
+ * @param time_ms The time budget of every position in milliseconds, or 0 for none.
+ * @param solved The solved position cache the searches use, or NULL for none.
+ * @return One analysed move for every move of the game, which the caller frees, or NULL if
+ *         the analysis could not be run.
+*/
+analysis_move* analysis_run(game* g, int threads, unsigned long max_nodes, long time_ms, cache* solved) {
+    size_t positions = g->moves_count + 1;
+    if (threads < 1) {
+        threads = 1;
+    }
+    if ((size_t)threads > positions) {
+        threads = positions;
+    }
+
+    analysis_context c = {g, calloc(threads, sizeof(search*)), max_nodes, time_ms, malloc(sizeof(search_result) * positions)};
+    analysis_job* jobs = malloc(sizeof(analysis_job) * positions);
+    analysis_move* moves = malloc(sizeof(analysis_move) * positions);
+    game* replay = game_create(g->board->size, g->type);
+    bool ok = c.searches != NULL && c.results != NULL && jobs != NULL && moves != NULL && replay != NULL;
+    for (int w = 0; ok && w < threads; w++) {
+        c.searches[w] = search_create(ANALYSIS_TABLE_SIZE);
+        ok = c.searches[w] != NULL;
+        if (ok) {
+            c.searches[w]->cache = solved;
+        }
+    }
+
+    pool* p = ok ? pool_create(threads) : NULL;
+    if (p != NULL) {
+        for (size_t i = 0; i < positions; i++) {
+            search_result none = {SEARCH_NO_MOVE, SEARCH_NO_MOVE, 0, 0, 0};
+            c.results[i] = none;
+            jobs[i].c = &c;
+            jobs[i].position = i;
+            if (!pool_submit(p, analyze_position, &jobs[i])) {
+                ok = false;
+                break;
+            }
+        }
+        pool_wait(p);
+        pool_delete(p);
+    } else {
+        ok = false;
+    }
+
+    for (size_t i = 0; ok && i < g->moves_count; i++) {
+        analysis_move* m = &moves[i];
+        search_result* before = &c.results[i];
+        m->x = g->moves[i].x;
+        m->y = g->moves[i].y;
+        m->stone = replay->stone;
+        m->best_x = before->x;
+        m->best_y = before->y;
+        m->best = before->score;
+        m->depth = before->depth;
+        m->nodes = before->nodes;
+
+        game_place_stone(replay, m->x, m->y);
+        if (replay->state == GAME_STATE_FINISHED) {
+            m->known = true;
+            m->played = replay->winner == m->stone ? SEARCH_WIN - 1 : 0;
+        } else if (replay->state == GAME_STATE_FORBIDDEN) {
+            m->known = true;
+            m->played = -(SEARCH_WIN - 1);
+        } else {
+            m->known = c.results[i + 1].depth > 0;
+            m->played = move_score(c.results[i + 1].score);
+        }
+        if (m->known && m->depth > 0 && m->x == m->best_x && m->y == m->best_y) {
+            m->played = m->best;
+        }
+        m->note = judge(m);
+    }
+
+    if (c.searches != NULL) {
+        for (int w = 0; w < threads; w++) {
+            search_delete(c.searches[w]);
+        }
+    }
+    free(c.searches);
+    free(c.results);
+    free(jobs);
+    game_delete(replay);
+    if (!ok) {
+        free(moves);
+        return NULL;
+    }
+    return moves;
+}
@@ -0,0 +1,29 @@
+#ifndef _ANALYSIS_H_
+#define _ANALYSIS_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include "game.h"
+#include "search.h"
+#define ANALYSIS_TABLE_SIZE (1 << 16)
+#define ANALYSIS_NODES 10000
+#define ANALYSIS_MARGIN 3000
+#define ANALYSIS_GOOD 0
+#define ANALYSIS_BLUNDER 1
+#define ANALYSIS_MISSED_WIN 2
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+    unsigned char stone;
+    bool known;
+    int played;
+    unsigned char best_x;
+    unsigned char best_y;
+    int best;
+    int depth;
+    unsigned long nodes;
+    unsigned char note;
+} analysis_move;
+
+analysis_move* analysis_run(game* g, int threads, unsigned long max_nodes, long time_ms, cache* solved);
+#endif
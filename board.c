@@ -1,11 +1,10 @@
 /**
  * @file io.c
  * @author Faris Soliman
- * This file contains the methods used to create, delete, and print boards.
+ * This file contains the methods used to create and delete boards.
  * It also contains the methods used to convert between formal and board coordinates
  * and adding stones to the board.
  */
-#include <stdio.h>
 #include <stdlib.h>
 #include "board.h"
 #include "error-codes.h"
@@ -13,17 +12,19 @@
 /**
  * Creates a new board.
  * @param size The size of the board.
+ * @return The new board, or NULL if it could not be allocated.
 */
 board* board_create(unsigned char size) {
   board* b = malloc(sizeof(board));
   if (b == NULL) {
-    exit(NULL_POINTER_ERR);
+    return NULL;
   }
 
   b->size = size;
   b->grid = malloc(sizeof(unsigned char) * size * size);
   if (b->grid == NULL) {
-    exit(NULL_POINTER_ERR);
+    free(b);
+    return NULL;
   }
 
   for (int i = 0; i < size * size; i++) {
@@ -35,63 +36,17 @@ board* board_create(unsigned char size) {
 
 /**
  * Deletes a board.
- * @param b The board to delete.
+ * @param b The board to delete, or NULL.
 */
 void board_delete(board* b) {
   if (b == NULL) {
-    exit(NULL_POINTER_ERR);
+    return;
   }
 
   free(b->grid);
   free(b);
 }
 
-/**
- * Prints a board.
- * @param b The board to print.
- * @param in_place Whether to print the board in place.
-*/
-void board_print(board* b, bool in_place) {
-    if (in_place) {
-        clear();
-    }
-
-    for (int i = b->size - 1; i >= 0; i--) {
-        printf("%2d ", i + 1);
-        for (int j = 0; j < b->size; j++) {
-            switch (board_get(b, j, i)) {
-                case BLACK_STONE:
-                    if (j == b->size - 1)
-                        printf("\u25CF");
-                    else
-                        printf("\u25CF-");
-                    break;
-                case WHITE_STONE:
-                    if (j == b->size - 1)
-                        printf("\u25CB");
-                    else
-                        printf("\u25CB-");
-                    break;
-                default:
-                    if (j == b->size - 1)
-                        printf("+");
-                    else
-                        printf("+-");
-                    break;
-            }
-        }
-
-        printf("\n");
-    }
-
-    printf("   ");
-    for (int i = 0; i < b->size - 1; i++) {
-        printf("%c ", 'A' + i);
-    }
-    printf("%c", 'A' + b->size - 1);
-    printf("\n");
-}
-
 /**
  * Converts a board coordinate to a formal coordinate.
  * @param b The board to get the formal coordinate from.
@@ -141,8 +96,7 @@ unsigned char board_coord(board* b, const char* formal_coord, unsigned char* x,
  * @return The stone at the coordinate.
 */
 unsigned char board_get(board* b, unsigned char x, unsigned char y) {
-  if (x > b->size || y > b->size) {
-    printf("Coordinate error 1 \n");
+  if (x >= b->size || y >= b->size) {
     return COORDINATE_ERR;
   }
 
@@ -155,18 +109,36 @@ unsigned char board_get(board* b, unsigned char x, unsigned char y) {
  * @param x The x coordinate.
  * @param y The y coordinate.
  * @param stone The stone to set.
+ * @return SUCCESS, STONE_TYPE_ERR if the stone is not black or white, or COORDINATE_ERR if
+ *         the coordinate is off the board.
 */
-void board_set(board* b, unsigned char x, unsigned char y, unsigned char stone) {
+unsigned char board_set(board* b, unsigned char x, unsigned char y, unsigned char stone) {
     if (stone != BLACK_STONE && stone != WHITE_STONE) {
-        exit(STONE_TYPE_ERR);
+        return STONE_TYPE_ERR;
     }
 
-    if (x > b->size || y > b->size) {
-        printf("Coordinate error 2 \n");
-        exit(COORDINATE_ERR);
+    if (x >= b->size || y >= b->size) {
+        return COORDINATE_ERR;
     }
 
     b->grid[y * b->size + x] = stone;
+    return SUCCESS;
+}
+
+/**
+ * Removes the stone at a coordinate.
+ * @param b The board to remove the stone from.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return SUCCESS, or COORDINATE_ERR if the coordinate is off the board.
+*/
+unsigned char board_clear(board* b, unsigned char x, unsigned char y) {
+    if (x >= b->size || y >= b->size) {
+        return COORDINATE_ERR;
+    }
+
+    b->grid[y * b->size + x] = EMPTY_INTERSECTION;
+    return SUCCESS;
 }
 
 /**
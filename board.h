@@ -4,7 +4,6 @@
 #define EMPTY_INTERSECTION 0
 #define BLACK_STONE 1
 #define WHITE_STONE 2
-#define clear() printf("\033[H\033[J")
 
 typedef struct {
     unsigned char size;
@@ -13,10 +12,10 @@ typedef struct {
 
 board* board_create(unsigned char size);
 void board_delete(board* b);
-void board_print(board* b, bool in_place);
 unsigned char board_formal_coord(board* b, unsigned char x, unsigned char y, char* formal_coord);
 unsigned char board_coord(board* b, const char* formal_coord, unsigned char* x, unsigned char* y);
 unsigned char board_get(board* b, unsigned char x, unsigned char y);
-void board_set(board* b, unsigned char x, unsigned char y, unsigned char stone);
+unsigned char board_set(board* b, unsigned char x, unsigned char y, unsigned char stone);
+unsigned char board_clear(board* b, unsigned char x, unsigned char y);
 bool board_is_full(board* b);
 #endif
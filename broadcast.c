@@ -0,0 +1,330 @@
+/**
+ * @file broadcast.c
+ * @author Faris Soliman
+ * This file contains the spectator broadcast. A game being played can publish its moves to a
+ * ring of events in POSIX shared memory, as game_place_stone() and game_undo() make them, and
+ * any number of spectators on the same machine can map the ring and follow the game. The game
+ * writes every event once, into the ring, whatever the number of spectators, and never waits
+ * for them; a spectator keeps its own place in the ring and renders the board itself.
+ *
+ * There is one writer, so the ring needs no locks. Every slot carries the sequence number of
+ * the event in it, which the writer clears before it writes the slot and sets after, so a
+ * spectator that was so slow the writer came round and wrote over the event it was reading
+ * sees the number change and knows it fell behind. The ring also keeps the moves of the game,
+ * under a sequence count that is odd while they change, so a spectator that joins late or
+ * fell behind can pick the game up from there and go on from the event after it.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "broadcast.h"
+
+/**
+ * Checks if the game publishing to a ring is still running.
+ * @param r The ring.
+ * @return Whether its process is still there.
+*/
+bool static writer_alive(const broadcast_ring* r) {
+    return kill(r->pid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * Finds out which game a name belongs to, by mapping the ring under it.
+ * @param name The name.
+ * @param alive Where to put whether the game is still running, or NULL.
+ * @return The process of the game, or 0 if there is nothing under the name or it is not a
+ *         ring that has been set up.
+*/
+pid_t static name_owner(const char* name, bool* alive) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size != sizeof(broadcast_ring)) {
+        close(fd);
+        return 0;
+    }
+    broadcast_ring* r = mmap(NULL, sizeof(broadcast_ring), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r == MAP_FAILED) {
+        return 0;
+    }
+
+    // The pid goes in before the magic, so a ring a game is still setting up has it already.
+    pid_t pid = r->pid;
+    if (pid != 0 && alive != NULL) {
+        *alive = writer_alive(r);
+    }
+    munmap(r, sizeof(broadcast_ring));
+    return pid;
+}
+
+/**
+ * Sleeps for a moment while waiting for the writer.
+*/
+void static pause_briefly(void) {
+    struct timespec ts = {0, 1000000};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Starts broadcasting a game under a name, replacing whatever was left under it by a game
+ * that did not end cleanly. The moves already played are there for spectators to pick up.
+ * @param name The name of the shared memory object, starting with a '/'.
+ * @param g The game.
+ * @return The broadcast, or NULL with errno set if the shared memory could not be set up,
+ *         EBUSY if a game that is still running broadcasts under the name.
+*/
+broadcast* broadcast_open(const char* name, game* g) {
+    broadcast* b = malloc(sizeof(broadcast));
+    char* copy = malloc(strlen(name) + 1);
+    if (b == NULL || copy == NULL) {
+        free(b);
+        free(copy);
+        return NULL;
+    }
+    strcpy(copy, name);
+    b->name = copy;
+
+    bool alive = false;
+    if (name_owner(name, &alive) != 0 && alive) {
+        free(copy);
+        free(b);
+        errno = EBUSY;
+        return NULL;
+    }
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(broadcast_ring)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        free(copy);
+        free(b);
+        return NULL;
+    }
+    b->ring = mmap(NULL, sizeof(broadcast_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (b->ring == MAP_FAILED) {
+        shm_unlink(name);
+        free(copy);
+        free(b);
+        return NULL;
+    }
+
+    // The object starts out zeroed; the magic goes in last, so a spectator that sees it sees
+    // the rest.
+    broadcast_ring* r = b->ring;
+    r->version = BROADCAST_VERSION;
+    r->size = g->board->size;
+    r->type = g->type;
+    r->pid = getpid();
+    r->moves_count = g->moves_count;
+    r->state = g->state;
+    r->winner = g->winner;
+    for (size_t i = 0; i < g->moves_count; i++) {
+        r->moves[i][0] = g->moves[i].x;
+        r->moves[i][1] = g->moves[i].y;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(r->magic, BROADCAST_MAGIC, sizeof(r->magic));
+    return b;
+}
+
+/**
+ * Publishes an event of a game, after the game has made it: the moves kept in the ring are
+ * brought up to date and the event goes into the next slot.
+ * @param b The broadcast.
+ * @param g The game.
+ * @param op BROADCAST_MOVE with the coordinates of the move, BROADCAST_UNDO with those of the
+ *        move taken back, or BROADCAST_END.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+*/
+void broadcast_publish(broadcast* b, game* g, unsigned char op, unsigned char x, unsigned char y) {
+    broadcast_ring* r = b->ring;
+    uint64_t seq = r->head;
+    broadcast_event* e = &r->events[seq % BROADCAST_EVENTS];
+
+    __atomic_store_n(&r->snapshot, r->snapshot + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (op == BROADCAST_MOVE) {
+        r->moves[g->moves_count - 1][0] = x;
+        r->moves[g->moves_count - 1][1] = y;
+    }
+    r->moves_count = g->moves_count;
+    r->state = g->state;
+    r->winner = g->winner;
+    r->ended = op == BROADCAST_END;
+
+    e->hash = game_hash(g);
+    e->moves = g->moves_count;
+    e->op = op;
+    e->x = x;
+    e->y = y;
+    e->stone = op == BROADCAST_END ? EMPTY_INTERSECTION : op == BROADCAST_MOVE ? g->moves[g->moves_count - 1].stone : g->stone;
+    e->state = g->state;
+    e->winner = g->winner;
+
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->head, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->snapshot, r->snapshot + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Ends a broadcast with the final state of the game and removes its name, unless the name
+ * has been taken over by another game since. Spectators still attached keep the ring until
+ * they detach.
+ * @param b The broadcast, or NULL.
+ * @param g The game.
+*/
+void broadcast_close(broadcast* b, game* g) {
+    if (b == NULL) {
+        return;
+    }
+
+    broadcast_publish(b, g, BROADCAST_END, 0, 0);
+    munmap(b->ring, sizeof(broadcast_ring));
+    if (name_owner(b->name, NULL) == getpid()) {
+        shm_unlink(b->name);
+    }
+    free(b->name);
+    free(b);
+}
+
+/**
+ * Attaches a spectator to a broadcast. Nothing is read from it until broadcast_sync().
+ * @param name The name the game is broadcast under.
+ * @return The view of the broadcast, or NULL with errno set if there is none, ENOENT if
+ *         nothing is broadcast under the name and EINVAL if it is not a broadcast.
+*/
+broadcast_view* broadcast_attach(const char* name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    // A game that has only just created the object has not sized it yet.
+    struct stat st;
+    bool stated = fstat(fd, &st) == 0;
+    if (!stated || st.st_size != sizeof(broadcast_ring)) {
+        close(fd);
+        errno = stated && st.st_size == 0 ? ENOENT : EINVAL;
+        return NULL;
+    }
+    broadcast_ring* r = mmap(NULL, sizeof(broadcast_ring), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (r == MAP_FAILED) {
+        return NULL;
+    }
+
+    // A game that is still setting the ring up has not written the magic yet.
+    bool ready = memcmp(r->magic, BROADCAST_MAGIC, sizeof(r->magic)) == 0;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    broadcast_view* v = malloc(sizeof(broadcast_view));
+    if (!ready || r->version != BROADCAST_VERSION || v == NULL) {
+        munmap(r, sizeof(broadcast_ring));
+        free(v);
+        errno = ready ? EINVAL : ENOENT;
+        return NULL;
+    }
+    v->ring = r;
+    v->next = 0;
+    return v;
+}
+
+/**
+ * Detaches a spectator from a broadcast.
+ * @param v The view, or NULL.
+*/
+void broadcast_detach(broadcast_view* v) {
+    if (v == NULL) {
+        return;
+    }
+    munmap((void*)v->ring, sizeof(broadcast_ring));
+    free(v);
+}
+
+/**
+ * Picks the game up as it is now, from the moves kept in the ring, and moves the spectator's
+ * place to the event after, or to the end of the game if it is over.
+ * @param v The view.
+ * @return The game, or NULL if it could not be allocated or the game is gone.
+*/
+game* broadcast_sync(broadcast_view* v) {
+    const broadcast_ring* r = v->ring;
+    unsigned char moves[BROADCAST_MAX_MOVES][2];
+    size_t count;
+    unsigned char state;
+    unsigned char winner;
+    uint64_t head;
+    bool ended;
+    while (true) {
+        uint32_t before = __atomic_load_n(&r->snapshot, __ATOMIC_ACQUIRE);
+        if (before % 2 == 0) {
+            count = r->moves_count;
+            state = r->state;
+            winner = r->winner;
+            head = r->head;
+            ended = r->ended;
+            memcpy(moves, r->moves, (count < BROADCAST_MAX_MOVES ? count : BROADCAST_MAX_MOVES) * 2);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&r->snapshot, __ATOMIC_RELAXED) == before && count <= BROADCAST_MAX_MOVES) {
+                break;
+            }
+        } else if (!writer_alive(r)) {
+            return NULL;
+        }
+        pause_briefly();
+    }
+
+    game* g = game_create(r->size, r->type);
+    if (g == NULL) {
+        return NULL;
+    }
+    for (size_t i = 0; i < count && g->state == GAME_STATE_PLAYING; i++) {
+        game_place_stone(g, moves[i][0], moves[i][1]);
+    }
+    g->state = state;
+    g->winner = winner;
+
+    // The end is left to be read, so a spectator that picks up a game that is over sees it end.
+    v->next = ended ? head - 1 : head;
+    return g;
+}
+
+/**
+ * Reads the spectator's next event, without waiting for it.
+ * @param v The view.
+ * @param e Where to put the event.
+ * @return BROADCAST_EVENT if there was one, BROADCAST_NONE if the game has not made it yet,
+ *         BROADCAST_LAPPED if it was written over before it was read, so the spectator has
+ *         to broadcast_sync(), or BROADCAST_GONE if the game ended without ending the
+ *         broadcast.
+*/
+int broadcast_next(broadcast_view* v, broadcast_event* e) {
+    const broadcast_ring* r = v->ring;
+    if (v->next >= __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) {
+        return writer_alive(r) ? BROADCAST_NONE : BROADCAST_GONE;
+    }
+
+    const broadcast_event* slot = &r->events[v->next % BROADCAST_EVENTS];
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    *e = *slot;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (seq != v->next + 1 || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+        return BROADCAST_LAPPED;
+    }
+    v->next++;
+    return BROADCAST_EVENT;
+}
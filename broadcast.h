@@ -0,0 +1,67 @@
+#ifndef _BROADCAST_H_
+#define _BROADCAST_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "game.h"
+#include "pattern.h"
+#define BROADCAST_MAGIC "GMKCAST"
+#define BROADCAST_VERSION 1
+#define BROADCAST_EVENTS 256
+#define BROADCAST_MAX_MOVES (PATTERN_MAX_SIZE * PATTERN_MAX_SIZE)
+#define BROADCAST_POLL_MS 10
+#define BROADCAST_MOVE 1
+#define BROADCAST_UNDO 2
+#define BROADCAST_END 3
+#define BROADCAST_NONE 0
+#define BROADCAST_EVENT 1
+#define BROADCAST_LAPPED 2
+#define BROADCAST_GONE 3
+
+typedef struct {
+    uint64_t seq;
+    uint64_t hash;
+    uint16_t moves;
+    unsigned char op;
+    unsigned char x;
+    unsigned char y;
+    unsigned char stone;
+    unsigned char state;
+    unsigned char winner;
+} broadcast_event;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    unsigned char size;
+    unsigned char type;
+    unsigned char reserved[2];
+    pid_t pid;
+    uint32_t snapshot;
+    uint64_t head;
+    uint16_t moves_count;
+    unsigned char state;
+    unsigned char winner;
+    bool ended;
+    unsigned char moves[BROADCAST_MAX_MOVES][2];
+    broadcast_event events[BROADCAST_EVENTS];
+} broadcast_ring;
+
+typedef struct broadcast {
+    char* name;
+    broadcast_ring* ring;
+} broadcast;
+
+typedef struct {
+    const broadcast_ring* ring;
+    uint64_t next;
+} broadcast_view;
+
+broadcast* broadcast_open(const char* name, game* g);
+void broadcast_publish(broadcast* b, game* g, unsigned char op, unsigned char x, unsigned char y);
+void broadcast_close(broadcast* b, game* g);
+broadcast_view* broadcast_attach(const char* name);
+void broadcast_detach(broadcast_view* v);
+game* broadcast_sync(broadcast_view* v);
+int broadcast_next(broadcast_view* v, broadcast_event* e);
+#endif
@@ -0,0 +1,234 @@
+/**
+ * @file cache.c
+ * @author Faris Soliman
+ * This file contains the solved position cache: a fixed size open addressing hash table in a
+ * file that every process maps with mmap, so results proven by one search are there for every
+ * other search, in the same run or a later one, in this process or another one.
+ *
+ * The file starts with a versioned header followed by the slots. A slot holds the packed
+ * result and its key xored with it. Writers store the two words one after the other without
+ * locking; a reader that catches a slot halfway through an update, or two writers racing for
+ * one slot, ends up with a key that matches nothing, which reads as a miss.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "cache.h"
+#include "hash.h"
+
+/**
+ * Takes or releases the lock on the whole cache file.
+ * @param fd The file.
+ * @param type F_WRLCK to take the lock or F_UNLCK to release it.
+ * @return Whether it worked.
+*/
+bool static lock_file(int fd, short type) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = type;
+    lock.l_whence = SEEK_SET;
+    return fcntl(fd, F_SETLKW, &lock) == 0;
+}
+
+/**
+ * Sets up a new cache file, or checks the header of an existing one. The caller holds the
+ * file lock, so two processes never set up the same file.
+ * @param fd The file.
+ * @param slots The number of slots for a new file.
+ * @param header Where to put the header.
+ * @return Whether the file is a usable cache.
+*/
+bool static prepare_file(int fd, uint64_t slots, cache_header* header) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        memset(header, 0, sizeof(cache_header));
+        memcpy(header->magic, CACHE_MAGIC, sizeof(header->magic));
+        header->version = CACHE_VERSION;
+        header->slot_size = sizeof(cache_slot);
+        header->slots = slots;
+        return ftruncate(fd, sizeof(cache_header) + slots * sizeof(cache_slot)) == 0 &&
+            pwrite(fd, header, sizeof(cache_header), 0) == sizeof(cache_header);
+    }
+
+    if (pread(fd, header, sizeof(cache_header), 0) != sizeof(cache_header)) {
+        return false;
+    }
+    return memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+        header->version == CACHE_VERSION &&
+        header->slot_size == sizeof(cache_slot) &&
+        header->slots >= CACHE_PROBES && (header->slots & (header->slots - 1)) == 0 &&
+        (uint64_t)st.st_size == sizeof(cache_header) + header->slots * sizeof(cache_slot);
+}
+
+/**
+ * Opens a cache file, creating it if it does not exist yet.
+ * @param path The path to the file.
+ * @param slots The number of slots of a new file, rounded down to a power of two. An existing
+ *        file keeps its own size.
+ * @return The cache, or NULL if the file could not be opened, created or mapped, or is not a
+ *         cache of this version.
+*/
+cache* cache_open(const char* path, uint64_t slots) {
+    uint64_t size = CACHE_PROBES;
+    while (size * 2 <= slots) {
+        size *= 2;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    cache_header header;
+    if (!lock_file(fd, F_WRLCK)) {
+        close(fd);
+        return NULL;
+    }
+    bool usable = prepare_file(fd, size, &header);
+    lock_file(fd, F_UNLCK);
+    if (!usable) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t length = sizeof(cache_header) + header.slots * sizeof(cache_slot);
+    void* map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    cache* c = malloc(sizeof(cache));
+    if (c == NULL) {
+        munmap(map, length);
+        close(fd);
+        return NULL;
+    }
+
+    c->fd = fd;
+    c->length = length;
+    c->header = map;
+    c->slots = (cache_slot*)((char*)map + sizeof(cache_header));
+    c->mask = header.slots - 1;
+    return c;
+}
+
+/**
+ * Closes a cache. What was stored stays in the file.
+ * @param c The cache to close.
+*/
+void cache_close(cache* c) {
+    if (c == NULL) {
+        return;
+    }
+
+    munmap(c->header, c->length);
+    close(c->fd);
+    free(c);
+}
+
+/**
+ * Packs an entry into a slot word. The result is never 0, so neither is the word.
+ * @param e The entry.
+ * @return The word.
+*/
+uint64_t static pack(const cache_entry* e) {
+    return (uint64_t)e->result | (uint64_t)e->x << 8 | (uint64_t)e->y << 16 | (uint64_t)e->depth << 24 |
+        (uint64_t)e->proof << 32;
+}
+
+/**
+ * Gets the key of a position in the cache. Games of every rule set and size share the file,
+ * and the hash of a position only covers its stones, whose indices depend on the size, so
+ * both go into the key, as they do in the position index.
+ * @param game_type The rule set.
+ * @param board_size The size of the board.
+ * @param hash The canonical hash of the position.
+ * @return The key.
+*/
+uint64_t static position_key(unsigned char game_type, unsigned char board_size, uint64_t hash) {
+    return hash ^ hash_rules(game_type) ^ hash_key(EMPTY_INTERSECTION, board_size);
+}
+
+/**
+ * Reads a slot.
+ * @param slot The slot.
+ * @param key Where to put the key of what the slot holds.
+ * @return The packed entry, or 0 if the slot is empty.
+*/
+uint64_t static read_slot(cache_slot* slot, uint64_t* key) {
+    uint64_t data = __atomic_load_n(&slot->data, __ATOMIC_ACQUIRE);
+    uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_ACQUIRE);
+    *key = check ^ data;
+    return data;
+}
+
+/**
+ * Looks up the proven result of a position.
+ * @param c The cache.
+ * @param game_type The rule set.
+ * @param board_size The size of the board.
+ * @param hash The canonical hash of the position, from game_canonical_hash().
+ * @param e Where to put the result.
+ * @return Whether the position was found.
+*/
+bool cache_lookup(cache* c, unsigned char game_type, unsigned char board_size, uint64_t hash, cache_entry* e) {
+    uint64_t key = position_key(game_type, board_size, hash);
+    for (int p = 0; p < CACHE_PROBES; p++) {
+        uint64_t found;
+        uint64_t data = read_slot(&c->slots[(key + p) & c->mask], &found);
+        if (data != 0 && found == key) {
+            e->result = data & 0xFF;
+            e->x = (data >> 8) & 0xFF;
+            e->y = (data >> 16) & 0xFF;
+            e->depth = (data >> 24) & 0xFF;
+            e->proof = (data >> 32) & 0xFF;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Stores the proven result of a position. It goes in the slot that already holds the
+ * position, or else an empty slot, or else over the shortest proof among the probed slots.
+ * @param c The cache.
+ * @param game_type The rule set.
+ * @param board_size The size of the board.
+ * @param hash The canonical hash of the position, from game_canonical_hash().
+ * @param e The result, which must be CACHE_WIN, CACHE_LOSS or CACHE_DRAW for the color to
+ *        move, with the best move in the canonical frame, the length of the proof in plies and
+ *        how it was proven: CACHE_BY_SEARCH, or CACHE_BY_VCF or CACHE_BY_VCT by the solver.
+*/
+void cache_store(cache* c, unsigned char game_type, unsigned char board_size, uint64_t hash, const cache_entry* e) {
+    uint64_t key = position_key(game_type, board_size, hash);
+    cache_slot* victim = NULL;
+    unsigned int victim_depth = 256;
+
+    for (int p = 0; p < CACHE_PROBES; p++) {
+        cache_slot* slot = &c->slots[(key + p) & c->mask];
+        uint64_t found;
+        uint64_t data = read_slot(slot, &found);
+        if (data == 0 || found == key) {
+            victim = slot;
+            break;
+        }
+        if (((data >> 24) & 0xFF) < victim_depth) {
+            victim = slot;
+            victim_depth = (data >> 24) & 0xFF;
+        }
+    }
+
+    uint64_t data = pack(e);
+    __atomic_store_n(&victim->data, data, __ATOMIC_RELEASE);
+    __atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,50 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#define CACHE_MAGIC "GMKCACHE"
+#define CACHE_VERSION 5
+#define CACHE_SLOTS (1 << 20)
+#define CACHE_PROBES 4
+#define CACHE_WIN 1
+#define CACHE_LOSS 2
+#define CACHE_DRAW 3
+#define CACHE_BY_SEARCH 0
+#define CACHE_BY_VCF 1
+#define CACHE_BY_VCT 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_size;
+    uint64_t slots;
+    uint64_t reserved[5];
+} cache_header;
+
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} cache_slot;
+
+typedef struct {
+    unsigned char result;
+    unsigned char x;
+    unsigned char y;
+    unsigned char depth;
+    unsigned char proof;
+} cache_entry;
+
+typedef struct {
+    int fd;
+    size_t length;
+    cache_header* header;
+    cache_slot* slots;
+    uint64_t mask;
+} cache;
+
+cache* cache_open(const char* path, uint64_t slots);
+void cache_close(cache* c);
+bool cache_lookup(cache* c, unsigned char game_type, unsigned char board_size, uint64_t hash, cache_entry* e);
+void cache_store(cache* c, unsigned char game_type, unsigned char board_size, uint64_t hash, const cache_entry* e);
+#endif
@@ -0,0 +1,187 @@
+/**
+ * @file cluster.c
+ * @author Faris Soliman
+ * This file is a tool that searches the position of a saved game across worker processes with
+ * the coordinator in split.c. The workers are started on this machine with -l, or reached at
+ * the addresses given, where "cluster -w" runs them. A worker serves one coordinator per
+ * connection, each in a process of its own, until it is stopped.
+ *
+ * It prints the best move with its score, and with -v, every iteration as it completes.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "board.h"
+#include "console.h"
+#include "error-codes.h"
+#include "game.h"
+#include "pool.h"
+#include "search.h"
+#include "split.h"
+#define CLUSTER_DEPTH 6
+
+/**
+ * Writes a search score: a win or loss as the number of plies to the five.
+ * @param score The score.
+ * @param out Where to write it.
+*/
+void static format_score(int score, char* out) {
+    if (score > SEARCH_WIN_BOUND) {
+        sprintf(out, "win %d", SEARCH_WIN - score);
+    } else if (score < -SEARCH_WIN_BOUND) {
+        sprintf(out, "loss %d", SEARCH_WIN + score);
+    } else {
+        sprintf(out, "%d", score);
+    }
+}
+
+/**
+ * Prints an iteration as it completes.
+ * @param arg Unused.
+ * @param p The iteration.
+*/
+void static report(void* arg, const split_progress* p) {
+    char score[24];
+    format_score(p->score, score);
+    fprintf(stderr, "depth %2d  %c%-2d %10s %12lu nodes %8lld ms\n", p->depth, p->x + 'A', p->y + 1, score, p->nodes,
+        p->elapsed_ms);
+}
+
+/**
+ * Runs a worker: serves every coordinator that connects, each in a child process.
+ * @param address Where to listen.
+ * @return The exit code, if the socket could not be opened.
+*/
+int static serve(const char* address) {
+    int listener = split_listen(address);
+    if (listener < 0) {
+        fprintf(stderr, "Cannot listen on %s\n", address);
+        return FILE_INPUT_ERR;
+    }
+
+    // Children are not waited for.
+    signal(SIGCHLD, SIG_IGN);
+    while (true) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            _exit(split_serve(fd, SEARCH_TABLE_SIZE) ? 0 : 1);
+        }
+        close(fd);
+    }
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int local = 0;
+    int depth = CLUSTER_DEPTH;
+    long time_ms = 0;
+    bool verbose = false;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    if (argc == 3 && strcmp(argv[1], "-w") == 0) {
+        return serve(argv[2]);
+    }
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-l") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            local = atoi(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-d") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0 &&
+            atoi(argv[first + 1]) <= SEARCH_MAX_DEPTH) {
+            depth = atoi(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-t") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            time_ms = atol(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-v") == 0) {
+            verbose = true;
+            first++;
+        } else if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+        } else {
+            first = argc;
+        }
+    }
+    if (first >= argc || local + argc - first - 1 > SPLIT_MAX_WORKERS) {
+        fprintf(stdout, "usage: %s [-l workers] [-d depth] [-t ms] [-v] [-q] [host:port]... <saved-match.gmk>\n"
+            "       %s -w [host:]port\n", argv[0], argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // Load the position. A stopped game goes on from where it stopped.
+    game* g = console_import(argv[argc - 1]);
+    if (g->state == GAME_STATE_STOPPED) {
+        g->state = GAME_STATE_PLAYING;
+    }
+
+    // Reach the workers, with one per core on this machine if none are given.
+    split* sp = split_create();
+    if (sp == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    for (int i = first; i < argc - 1; i++) {
+        int fd = split_connect(argv[i]);
+        if (fd < 0 || !split_add_worker(sp, fd)) {
+            fprintf(stderr, "Cannot reach %s\n", argv[i]);
+            split_delete(sp);
+            return FILE_INPUT_ERR;
+        }
+    }
+    if (local == 0 && sp->count == 0) {
+        local = pool_default_threads();
+    }
+    if (!split_spawn(sp, local, SEARCH_TABLE_SIZE)) {
+        fprintf(stderr, "Cannot start the workers\n");
+        split_delete(sp);
+        return NULL_POINTER_ERR;
+    }
+    if (verbose) {
+        sp->report = report;
+    }
+
+    split_result r = split_run(sp, g, depth, time_ms);
+
+    printf("Position:            %s, %s to move\n", g->type == GAME_RENJU ? "renju" : "freestyle",
+        g->stone == BLACK_STONE ? "black" : "white");
+    printf("Workers:             %d\n", sp->count);
+    if (r.x == SEARCH_NO_MOVE) {
+        printf("Move:                none\n");
+    } else {
+        char score[24];
+        format_score(r.score, score);
+        printf("Move:                %c%d\n", r.x + 'A', r.y + 1);
+        printf("Score:               %s\n", score);
+        printf("Depth:               %d\n", r.depth);
+    }
+    if (sp->lost > 0) {
+        printf("Lost:                %lu workers\n", sp->lost);
+    }
+    if (!quiet) {
+        printf("\n%lu nodes in %lld ms, %.0f nodes/sec, %lu jobs, %lu searched again\n", r.nodes, r.elapsed_ms,
+            r.elapsed_ms > 0 ? r.nodes * 1000.0 / r.elapsed_ms : 0.0, sp->jobs, sp->researches);
+        for (int i = 0; i < sp->count; i++) {
+            printf("Worker %-2d %10lu jobs %12lu nodes\n", i + 1, sp->workers[i].jobs, sp->workers[i].nodes);
+        }
+    }
+
+    int status = sp->alive == 0 ? FILE_INPUT_ERR : SUCCESS;
+    split_delete(sp);
+    game_delete(g);
+    return status;
+}
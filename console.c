@@ -0,0 +1,417 @@
+/**
+ * @file console.c
+ * @author Faris Soliman
+ * This file contains the console frontend shared by the gomoku, renju and replay programs:
+ * printing the board, reading moves from the players, the game loop with or without a
+ * computer opponent, and replaying saved games. It is the only part of the game that reads
+ * input, prints or exits; the rules it drives are in libgomoku.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "analysis.h"
+#include "board.h"
+#include "console.h"
+#include "engine.h"
+#include "error-codes.h"
+#include "eval.h"
+#include "game.h"
+#include "io.h"
+#include "journal.h"
+#include "search.h"
+
+/**
+ * Prints a board.
+ * @param b The board to print.
+ * @param in_place Whether to print the board in place.
+*/
+void board_print(board* b, bool in_place) {
+    if (in_place) {
+        clear();
+    }
+
+    for (int i = b->size - 1; i >= 0; i--) {
+        printf("%2d ", i + 1);
+        for (int j = 0; j < b->size; j++) {
+            switch (board_get(b, j, i)) {
+                case BLACK_STONE:
+                    if (j == b->size - 1)
+                        printf("\u25CF");
+                    else
+                        printf("\u25CF-");
+                    break;
+                case WHITE_STONE:
+                    if (j == b->size - 1)
+                        printf("\u25CB");
+                    else
+                        printf("\u25CB-");
+                    break;
+                default:
+                    if (j == b->size - 1)
+                        printf("+");
+                    else
+                        printf("+-");
+                    break;
+            }
+        }
+
+        printf("\n");
+    }
+
+    printf("   ");
+    for (int i = 0; i < b->size - 1; i++) {
+        printf("%c ", 'A' + i);
+    }
+    printf("%c", 'A' + b->size - 1);
+    printf("\n");
+}
+
+/**
+ * Checks if an input is valid.
+ * @param input The input to check.
+ * @return Whether the input is valid.
+*/
+bool static isValidInput(char* input, game* game) {
+    if (strlen(input) == 0) {
+        return false;
+    }
+    
+    if (input[0] < 'A' || input[0] > game->board->size + 'A' - 1) {
+        return false;
+    }
+
+    unsigned char y = 0;
+    sscanf(input + 1, "%hhu", &y);
+
+    if (y <= 0 || y > game->board->size) {
+        return false;
+    }
+    
+    if (strcmp(input, "EOF") == 0) {
+        return true;
+    }
+    
+    if (board_get(game->board, input[0] - 'A', y - 1) != EMPTY_INTERSECTION) {
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * Imports a game from a file for a frontend. If the file cannot be read, the reason is printed
+ * to stderr and the program exits with FILE_INPUT_ERR.
+ * @param path The path to the file.
+ * @return The game.
+*/
+game* console_import(const char* path) {
+    parse_error err;
+    game* g = game_import(path, &err);
+    if (g == NULL) {
+        if (err.line > 0) {
+            fprintf(stderr, "%s:%d: %s\n", path, err.line, err.reason);
+        } else {
+            fprintf(stderr, "%s: %s\n", path, err.reason);
+        }
+        exit(FILE_INPUT_ERR);
+    }
+    return g;
+}
+
+/**
+ * This function controls what happens in the game at each turn. 
+ * @param g The game to update.
+ * @return Whether the game is updated.
+*/
+bool game_update(game* g) {
+    if (g->state != GAME_STATE_PLAYING) {
+        return false;
+    }
+
+    // The human may take any time to answer, so the moves so far go to the disk before waiting.
+    if (g->journal != NULL) {
+        journal_sync(g->journal);
+    }
+
+    char input[5] = "";
+    bool entered = false;
+    if (g->stone == BLACK_STONE) {
+        printf("Black stone's turn, please enter a move: ");
+    } else {
+        printf("White stone's turn, please enter a move: ");
+    }
+
+    //Prompt until a valid input is entered
+    while (fgets(input, 5, stdin)) {
+        if (isValidInput(input, g)) {
+            entered = true;
+            break;
+        } else if (input[0] == 'E' && input[1] == 'O' && input[2] == 'F') {
+            printf("The game is stopped.\n");
+            g->state = GAME_STATE_STOPPED;
+            return false;
+        } else {
+            printf("The coordinate you entered is invalid, please try again.\n");
+        }
+        if (g->stone == BLACK_STONE) {
+            printf("Black stone's turn, please enter a move: ");
+        } else {
+            printf("White stone's turn, please enter a move: ");
+        }
+    }
+
+    // The input ran out before a valid move was entered.
+    if (!entered) {
+        printf("The game is stopped.\n");
+        g->state = GAME_STATE_STOPPED;
+        return false;
+    }
+
+    unsigned char value;
+    sscanf(input + 1, "%hhu", &value);
+    game_place_stone(g, input[0] - 'A', value - 1);
+
+    return true;
+}
+
+/**
+ * Plays one turn of a game: reads the move from the human whose turn it is, or lets the
+ * computer opponent move if the game has one and it is its turn. The computer ponders while
+ * the human thinks.
+ * @param g The game to update.
+ * @return Whether the game is updated.
+*/
+bool static console_turn(game* g) {
+    engine* e = g->engine;
+    if (e == NULL) {
+        return game_update(g);
+    }
+    if (g->state != GAME_STATE_PLAYING) {
+        return false;
+    }
+
+    if (g->stone != e->stone) {
+        engine_ponder_start(e, g);
+        bool updated = game_update(g);
+        engine_ponder_finish(e, g);
+        return updated;
+    }
+    return engine_play(e, g) == SUCCESS;
+}
+
+/**
+ * This function controls the game loop as the name suggests,
+ * @param g The game to loop.
+*/
+void game_loop(game* g) {
+    while (console_turn(g)) {
+        board_print(g->board, true);
+    }
+
+    if (g->state == GAME_STATE_FINISHED) {
+        printf("Game concluded, %s won.\n", g->winner == BLACK_STONE ? "black" : "white");
+    } else if (g->state == GAME_STATE_FORBIDDEN) {
+        printf("Game concluded, black made a forbidden move, white won.\n");
+    }
+}
+
+/**
+ * Function resumes a new game from a saved file.
+ * @param g The game to resume.
+ * @return Whether the game is resumed.
+*/
+void game_resume(game* g) {
+
+  if (g->state != GAME_STATE_STOPPED) {
+    exit(RESUME_ERR);
+  }
+
+  if (g->type != GAME_FREESTYLE && g->type != GAME_RENJU) {
+    exit(RESUME_ERR);
+  }
+
+  g->state = GAME_STATE_PLAYING;
+  game_loop(g);
+}
+
+/**
+ * This function replays a saved game. You should create a new game struct, and re-make moves saved in g, pause 1 second before making every move (this can be done by including a POSIX header unistd.h and call function sleep()). This function should act largely the same as game_loop() except it doesn't read user input, and prints extra information as specified in section Replay Saved Games.
+*/
+void game_replay(game* g) {
+    if (g->state == GAME_STATE_PLAYING) {
+        printf("Input error 1 \n");
+        exit(INPUT_ERR);
+    }
+    
+    if (g->type != GAME_FREESTYLE && g->type != GAME_RENJU) {
+        printf("Input error 2 \n");
+        exit(INPUT_ERR);
+    }
+    
+    game* g2 = game_create(g->board->size, g->type);
+
+    for (int i = 0; i < g->moves_count - 1; i++) {
+        game_place_stone(g2, g->moves[i].x, g->moves[i].y);
+        board_print(g2->board, true);
+
+        printf("Moves:\n");
+        for (int j = 0; j <= i; j++) {
+            char move[15];
+            if (g->moves[j].y + 1 >= 10) {
+                sprintf(move, " %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
+            } else {
+                sprintf(move, "  %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
+            }
+
+            if (j % 2 == 0) {
+                printf("%6s%4s", "Black:", move);
+            } else {
+                printf("  %6s%4s\n", "White:", move);
+            }
+        }
+    }
+
+    game_place_stone(g2, g->moves[g->moves_count - 1].x, g->moves[g->moves_count - 1].y);
+    board_print(g2->board, true);
+
+    if (g->state == GAME_STATE_FORBIDDEN) {
+        printf("Game concluded, black made a forbidden move, white won.\n");
+    } else if (g->state == GAME_STATE_FINISHED) {
+        printf("Game concluded, %s won.\n", g->winner == BLACK_STONE ? "black" : "white");
+    } else {
+        printf("The game is stopped.\n");
+    }
+
+    printf("Moves:\n");
+    for (int j = 0; j <= g->moves_count - 1; j++) {
+        char move[15];
+        if (g->moves[j].y + 1 >= 10) {
+            sprintf(move, " %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
+        } else {
+            sprintf(move, "  %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
+        }
+
+        if (j % 2 == 0) {
+            printf("%6s%4s", "Black:", move);
+        } else {
+            printf("  %6s%4s\n", "White:", move);
+        }
+    }
+
+    if (g->moves_count % 2 != 0)
+        printf("\n");
+    game_delete(g2);
+}
+
+/**
+ * This function replays a saved game without drawing the board, printing the static evaluation
+ * after every move. Positive scores favour black.
+ * @param g The game to replay.
+*/
+void game_replay_eval(game* g) {
+    if (g->type != GAME_FREESTYLE && g->type != GAME_RENJU) {
+        exit(INPUT_ERR);
+    }
+
+    game* g2 = game_create(g->board->size, g->type);
+    printf("Move  Stone  Coord     Score\n");
+    for (int i = 0; i < g->moves_count && g2->state == GAME_STATE_PLAYING; i++) {
+        unsigned char stone = g2->stone;
+        char coord[5];
+        sprintf(coord, "%c%d", g->moves[i].x + 'A', g->moves[i].y + 1);
+        game_place_stone(g2, g->moves[i].x, g->moves[i].y);
+        printf("%4d  %-5s  %-5s  %8d\n", i + 1, stone == BLACK_STONE ? "Black" : "White", coord, eval_score(&g2->eval, BLACK_STONE));
+    }
+
+    if (g->state == GAME_STATE_FORBIDDEN) {
+        printf("Game concluded, black made a forbidden move, white won.\n");
+    } else if (g->state == GAME_STATE_FINISHED) {
+        printf("Game concluded, %s won.\n", g->winner == BLACK_STONE ? "black" : "white");
+    } else {
+        printf("The game is stopped.\n");
+    }
+    game_delete(g2);
+}
+
+/**
+ * Writes a search score for a report: a win or loss as the number of plies to the five.
+ * @param score The score.
+ * @param known Whether the score is known.
+ * @param out Where to write it, at least 24 characters.
+*/
+void static format_score(int score, bool known, char* out) {
+    if (!known) {
+        sprintf(out, "?");
+    } else if (score > SEARCH_WIN_BOUND) {
+        sprintf(out, "win %d", SEARCH_WIN - score);
+    } else if (score < -SEARCH_WIN_BOUND) {
+        sprintf(out, "loss %d", SEARCH_WIN + score);
+    } else {
+        sprintf(out, "%d", score);
+    }
+}
+
+/**
+ * Analyses every move of a saved game with the engine and prints a report: the value of
+ * every move for the player who made it, the best move of the position and its value, and
+ * whether the move was a blunder or missed a forced win.
+ * @param g The saved game.
+ * @param threads The number of positions to search at the same time.
+ * @param max_nodes The node budget of every position, or 0 for none.
+ * @param time_ms The time budget of every position in milliseconds, or 0 for none.
+ * @param solved The solved position cache to use, or NULL for none.
+ * @return Whether the analysis could be run.
+*/
+bool game_replay_analyze(game* g, int threads, unsigned long max_nodes, long time_ms, cache* solved) {
+    if (g->type != GAME_FREESTYLE && g->type != GAME_RENJU) {
+        exit(INPUT_ERR);
+    }
+
+    analysis_move* moves = analysis_run(g, threads, max_nodes, time_ms, solved);
+    if (moves == NULL) {
+        return false;
+    }
+
+    int blunders[2] = {0, 0};
+    int missed[2] = {0, 0};
+    printf("Move  Stone  Coord     Played  Best   Best score  Note\n");
+    for (size_t i = 0; i < g->moves_count; i++) {
+        analysis_move* m = &moves[i];
+        int color = m->stone == BLACK_STONE ? 0 : 1;
+        char coord[5];
+        char best[5];
+        char played[24];
+        char best_score[24];
+        sprintf(coord, "%c%d", m->x + 'A', m->y + 1);
+        if (m->best_x == SEARCH_NO_MOVE) {
+            sprintf(best, "-");
+        } else {
+            sprintf(best, "%c%d", m->best_x + 'A', m->best_y + 1);
+        }
+        format_score(m->played, m->known, played);
+        format_score(m->best, m->depth > 0, best_score);
+
+        const char* note = "";
+        if (m->note == ANALYSIS_BLUNDER) {
+            note = "blunder";
+            blunders[color]++;
+        } else if (m->note == ANALYSIS_MISSED_WIN) {
+            note = "missed win";
+            missed[color]++;
+        }
+        printf("%4zu  %-5s  %-5s  %9s  %-5s  %10s%s%s\n", i + 1, color == 0 ? "Black" : "White", coord, played, best, best_score, *note ? "  " : "", note);
+    }
+
+    if (g->state == GAME_STATE_FORBIDDEN) {
+        printf("Game concluded, black made a forbidden move, white won.\n");
+    } else if (g->state == GAME_STATE_FINISHED) {
+        printf("Game concluded, %s won.\n", g->winner == BLACK_STONE ? "black" : "white");
+    } else {
+        printf("The game is stopped.\n");
+    }
+    printf("Black: %d blunders, %d missed wins.\n", blunders[0], missed[0]);
+    printf("White: %d blunders, %d missed wins.\n", blunders[1], missed[1]);
+    free(moves);
+    return true;
+}
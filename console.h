@@ -0,0 +1,17 @@
+#ifndef _CONSOLE_H_
+#define _CONSOLE_H_
+#include <stdbool.h>
+#include "board.h"
+#include "cache.h"
+#include "game.h"
+#define clear() printf("\033[H\033[J")
+
+void board_print(board* b, bool in_place);
+game* console_import(const char* path);
+bool game_update(game* g);
+void game_loop(game* g);
+void game_resume(game* g);
+void game_replay(game* g);
+void game_replay_eval(game* g);
+bool game_replay_analyze(game* g, int threads, unsigned long max_nodes, long time_ms, cache* solved);
+#endif
@@ -0,0 +1,605 @@
+/**
+ * @file corpus.c
+ * @author Faris Soliman
+ * This file is a tool that reads a corpus of saved games and reports statistics about it. It
+ * takes saved games in any format parse_buffer() reads (.gmk, .gmj, .sgf and RenLib .lib
+ * files), directories, which are searched for them, and tar archives of them. The games are
+ * parsed and analysed by a thread pool in batches.
+ *
+ * Games are compared up to the 8 symmetries of the board: two games are duplicates if one is
+ * a rotation or reflection of the other, and only the first one read is counted. Every
+ * position along the unique games is also put in a set by its canonical hash, so openings and
+ * lines that many games share count once in the number of distinct positions. With -p, those
+ * positions are also written out as a sorted array of packed positions, for deduplication
+ * indexes and training sets built from the corpus.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "error-codes.h"
+#include "game.h"
+#include "hash.h"
+#include "packed.h"
+#include "parse.h"
+#include "pool.h"
+#include "source.h"
+#include "symmetry.h"
+#define CORPUS_BATCH 256
+#define CORPUS_SHARDS 64
+#define CORPUS_MAX_MOVES PARSE_MAX_MOVES
+#define CORPUS_OPENING_MOVES 3
+#define CORPUS_MAX_OPENING_MOVES 8
+#define CORPUS_TOP_OPENINGS 10
+#define CORPUS_LENGTH_BUCKETS (CORPUS_MAX_MOVES / 10 + 1)
+#define CORPUS_SIZES 3
+#define OUTCOME_BLACK 0
+#define OUTCOME_WHITE 1
+#define OUTCOME_DRAW 2
+#define OUTCOME_FORBIDDEN 3
+#define OUTCOME_UNFINISHED 4
+#define OUTCOMES 5
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t* keys;
+    size_t capacity;
+    size_t count;
+} shard;
+
+typedef struct {
+    uint64_t key;
+    unsigned long count;
+    unsigned char type;
+    unsigned char size;
+    unsigned char moves[2 * CORPUS_MAX_OPENING_MOVES];
+} opening;
+
+typedef struct {
+    unsigned long games;
+    unsigned long unreadable;
+    unsigned long duplicates;
+    unsigned long lengths[CORPUS_LENGTH_BUCKETS];
+    unsigned long outcomes[2][CORPUS_SIZES][OUTCOMES];
+    opening* openings;
+    size_t openings_capacity;
+    size_t openings_count;
+    packed_position* packed;
+    size_t packed_capacity;
+    size_t packed_count;
+    bool packed_failed;
+} tally;
+
+typedef struct {
+    int opening_moves;
+    const char* packed_path;
+    unsigned long missing;
+    shard games[CORPUS_SHARDS];
+    shard positions[CORPUS_SHARDS];
+    tally* tallies;
+    int workers;
+} corpus;
+
+typedef struct {
+    corpus* c;
+    int count;
+    char* paths[CORPUS_BATCH];
+    char* data[CORPUS_BATCH];
+    size_t lengths[CORPUS_BATCH];
+} batch;
+
+typedef struct {
+    pool* p;
+    corpus* c;
+    batch* current;
+} reader;
+
+/**
+ * Adds a key to a sharded set.
+ * @param set The shards of the set.
+ * @param key The key.
+ * @return Whether the key was new, or -1 if the set could not grow.
+*/
+int static set_insert(shard* set, uint64_t key) {
+    if (key == 0) {
+        key = 1;
+    }
+    shard* s = &set[key >> 58];
+
+    pthread_mutex_lock(&s->lock);
+    if ((s->count + 1) * 2 > s->capacity) {
+        size_t capacity = s->capacity == 0 ? 1024 : s->capacity * 2;
+        uint64_t* keys = calloc(capacity, sizeof(uint64_t));
+        if (keys == NULL) {
+            pthread_mutex_unlock(&s->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < s->capacity; i++) {
+            if (s->keys[i] != 0) {
+                size_t j = s->keys[i] & (capacity - 1);
+                while (keys[j] != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                keys[j] = s->keys[i];
+            }
+        }
+        free(s->keys);
+        s->keys = keys;
+        s->capacity = capacity;
+    }
+
+    size_t i = key & (s->capacity - 1);
+    while (s->keys[i] != 0 && s->keys[i] != key) {
+        i = (i + 1) & (s->capacity - 1);
+    }
+    int added = s->keys[i] == 0;
+    if (added) {
+        s->keys[i] = key;
+        s->count++;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return added;
+}
+
+/**
+ * Counts the keys in a sharded set.
+ * @param set The shards of the set.
+ * @return The number of keys.
+*/
+size_t static set_count(shard* set) {
+    size_t count = 0;
+    for (int i = 0; i < CORPUS_SHARDS; i++) {
+        count += set[i].count;
+    }
+    return count;
+}
+
+/**
+ * Counts an opening in a tally. Of the move orders that reach the same opening, the smallest
+ * one is kept to show it, so the report does not depend on the order games were read in.
+ * @param t The tally.
+ * @param key The canonical hash of the opening position.
+ * @param type The rule set.
+ * @param size The size of the board.
+ * @param moves The moves in the canonical frame, x and y after each other.
+ * @param count How many games to count.
+ * @param length The number of bytes in moves.
+ * @return Whether the opening could be counted.
+*/
+bool static tally_opening(tally* t, uint64_t key, unsigned char type, unsigned char size, const unsigned char* moves, unsigned long count, int length) {
+    if ((t->openings_count + 1) * 2 > t->openings_capacity) {
+        size_t capacity = t->openings_capacity == 0 ? 256 : t->openings_capacity * 2;
+        opening* table = calloc(capacity, sizeof(opening));
+        if (table == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < t->openings_capacity; i++) {
+            if (t->openings[i].count != 0) {
+                size_t j = t->openings[i].key & (capacity - 1);
+                while (table[j].count != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                table[j] = t->openings[i];
+            }
+        }
+        free(t->openings);
+        t->openings = table;
+        t->openings_capacity = capacity;
+    }
+
+    size_t i = key & (t->openings_capacity - 1);
+    while (t->openings[i].count != 0 && t->openings[i].key != key) {
+        i = (i + 1) & (t->openings_capacity - 1);
+    }
+    opening* o = &t->openings[i];
+    if (o->count == 0) {
+        o->key = key;
+        o->type = type;
+        o->size = size;
+        memcpy(o->moves, moves, length);
+        t->openings_count++;
+    } else if (memcmp(moves, o->moves, length) < 0) {
+        memcpy(o->moves, moves, length);
+    }
+    o->count += count;
+    return true;
+}
+
+/**
+ * Keeps the packed positions of a game in a tally, to be written out at the end.
+ * @param t The tally.
+ * @param positions The positions.
+ * @param count The number of positions.
+*/
+void static tally_packed(tally* t, const packed_position* positions, int count) {
+    if (t->packed_count + count > t->packed_capacity) {
+        size_t capacity = t->packed_capacity == 0 ? 4096 : t->packed_capacity * 2;
+        while (capacity < t->packed_count + count) {
+            capacity *= 2;
+        }
+        packed_position* packed = realloc(t->packed, sizeof(packed_position) * capacity);
+        if (packed == NULL) {
+            t->packed_failed = true;
+            return;
+        }
+        t->packed = packed;
+        t->packed_capacity = capacity;
+    }
+    memcpy(t->packed + t->packed_count, positions, sizeof(packed_position) * count);
+    t->packed_count += count;
+}
+
+/**
+ * Adds a parsed game to the corpus and to the tally of the worker that parsed it.
+ * @param c The corpus.
+ * @param t The tally.
+ * @param r The game.
+*/
+void static analyse_record(corpus* c, tally* t, const parse_record* r) {
+    uint64_t base = hash_rules(r->type) ^ hash_key(EMPTY_INTERSECTION, r->size);
+    uint64_t boards[SYMMETRIES] = {0};
+    uint64_t lines[SYMMETRIES] = {0};
+    uint64_t positions[CORPUS_MAX_MOVES];
+    uint64_t opening_key = 0;
+    unsigned char opening_transform = SYMMETRY_IDENTITY;
+    packed_position frames[SYMMETRIES];
+    packed_position packed[CORPUS_MAX_MOVES];
+    for (int s = 0; c->packed_path != NULL && s < SYMMETRIES; s++) {
+        packed_init(&frames[s], r->size, r->type, BLACK_STONE);
+    }
+
+    for (int i = 0; i < r->count; i++) {
+        unsigned char stone = i % 2 == 0 ? BLACK_STONE : WHITE_STONE;
+        unsigned char best = SYMMETRY_IDENTITY;
+        for (int s = 0; s < SYMMETRIES; s++) {
+            unsigned char tx;
+            unsigned char ty;
+            symmetry_apply(s, r->size, r->x[i], r->y[i], &tx, &ty);
+            boards[s] ^= hash_key(stone, ty * r->size + tx);
+            lines[s] = (lines[s] ^ (ty * r->size + tx + 1)) * 0x100000001B3ULL;
+            if (c->packed_path != NULL) {
+                packed_set(&frames[s], ty * r->size + tx, stone);
+            }
+            if (boards[s] < boards[best]) {
+                best = s;
+            }
+        }
+        positions[i] = boards[best] ^ hash_side(stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE) ^ base;
+        if (c->packed_path != NULL) {
+            packed[i] = frames[best];
+            packed_set_stone(&packed[i], stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE);
+        }
+        if (i + 1 == c->opening_moves) {
+            opening_key = positions[i];
+            opening_transform = best;
+        }
+    }
+
+    // The game is the move sequence, so compare whole lines rather than final positions.
+    uint64_t line = lines[0];
+    for (int s = 1; s < SYMMETRIES; s++) {
+        if (lines[s] < line) {
+            line = lines[s];
+        }
+    }
+    if (set_insert(c->games, line ^ base) == 0) {
+        t->duplicates++;
+        return;
+    }
+    for (int i = 0; i < r->count; i++) {
+        set_insert(c->positions, positions[i]);
+    }
+    if (c->packed_path != NULL) {
+        tally_packed(t, packed, r->count);
+    }
+
+    t->lengths[r->count / 10]++;
+    int outcome = OUTCOME_UNFINISHED;
+    if (r->state == GAME_STATE_FORBIDDEN) {
+        outcome = OUTCOME_FORBIDDEN;
+    } else if (r->state == GAME_STATE_FINISHED) {
+        outcome = r->winner == BLACK_STONE ? OUTCOME_BLACK : r->winner == WHITE_STONE ? OUTCOME_WHITE : OUTCOME_DRAW;
+    }
+    t->outcomes[r->type][(r->size - 15) / 2][outcome]++;
+
+    if (r->count >= c->opening_moves) {
+        unsigned char moves[2 * CORPUS_MAX_OPENING_MOVES];
+        for (int i = 0; i < c->opening_moves; i++) {
+            symmetry_apply(opening_transform, r->size, r->x[i], r->y[i], &moves[2 * i], &moves[2 * i + 1]);
+        }
+        tally_opening(t, opening_key, r->type, r->size, moves, 1, 2 * c->opening_moves);
+    }
+}
+
+/**
+ * The pool job: parses and analyses a batch of games.
+ * @param arg The batch, which the job frees.
+ * @param worker The number of the worker running the job.
+*/
+void static run_batch(void* arg, int worker) {
+    batch* b = arg;
+    tally* t = &b->c->tallies[worker];
+    parse_record* r = malloc(sizeof(parse_record));
+
+    for (int i = 0; i < b->count; i++) {
+        if (b->data[i] == NULL) {
+            b->data[i] = source_read_file(b->paths[i], &b->lengths[i]);
+        }
+        t->games++;
+        if (r == NULL || b->data[i] == NULL || !parse_buffer(b->data[i], b->lengths[i], r, NULL)) {
+            t->unreadable++;
+        } else {
+            analyse_record(b->c, t, r);
+        }
+        free(b->paths[i]);
+        free(b->data[i]);
+    }
+    free(r);
+    free(b);
+}
+
+/**
+ * Adds a game to the batch being filled, handing the batch to the pool once it is full.
+ * @param arg The reader.
+ * @param path The path of the game.
+ * @param data The contents of the game if it is already in memory, or NULL to read the path.
+ * @param length The length of the contents.
+*/
+void static add_game(void* arg, char* path, char* data, size_t length) {
+    reader* r = arg;
+    if (r->current == NULL) {
+        r->current = malloc(sizeof(batch));
+        if (r->current == NULL) {
+            exit(NULL_POINTER_ERR);
+        }
+        r->current->c = r->c;
+        r->current->count = 0;
+    }
+
+    batch* b = r->current;
+    b->paths[b->count] = path;
+    b->data[b->count] = data;
+    b->lengths[b->count] = length;
+    b->count++;
+    if (b->count == CORPUS_BATCH) {
+        pool_submit(r->p, run_batch, b);
+        r->current = NULL;
+    }
+}
+
+/**
+ * Reports a path that cannot be read.
+ * @param arg The reader.
+ * @param path The path.
+ * @param reason Why it cannot be read.
+*/
+void static read_error(void* arg, const char* path, unsigned char reason) {
+    reader* r = arg;
+    if (reason == SOURCE_TRUNCATED) {
+        fprintf(stderr, "Cannot read all of %s\n", path);
+    } else {
+        fprintf(stderr, "Cannot read %s\n", path);
+    }
+    if (reason == SOURCE_MISSING) {
+        r->c->missing++;
+    }
+}
+
+/**
+ * Orders openings by count, most common first, and equal counts by rule set, board size and
+ * moves.
+ * @param a The first opening.
+ * @param b The second opening.
+ * @return The order.
+*/
+int static compare_openings(const void* a, const void* b) {
+    const opening* x = a;
+    const opening* y = b;
+    if (x->count != y->count) {
+        return x->count < y->count ? 1 : -1;
+    }
+    if (x->type != y->type || x->size != y->size) {
+        return x->type != y->type ? x->type - y->type : x->size - y->size;
+    }
+    return memcmp(x->moves, y->moves, sizeof(x->moves));
+}
+
+/**
+ * Adds up the tallies of all workers into the first one and prints the report.
+ * @param c The corpus.
+*/
+void static report(corpus* c) {
+    tally* total = &c->tallies[0];
+    for (int w = 1; w < c->workers; w++) {
+        tally* t = &c->tallies[w];
+        total->games += t->games;
+        total->unreadable += t->unreadable;
+        total->duplicates += t->duplicates;
+        for (int i = 0; i < CORPUS_LENGTH_BUCKETS; i++) {
+            total->lengths[i] += t->lengths[i];
+        }
+        for (int r = 0; r < 2; r++) {
+            for (int s = 0; s < CORPUS_SIZES; s++) {
+                for (int o = 0; o < OUTCOMES; o++) {
+                    total->outcomes[r][s][o] += t->outcomes[r][s][o];
+                }
+            }
+        }
+        for (size_t i = 0; i < t->openings_capacity; i++) {
+            if (t->openings[i].count != 0) {
+                tally_opening(total, t->openings[i].key, t->openings[i].type, t->openings[i].size, t->openings[i].moves, t->openings[i].count, 2 * c->opening_moves);
+            }
+        }
+        tally_packed(total, t->packed, t->packed_count);
+        total->packed_failed |= t->packed_failed;
+    }
+
+    total->games += c->missing;
+    total->unreadable += c->missing;
+    unsigned long unique = total->games - total->unreadable - total->duplicates;
+    printf("Games:               %lu\n", total->games);
+    printf("Unreadable:          %lu\n", total->unreadable);
+    printf("Duplicates:          %lu\n", total->duplicates);
+    printf("Unique games:        %lu\n", unique);
+    printf("Distinct positions:  %zu\n", set_count(c->positions));
+
+    printf("\nGame length     Games\n");
+    for (int i = 0; i < CORPUS_LENGTH_BUCKETS; i++) {
+        if (total->lengths[i] != 0) {
+            printf("%5d-%-5d %10lu\n", i * 10, i * 10 + 9, total->lengths[i]);
+        }
+    }
+
+    printf("\nRules      Size     Games     Black     White      Draw Forbidden Unfinished\n");
+    unsigned long renju = 0;
+    unsigned long forbidden = 0;
+    for (int r = 0; r < 2; r++) {
+        for (int s = 0; s < CORPUS_SIZES; s++) {
+            unsigned long* o = total->outcomes[r][s];
+            unsigned long games = o[OUTCOME_BLACK] + o[OUTCOME_WHITE] + o[OUTCOME_DRAW] + o[OUTCOME_FORBIDDEN] + o[OUTCOME_UNFINISHED];
+            if (games == 0) {
+                continue;
+            }
+            printf("%-9s %5d %9lu %9lu %9lu %9lu %9lu %10lu\n", r == GAME_FREESTYLE ? "freestyle" : "renju", 15 + 2 * s,
+                games, o[OUTCOME_BLACK], o[OUTCOME_WHITE], o[OUTCOME_DRAW], o[OUTCOME_FORBIDDEN], o[OUTCOME_UNFINISHED]);
+            if (r == GAME_RENJU) {
+                renju += games;
+                forbidden += o[OUTCOME_FORBIDDEN];
+            }
+        }
+    }
+
+    opening* top = malloc(sizeof(opening) * (total->openings_count + 1));
+    if (top == NULL) {
+        exit(NULL_POINTER_ERR);
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < total->openings_capacity; i++) {
+        if (total->openings[i].count != 0) {
+            top[n++] = total->openings[i];
+        }
+    }
+    qsort(top, n, sizeof(opening), compare_openings);
+    printf("\nMost common openings (%d moves, up to symmetry)\n", c->opening_moves);
+    for (size_t i = 0; i < n && i < CORPUS_TOP_OPENINGS; i++) {
+        char line[64] = "";
+        for (int m = 0; m < c->opening_moves; m++) {
+            char move[8];
+            sprintf(move, "%s%c%d", m == 0 ? "" : " ", top[i].moves[2 * m] + 'A', top[i].moves[2 * m + 1] + 1);
+            strcat(line, move);
+        }
+        printf("%4zu. %-9s %5d  %-24s %9lu\n", i + 1, top[i].type == GAME_FREESTYLE ? "freestyle" : "renju", top[i].size,
+            line, top[i].count);
+    }
+    free(top);
+
+    printf("\nForbidden move losses: %lu of %lu renju games (%.1f%%)\n", forbidden, renju,
+        renju == 0 ? 0.0 : 100.0 * forbidden / renju);
+}
+
+/**
+ * Writes the distinct positions of the unique games, in their canonical orientation, as a
+ * sorted array of packed positions. Call after report(), which gathers them.
+ * @param c The corpus.
+ * @return SUCCESS, FILE_OUTPUT_ERR if the array could not be written, or NULL_POINTER_ERR if
+ *         the positions did not fit in memory.
+*/
+int static write_packed(corpus* c) {
+    tally* total = &c->tallies[0];
+    if (total->packed_failed) {
+        return NULL_POINTER_ERR;
+    }
+    size_t count = packed_sort(total->packed, total->packed_count);
+    if (!packed_write(c->packed_path, total->packed, count)) {
+        fprintf(stderr, "Cannot write %s\n", c->packed_path);
+        return FILE_OUTPUT_ERR;
+    }
+    printf("\nPacked positions:    %zu written to %s\n", count, c->packed_path);
+    return SUCCESS;
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    int opening_moves = CORPUS_OPENING_MOVES;
+    const char* packed_path = NULL;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-j") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            threads = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-n") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0 &&
+            atoi(argv[first + 1]) <= CORPUS_MAX_OPENING_MOVES) {
+            opening_moves = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-p") == 0 && first + 1 < argc) {
+            packed_path = argv[first + 1];
+        } else {
+            first = argc;
+            break;
+        }
+        first += 2;
+    }
+    if (first >= argc) {
+        fprintf(stdout, "usage: %s [-j threads] [-n opening-moves] [-p positions.gpk] <saved-match.gmk|directory|archive.tar>...\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    corpus* c = calloc(1, sizeof(corpus));
+    if (c == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    c->opening_moves = opening_moves;
+    c->packed_path = packed_path;
+    c->workers = threads;
+    c->tallies = calloc(threads, sizeof(tally));
+    if (c->tallies == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    for (int i = 0; i < CORPUS_SHARDS; i++) {
+        pthread_mutex_init(&c->games[i].lock, NULL);
+        pthread_mutex_init(&c->positions[i].lock, NULL);
+    }
+
+    pool* p = pool_create(threads);
+    if (p == NULL) {
+        return NULL_POINTER_ERR;
+    }
+
+    // Read everything, handing the games to the pool in batches.
+    reader r = {p, c, NULL};
+    source_visitor v = {add_game, read_error, &r};
+    for (int i = first; i < argc; i++) {
+        if (!source_walk(argv[i], true, &v)) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    if (r.current != NULL) {
+        pool_submit(p, run_batch, r.current);
+    }
+    pool_wait(p);
+    pool_delete(p);
+
+    report(c);
+    int status = packed_path == NULL ? SUCCESS : write_packed(c);
+
+    for (int i = 0; i < CORPUS_SHARDS; i++) {
+        free(c->games[i].keys);
+        free(c->positions[i].keys);
+    }
+    for (int w = 0; w < threads; w++) {
+        free(c->tallies[w].openings);
+        free(c->tallies[w].packed);
+    }
+    free(c->tallies);
+    free(c);
+    return status;
+}
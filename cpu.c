@@ -0,0 +1,87 @@
+/**
+ * @file cpu.c
+ * @author Faris Soliman
+ * This file contains the kernel dispatch shared by the pattern scanner, the network evaluator
+ * and the batched rules. Each keeps a table of kernels for the same job, widest first, whose
+ * entries start with the name of the instruction set they need; this picks the first one the
+ * processor runs and remembers it, or the one a benchmark asks for.
+*/
+#include <string.h>
+#include "cpu.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_X86
+#endif
+
+/**
+ * Checks if the processor can run kernels written for an instruction set.
+ * @param name The instruction set, "avx2", "sse2" or "scalar".
+ * @return Whether it is supported; "scalar" always is, anything else unknown never is.
+*/
+bool cpu_supports(const char* name) {
+#ifdef CPU_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0) {
+        return __builtin_cpu_supports("avx2");
+    }
+    if (strcmp(name, "sse2") == 0) {
+        return __builtin_cpu_supports("sse2");
+    }
+#endif
+    return strcmp(name, "scalar") == 0;
+}
+
+/**
+ * Gets the name of a kernel in a table.
+ * @param kernels The table.
+ * @param size The size of an entry.
+ * @param i The index of the kernel.
+ * @return The name.
+*/
+const char static* kernel_name(const void* kernels, size_t size, size_t i) {
+    return *(const char* const*)((const char*)kernels + i * size);
+}
+
+/**
+ * Picks the widest kernel of a table the processor supports, the first time it is asked, and
+ * the remembered one after that. The remembered kernel is the one piece of state shared by
+ * all games; threads that get here first at the same time all pick the same kernel, so it is
+ * only made atomic, not locked.
+ * @param active Where the kernel in use is remembered, NULL until one is picked.
+ * @param kernels The table, widest first, ending with a scalar kernel.
+ * @param count The number of kernels.
+ * @param size The size of an entry.
+ * @return The kernel.
+*/
+const void* cpu_select(const void** active, const void* kernels, size_t count, size_t size) {
+    const void* k = __atomic_load_n(active, __ATOMIC_ACQUIRE);
+    if (k == NULL) {
+        for (size_t i = 0; i < count; i++) {
+            if (cpu_supports(kernel_name(kernels, size, i))) {
+                k = (const char*)kernels + i * size;
+                break;
+            }
+        }
+        __atomic_store_n(active, k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+/**
+ * Forces a kernel of a table to be used, mostly for benchmarks and cross checks.
+ * @param active Where the kernel in use is remembered.
+ * @param kernels The table.
+ * @param count The number of kernels.
+ * @param size The size of an entry.
+ * @param name The kernel name.
+ * @return Whether the kernel exists and is supported by the processor.
+*/
+bool cpu_use(const void** active, const void* kernels, size_t count, size_t size, const char* name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(kernel_name(kernels, size, i), name) == 0 && cpu_supports(name)) {
+            __atomic_store_n(active, (const char*)kernels + i * size, __ATOMIC_RELEASE);
+            return true;
+        }
+    }
+    return false;
+}
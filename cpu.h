@@ -0,0 +1,9 @@
+#ifndef _CPU_H_
+#define _CPU_H_
+#include <stdbool.h>
+#include <stddef.h>
+
+bool cpu_supports(const char* name);
+const void* cpu_select(const void** active, const void* kernels, size_t count, size_t size);
+bool cpu_use(const void** active, const void* kernels, size_t count, size_t size, const char* name);
+#endif
@@ -0,0 +1,467 @@
+/**
+ * @file dataset.c
+ * @author Faris Soliman
+ * This file is a tool that exports the positions of a corpus of saved games as training data.
+ * It takes the same paths as corpus: saved games, directories of them and tar archives of
+ * them. Every game is played through the rules in game.c, and every position along it becomes
+ * one fixed-size record: the board as bit planes, the move played from it and the result of
+ * the game for the color to move. Games the rules reject part of the way through are left out
+ * whole. With -a, every position is written once for each of the 8 symmetries of the board.
+ *
+ * The export is a pipeline of three stages with bounded queues between them. The main thread
+ * walks the paths and reads the games into batches, which wait in the queue of a thread pool;
+ * the workers of the pool play the games and encode their records; and a writer thread takes
+ * the encoded batches in the order they were read and appends them to the file. The writer
+ * only lets DATASET_QUEUE batches be encoded ahead of it, so the output is the same for any
+ * number of threads and memory stays bounded however large the corpus is.
+ *
+ * The file starts with a dataset_header, followed by its records in native byte order. The
+ * plane bit of an intersection is y * size + x, counting from the low bit of the first byte.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "dataset.h"
+#include "error-codes.h"
+#include "game.h"
+#include "hash.h"
+#include "parse.h"
+#include "pool.h"
+#include "source.h"
+#include "symmetry.h"
+#define DATASET_BATCH 16
+#define DATASET_QUEUE 8
+
+typedef struct exporter exporter;
+
+typedef struct {
+    exporter* e;
+    unsigned long seq;
+    int count;
+    char* data[DATASET_BATCH];
+    size_t lengths[DATASET_BATCH];
+    dataset_record* records;
+    size_t records_count;
+    size_t records_capacity;
+    unsigned long unreadable;
+    unsigned long rejected;
+    unsigned long positions;
+    bool failed;
+} batch;
+
+struct exporter {
+    bool augment;
+    FILE* fp;
+    pool* p;
+    batch* current;
+    unsigned long submitted;
+    unsigned long missing;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    batch* slots[DATASET_QUEUE];
+    unsigned long next;
+    bool closing;
+    unsigned long games;
+    unsigned long unreadable;
+    unsigned long rejected;
+    unsigned long positions;
+    uint64_t records;
+    uint64_t checksum;
+    bool failed;
+    bool write_failed;
+};
+
+/**
+ * Sets the bit of an intersection in a plane.
+ * @param plane The plane.
+ * @param index The index of the intersection.
+*/
+void static plane_set(unsigned char* plane, int index) {
+    plane[index / 8] |= 1 << (index % 8);
+}
+
+/**
+ * Encodes the position of a game before a move, once, or once for every symmetry.
+ * @param g The game.
+ * @param x The x coordinate of the move played.
+ * @param y The y coordinate of the move played.
+ * @param length The number of moves in the game.
+ * @param symmetries The number of symmetries to encode, 1 or SYMMETRIES.
+ * @param out Where to put the records, one for each symmetry.
+*/
+void static encode(game* g, unsigned char x, unsigned char y, size_t length, int symmetries, dataset_record* out) {
+    unsigned char size = g->board->size;
+    for (int s = 0; s < symmetries; s++) {
+        memset(&out[s], 0, sizeof(dataset_record));
+        out[s].size = size;
+        out[s].type = g->type;
+        out[s].stone = g->stone;
+        out[s].result = DATASET_UNFINISHED;
+        out[s].symmetry = s;
+        out[s].ply = g->moves_count;
+        out[s].length = length;
+        symmetry_apply(s, size, x, y, &out[s].x, &out[s].y);
+    }
+
+    int last = -1;
+    if (g->moves_count > 0) {
+        last = g->moves[g->moves_count - 1].y * size + g->moves[g->moves_count - 1].x;
+    }
+    bool forbidden = g->type == GAME_RENJU && g->stone == BLACK_STONE;
+    for (unsigned char cy = 0; cy < size; cy++) {
+        for (unsigned char cx = 0; cx < size; cx++) {
+            unsigned char stone = g->board->grid[cy * size + cx];
+            int plane = -1;
+            if (stone == BLACK_STONE) {
+                plane = DATASET_PLANE_BLACK;
+            } else if (stone == WHITE_STONE) {
+                plane = DATASET_PLANE_WHITE;
+            } else if (forbidden && game_forbidden(g, BLACK_STONE, cx, cy)) {
+                plane = DATASET_PLANE_FORBIDDEN;
+            }
+            if (plane < 0) {
+                continue;
+            }
+            for (int s = 0; s < symmetries; s++) {
+                unsigned char tx;
+                unsigned char ty;
+                symmetry_apply(s, size, cx, cy, &tx, &ty);
+                plane_set(out[s].planes[plane], ty * size + tx);
+                if (cy * size + cx == last) {
+                    plane_set(out[s].planes[DATASET_PLANE_LAST], ty * size + tx);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Plays a game through the rules and appends the records of its positions to a batch. If the
+ * rules reject a move, the records of the game are taken back off.
+ * @param b The batch.
+ * @param r The game.
+*/
+void static export_game(batch* b, const parse_record* r) {
+    int symmetries = b->e->augment ? SYMMETRIES : 1;
+    size_t needed = b->records_count + r->count * symmetries;
+    if (needed > b->records_capacity) {
+        size_t capacity = b->records_capacity == 0 ? 256 : b->records_capacity;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        dataset_record* records = realloc(b->records, sizeof(dataset_record) * capacity);
+        if (records == NULL) {
+            b->failed = true;
+            return;
+        }
+        b->records = records;
+        b->records_capacity = capacity;
+    }
+
+    game* g = game_create(r->size, r->type);
+    if (g == NULL) {
+        b->failed = true;
+        return;
+    }
+    size_t start = b->records_count;
+    for (size_t i = 0; i < r->count; i++) {
+        dataset_record* out = &b->records[b->records_count];
+        if (g->state != GAME_STATE_PLAYING) {
+            break;
+        }
+        encode(g, r->x[i], r->y[i], r->count, symmetries, out);
+        if (game_place_stone(g, r->x[i], r->y[i]) != SUCCESS) {
+            break;
+        }
+        b->records_count += symmetries;
+    }
+    if (b->records_count - start != r->count * symmetries) {
+        b->records_count = start;
+        b->rejected++;
+        game_delete(g);
+        return;
+    }
+
+    for (size_t i = start; i < b->records_count; i++) {
+        dataset_record* out = &b->records[i];
+        if (g->state == GAME_STATE_PLAYING) {
+            out->result = DATASET_UNFINISHED;
+        } else if (g->winner == EMPTY_INTERSECTION) {
+            out->result = DATASET_DRAW;
+        } else {
+            out->result = g->winner == out->stone ? DATASET_WIN : DATASET_LOSS;
+        }
+    }
+    b->positions += r->count;
+    game_delete(g);
+}
+
+/**
+ * Hands an encoded batch to the writer, waiting while it is more than DATASET_QUEUE batches
+ * ahead of the one the writer needs next.
+ * @param b The batch.
+*/
+void static push_batch(batch* b) {
+    exporter* e = b->e;
+    pthread_mutex_lock(&e->lock);
+    while (b->seq >= e->next + DATASET_QUEUE) {
+        pthread_cond_wait(&e->space, &e->lock);
+    }
+    e->slots[b->seq % DATASET_QUEUE] = b;
+    pthread_cond_signal(&e->ready);
+    pthread_mutex_unlock(&e->lock);
+}
+
+/**
+ * The pool job: plays and encodes a batch of games, then hands it to the writer.
+ * @param arg The batch.
+ * @param worker The number of the worker running the job.
+*/
+void static run_batch(void* arg, int worker) {
+    batch* b = arg;
+    parse_record* r = malloc(sizeof(parse_record));
+    if (r == NULL) {
+        b->failed = true;
+    }
+
+    for (int i = 0; i < b->count; i++) {
+        if (r != NULL && b->data[i] != NULL && parse_buffer(b->data[i], b->lengths[i], r, NULL)) {
+            export_game(b, r);
+        } else {
+            b->unreadable++;
+        }
+        free(b->data[i]);
+    }
+    free(r);
+    push_batch(b);
+}
+
+/**
+ * The body of the writer thread: appends the batches to the file in the order they were read,
+ * until the reader is done and every batch it read has been written.
+ * @param arg The exporter.
+ * @return Nothing.
+*/
+void static* write_batches(void* arg) {
+    exporter* e = arg;
+    pthread_mutex_lock(&e->lock);
+    while (true) {
+        while (e->slots[e->next % DATASET_QUEUE] == NULL && !(e->closing && e->next == e->submitted)) {
+            pthread_cond_wait(&e->ready, &e->lock);
+        }
+        batch* b = e->slots[e->next % DATASET_QUEUE];
+        if (b == NULL) {
+            break;
+        }
+        e->slots[e->next % DATASET_QUEUE] = NULL;
+        e->next++;
+        pthread_cond_broadcast(&e->space);
+        pthread_mutex_unlock(&e->lock);
+
+        if (b->records_count > 0) {
+            if (fwrite(b->records, sizeof(dataset_record), b->records_count, e->fp) != b->records_count) {
+                e->write_failed = true;
+            }
+            e->checksum = (e->checksum ^ hash_bytes(b->records, sizeof(dataset_record) * b->records_count)) *
+                0x100000001B3ULL;
+        }
+        e->games += b->count;
+        e->unreadable += b->unreadable;
+        e->rejected += b->rejected;
+        e->positions += b->positions;
+        e->records += b->records_count;
+        e->failed = e->failed || b->failed;
+        free(b->records);
+        free(b);
+
+        pthread_mutex_lock(&e->lock);
+    }
+    pthread_mutex_unlock(&e->lock);
+    return NULL;
+}
+
+/**
+ * Hands the batch being filled to the pool.
+ * @param e The exporter.
+*/
+void static submit_batch(exporter* e) {
+    batch* b = e->current;
+    e->current = NULL;
+    pthread_mutex_lock(&e->lock);
+    b->seq = e->submitted++;
+    pthread_mutex_unlock(&e->lock);
+    if (!pool_submit(e->p, run_batch, b)) {
+        exit(NULL_POINTER_ERR);
+    }
+}
+
+/**
+ * Reads a game into the batch being filled, handing the batch to the pool once it is full.
+ * @param arg The exporter.
+ * @param path The path of the game.
+ * @param data The contents of the game if it is already in memory, or NULL to read the path.
+ * @param length The length of the contents.
+*/
+void static add_game(void* arg, char* path, char* data, size_t length) {
+    exporter* e = arg;
+    if (e->current == NULL) {
+        e->current = calloc(1, sizeof(batch));
+        if (e->current == NULL) {
+            exit(NULL_POINTER_ERR);
+        }
+        e->current->e = e;
+    }
+
+    if (data == NULL) {
+        data = source_read_file(path, &length);
+    }
+    free(path);
+    batch* b = e->current;
+    b->data[b->count] = data;
+    b->lengths[b->count] = length;
+    b->count++;
+    if (b->count == DATASET_BATCH) {
+        submit_batch(e);
+    }
+}
+
+/**
+ * Reports a path that cannot be read.
+ * @param arg The exporter.
+ * @param path The path.
+ * @param reason Why it cannot be read.
+*/
+void static read_error(void* arg, const char* path, unsigned char reason) {
+    exporter* e = arg;
+    if (reason == SOURCE_TRUNCATED) {
+        fprintf(stderr, "Cannot read all of %s\n", path);
+    } else {
+        fprintf(stderr, "Cannot read %s\n", path);
+    }
+    if (reason == SOURCE_MISSING) {
+        e->missing++;
+    }
+}
+
+/**
+ * Writes the header of the file, with the number of records in it.
+ * @param fp The file.
+ * @param count The number of records.
+ * @return Whether it was written.
+*/
+bool static write_header(FILE* fp, uint64_t count) {
+    dataset_header header;
+    memset(&header, 0, sizeof(dataset_header));
+    memcpy(header.magic, DATASET_MAGIC, sizeof(header.magic));
+    header.version = DATASET_VERSION;
+    header.record_size = sizeof(dataset_record);
+    header.count = count;
+    return fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(dataset_header), 1, fp) == 1;
+}
+
+/**
+ * The main function: exports the positions of the saved games given on the command line.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    bool augment = false;
+    const char* path = NULL;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-a") == 0) {
+            augment = true;
+            first++;
+            continue;
+        }
+        if (strcmp(argv[first], "-j") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            threads = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+            path = argv[first + 1];
+        } else {
+            first = argc;
+            break;
+        }
+        first += 2;
+    }
+    if (first >= argc || path == NULL) {
+        fprintf(stdout, "usage: %s [-j threads] [-a] -o dataset.bin <saved-match.gmk|directory|archive.tar>...\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    exporter* e = calloc(1, sizeof(exporter));
+    char* temporary = malloc(strlen(path) + 5);
+    if (e == NULL || temporary == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    sprintf(temporary, "%s.tmp", path);
+    e->augment = augment;
+    e->fp = fopen(temporary, "wb");
+    if (e->fp == NULL || !write_header(e->fp, 0)) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return FILE_OUTPUT_ERR;
+    }
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->ready, NULL);
+    pthread_cond_init(&e->space, NULL);
+
+    e->p = pool_create(threads);
+    pthread_t writer;
+    if (e->p == NULL || pthread_create(&writer, NULL, write_batches, e) != 0) {
+        return NULL_POINTER_ERR;
+    }
+
+    // Read everything, handing the games to the pool in batches, then let the writer finish.
+    source_visitor v = {add_game, read_error, e};
+    for (int i = first; i < argc; i++) {
+        if (!source_walk(argv[i], true, &v)) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    if (e->current != NULL) {
+        submit_batch(e);
+    }
+    pool_wait(e->p);
+    pool_delete(e->p);
+    pthread_mutex_lock(&e->lock);
+    e->closing = true;
+    pthread_cond_signal(&e->ready);
+    pthread_mutex_unlock(&e->lock);
+    pthread_join(writer, NULL);
+
+    if (e->failed) {
+        fclose(e->fp);
+        remove(temporary);
+        return NULL_POINTER_ERR;
+    }
+    bool written = !e->write_failed && write_header(e->fp, e->records);
+    if (fclose(e->fp) != 0 || !written || rename(temporary, path) != 0) {
+        remove(temporary);
+        fprintf(stderr, "Cannot write %s\n", path);
+        return FILE_OUTPUT_ERR;
+    }
+
+    printf("Games:               %lu\n", e->games + e->missing);
+    printf("Unreadable:          %lu\n", e->unreadable + e->missing);
+    printf("Rejected by rules:   %lu\n", e->rejected);
+    printf("Positions:           %lu\n", e->positions);
+    printf("Records:             %llu of %zu bytes written to %s\n", (unsigned long long)e->records,
+        sizeof(dataset_record), path);
+    printf("Checksum:            %016llx\n", (unsigned long long)e->checksum);
+
+    pthread_mutex_destroy(&e->lock);
+    pthread_cond_destroy(&e->ready);
+    pthread_cond_destroy(&e->space);
+    free(temporary);
+    free(e);
+    return SUCCESS;
+}
@@ -0,0 +1,39 @@
+#ifndef _DATASET_H_
+#define _DATASET_H_
+#include <stdint.h>
+#include "pattern.h"
+#define DATASET_MAGIC "GMKDATA"
+#define DATASET_VERSION 1
+#define DATASET_PLANES 4
+#define DATASET_PLANE_BYTES ((PATTERN_MAX_SIZE * PATTERN_MAX_SIZE + 7) / 8)
+#define DATASET_PLANE_BLACK 0
+#define DATASET_PLANE_WHITE 1
+#define DATASET_PLANE_LAST 2
+#define DATASET_PLANE_FORBIDDEN 3
+#define DATASET_LOSS 0
+#define DATASET_DRAW 1
+#define DATASET_WIN 2
+#define DATASET_UNFINISHED 3
+
+typedef struct {
+    unsigned char size;
+    unsigned char type;
+    unsigned char stone;
+    unsigned char result;
+    unsigned char x;
+    unsigned char y;
+    unsigned char symmetry;
+    unsigned char reserved;
+    uint16_t ply;
+    uint16_t length;
+    unsigned char planes[DATASET_PLANES][DATASET_PLANE_BYTES];
+} dataset_record;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t reserved[2];
+} dataset_header;
+#endif
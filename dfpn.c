@@ -0,0 +1,746 @@
+/**
+ * @file dfpn.c
+ * @author Faris Soliman
+ * This file contains the solver: a depth-first proof-number search that proves a position won
+ * or lost for the side to move. Every node has a proof number, how many more leaves at least
+ * have to be proven for the attacker to win there, and a disproof number for the defender;
+ * the search always goes down into the child with the smallest number for the side to move,
+ * with thresholds that bring it back up as soon as a sibling would be a better choice. The
+ * numbers are kept as phi and delta, the proof and disproof numbers seen from the side to move,
+ * so OR and AND nodes are handled by the same code.
+ *
+ * The attacker only plays threats: fours, and with DFPN_VCT open threes as well. A threat
+ * leaves the defender few answers, and only those are searched: a five to make or block, and
+ * against an open three, the intersections that would make a four for the attacker, since any
+ * other stone leaves the three and every window it could become a four in untouched, or a four
+ * of the defender's own, which forces the attacker to answer. A node where the attacker has no
+ * threat left is a win for the defender, so a proof is a threat sequence that wins against
+ * every defence, and a disproof only says there is none.
+ *
+ * Nothing in gomoku or renju ever repeats a position, so the search graph has no cycles, but
+ * it has many transpositions, and summing the numbers of children that share descendants
+ * counts the shared ones again and again. The sum at each node is replaced with the weak
+ * proof number: the largest child number plus one for every other unsolved child. Positions
+ * are stored in a bounded transposition table by hash, in clusters of DFPN_CLUSTER entries,
+ * together with the number of nodes spent on them. A full cluster gives up its cheapest entry,
+ * and when three quarters of the table is used, the entries for the smallest subtrees are
+ * collected until half of it is free again.
+ *
+ * A solver given a solved position cache looks the root up there first, and stores every
+ * position along a winning line it proves, marked with the threats it was proven by. A result
+ * the search proved, or one proven with threes when only fours are allowed, says nothing about
+ * whether the threats of the mode win, so the solver only takes the ones proven its own way.
+ * The line of a position found there is followed through the cache as far as it goes.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "dfpn.h"
+#include "error-codes.h"
+#include "game.h"
+#include "hash.h"
+#include "pattern.h"
+#include "search.h"
+#include "symmetry.h"
+#include "threat.h"
+
+#define NODE_OPEN 0
+#define NODE_WON 1
+#define NODE_LOST 2
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+    unsigned char priority;
+} dfpn_move;
+
+/**
+ * Creates a solver with an empty transposition table.
+ * @param bytes The memory the table may take, rounded down to a power of two entries.
+ * @return The new solver, or NULL if it could not be allocated.
+*/
+dfpn* dfpn_create(size_t bytes) {
+    dfpn* d = calloc(1, sizeof(dfpn));
+    if (d == NULL) {
+        return NULL;
+    }
+
+    size_t size = DFPN_CLUSTER;
+    while (size * 2 * sizeof(dfpn_entry) <= bytes) {
+        size *= 2;
+    }
+    d->table = calloc(size, sizeof(dfpn_entry));
+    if (d->table == NULL) {
+        free(d);
+        return NULL;
+    }
+    d->mask = size - 1;
+    return d;
+}
+
+/**
+ * Deletes a solver.
+ * @param d The solver to delete, or NULL.
+*/
+void dfpn_delete(dfpn* d) {
+    if (d == NULL) {
+        return;
+    }
+
+    cache_close(d->cache);
+    free(d->table);
+    free(d);
+}
+
+/**
+ * Lets a solver share proven results with searches and other processes through a solved
+ * position cache file, which is created if it does not exist.
+ * @param d The solver.
+ * @param path The path to the cache file.
+ * @return Whether the cache could be opened.
+*/
+bool dfpn_use_cache(dfpn* d, const char* path) {
+    cache* c = cache_open(path, CACHE_SLOTS);
+    if (c == NULL) {
+        return false;
+    }
+
+    cache_close(d->cache);
+    d->cache = c;
+    return true;
+}
+
+/**
+ * Forgets everything in the transposition table.
+ * @param d The solver.
+*/
+void dfpn_clear(dfpn* d) {
+    memset(d->table, 0, (d->mask + 1) * sizeof(dfpn_entry));
+    d->used = 0;
+}
+
+/**
+ * Asks a solver running on another thread to stop.
+ * @param d The solver.
+*/
+void dfpn_stop(dfpn* d) {
+    __atomic_store_n(&d->stop, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Finds the entry of a position.
+ * @param d The solver.
+ * @param key The key of the position.
+ * @return The entry, or NULL if the position is not in the table.
+*/
+dfpn_entry static* probe(dfpn* d, uint64_t key) {
+    for (int i = 0; i < DFPN_CLUSTER; i++) {
+        dfpn_entry* e = &d->table[(key + i) & d->mask];
+        if (e->key == key) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Gets the numbers of a position, 1 and 1 if it has not been searched yet.
+ * @param d The solver.
+ * @param key The key of the position.
+ * @param phi Where to put the number for the side to move.
+ * @param delta Where to put the number for the other side.
+*/
+void static lookup(dfpn* d, uint64_t key, uint32_t* phi, uint32_t* delta) {
+    dfpn_entry* e = probe(d, key);
+    *phi = e == NULL ? 1 : e->phi;
+    *delta = e == NULL ? 1 : e->delta;
+}
+
+/**
+ * Collects the entries of the smallest subtrees until at least half of the table is free. The
+ * work of an entry is bucketed by its bit length, and whole buckets are freed from the
+ * smallest up, so entries that took about as long to search go together.
+ * @param d The solver.
+*/
+void static collect(dfpn* d) {
+    size_t buckets[33] = {0};
+    size_t capacity = d->mask + 1;
+    for (size_t i = 0; i < capacity; i++) {
+        if (d->table[i].key != 0) {
+            uint32_t w = d->table[i].work;
+            int bits = 0;
+            while (w > 0) {
+                bits++;
+                w >>= 1;
+            }
+            buckets[bits]++;
+        }
+    }
+
+    int limit = 0;
+    size_t freed = buckets[0];
+    while (limit < 32 && d->used - freed > capacity / 2) {
+        freed += buckets[++limit];
+    }
+    uint32_t below = limit >= 32 ? UINT32_MAX : (uint32_t)1 << limit;
+    for (size_t i = 0; i < capacity; i++) {
+        if (d->table[i].key != 0 && d->table[i].work < below) {
+            d->table[i].key = 0;
+            d->used--;
+            d->freed++;
+        }
+    }
+    d->collections++;
+}
+
+/**
+ * Stores the numbers of a position, replacing the entry for the smallest subtree in its
+ * cluster if the cluster is full.
+ * @param d The solver.
+ * @param key The key of the position.
+ * @param phi The number for the side to move.
+ * @param delta The number for the other side.
+ * @param work The number of nodes searched below the position.
+ * @param x The x coordinate of the best move, or SEARCH_NO_MOVE.
+ * @param y The y coordinate of the best move.
+*/
+void static store(dfpn* d, uint64_t key, uint32_t phi, uint32_t delta, unsigned long work, unsigned char x, unsigned char y) {
+    dfpn_entry* e = probe(d, key);
+    if (e == NULL) {
+        if (d->used >= (d->mask + 1) / 4 * 3) {
+            collect(d);
+        }
+        for (int i = 0; i < DFPN_CLUSTER; i++) {
+            dfpn_entry* slot = &d->table[(key + i) & d->mask];
+            if (slot->key == 0) {
+                e = slot;
+                d->used++;
+                break;
+            }
+            if (e == NULL || slot->work < e->work) {
+                e = slot;
+            }
+        }
+        e->key = key;
+        e->work = 0;
+    }
+    e->phi = phi;
+    e->delta = delta;
+    e->work = e->work + work > UINT32_MAX ? UINT32_MAX : e->work + work;
+    e->x = x;
+    e->y = y;
+}
+
+/**
+ * Gets the other color.
+ * @param stone A color.
+ * @return The other one.
+*/
+unsigned char static other(unsigned char stone) {
+    return stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+}
+
+/**
+ * Checks if a color would win by playing an intersection.
+ * @param g The game.
+ * @param stone The color.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return Whether the move makes five, or an overline where that wins.
+*/
+bool static makes_five(game* g, unsigned char stone, unsigned char x, unsigned char y) {
+    unsigned char code = threat_best(g->threats, stone, x, y);
+    return code == PATTERN_FIVE ||
+        (code == PATTERN_OVERLINE && (g->type != GAME_RENJU || stone == WHITE_STONE));
+}
+
+/**
+ * Adds a move to a list, keeping the list ordered by urgency for the color to move.
+ * @param g The game.
+ * @param stone The color to move.
+ * @param list The list.
+ * @param n The number of moves in the list, which is increased.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+*/
+void static add_move(game* g, unsigned char stone, dfpn_move* list, int* n, unsigned char x, unsigned char y) {
+    unsigned char priority = threat_priority(g->threats, stone, x, y);
+    int i = (*n)++;
+    while (i > 0 && list[i - 1].priority < priority) {
+        list[i] = list[i - 1];
+        i--;
+    }
+    list[i].x = x;
+    list[i].y = y;
+    list[i].priority = priority;
+}
+
+/**
+ * Lists the moves worth searching at a node, or decides the node without any.
+ * @param d The solver.
+ * @param g The game.
+ * @param or_node Whether the attacker is to move.
+ * @param root Whether the node is the root, where a defender not facing a threat has to try
+ *        every move.
+ * @param list Where to put the moves.
+ * @param n Where to put the number of moves.
+ * @return NODE_WON or NODE_LOST if the side to move has already reached or missed its goal,
+ *         NODE_OPEN otherwise.
+*/
+int static generate(dfpn* d, game* g, bool or_node, bool root, dfpn_move* list, int* n) {
+    unsigned char size = g->board->size;
+    unsigned char me = or_node ? d->attacker : other(d->attacker);
+    unsigned char them = other(me);
+    unsigned char cells[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE][2];
+    int empty = 0;
+    int blocks = 0;
+    bool threat = false;
+    *n = 0;
+
+    for (unsigned char y = 0; y < size; y++) {
+        for (unsigned char x = 0; x < size; x++) {
+            if (g->board->grid[y * size + x] != EMPTY_INTERSECTION) {
+                continue;
+            }
+            if (makes_five(g, me, x, y)) {
+                return NODE_WON;
+            }
+            cells[empty][0] = x;
+            cells[empty][1] = y;
+            empty++;
+            if (makes_five(g, them, x, y)) {
+                blocks++;
+            } else if (!or_node && !threat && threat_best(g->threats, them, x, y) == PATTERN_OPEN_FOUR &&
+                !game_forbidden(g, them, x, y)) {
+                threat = true;
+            }
+        }
+    }
+
+    // A five to block leaves no choice, and two cannot both be blocked.
+    if (blocks > 1) {
+        return NODE_LOST;
+    }
+    for (int i = 0; i < empty; i++) {
+        unsigned char x = cells[i][0];
+        unsigned char y = cells[i][1];
+        bool take;
+        if (blocks == 1) {
+            take = makes_five(g, them, x, y);
+        } else if (or_node) {
+            unsigned char code = threat_best(g->threats, me, x, y);
+            take = code >= (d->mode == DFPN_VCT ? PATTERN_OPEN_THREE : PATTERN_FOUR) && code != PATTERN_OVERLINE;
+        } else if (threat) {
+            take = threat_best(g->threats, them, x, y) >= PATTERN_FOUR || threat_best(g->threats, me, x, y) >= PATTERN_FOUR;
+        } else {
+            take = root;
+        }
+        if (take && !game_forbidden(g, me, x, y)) {
+            add_move(g, me, list, n, x, y);
+        }
+    }
+
+    // Out of threats, the attacker has failed; out of defences, the defender has.
+    if (*n == 0) {
+        return or_node || blocks == 1 || threat || root ? NODE_LOST : NODE_WON;
+    }
+    return NODE_OPEN;
+}
+
+/**
+ * Gets the key of a node: the position and the color to move in the tree, which is not the
+ * color the game says is to move once the game is over.
+ * @param g The game.
+ * @param stone The color to move.
+ * @return The key.
+*/
+uint64_t static node_key(game* g, unsigned char stone) {
+    return g->hashes[SYMMETRY_IDENTITY] ^ hash_side(stone);
+}
+
+/**
+ * Checks the node and time budgets, and reports progress now and then.
+ * @param d The solver.
+ * @return Whether the solver should stop.
+*/
+bool static aborted(dfpn* d) {
+    if (__atomic_load_n(&d->stop, __ATOMIC_RELAXED)) {
+        return true;
+    }
+    if ((d->nodes & 1023) != 0) {
+        return false;
+    }
+
+    long long now = search_clock();
+    if ((d->max_nodes > 0 && d->nodes >= d->max_nodes) || (d->deadline > 0 && now >= d->deadline)) {
+        dfpn_stop(d);
+        return true;
+    }
+    if (d->report != NULL && now - d->reported >= DFPN_REPORT_MS) {
+        dfpn_progress p = {d->nodes, now - d->started, d->attacker, d->root_proof, d->root_disproof, d->used,
+            d->mask + 1, d->collections};
+        d->report(d->report_arg, &p);
+        d->reported = now;
+    }
+    return false;
+}
+
+/**
+ * Adds two numbers, saturating at DFPN_INF.
+ * @param a A number.
+ * @param b Another.
+ * @return The sum.
+*/
+uint32_t static add(uint32_t a, uint32_t b) {
+    return a >= DFPN_INF - b ? DFPN_INF : a + b;
+}
+
+/**
+ * Searches a node until its phi or delta reaches its threshold, or it is solved. The numbers
+ * of the children are read from the table once and then kept here as they come back, so a
+ * child pushed out of its cluster while a sibling is searched is not searched again from 1.
+ * @param d The solver.
+ * @param g The game, which is back in the same position when this returns.
+ * @param or_node Whether the attacker is to move.
+ * @param root Whether the node is the root.
+ * @param th_phi The threshold for phi.
+ * @param th_delta The threshold for delta.
+ * @param phi Where to put phi when the search stops.
+ * @param delta Where to put delta when the search stops.
+*/
+void static mid(dfpn* d, game* g, bool or_node, bool root, uint32_t th_phi, uint32_t th_delta, uint32_t* phi,
+    uint32_t* delta) {
+    unsigned char me = or_node ? d->attacker : other(d->attacker);
+    uint64_t key = node_key(g, me);
+    dfpn_move list[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    int n = 0;
+    int status = NODE_OPEN;
+    if (g->state != GAME_STATE_PLAYING) {
+        bool goal = me == d->attacker ? g->winner == d->attacker : g->winner != d->attacker;
+        status = goal ? NODE_WON : NODE_LOST;
+    } else {
+        status = generate(d, g, or_node, root, list, &n);
+    }
+    if (status != NODE_OPEN) {
+        *phi = status == NODE_WON ? 0 : DFPN_INF;
+        *delta = status == NODE_WON ? DFPN_INF : 0;
+        store(d, key, *phi, *delta, 1, SEARCH_NO_MOVE, SEARCH_NO_MOVE);
+        return;
+    }
+
+    uint64_t keys[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    uint32_t phis[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    uint32_t deltas[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    uint64_t position = g->hashes[SYMMETRY_IDENTITY] ^ hash_side(other(me));
+    for (int i = 0; i < n; i++) {
+        keys[i] = position ^ hash_key(me, list[i].y * g->board->size + list[i].x);
+        lookup(d, keys[i], &phis[i], &deltas[i]);
+    }
+
+    unsigned long start = d->nodes;
+    int best = 0;
+    while (true) {
+        // phi is the smallest delta of a child; delta is the weak sum of the children's phi.
+        uint32_t delta2 = DFPN_INF;
+        uint32_t largest = 0;
+        uint32_t open = 0;
+        *phi = DFPN_INF;
+        for (int i = 0; i < n; i++) {
+            if (deltas[i] < *phi) {
+                delta2 = *phi;
+                *phi = deltas[i];
+                best = i;
+            } else if (deltas[i] < delta2) {
+                delta2 = deltas[i];
+            }
+            if (phis[i] > 0) {
+                open++;
+                largest = phis[i] > largest ? phis[i] : largest;
+            }
+        }
+        *delta = open == 0 ? 0 : add(largest, open - 1);
+        if (root) {
+            d->root_proof = or_node ? *phi : *delta;
+            d->root_disproof = or_node ? *delta : *phi;
+        }
+        if (*phi >= th_phi || *delta >= th_delta || aborted(d)) {
+            break;
+        }
+
+        // The child has to bring delta up to its threshold on its own, with every other
+        // unsolved child counting one.
+        uint32_t others = open - (phis[best] > 0);
+        uint32_t child_th_phi = th_delta >= DFPN_INF ? DFPN_INF : th_delta - others;
+        uint32_t child_th_delta = add(delta2, delta2 / 4 + 1);
+        child_th_delta = th_phi < child_th_delta ? th_phi : child_th_delta;
+
+        if (game_place_stone(g, list[best].x, list[best].y) != SUCCESS) {
+            phis[best] = 0;
+            deltas[best] = DFPN_INF;
+            continue;
+        }
+        d->nodes++;
+        mid(d, g, !or_node, false, child_th_phi, child_th_delta, &phis[best], &deltas[best]);
+        game_undo(g);
+    }
+    store(d, key, *phi, *delta, d->nodes - start + 1, list[best].x, list[best].y);
+}
+
+/**
+ * Runs the search from the root until it is solved or the budget runs out.
+ * @param d The solver.
+ * @param g The game.
+ * @param attacker The color trying to win.
+ * @return Whether the attacker was proven to win.
+*/
+bool static prove(dfpn* d, game* g, unsigned char attacker) {
+    dfpn_clear(d);
+    d->attacker = attacker;
+    d->root_proof = 1;
+    d->root_disproof = 1;
+    uint32_t phi;
+    uint32_t delta;
+    mid(d, g, g->stone == attacker, true, DFPN_INF, DFPN_INF, &phi, &delta);
+    return g->stone == attacker ? phi == 0 : delta == 0;
+}
+
+/**
+ * Finds an intersection where a color would make five.
+ * @param g The game.
+ * @param stone The color.
+ * @param x Where to put the x coordinate.
+ * @param y Where to put the y coordinate.
+ * @return Whether there is one.
+*/
+bool static find_five(game* g, unsigned char stone, unsigned char* x, unsigned char* y) {
+    for (*y = 0; *y < g->board->size; (*y)++) {
+        for (*x = 0; *x < g->board->size; (*x)++) {
+            if (board_get(g->board, *x, *y) == EMPTY_INTERSECTION && makes_five(g, stone, *x, *y)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Follows the proof from the root: the attacker plays a move that was proven to win, and the
+ * defender the one that held out longest. The line stops early where a collection has taken
+ * part of the proof out of the table.
+ * @param d The solver.
+ * @param g The game, which is copied.
+ * @param r The result to put the line in.
+*/
+void static follow_proof(dfpn* d, game* g, dfpn_result* r) {
+    game* c = game_copy(g);
+    if (c == NULL) {
+        return;
+    }
+
+    dfpn_move list[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    while (c->state == GAME_STATE_PLAYING && r->length < DFPN_MAX_LINE) {
+        bool or_node = c->stone == d->attacker;
+        int n;
+        int status = generate(d, c, or_node, r->length == 0, list, &n);
+        if (status != NODE_OPEN) {
+            // The end is not searched: make the five, or block one of the attacker's fives
+            // and lose to the other.
+            n = status == NODE_WON || !or_node ?
+                find_five(c, status == NODE_WON ? c->stone : d->attacker, &list[0].x, &list[0].y) : 0;
+        }
+
+        int chosen = -1;
+        uint32_t longest = 0;
+        uint64_t position = c->hashes[SYMMETRY_IDENTITY] ^ hash_side(other(c->stone));
+        for (int i = 0; i < n && (chosen < 0 || !or_node); i++) {
+            dfpn_entry* e = probe(d, position ^ hash_key(c->stone, list[i].y * c->board->size + list[i].x));
+            bool proven = e != NULL && (or_node ? e->phi >= DFPN_INF : e->phi == 0);
+            if (n == 1 || (proven && (chosen < 0 || e->work > longest))) {
+                chosen = i;
+                longest = e == NULL ? 0 : e->work;
+            }
+        }
+        if (chosen < 0 || game_place_stone(c, list[chosen].x, list[chosen].y) != SUCCESS) {
+            break;
+        }
+        r->line[r->length][0] = list[chosen].x;
+        r->line[r->length][1] = list[chosen].y;
+        r->length++;
+    }
+    game_delete(c);
+}
+
+/**
+ * Looks a position up in the solved position cache, keeping only a result proven by threats
+ * the mode allows: fours for DFPN_VCF, fours or threes for DFPN_VCT.
+ * @param d The solver.
+ * @param g The game.
+ * @param e Where to put the result, with its move in the orientation of the game.
+ * @return Whether there was one.
+*/
+bool static cache_probe(dfpn* d, game* g, cache_entry* e) {
+    unsigned char t;
+    if (!cache_lookup(d->cache, g->type, g->board->size, game_canonical_hash(g, &t), e) ||
+        e->proof == CACHE_BY_SEARCH || (d->mode == DFPN_VCF && e->proof != CACHE_BY_VCF)) {
+        return false;
+    }
+    symmetry_revert(t, g->board->size, e->x, e->y, &e->x, &e->y);
+    return true;
+}
+
+/**
+ * Reads the result of the root from the solved position cache, and its line as far as the
+ * cache holds the positions along it.
+ * @param d The solver.
+ * @param g The game.
+ * @param defend Whether a win for the other side is wanted too.
+ * @param r The result to fill in.
+ * @return Whether the root was found.
+*/
+bool static recall(dfpn* d, game* g, bool defend, dfpn_result* r) {
+    cache_entry e;
+    if (d->cache == NULL || !cache_probe(d, g, &e)) {
+        return false;
+    }
+
+    // A side that loses has no win to find.
+    if (e.result != CACHE_WIN && !defend) {
+        return true;
+    }
+    r->result = e.result == CACHE_WIN ? DFPN_WIN : DFPN_LOSS;
+    r->winner = e.result == CACHE_WIN ? g->stone : other(g->stone);
+    game* c = game_copy(g);
+    if (c == NULL) {
+        return true;
+    }
+    while ((e.result == CACHE_WIN) == (c->stone == r->winner) && game_place_stone(c, e.x, e.y) == SUCCESS) {
+        r->line[r->length][0] = e.x;
+        r->line[r->length][1] = e.y;
+        r->length++;
+        if (c->state != GAME_STATE_PLAYING || r->length == DFPN_MAX_LINE || !cache_probe(d, c, &e)) {
+            break;
+        }
+    }
+    game_delete(c);
+    return true;
+}
+
+/**
+ * Stores every position along a winning line in the solved position cache. A line cut short
+ * by a collection proves nothing past its end, so nothing of it is stored.
+ * @param d The solver.
+ * @param g The game at the root.
+ * @param r The result, with its line.
+*/
+void static remember(dfpn* d, game* g, const dfpn_result* r) {
+    game* c = game_copy(g);
+    if (c == NULL) {
+        return;
+    }
+
+    uint64_t hashes[DFPN_MAX_LINE];
+    unsigned char transforms[DFPN_MAX_LINE];
+    unsigned char stones[DFPN_MAX_LINE];
+    int played = 0;
+    while (played < r->length) {
+        hashes[played] = game_canonical_hash(c, &transforms[played]);
+        stones[played] = c->stone;
+        if (game_place_stone(c, r->line[played][0], r->line[played][1]) != SUCCESS) {
+            break;
+        }
+        played++;
+    }
+    bool complete = played == r->length && c->state != GAME_STATE_PLAYING && c->winner == r->winner;
+    unsigned char size = c->board->size;
+    unsigned char type = c->type;
+    game_delete(c);
+    if (!complete) {
+        return;
+    }
+
+    for (int i = 0; i < r->length; i++) {
+        cache_entry e;
+        e.result = stones[i] == r->winner ? CACHE_WIN : CACHE_LOSS;
+        e.depth = r->length - i;
+        e.proof = d->mode == DFPN_VCF ? CACHE_BY_VCF : CACHE_BY_VCT;
+        symmetry_apply(transforms[i], size, r->line[i][0], r->line[i][1], &e.x, &e.y);
+        cache_store(d->cache, type, size, hashes[i], &e);
+    }
+}
+
+/**
+ * Tries to prove a win for the side to move and, if asked, then a win for the other side
+ * against every move, both within one budget.
+ * @param d The solver.
+ * @param g The game, which is back in the same position when this returns.
+ * @param mode DFPN_VCF for fours only, DFPN_VCT for fours and open threes.
+ * @param max_nodes The most nodes to search, or 0 for no limit.
+ * @param time_ms The most time to take in milliseconds, or 0 for no limit.
+ * @param defend Whether to try the other side too.
+ * @return The result, with the winning line if there is one.
+*/
+dfpn_result static run(dfpn* d, game* g, unsigned char mode, unsigned long max_nodes, long time_ms, bool defend) {
+    dfpn_result r;
+    memset(&r, 0, sizeof(r));
+    r.result = DFPN_UNKNOWN;
+    r.winner = EMPTY_INTERSECTION;
+
+    __atomic_store_n(&d->stop, 0, __ATOMIC_RELAXED);
+    d->mode = mode;
+    d->nodes = 0;
+    d->max_nodes = max_nodes;
+    d->collections = 0;
+    d->freed = 0;
+    d->started = search_clock();
+    d->reported = d->started;
+    d->deadline = time_ms > 0 ? d->started + time_ms : 0;
+
+    if (g->state == GAME_STATE_PLAYING && !recall(d, g, defend, &r)) {
+        unsigned char winner = EMPTY_INTERSECTION;
+        if (prove(d, g, g->stone)) {
+            winner = g->stone;
+        } else if (defend && !__atomic_load_n(&d->stop, __ATOMIC_RELAXED) && prove(d, g, other(g->stone))) {
+            winner = other(g->stone);
+        }
+        if (winner != EMPTY_INTERSECTION) {
+            r.result = winner == g->stone ? DFPN_WIN : DFPN_LOSS;
+            r.winner = winner;
+            follow_proof(d, g, &r);
+            if (d->cache != NULL) {
+                remember(d, g, &r);
+            }
+        }
+    }
+    r.nodes = d->nodes;
+    r.elapsed_ms = search_clock() - d->started;
+    return r;
+}
+
+/**
+ * Solves a position: first tries to prove a win for the side to move, then a win for the
+ * other side against every move, both within one budget.
+ * @param d The solver.
+ * @param g The game, which is back in the same position when this returns.
+ * @param mode DFPN_VCF for fours only, DFPN_VCT for fours and open threes.
+ * @param max_nodes The most nodes to search, or 0 for no limit.
+ * @param time_ms The most time to take in milliseconds, or 0 for no limit.
+ * @return The result, with the winning line if there is one.
+*/
+dfpn_result dfpn_solve(dfpn* d, game* g, unsigned char mode, unsigned long max_nodes, long time_ms) {
+    return run(d, g, mode, max_nodes, time_ms, true);
+}
+
+/**
+ * Only tries to prove a win for the side to move, which is all a search for missed wins needs,
+ * and saves the budget the other side would take where there is none.
+ * @param d The solver.
+ * @param g The game, which is back in the same position when this returns.
+ * @param mode DFPN_VCF for fours only, DFPN_VCT for fours and open threes.
+ * @param max_nodes The most nodes to search, or 0 for no limit.
+ * @param time_ms The most time to take in milliseconds, or 0 for no limit.
+ * @return The result, DFPN_WIN with the winning line or DFPN_UNKNOWN.
+*/
+dfpn_result dfpn_attack(dfpn* d, game* g, unsigned char mode, unsigned long max_nodes, long time_ms) {
+    return run(d, g, mode, max_nodes, time_ms, false);
+}
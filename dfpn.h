@@ -0,0 +1,78 @@
+#ifndef _DFPN_H_
+#define _DFPN_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cache.h"
+#include "game.h"
+#define DFPN_INF 0x7FFFFFFFu
+#define DFPN_MEMORY (64 << 20)
+#define DFPN_CLUSTER 8
+#define DFPN_MAX_LINE 64
+#define DFPN_REPORT_MS 1000
+#define DFPN_VCF 0
+#define DFPN_VCT 1
+#define DFPN_UNKNOWN 0
+#define DFPN_WIN 1
+#define DFPN_LOSS 2
+
+typedef struct {
+    uint64_t key;
+    uint32_t phi;
+    uint32_t delta;
+    uint32_t work;
+    unsigned char x;
+    unsigned char y;
+} dfpn_entry;
+
+typedef struct {
+    unsigned long nodes;
+    long long elapsed_ms;
+    unsigned char attacker;
+    uint32_t proof;
+    uint32_t disproof;
+    size_t used;
+    size_t capacity;
+    unsigned long collections;
+} dfpn_progress;
+
+typedef void (*dfpn_report)(void* arg, const dfpn_progress* p);
+
+typedef struct {
+    dfpn_entry* table;
+    size_t mask;
+    size_t used;
+    unsigned char mode;
+    unsigned char attacker;
+    int stop;
+    long long started;
+    long long deadline;
+    long long reported;
+    unsigned long nodes;
+    unsigned long max_nodes;
+    unsigned long collections;
+    unsigned long freed;
+    uint32_t root_proof;
+    uint32_t root_disproof;
+    dfpn_report report;
+    void* report_arg;
+    cache* cache;
+} dfpn;
+
+typedef struct {
+    unsigned char result;
+    unsigned char winner;
+    int length;
+    unsigned char line[DFPN_MAX_LINE][2];
+    unsigned long nodes;
+    long long elapsed_ms;
+} dfpn_result;
+
+dfpn* dfpn_create(size_t bytes);
+void dfpn_delete(dfpn* d);
+bool dfpn_use_cache(dfpn* d, const char* path);
+void dfpn_clear(dfpn* d);
+void dfpn_stop(dfpn* d);
+dfpn_result dfpn_solve(dfpn* d, game* g, unsigned char mode, unsigned long max_nodes, long time_ms);
+dfpn_result dfpn_attack(dfpn* d, game* g, unsigned char mode, unsigned long max_nodes, long time_ms);
+#endif
@@ -0,0 +1,247 @@
+/**
+ * @file engine.c
+ * @author Faris Soliman
+ * This file contains the computer opponent. On its own turn it searches for a move within its
+ * thinking time. On the human's turn it guesses the reply and, while the frontend waits for
+ * the human's move, keeps searching the position after that reply on a background thread
+ * (pondering). If the human plays the guessed move the search carries on with everything it
+ * has found so far and only gets whatever is left of the thinking time; otherwise it is
+ * stopped and thrown away, keeping only the transposition table.
+ *
+ * Given a node budget instead, the computer searches every move to that budget whatever the
+ * time. A ponder hit runs its whole budget; a miss is stopped, and since how far it got depends
+ * on how fast the human answered, its table is thrown away too. Either way the games it plays
+ * do not depend on how fast the machine is or how fast the human answers.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdlib.h>
+#include "cache.h"
+#include "error-codes.h"
+#include "engine.h"
+#include "game.h"
+#include "nnue.h"
+#include "search.h"
+
+/**
+ * Creates a computer opponent.
+ * @param stone The color the computer plays.
+ * @param think_ms The time the computer may think about a move in milliseconds.
+ * @return The new engine, or NULL if it could not be allocated.
+*/
+engine* engine_create(unsigned char stone, long think_ms) {
+    engine* e = malloc(sizeof(engine));
+    if (e == NULL) {
+        return NULL;
+    }
+
+    e->search = search_create(SEARCH_TABLE_SIZE);
+    if (e->search == NULL) {
+        free(e);
+        return NULL;
+    }
+
+    e->stone = stone;
+    e->think_ms = think_ms;
+    e->max_nodes = 0;
+    e->ponder = NULL;
+    e->ready = false;
+    e->network = NULL;
+    return e;
+}
+
+/**
+ * Deletes a computer opponent.
+ * @param e The engine to delete.
+*/
+void engine_delete(engine* e) {
+    if (e == NULL) {
+        return;
+    }
+
+    cache_close(e->search->cache);
+    search_delete(e->search);
+    nnue_close(e->network);
+    free(e);
+}
+
+/**
+ * Lets a computer opponent share proven results with other processes through a solved
+ * position cache file, which is created if it does not exist.
+ * @param e The engine.
+ * @param path The path to the cache file.
+ * @return Whether the cache could be opened.
+*/
+bool engine_use_cache(engine* e, const char* path) {
+    cache* c = cache_open(path, CACHE_SLOTS);
+    if (c == NULL) {
+        return false;
+    }
+
+    cache_close(e->search->cache);
+    e->search->cache = c;
+    return true;
+}
+
+/**
+ * Makes a computer opponent evaluate positions with a network instead of the pattern weights.
+ * @param e The engine.
+ * @param path The path to the network file.
+ * @return Whether the network could be loaded.
+*/
+bool engine_use_network(engine* e, const char* path) {
+    nnue_network* n = nnue_load(path);
+    if (n == NULL) {
+        return false;
+    }
+
+    nnue_close(e->network);
+    e->network = n;
+    return true;
+}
+
+/**
+ * Sets up the engine's network on a game it is about to search, if it has one and the game
+ * does not evaluate with it yet.
+ * @param e The engine.
+ * @param g The game.
+ * @return Whether the game is ready to search.
+*/
+bool static engine_attach(engine* e, game* g) {
+    if (e->network == NULL || (g->nnue != NULL && g->nnue->net == e->network)) {
+        return true;
+    }
+    return game_use_network(g, e->network);
+}
+
+/**
+ * Makes the computer search a fixed number of nodes for every move instead of thinking for a
+ * time.
+ * @param e The engine.
+ * @param max_nodes The node budget of every move, or 0 to go back to thinking for a time.
+*/
+void engine_use_nodes(engine* e, unsigned long max_nodes) {
+    e->max_nodes = max_nodes;
+}
+
+/**
+ * The body of the pondering thread.
+ * @param arg The engine.
+ * @return Nothing.
+*/
+void static* engine_ponder_main(void* arg) {
+    engine* e = arg;
+    e->ponder_result = search_run(e->search, e->ponder, SEARCH_MAX_DEPTH, e->max_nodes);
+    return NULL;
+}
+
+/**
+ * Starts pondering on the position after the guessed reply, to be called when the human is
+ * about to think about a move. Nothing happens if there is no guess, the guess ends the game,
+ * or the copy or thread cannot be made.
+ * @param e The engine.
+ * @param g The game, with the human to move.
+*/
+void engine_ponder_start(engine* e, game* g) {
+    unsigned char x;
+    unsigned char y;
+    if (g->state != GAME_STATE_PLAYING || g->stone == e->stone || !search_predict(e->search, g, &x, &y)) {
+        return;
+    }
+
+    e->ponder = game_copy(g);
+    if (e->ponder == NULL) {
+        return;
+    }
+    if (!engine_attach(e, e->ponder)) {
+        game_delete(e->ponder);
+        e->ponder = NULL;
+        return;
+    }
+    game_place_stone(e->ponder, x, y);
+    e->ponder_x = x;
+    e->ponder_y = y;
+    e->ponder_moves = e->ponder->moves_count;
+    if (e->ponder->state == GAME_STATE_PLAYING) {
+        search_prepare(e->search, 0);
+        e->ponder_started = search_clock();
+        if (pthread_create(&e->thread, NULL, engine_ponder_main, e) == 0) {
+            return;
+        }
+    }
+
+    game_delete(e->ponder);
+    e->ponder = NULL;
+}
+
+/**
+ * Ends pondering once the human has moved or stopped the game. On a ponder hit the search
+ * gets the rest of the thinking time, counted from when pondering started, and its result is
+ * kept for the computer's turn; with a node budget, pondering finishes its budget first. A miss,
+ * or a game that stopped, stops pondering, and with a node budget also clears the table, so the
+ * computer's next move is searched from scratch. Nothing happens if the engine is not pondering.
+ * @param e The engine.
+ * @param g The game after the human's turn.
+*/
+void engine_ponder_finish(engine* e, game* g) {
+    if (e->ponder == NULL) {
+        return;
+    }
+
+    // The pondering thread is still playing moves on its copy, so only look at the guess.
+    move* last = g->moves_count > 0 ? &g->moves[g->moves_count - 1] : NULL;
+    bool hit = g->state == GAME_STATE_PLAYING && g->moves_count == e->ponder_moves &&
+        last->x == e->ponder_x && last->y == e->ponder_y;
+
+    // With a node budget a hit runs the whole budget, so what it leaves in the table is always
+    // the same; what a stopped miss leaves depends on when it was stopped.
+    if (hit && e->max_nodes == 0) {
+        search_set_deadline(e->search, e->ponder_started + e->think_ms);
+    } else if (!hit) {
+        search_stop(e->search);
+    }
+    pthread_join(e->thread, NULL);
+    if (!hit && e->max_nodes > 0) {
+        search_clear(e->search);
+    }
+
+    if (hit && e->ponder_result.x != SEARCH_NO_MOVE) {
+        e->ready = true;
+        e->ready_hash = game_hash(g);
+        e->ready_result = e->ponder_result;
+    }
+    game_delete(e->ponder);
+    e->ponder = NULL;
+}
+
+/**
+ * Plays the computer's move, reusing the result of pondering if the human played the guessed
+ * move.
+ * @param e The engine.
+ * @param g The game, with the computer to move.
+ * @return SUCCESS, INPUT_ERR if it is not the computer's turn or there is no move to play, or
+ *         the error game_place_stone() returned.
+*/
+unsigned char engine_play(engine* e, game* g) {
+    if (g->state != GAME_STATE_PLAYING || g->stone != e->stone) {
+        return INPUT_ERR;
+    }
+    if (!engine_attach(e, g)) {
+        return NULL_POINTER_ERR;
+    }
+
+    search_result r;
+    if (e->ready && e->ready_hash == game_hash(g)) {
+        r = e->ready_result;
+    } else {
+        search_prepare(e->search, e->max_nodes > 0 ? 0 : e->think_ms);
+        r = search_run(e->search, g, SEARCH_MAX_DEPTH, e->max_nodes);
+    }
+    e->ready = false;
+
+    // Out of time before the first iteration finished: take the strongest looking move.
+    if (r.x == SEARCH_NO_MOVE && !search_predict(e->search, g, &r.x, &r.y)) {
+        return INPUT_ERR;
+    }
+    return game_place_stone(g, r.x, r.y);
+}
@@ -0,0 +1,38 @@
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "game.h"
+#include "nnue.h"
+#include "search.h"
+#define ENGINE_THINK_MS 1000
+
+typedef struct engine {
+    unsigned char stone;
+    long think_ms;
+    unsigned long max_nodes;
+    search* search;
+    game* ponder;
+    unsigned char ponder_x;
+    unsigned char ponder_y;
+    size_t ponder_moves;
+    pthread_t thread;
+    long long ponder_started;
+    search_result ponder_result;
+    bool ready;
+    uint64_t ready_hash;
+    search_result ready_result;
+    nnue_network* network;
+} engine;
+
+engine* engine_create(unsigned char stone, long think_ms);
+void engine_delete(engine* e);
+void engine_use_nodes(engine* e, unsigned long max_nodes);
+bool engine_use_cache(engine* e, const char* path);
+bool engine_use_network(engine* e, const char* path);
+void engine_ponder_start(engine* e, game* g);
+void engine_ponder_finish(engine* e, game* g);
+unsigned char engine_play(engine* e, game* g);
+#endif
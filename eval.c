@@ -0,0 +1,116 @@
+/**
+ * @file eval.c
+ * @author Faris Soliman
+ * This file contains the static position evaluator. A position is scored by the patterns the
+ * stones of each color are part of: every stone adds the weight of its pattern once per
+ * direction, so an open three adds three open three weights. The pattern codes come from the
+ * game's threat map, and since a move only changes the codes along the four lines through it,
+ * the running score is kept up to date by taking those lines out before a stone is placed or
+ * removed and putting them back afterwards.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "eval.h"
+#include "game.h"
+#include "pattern.h"
+#include "threat.h"
+
+// Weights per stone and direction, indexed by rule set, color and pattern code.
+static const int weights[2][2][PATTERN_KINDS] = {
+    // Freestyle: both colors play by the same rules and an overline wins.
+    {
+        {0, 2, 6, 40, 50, 500, EVAL_WIN / 5, EVAL_WIN / 5},
+        {0, 2, 6, 40, 50, 500, EVAL_WIN / 5, EVAL_WIN / 5},
+    },
+    // Renju: black's overline loses and two open fours are forbidden to black, so black's
+    // open fours are worth less; white's overline wins.
+    {
+        {0, 2, 6, 40, 50, 300, EVAL_WIN / 5, -EVAL_WIN / 5},
+        {0, 2, 7, 45, 55, 500, EVAL_WIN / 5, EVAL_WIN / 5},
+    },
+};
+
+/**
+ * Gets the weight one stone adds for a pattern along one direction.
+ * @param game_type The rule set.
+ * @param stone The color of the stone.
+ * @param code The pattern code.
+ * @return The weight.
+*/
+int eval_weight(unsigned char game_type, unsigned char stone, unsigned char code) {
+    return weights[game_type == GAME_RENJU][stone - BLACK_STONE][code];
+}
+
+/**
+ * Adds or takes out one pattern of a stone.
+ * @param e The evaluator.
+ * @param stone The color of the stone.
+ * @param code The pattern code.
+ * @param sign 1 to add the pattern, -1 to take it out.
+*/
+void static eval_pattern(evaluator* e, unsigned char stone, unsigned char code, int sign) {
+    int w = eval_weight(e->type, stone, code);
+    e->counts[stone - BLACK_STONE][code] += sign;
+    e->score += stone == BLACK_STONE ? sign * w : -sign * w;
+}
+
+/**
+ * Computes the score of a position from scratch.
+ * @param e The evaluator to set up.
+ * @param game_type The rule set.
+ * @param b The board.
+ * @param t The threat map of the board.
+*/
+void eval_init(evaluator* e, unsigned char game_type, board* b, const threat_map* t) {
+    memset(e, 0, sizeof(evaluator));
+    e->type = game_type;
+    for (int y = 0; y < b->size; y++) {
+        for (int x = 0; x < b->size; x++) {
+            unsigned char stone = b->grid[y * b->size + x];
+            if (stone == EMPTY_INTERSECTION) {
+                continue;
+            }
+            for (int d = 0; d < DIRECTIONS; d++) {
+                eval_pattern(e, stone, threat_get(t, stone, d, x, y), 1);
+            }
+        }
+    }
+}
+
+/**
+ * Adds or takes out the contribution of the four lines through (x, y), which are the only
+ * ones a stone placed on or removed from (x, y) can change. Call it with -1 before the
+ * change and with 1 once the board and the threat map have been updated.
+ * @param e The evaluator.
+ * @param b The board.
+ * @param t The threat map of the board.
+ * @param x The x coordinate of the change.
+ * @param y The y coordinate of the change.
+ * @param sign 1 to add the lines, -1 to take them out.
+*/
+void eval_lines(evaluator* e, board* b, const threat_map* t, unsigned char x, unsigned char y, int sign) {
+    for (int d = 0; d < DIRECTIONS; d++) {
+        for (int k = -5; k <= 5; k++) {
+            int cx = x + k * pattern_dx[d];
+            int cy = y + k * pattern_dy[d];
+            if (cx < 0 || cx >= b->size || cy < 0 || cy >= b->size) {
+                continue;
+            }
+            unsigned char stone = b->grid[cy * b->size + cx];
+            if (stone != EMPTY_INTERSECTION) {
+                eval_pattern(e, stone, threat_get(t, stone, d, cx, cy), sign);
+            }
+        }
+    }
+}
+
+/**
+ * Gets the score of the position from one color's point of view.
+ * @param e The evaluator.
+ * @param stone The color to score for.
+ * @return The score, positive when the color is better.
+*/
+int eval_score(const evaluator* e, unsigned char stone) {
+    return stone == BLACK_STONE ? e->score : -e->score;
+}
\ No newline at end of file
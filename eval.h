@@ -0,0 +1,18 @@
+#ifndef _EVAL_H_
+#define _EVAL_H_
+#include "board.h"
+#include "pattern.h"
+#include "threat.h"
+#define EVAL_WIN 1000000
+
+typedef struct {
+    unsigned char type;
+    int score;
+    int counts[2][PATTERN_KINDS];
+} evaluator;
+
+void eval_init(evaluator* e, unsigned char game_type, board* b, const threat_map* t);
+void eval_lines(evaluator* e, board* b, const threat_map* t, unsigned char x, unsigned char y, int sign);
+int eval_score(const evaluator* e, unsigned char stone);
+int eval_weight(unsigned char game_type, unsigned char stone, unsigned char code);
+#endif
\ No newline at end of file
@@ -2,30 +2,40 @@
  * @file game.c
  * @author Faris Soliman
  * This file contains the implementation of the game struct and its functions.
- * It also contains the implementation of the functions used to check if the game is won or drawn.
+ * It also checks if the game is won or drawn, with the rule kernel in rules.c for its board size.
  * It also contains the implementation of the functions used to place stones on the board
- * and used to create, delete, and print games. It contains all the methods for checking in game 
- * rules and updating the game.
+ * and used to create and delete games. It contains all the methods for checking in game rules
+ * and updating the game. Nothing here reads input, prints or exits: errors are returned as the
+ * codes in error-codes.h, and every function only touches the game it is given, so separate
+ * games can be played on separate threads. The console frontend is in console.c.
 */
-#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
 #include "board.h"
+#include "broadcast.h"
 #include "game.h"
 #include "error-codes.h"
-#include "io.h"
+#include "eval.h"
+#include "hash.h"
+#include "journal.h"
+#include "nnue.h"
+#include "rules.h"
+#include "symmetry.h"
+#include "threat.h"
 
 /**
  * Creates a new game.
  * @param board_size The size of the board.
  * @param game_type The type of the game.
- * @return The new game.
+ * @return The new game, or NULL if the size or type is invalid or it could not be allocated.
 */
 game* game_create(unsigned char board_size, unsigned char game_type) {
+    if (board_size < 1 || board_size > PATTERN_MAX_SIZE || (game_type != GAME_FREESTYLE && game_type != GAME_RENJU)) {
+        return NULL;
+    }
+
     game* g = malloc(sizeof(game));
     if (g == NULL) {
-        exit(NULL_POINTER_ERR);
+        return NULL;
     }
 
     g->board = board_create(board_size);
@@ -34,654 +44,315 @@ game* game_create(unsigned char board_size, unsigned char game_type) {
     g->state = GAME_STATE_PLAYING;
     g->winner = EMPTY_INTERSECTION;
     g->moves = malloc(sizeof(move) * 16);
-    if (g->moves == NULL) {
-        exit(NULL_POINTER_ERR);
-    }
-
     g->moves_count = 0;
     g->moves_capacity = 16;
+    g->threats = g->board == NULL ? NULL : threat_create(g->board);
+    if (g->moves == NULL || g->threats == NULL) {
+        board_delete(g->board);
+        threat_delete(g->threats);
+        free(g->moves);
+        free(g);
+        return NULL;
+    }
+    eval_init(&g->eval, game_type, g->board, g->threats);
+    for (int t = 0; t < SYMMETRIES; t++) {
+        g->hashes[t] = 0;
+    }
+    g->rules = rules_select(board_size);
+    g->nnue = NULL;
+    g->engine = NULL;
+    g->journal = NULL;
+    g->broadcast = NULL;
 
     return g;
 }
 
+/**
+ * Copies a game by replaying its moves on a new game, so the copy has its own board, threat
+ * map and evaluation, and its own accumulators if the game evaluates with a network. A
+ * computer opponent, journal or broadcast attached to the game is not copied.
+ * @param g The game to copy.
+ * @return The copy, or NULL if it could not be allocated.
+*/
+game* game_copy(game* g) {
+    game* c = game_create(g->board->size, g->type);
+    if (c == NULL) {
+        return NULL;
+    }
+    if (g->nnue != NULL && !game_use_network(c, g->nnue->net)) {
+        game_delete(c);
+        return NULL;
+    }
+    for (size_t i = 0; i < g->moves_count && c->state == GAME_STATE_PLAYING; i++) {
+        game_place_stone(c, g->moves[i].x, g->moves[i].y);
+    }
+    c->state = g->state;
+    c->winner = g->winner;
+    return c;
+}
+
 /**
  * Deletes a game.
- * @param g The game to delete.
+ * @param g The game to delete, or NULL.
 */
 void game_delete(game* g) {
     if (g == NULL) {
-        exit(NULL_POINTER_ERR);
+        return;
     }
 
     board_delete(g->board);
+    threat_delete(g->threats);
     free(g->moves);
+    free(g->nnue);
     free(g);
 }
 
 /**
- * Checks if an input is valid.
- * @param input The input to check.
- * @return Whether the input is valid.
+ * Makes a game evaluate its positions with a network instead of the pattern weights. The
+ * network's accumulators are set up for the board and then kept up to date with every stone
+ * placed or taken back, like the running pattern score.
+ * @param g The game.
+ * @param n The network, which has to stay open as long as the game uses it.
+ * @return Whether the accumulators could be allocated.
 */
-bool static isValidInput(char* input, game* game) {
-    if (strlen(input) == 0) {
+bool game_use_network(game* g, const nnue_network* n) {
+    if (g->nnue == NULL && (g->nnue = malloc(sizeof(nnue_state))) == NULL) {
         return false;
     }
-    
-    if (input[0] < 'A' || input[0] > game->board->size + 'A' - 1) {
-        return false;
-    }
-
-    unsigned char y;
-    sscanf(input + 1, "%hhu", &y);
-
-    if (y <= 0 || y > game->board->size) {
-        return false;
-    }
-    
-    if (strcmp(input, "EOF") == 0) {
-        return true;
-    }
-    
-    if (board_get(game->board, input[0] - 'A', y - 1) != EMPTY_INTERSECTION) {
-        return false;
-    }
-    
+    nnue_refresh(g->nnue, n, g->board, g->type);
     return true;
 }
 
-bool static is_overline(game* g, unsigned char x, unsigned char y) {
-    if (g->stone == WHITE_STONE) {
-        return false;
+/**
+ * Evaluates the position for the color to move, with the game's network if it has one and
+ * with the pattern weights otherwise.
+ * @param g The game.
+ * @return The score, positive when the color to move is better.
+*/
+int game_evaluate(game* g) {
+    if (g->nnue != NULL) {
+        return nnue_evaluate(g->nnue, g->stone);
     }
+    return eval_score(&g->eval, g->stone);
+}
 
-    int count = 0;
-    int i = 0;
-    int j = 0;
-    int k = 0;
-    int l = 0;
-
-    // check horizontal
-    for (i = x - 4; i <= x + 4; i++) {
-        if (i < 0 || i >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, i, y) == g->stone) {
-            count++;
-            if (count == 6) {
-                return true;
-            }
-        } else {
-            count = 0;
-        }
+/**
+ * Puts a stone on or takes a stone off the board, keeping the threat map, the running
+ * evaluation, the network accumulators and the position hashes in step with it. There is one
+ * hash for each symmetry of the board, the hash the position would have after mapping it
+ * through that symmetry.
+ * @param g The game.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @param stone The stone to put there, or EMPTY_INTERSECTION to take it off.
+*/
+void static game_set_intersection(game* g, unsigned char x, unsigned char y, unsigned char stone) {
+    unsigned char size = g->board->size;
+    unsigned char hashed = stone == EMPTY_INTERSECTION ? board_get(g->board, x, y) : stone;
+    for (int t = 0; t < SYMMETRIES; t++) {
+        unsigned char tx;
+        unsigned char ty;
+        symmetry_apply(t, size, x, y, &tx, &ty);
+        g->hashes[t] ^= hash_key(hashed, ty * size + tx);
+    }
+
+    eval_lines(&g->eval, g->board, g->threats, x, y, -1);
+    if (stone == EMPTY_INTERSECTION) {
+        board_clear(g->board, x, y);
+    } else {
+        board_set(g->board, x, y, stone);
     }
-    
-    // check vertical
-    count = 0;
-    for (j = y - 4; j <= y + 4; j++) {
-        if (j < 0 || j >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x, j) == g->stone) {
-            count++;
-            if (count == 6) {
-                return true;
-            }
-        } else {
-            count = 0;
-        }
+    threat_update(g->threats, g->board, x, y);
+    eval_lines(&g->eval, g->board, g->threats, x, y, 1);
+    if (g->nnue != NULL) {
+        nnue_update(g->nnue, x, y, hashed, stone == EMPTY_INTERSECTION ? -1 : 1);
     }
-    
-    // check diagonal
-    count = 0;
-    for (k = -4; k <= 4; k++) {
-        if (x + k < 0 || x + k >= g->board->size || y + k < 0 || y + k >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + k, y + k) == g->stone) {
-            count++;
-            if (count == 6) {
-                return true;
-            }
-        } else {
-            count = 0;
-        }
-    }
-    
-    // check diagonal (other way)
-    count = 0;
-    for (l = -4; l <= 4; l++) {
-        if (x + l < 0 || x + l >= g->board->size || y - l < 0 || y - l >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + l, y - l) == g->stone) {
-            count++;
-            if (count == 6) {
-                return true;
-            }
-        } else {
-            count = 0;
-        }
+}
+
+/**
+ * This function checks if the game is a draw. It returns true if the board is full, false otherwise.
+ * @param g The game to check.
+ * @return Whether the game is a draw.
+ * 
+*/
+bool static game_check_draw(game* g) {
+    if (g->board->size * g->board->size == g->moves_count) {
+        return true;
     }
     return false;
 }
 
 /**
- * This function checks if there is an open four.
- * @param g The game to check.
+ * Places a stone for the color to move and updates the state of the game, as
+ * game_place_stone() does, except for the broadcast.
+ * @param g The game to place the stone on.
  * @param x The x coordinate of the stone.
  * @param y The y coordinate of the stone.
- * @return Whether there is an open four.
+ * @return The same as game_place_stone().
 */
-bool static is_open_four(game* g, unsigned char x, unsigned char y) {
-    if (g->stone == WHITE_STONE) {
-        return false;
+unsigned char static place_stone(game* g, unsigned char x, unsigned char y) {
+    if (g->state != GAME_STATE_PLAYING) {
+        return INPUT_ERR;
     }
-    int count = 0;
-    int i = 0;
-    int j = 0;
-    int totalIntersections = 0;
-
-    // Check for open four horizontal
-    for (i = x - 4; i <= x + 4; i++) {
-        if (i < 0 || i >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, i, y) == g->stone) {
-            count++;
-            if (count == 4) {
-                if (board_get(g->board, i + 1, y) == EMPTY_INTERSECTION && board_get(g->board, i - 5, y) == EMPTY_INTERSECTION) {
-                    totalIntersections++;
-                }            
-            }
-        } else {
-            count = 0;
-        }
+    if (x >= g->board->size || y >= g->board->size) {
+        return COORDINATE_ERR;
     }
-    
-    // Check for open four vertical
-    count = 0;
-    for (j = y - 4; j <= y + 4; j++) {
-        if (j < 0 || j >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x, j) == g->stone) {
-            count++;
-            if (count == 4) {
-                if (board_get(g->board, x, j + 1) == EMPTY_INTERSECTION && board_get(g->board, x, j - 5) == EMPTY_INTERSECTION) {
-                    totalIntersections++;
-                }
-            }
-        } else {
-            count = 0;
-        }
+    if (board_get(g->board, x, y) != EMPTY_INTERSECTION) {
+        return INPUT_ERR;
     }
-
-    // Check for open four diagonal
-    count = 0;
-    for (i = -4; i <= 4; i++) {
-        if (x + i < 0 || x + i >= g->board->size || y + i < 0 || y + i >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + i, y + i) == g->stone) {
-            count++;
-            if (count == 4) {
-                if (board_get(g->board, x + i + 1, y + i + 1) == EMPTY_INTERSECTION && board_get(g->board, x + i - 5, y + i - 5) == EMPTY_INTERSECTION) {
-                    totalIntersections++;
-                }
-            }
-        } else {
-            count = 0;
+    if (g->moves_count == g->moves_capacity) {
+        move* moves = realloc(g->moves, sizeof(move) * g->moves_capacity * 2);
+        if (moves == NULL) {
+            return NULL_POINTER_ERR;
         }
+        g->moves = moves;
+        g->moves_capacity *= 2;
     }
-
-    // Check for open four diagonal (other way)
-    count = 0;
-    for (i = -4; i <= 4; i++) {
-        if (x + i < 0 || x + i >= g->board->size || y - i < 0 || y - i >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + i, y - i) == g->stone) {
-            count++;
-            if (count == 4) {
-                if (board_get(g->board, x + i + 1, y - i - 1) == EMPTY_INTERSECTION && board_get(g->board, x + i - 5, y - i + 5) == EMPTY_INTERSECTION) {
-                    totalIntersections++;
-                }
-            }
-        } else {
-            count = 0;
-        }
+    if (g->journal != NULL) {
+        journal_append(g->journal, JOURNAL_MOVE, x, y);
     }
 
-    if (totalIntersections > 1) {
-        return true;
-    }
-    return false;
-}
+    game_set_intersection(g, x, y, g->stone);
+    g->moves[g->moves_count].x = x;
+    g->moves[g->moves_count].y = y;
+    g->moves[g->moves_count].stone = g->stone;
+    g->moves_count++;
 
-/**
- * This function controls what happens in the game at each turn. 
- * @param g The game to update.
- * @return Whether the game is updated.
-*/
-bool game_update(game* g) {
-    if (g->state != GAME_STATE_PLAYING) {
-        return false;
+    const unsigned char* grid = g->board->grid;
+    unsigned char size = g->board->size;
+    bool renju_black = g->type == GAME_RENJU && g->stone == BLACK_STONE;
+    if (renju_black && g->rules->overline(grid, size, x, y, g->stone)) {
+        g->state = GAME_STATE_FORBIDDEN;
+        g->winner = WHITE_STONE;
+        return SUCCESS;
     }
 
-    char input[5];
-    if (g->stone == BLACK_STONE) {
-        printf("Black stone's turn, please enter a move: ");
-    } else {
-        printf("White stone's turn, please enter a move: ");
+    if (g->rules->five(grid, size, x, y, g->stone)) {
+        g->state = GAME_STATE_FINISHED;
+        g->winner = g->stone;
+        return SUCCESS;
     }
 
-    //Prompt until a valid input is entered
-    while (fgets(input, 5, stdin)) {
-        if (isValidInput(input, g)) {
-            break;
-        } else if (input[0] == 'E' && input[1] == 'O' && input[2] == 'F') {
-            printf("The game is stopped.\n");
-            g->state = GAME_STATE_STOPPED;
-            return false;
-        } else {
-            printf("The coordinate you entered is invalid, please try again.\n");
-        }
-        if (g->stone == BLACK_STONE) {
-            printf("Black stone's turn, please enter a move: ");
-        } else {
-            printf("White stone's turn, please enter a move: ");
-        }
+    if (game_check_draw(g)) {
+        g->state = GAME_STATE_FINISHED;
+        return SUCCESS;
     }
 
-    if (strlen(input) == 0) {
-        printf("The game is stopped.\n");
-        g->state = GAME_STATE_STOPPED;
-        return false;
+    if (renju_black && g->rules->double_four(grid, size, x, y, g->stone)) {
+        g->state = GAME_STATE_FORBIDDEN;
+        g->winner = WHITE_STONE;
+        return SUCCESS;
     }
 
-    unsigned char value;
-    sscanf(input + 1, "%hhu", &value);
-    game_place_stone(g, input[0] - 'A', value - 1);
-
-    return true;
+    g->stone = (g->stone == BLACK_STONE) ? WHITE_STONE : BLACK_STONE;
+    return SUCCESS;
 }
 
 /**
- * This function controls the game loop as the name suggests,
- * @param g The game to loop.
+ * This function places a stone on the board for the color to move. It also checks if the game
+ * is won or drawn, appends the move to the autosave journal if the game has one and publishes
+ * it to the broadcast if the game has one.
+ * @param g The game to place the stone on.
+ * @param x The x coordinate of the stone.
+ * @param y The y coordinate of the stone.
+ * @return SUCCESS, INPUT_ERR if the game is not being played or the intersection is taken,
+ *         COORDINATE_ERR if the coordinate is off the board, or NULL_POINTER_ERR if the move
+ *         list could not grow. Nothing changes unless it is SUCCESS.
 */
-void game_loop(game* g) {
-    while (game_update(g)) {
-        board_print(g->board, true);
-    }
-
-    if (g->state == GAME_STATE_FINISHED) {
-        printf("Game concluded, %s won.\n", g->winner == BLACK_STONE ? "black" : "white");
-    } else if (g->state == GAME_STATE_FORBIDDEN) {
-        printf("Game concluded, black made a forbidden move, white won.\n");
+unsigned char game_place_stone(game* g, unsigned char x, unsigned char y) {
+    unsigned char status = place_stone(g, x, y);
+    if (status == SUCCESS && g->broadcast != NULL) {
+        broadcast_publish(g->broadcast, g, BROADCAST_MOVE, x, y);
     }
+    return status;
 }
 
 /**
- * Function resumes a new game from a saved file.
- * @param g The game to resume.
- * @return Whether the game is resumed.
+ * This function checks if a move would be forbidden for a color: in renju, black loses by
+ * making an overline, or two open fours that do not also make five. The color does not have
+ * to be the one to move, so a search can ask whether the other side's threat is real. The
+ * stone is put on the grid only while the rule checks run, so nothing else about the game
+ * changes.
+ * @param g The game.
+ * @param stone The color that would move.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return Whether the move is forbidden. Moves in freestyle games, moves by white and moves
+ *         onto taken intersections are not.
 */
-void game_resume(game* g) {
-
-  if (g->state != GAME_STATE_STOPPED) {
-    exit(RESUME_ERR);
-  }
-
-  if (g->type != GAME_FREESTYLE && g->type != GAME_RENJU) {
-    exit(RESUME_ERR);
-  }
+bool game_forbidden(game* g, unsigned char stone, unsigned char x, unsigned char y) {
+    if (g->type != GAME_RENJU || stone != BLACK_STONE || x >= g->board->size || y >= g->board->size ||
+        board_get(g->board, x, y) != EMPTY_INTERSECTION) {
+        return false;
+    }
 
-  g->state = GAME_STATE_PLAYING;
-  game_loop(g);
+    const unsigned char* grid = g->board->grid;
+    unsigned char size = g->board->size;
+    board_set(g->board, x, y, BLACK_STONE);
+    bool forbidden = g->rules->overline(grid, size, x, y, BLACK_STONE) ||
+        (!g->rules->five(grid, size, x, y, BLACK_STONE) && g->moves_count + 1 < (size_t)size * size &&
+        g->rules->double_four(grid, size, x, y, BLACK_STONE));
+    board_clear(g->board, x, y);
+    return forbidden;
 }
 
 /**
- * This function replays a saved game. You should create a new game struct, and re-make moves saved in g, pause 1 second before making every move (this can be done by including a POSIX header unistd.h and call function sleep()). This function should act largely the same as game_loop() except it doesn't read user input, and prints extra information as specified in section Replay Saved Games.
+ * This function takes back the last move. The stone is removed from the board, the threat map and
+ * the evaluation, the player who made the move is to move again and the game goes back to playing.
+ * The undo is appended to the autosave journal and published to the broadcast if the game has
+ * them.
+ * @param g The game to undo the move in.
+ * @return Whether a move was taken back.
 */
-void game_replay(game* g) {
-    if (g->state == GAME_STATE_PLAYING) {
-        printf("Input error 1 \n");
-        exit(INPUT_ERR);
-    }
-    
-    if (g->type != GAME_FREESTYLE && g->type != GAME_RENJU) {
-        printf("Input error 2 \n");
-        exit(INPUT_ERR);
-    }
-    
-    game* g2 = game_create(g->board->size, g->type);
-
-    for (int i = 0; i < g->moves_count - 1; i++) {
-        game_place_stone(g2, g->moves[i].x, g->moves[i].y);
-        board_print(g2->board, true);
-
-        printf("Moves:\n");
-        for (int j = 0; j <= i; j++) {
-            char move[15];
-            if (g->moves[j].y + 1 >= 10) {
-                sprintf(move, " %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
-            } else {
-                sprintf(move, "  %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
-            }
-
-            if (j % 2 == 0) {
-                printf("%6s%4s", "Black:", move);
-            } else {
-                printf("  %6s%4s\n", "White:", move);
-            }
-        }
+bool game_undo(game* g) {
+    if (g->moves_count == 0) {
+        return false;
     }
 
-    game_place_stone(g2, g->moves[g->moves_count - 1].x, g->moves[g->moves_count - 1].y);
-    board_print(g2->board, true);
-
-    if (g->state == GAME_STATE_FORBIDDEN) {
-        printf("Game concluded, black made a forbidden move, white won.\n");
-    } else if (g->state == GAME_STATE_FINISHED) {
-        printf("Game concluded, %s won.\n", g->winner == BLACK_STONE ? "black" : "white");
-    } else {
-        printf("The game is stopped.\n");
+    if (g->journal != NULL) {
+        journal_append(g->journal, JOURNAL_UNDO, 0, 0);
     }
 
-    printf("Moves:\n");
-    for (int j = 0; j <= g->moves_count - 1; j++) {
-        char move[15];
-        if (g->moves[j].y + 1 >= 10) {
-            sprintf(move, " %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
-        } else {
-            sprintf(move, "  %c%d", g->moves[j].x + 'A', g->moves[j].y + 1);
-        }
-
-        if (j % 2 == 0) {
-            printf("%6s%4s", "Black:", move);
-        } else {
-            printf("  %6s%4s\n", "White:", move);
-        }
+    g->moves_count--;
+    move* last = &g->moves[g->moves_count];
+    game_set_intersection(g, last->x, last->y, EMPTY_INTERSECTION);
+    g->stone = last->stone;
+    g->state = GAME_STATE_PLAYING;
+    g->winner = EMPTY_INTERSECTION;
+    if (g->broadcast != NULL) {
+        broadcast_publish(g->broadcast, g, BROADCAST_UNDO, last->x, last->y);
     }
-
-    if (g->moves_count % 2 != 0)
-        printf("\n");
-    game_delete(g2);
+    return true;
 }
 
 /**
- * This function checks if the game is a draw. It returns true if the board is full, false otherwise.
- * @param g The game to check.
- * @return Whether the game is a draw.
- * 
+ * Gets the hash of the position, which also tells which color is to move.
+ * @param g The game.
+ * @return The hash.
 */
-bool static game_check_draw(game* g) {
-    if (g->board->size * g->board->size == g->moves_count) {
-        return true;
-    }
-    return false;
+uint64_t game_hash(game* g) {
+    return g->hashes[SYMMETRY_IDENTITY] ^ hash_side(g->stone);
 }
 
 /**
- * This function checks if the game is won in freestyle mode. It returns true if the game is won, false otherwise.
- * @param g The game to check.
- * @param x The x coordinate of the stone.
- * @param y The y coordinate of the stone.
- * @return Whether the game is won.
+ * Gets the hash of the position that is the same for all 8 positions that are rotations or
+ * reflections of each other: the smallest of their hashes. Moves map into the frame this hash
+ * belongs to with symmetry_apply(), and back with symmetry_revert().
+ * @param g The game.
+ * @param transform Where to put the symmetry that maps the position to the one hashed, if not
+ *        NULL.
+ * @return The hash.
 */
-bool static game_check_win_freestyle(game* g, unsigned char x, unsigned char y) {
-    int count = 0;
-    int i = 0;
-    int j = 0;
-    int k = 0;
-    int l = 0;
-    
-    // check horizontal
-    for (i = x - 4; i <= x + 4; i++) {
-        if (i < 0 || i >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, i, y) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            return true;
-        }
-    }
-    
-    // check vertical
-    count = 0;
-    for (j = y - 4; j <= y + 4; j++) {
-        if (j < 0 || j >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x, j) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            return true;
-        }
-    }
-    
-    // check diagonal
-    count = 0;
-    for (k = -4; k <= 4; k++) {
-        if (x + k < 0 || x + k >= g->board->size || y + k < 0 || y + k >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + k, y + k) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            return true;
+uint64_t game_canonical_hash(game* g, unsigned char* transform) {
+    unsigned char best = SYMMETRY_IDENTITY;
+    for (int t = 1; t < SYMMETRIES; t++) {
+        if (g->hashes[t] < g->hashes[best]) {
+            best = t;
         }
     }
-    
-    // check diagonal (other way)
-    count = 0;
-    for (l = -4; l <= 4; l++) {
-        if (x + l < 0 || x + l >= g->board->size || y - l < 0 || y - l >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + l, y - l) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            return true;
-        }
-    }
-    return false;
-}
 
-/**
- * This function checks if the game is won in renju mode. It returns true if the game is won, false otherwise.
- * @param g The game to check.
- * @param x The x coordinate of the stone.
- * @param y The y coordinate of the stone.
- * @return Whether the game is won.
-*/
-bool static game_check_win_renju(game* g, unsigned char x, unsigned char y) {
-    int count = 0;
-    int i = 0;
-    int j = 0;
-    int k = 0;
-    int l = 0;
-
-    // check horizontal
-    for (i = x - 4; i <= x + 4; i++) {
-        if (i < 0 || i >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, i, y) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            g->winner = g->stone;
-            return true;
-        }
-    }
-    
-    // check vertical
-    count = 0;
-    for (j = y - 4; j <= y + 4; j++) {
-        if (j < 0 || j >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x, j) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            g->winner = g->stone;
-            return true;
-        }
-    }
-    
-    // check diagonal
-    count = 0;
-    for (k = -4; k <= 4; k++) {
-        if (x + k < 0 || x + k >= g->board->size || y + k < 0 || y + k >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + k, y + k) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            g->winner = g->stone;
-            return true;
-        }
+    if (transform != NULL) {
+        *transform = best;
     }
-    
-    // check diagonal (other way)
-    count = 0;
-    for (l = -4; l <= 4; l++) {
-        if (x + l < 0 || x + l >= g->board->size || y - l < 0 || y - l >= g->board->size) {
-            continue;
-        }
-        if (board_get(g->board, x + l, y - l) == g->stone) {
-            count++;
-        } else {
-            count = 0;
-        }
-        if (count == 5) {
-            g->winner = g->stone;
-            return true;
-        }
-    }
-    return false;
+    return g->hashes[best] ^ hash_side(g->stone);
 }
-
-/**
- * This function checks if the game is won. It returns true if the game is won, false otherwise.
- * @param g The game to check.
- * @param x The x coordinate of the stone.
- * @param y The y coordinate of the stone.
- * @return Whether the game is won.
-*/
-bool static game_check_win(game* g, unsigned char x, unsigned char y) {
-    if (g->type == GAME_FREESTYLE) {
-        if (game_check_win_freestyle(g, x, y)) {
-            return true;
-        }
-    } else if (g->type == GAME_RENJU) {
-        if (game_check_win_renju(g, x, y)) {
-            return true;
-        }
-    }
-    return false;
-}
-
-/**
- * This function places a stone on the board. It returns true if the stone is placed, false otherwise.
- * It also checks if the game is won or drawn.
- * @param g The game to place the stone on.
- * @param x The x coordinate of the stone.
- * @param y The y coordinate of the stone.
- * @return Whether the stone is placed.
-*/
-bool game_place_stone(game* g, unsigned char x, unsigned char y) {
-    if (g->state != GAME_STATE_PLAYING) {
-        exit(INPUT_ERR);
-    }
-    
-    if (g->type == GAME_FREESTYLE) {
-        board_set(g->board, x, y, g->stone);
-        g->moves[g->moves_count].x = x;
-        g->moves[g->moves_count].y = y;
-        g->moves_count++;
-        if (g->moves_count == g->moves_capacity) {
-            g->moves_capacity *= 2;
-            g->moves = realloc(g->moves, sizeof(move) * g->moves_capacity);
-            if (g->moves == NULL) {
-                printf("Null error 1 \n");
-                exit(NULL_POINTER_ERR);
-            }
-        }
-    
-        if (game_check_win(g, x, y)) {
-            g->state = GAME_STATE_FINISHED;
-            g->winner = g->stone;
-            return true;
-        }
-    
-        if (game_check_draw(g)) {
-            g->state = GAME_STATE_FINISHED;
-            return true;
-        }
-    
-        g->stone = (g->stone == BLACK_STONE) ? WHITE_STONE : BLACK_STONE;
-        return true;
-    } else if (g->type == GAME_RENJU) {
-        board_set(g->board, x, y, g->stone);
-        g->moves[g->moves_count].x = x;
-        g->moves[g->moves_count].y = y;
-        g->moves_count++;
-        if (g->moves_count == g->moves_capacity) {
-            g->moves_capacity *= 2;
-            g->moves = realloc(g->moves, sizeof(move) * g->moves_capacity);
-            if (g->moves == NULL) {
-                printf("Null error 1 \n");
-                exit(NULL_POINTER_ERR);
-            }
-        }
-        if (is_overline(g, x, y)) {
-            g->state = GAME_STATE_FORBIDDEN;
-            g->winner = WHITE_STONE;
-            return true;
-        }
-    
-        if (game_check_win(g, x, y)) {
-            g->state = GAME_STATE_FINISHED;
-            return true;
-        }
-    
-        if (game_check_draw(g)) {
-            g->state = GAME_STATE_FINISHED;
-            return true;
-        }
-        if (is_open_four(g, x, y)) {
-            g->state = GAME_STATE_FORBIDDEN;
-            g->winner = WHITE_STONE;
-            return true;
-        }
-    
-        g->stone = (g->stone == BLACK_STONE) ? WHITE_STONE : BLACK_STONE;
-        return true;
-    }
-    return false;
-}
\ No newline at end of file
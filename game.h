@@ -1,7 +1,13 @@
 #ifndef _GAME_H
 #define _GAME_H
 #include "board.h"
+#include "eval.h"
+#include "nnue.h"
+#include "rules.h"
+#include "symmetry.h"
+#include "threat.h"
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #define GAME_FREESTYLE 0
 #define GAME_RENJU 1
@@ -25,13 +31,24 @@ typedef struct {
     move* moves;
     size_t moves_count;
     size_t moves_capacity;
+    threat_map* threats;
+    evaluator eval;
+    uint64_t hashes[SYMMETRIES];
+    const rules_kernel* rules;
+    nnue_state* nnue;
+    struct engine* engine;
+    struct journal* journal;
+    struct broadcast* broadcast;
 } game;
 
 game* game_create(unsigned char board_size, unsigned char game_type);
+game* game_copy(game* g);
 void game_delete(game* g);
-bool game_update(game* g);
-void game_loop(game* g);
-void game_resume(game* g);
-void game_replay(game* g);
-bool game_place_stone(game* g, unsigned char x, unsigned char y);
+bool game_use_network(game* g, const nnue_network* n);
+int game_evaluate(game* g);
+unsigned char game_place_stone(game* g, unsigned char x, unsigned char y);
+bool game_forbidden(game* g, unsigned char stone, unsigned char x, unsigned char y);
+bool game_undo(game* g);
+uint64_t game_hash(game* g);
+uint64_t game_canonical_hash(game* g, unsigned char* transform);
 #endif
@@ -0,0 +1,393 @@
+/**
+ * @file generate.c
+ * @author Faris Soliman
+ * This file is a tool that generates a synthetic corpus of random but legal games with the
+ * generator in playout.c, for load testing the tools that import, check and replay corpora.
+ * The games are written in the format game_export() writes, either as one file each in a
+ * directory, or as the members of an uncompressed tar archive, which the other tools read like
+ * a directory and which can go to the standard output to be piped straight into them.
+ *
+ * The games are played in batches by a thread pool. With a directory, the workers write the
+ * files themselves. With an archive, a writer thread appends the batches in order, letting the
+ * workers get at most GENERATE_QUEUE batches ahead of it, so the archive is the same for any
+ * number of threads and memory stays bounded however many games there are.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "error-codes.h"
+#include "game.h"
+#include "pattern.h"
+#include "playout.h"
+#include "pool.h"
+#include "search.h"
+#define GENERATE_BATCH 256
+#define GENERATE_QUEUE 16
+#define GENERATE_GAMES 1000
+#define GENERATE_SEED 1
+#define GENERATE_NEAR 90
+#define GENERATE_OPENING 2
+#define GENERATE_NAME "game-%09llu.gmk"
+#define GENERATE_MEMBER (512 + (PLAYOUT_TEXT + 511) / 512 * 512)
+
+typedef struct generator generator;
+
+typedef struct {
+    generator* e;
+    unsigned long seq;
+    uint64_t first;
+    int count;
+    char* data;
+    size_t length;
+    unsigned long outcomes[5];
+    unsigned long moves;
+    bool failed;
+} batch;
+
+struct generator {
+    playout_options o;
+    uint64_t seed;
+    const char* directory;
+    FILE* fp;
+    pool* p;
+    unsigned long submitted;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    batch* slots[GENERATE_QUEUE];
+    unsigned long next;
+    bool closing;
+    unsigned long games;
+    unsigned long outcomes[5];
+    unsigned long moves;
+    bool failed;
+    bool write_failed;
+};
+
+/**
+ * Writes a tar member header for a file.
+ * @param header Where to write it, 512 bytes.
+ * @param name The name of the file.
+ * @param size The size of the file.
+*/
+void static tar_header(char* header, const char* name, size_t size) {
+    memset(header, 0, 512);
+    snprintf(header, 100, "%s", name);
+    memcpy(header + 100, "0000644", 8);
+    memcpy(header + 108, "0000000", 8);
+    memcpy(header + 116, "0000000", 8);
+    sprintf(header + 124, "%011lo", (unsigned long)size);
+    sprintf(header + 136, "%011o", 0);
+    header[156] = '0';
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // The checksum is taken with its own field as spaces.
+    memset(header + 148, ' ', 8);
+    unsigned int sum = 0;
+    for (int i = 0; i < 512; i++) {
+        sum += (unsigned char)header[i];
+    }
+    sprintf(header + 148, "%06o", sum);
+    header[155] = ' ';
+}
+
+/**
+ * Gets the outcome of a game, as a place in the counts.
+ * @param r The game.
+ * @return 0 for a black win, 1 for a white win, 2 for a draw, 3 for a forbidden move and 4
+ *         for a stopped game.
+*/
+int static outcome(const parse_record* r) {
+    if (r->state == GAME_STATE_FORBIDDEN) {
+        return 3;
+    }
+    if (r->state == GAME_STATE_STOPPED) {
+        return 4;
+    }
+    return r->winner == BLACK_STONE ? 0 : r->winner == WHITE_STONE ? 1 : 2;
+}
+
+/**
+ * Hands a batch to the writer, waiting while it is more than GENERATE_QUEUE batches ahead of
+ * the one the writer needs next.
+ * @param b The batch.
+*/
+void static push_batch(batch* b) {
+    generator* e = b->e;
+    pthread_mutex_lock(&e->lock);
+    while (b->seq >= e->next + GENERATE_QUEUE) {
+        pthread_cond_wait(&e->space, &e->lock);
+    }
+    e->slots[b->seq % GENERATE_QUEUE] = b;
+    pthread_cond_signal(&e->ready);
+    pthread_mutex_unlock(&e->lock);
+}
+
+/**
+ * The pool job: plays a batch of games, and writes them as files, or as tar members for the
+ * writer.
+ * @param arg The batch.
+ * @param worker The number of the worker running the job.
+*/
+void static run_batch(void* arg, int worker) {
+    batch* b = arg;
+    generator* e = b->e;
+    parse_record* r = malloc(sizeof(parse_record));
+    char* text = malloc(PLAYOUT_TEXT);
+    char* path = e->directory == NULL ? NULL : malloc(strlen(e->directory) + 32);
+    b->data = e->directory == NULL ? malloc((size_t)b->count * GENERATE_MEMBER) : NULL;
+    if (r == NULL || text == NULL || (e->directory != NULL && path == NULL) || (e->directory == NULL && b->data == NULL)) {
+        b->failed = true;
+        b->count = 0;
+    }
+
+    for (int i = 0; i < b->count; i++) {
+        uint64_t number = b->first + i;
+        playout_game(&e->o, e->seed, number, r);
+        b->outcomes[outcome(r)]++;
+        b->moves += r->count;
+
+        char name[32];
+        sprintf(name, GENERATE_NAME, (unsigned long long)number + 1);
+        size_t length = playout_format(r, text);
+        if (e->directory != NULL) {
+            sprintf(path, "%s/%s", e->directory, name);
+            FILE* fp = fopen(path, "w");
+            if (fp == NULL || fwrite(text, 1, length, fp) != length || fclose(fp) != 0) {
+                b->failed = true;
+            }
+            continue;
+        }
+        char* member = b->data + b->length;
+        tar_header(member, name, length);
+        memcpy(member + 512, text, length);
+        size_t padded = (length + 511) / 512 * 512;
+        memset(member + 512 + length, 0, padded - length);
+        b->length += 512 + padded;
+    }
+    free(path);
+    free(text);
+    free(r);
+    push_batch(b);
+}
+
+/**
+ * The body of the writer thread: appends the batches to the archive in order, and adds up the
+ * counts, until every batch has been written.
+ * @param arg The generator.
+ * @return Nothing.
+*/
+void static* write_batches(void* arg) {
+    generator* e = arg;
+    pthread_mutex_lock(&e->lock);
+    while (true) {
+        while (e->slots[e->next % GENERATE_QUEUE] == NULL && !(e->closing && e->next == e->submitted)) {
+            pthread_cond_wait(&e->ready, &e->lock);
+        }
+        batch* b = e->slots[e->next % GENERATE_QUEUE];
+        if (b == NULL) {
+            break;
+        }
+        e->slots[e->next % GENERATE_QUEUE] = NULL;
+        e->next++;
+        pthread_cond_broadcast(&e->space);
+        pthread_mutex_unlock(&e->lock);
+
+        if (e->fp != NULL && b->length > 0 && fwrite(b->data, 1, b->length, e->fp) != b->length) {
+            e->write_failed = true;
+        }
+        e->games += b->count;
+        for (int i = 0; i < 5; i++) {
+            e->outcomes[i] += b->outcomes[i];
+        }
+        e->moves += b->moves;
+        e->failed = e->failed || b->failed;
+        free(b->data);
+        free(b);
+
+        pthread_mutex_lock(&e->lock);
+    }
+    pthread_mutex_unlock(&e->lock);
+    return NULL;
+}
+
+/**
+ * Reads a range of game lengths: "min-max", or one number for both.
+ * @param text The range.
+ * @param min Where to put the minimum.
+ * @param max Where to put the maximum.
+ * @return Whether it was a valid range.
+*/
+bool static read_lengths(const char* text, int* min, int* max) {
+    char* end;
+    long lo = strtol(text, &end, 10);
+    long hi = lo;
+    if (*end == '-') {
+        hi = strtol(end + 1, &end, 10);
+    }
+    if (end == text || *end != '\0' || lo < 0 || hi < lo || hi > PARSE_MAX_MOVES) {
+        return false;
+    }
+    *min = lo;
+    *max = hi;
+    return true;
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    unsigned long long games = GENERATE_GAMES;
+    playout_options o = {15, GAME_FREESTYLE, 0, 0, GENERATE_OPENING, GENERATE_NEAR};
+    uint64_t seed = GENERATE_SEED;
+    const char* directory = NULL;
+    const char* archive = NULL;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-r") == 0) {
+            o.type = GAME_RENJU;
+            first++;
+            continue;
+        }
+        if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+            continue;
+        }
+        if (first + 1 >= argc) {
+            first = argc;
+            break;
+        }
+        const char* value = argv[first + 1];
+        if (strcmp(argv[first], "-j") == 0 && atoi(value) > 0) {
+            threads = atoi(value);
+        } else if (strcmp(argv[first], "-n") == 0 && atoll(value) > 0) {
+            games = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[first], "-b") == 0 && (atoi(value) == 15 || atoi(value) == 17 || atoi(value) == 19)) {
+            o.size = atoi(value);
+        } else if (strcmp(argv[first], "-c") == 0 && atoi(value) >= 0 && atoi(value) <= PATTERN_MAX_SIZE / 2) {
+            o.opening = atoi(value);
+        } else if (strcmp(argv[first], "-p") == 0 && atoi(value) >= 0 && atoi(value) <= 100) {
+            o.near = atoi(value);
+        } else if (strcmp(argv[first], "-s") == 0) {
+            seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[first], "-o") == 0) {
+            directory = value;
+        } else if (strcmp(argv[first], "-a") == 0) {
+            archive = value;
+        } else if (strcmp(argv[first], "-l") != 0 || !read_lengths(value, &o.min_moves, &o.max_moves)) {
+            first = argc;
+            break;
+        }
+        first += 2;
+    }
+    if (first != argc || (directory == NULL) == (archive == NULL)) {
+        fprintf(stdout, "usage: %s [-j threads] [-n games] [-b size] [-r] [-l min-max] [-c radius] [-p percent] [-s seed] [-q] "
+            "-o directory|-a archive.tar\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    generator* e = calloc(1, sizeof(generator));
+    if (e == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    e->o = o;
+    e->seed = seed;
+    e->directory = directory;
+    if (directory != NULL && mkdir(directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Cannot write %s\n", directory);
+        return FILE_OUTPUT_ERR;
+    }
+    bool piped = archive != NULL && strcmp(archive, "-") == 0;
+    if (archive != NULL) {
+        e->fp = piped ? stdout : fopen(archive, "wb");
+        if (e->fp == NULL) {
+            fprintf(stderr, "Cannot write %s\n", archive);
+            return FILE_OUTPUT_ERR;
+        }
+    }
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->ready, NULL);
+    pthread_cond_init(&e->space, NULL);
+
+    e->p = pool_create(threads);
+    pthread_t writer;
+    if (e->p == NULL || pthread_create(&writer, NULL, write_batches, e) != 0) {
+        return NULL_POINTER_ERR;
+    }
+
+    long long start = search_clock();
+    for (unsigned long long number = 0; number < games; number += GENERATE_BATCH) {
+        batch* b = calloc(1, sizeof(batch));
+        if (b == NULL) {
+            return NULL_POINTER_ERR;
+        }
+        b->e = e;
+        b->first = number;
+        b->count = games - number < GENERATE_BATCH ? games - number : GENERATE_BATCH;
+        pthread_mutex_lock(&e->lock);
+        b->seq = e->submitted++;
+        pthread_mutex_unlock(&e->lock);
+        if (!pool_submit(e->p, run_batch, b)) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    pool_wait(e->p);
+    pool_delete(e->p);
+    pthread_mutex_lock(&e->lock);
+    e->closing = true;
+    pthread_cond_signal(&e->ready);
+    pthread_mutex_unlock(&e->lock);
+    pthread_join(writer, NULL);
+
+    // An archive ends with two empty blocks.
+    if (e->fp != NULL) {
+        char end[1024];
+        memset(end, 0, sizeof(end));
+        if (fwrite(end, 1, sizeof(end), e->fp) != sizeof(end)) {
+            e->write_failed = true;
+        }
+        if ((piped ? fflush(e->fp) : fclose(e->fp)) != 0) {
+            e->write_failed = true;
+        }
+    }
+    long long elapsed = search_clock() - start;
+    if (e->failed || e->write_failed) {
+        fprintf(stderr, "Cannot write %s\n", directory != NULL ? directory : archive);
+        return FILE_OUTPUT_ERR;
+    }
+
+    // With the archive on the standard output, the summary goes to the standard error.
+    FILE* out = piped ? stderr : stdout;
+    fprintf(out, "Games:               %lu\n", e->games);
+    fprintf(out, "Black wins:          %lu\n", e->outcomes[0]);
+    fprintf(out, "White wins:          %lu\n", e->outcomes[1]);
+    fprintf(out, "Draws:               %lu\n", e->outcomes[2]);
+    fprintf(out, "Forbidden:           %lu\n", e->outcomes[3]);
+    fprintf(out, "Stopped:             %lu\n", e->outcomes[4]);
+    fprintf(out, "Moves:               %lu\n", e->moves);
+    if (!quiet) {
+        fprintf(out, "\n%lu games in %lld ms, %.0f games/sec\n", e->games, elapsed,
+            elapsed > 0 ? e->games * 1000.0 / elapsed : 0.0);
+    }
+
+    pthread_mutex_destroy(&e->lock);
+    pthread_cond_destroy(&e->ready);
+    pthread_cond_destroy(&e->space);
+    free(e);
+    return SUCCESS;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file hash.c
+ * @author Faris Soliman
+ * This file contains the Zobrist keys used to hash positions. Instead of a random table that
+ * has to be filled in before first use, every key is derived from its stone and intersection
+ * by a fixed mixing function, so keys are the same in every run and in every thread.
+*/
+#include <stdint.h>
+#include <string.h>
+#include "board.h"
+#include "hash.h"
+
+/**
+ * Mixes a number into a well distributed 64 bit key (the splitmix64 finalizer).
+ * @param z The number to mix.
+ * @return The key.
+*/
+uint64_t static mix(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Gets the key of a stone standing on an intersection. The hash of a position is the xor of
+ * the keys of all its stones.
+ * @param stone The color of the stone.
+ * @param index The index of the intersection in the board grid.
+ * @return The key.
+*/
+uint64_t hash_key(unsigned char stone, int index) {
+    return mix(((uint64_t)stone << 16) | (uint64_t)index);
+}
+
+/**
+ * Gets the key xored into a position hash for the color to move. Black gets a key too, so
+ * that no position hashes to 0, the key of an empty table entry.
+ * @param stone The color to move.
+ * @return The key.
+*/
+uint64_t hash_side(unsigned char stone) {
+    return mix(0xFFFF0000ULL | stone);
+}
+
+/**
+ * Gets the key xored into a position hash to tell the rule sets apart, for tables that hold
+ * positions of more than one rule set.
+ * @param game_type The rule set.
+ * @return The key.
+*/
+uint64_t hash_rules(unsigned char game_type) {
+    return mix(0xFFFE0000ULL | game_type);
+}
+
+/**
+ * Hashes a block of bytes, mixing in eight bytes at a time.
+ * @param data The bytes.
+ * @param length The number of bytes.
+ * @return The hash.
+*/
+uint64_t hash_bytes(const void* data, size_t length) {
+    const unsigned char* p = data;
+    uint64_t h = mix(length);
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        h = mix(h ^ word);
+        p += 8;
+        length -= 8;
+    }
+    if (length > 0) {
+        uint64_t word = 0;
+        memcpy(&word, p, length);
+        h = mix(h ^ word);
+    }
+    return h;
+}
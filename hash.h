@@ -0,0 +1,10 @@
+#ifndef _HASH_H_
+#define _HASH_H_
+#include <stddef.h>
+#include <stdint.h>
+
+uint64_t hash_key(unsigned char stone, int index);
+uint64_t hash_side(unsigned char stone);
+uint64_t hash_rules(unsigned char game_type);
+uint64_t hash_bytes(const void* data, size_t length);
+#endif
@@ -0,0 +1,402 @@
+/**
+ * @file index.c
+ * @author Faris Soliman
+ * This file contains the position index: an inverted index from every position reached in a
+ * corpus of saved games to the games that reached it. A position is keyed by its hash up to
+ * the 8 symmetries of the board, with the rule set, board size and color to move, so a game
+ * played in a rotation or reflection of another is found from either. A position with n
+ * stones can only be reached after move n, so the games are all it needs to list.
+ *
+ * The index is written once, sorted by key, and mapped with mmap to be searched in place. The
+ * keys are stored in blocks of INDEX_BLOCK: the first key of every block is in a directory,
+ * which is searched by binary search, and the rest of the block holds the other keys as
+ * differences from the one before, each followed by its games, also as differences, all as
+ * variable-length integers of 7 bits a byte. A lookup decodes at most one block.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "game.h"
+#include "hash.h"
+#include "index.h"
+#include "symmetry.h"
+
+typedef struct {
+    unsigned char* bytes;
+    size_t length;
+    size_t capacity;
+} buffer;
+
+/**
+ * Gets the key of every position of a game, up to the symmetries of the board.
+ * @param r The game.
+ * @param keys Where to put the keys: the position after move i + 1 is at i.
+*/
+void index_keys(const parse_record* r, uint64_t* keys) {
+    uint64_t base = hash_rules(r->type) ^ hash_key(EMPTY_INTERSECTION, r->size);
+    uint64_t boards[SYMMETRIES] = {0};
+    for (size_t i = 0; i < r->count; i++) {
+        unsigned char stone = i % 2 == 0 ? BLACK_STONE : WHITE_STONE;
+        uint64_t best = UINT64_MAX;
+        for (int s = 0; s < SYMMETRIES; s++) {
+            unsigned char tx;
+            unsigned char ty;
+            symmetry_apply(s, r->size, r->x[i], r->y[i], &tx, &ty);
+            boards[s] ^= hash_key(stone, ty * r->size + tx);
+            if (boards[s] < best) {
+                best = boards[s];
+            }
+        }
+        keys[i] = best ^ hash_side(stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE) ^ base;
+    }
+}
+
+/**
+ * Gets the outcome of a game as the index keeps it.
+ * @param state The state the game ended in.
+ * @param winner The winner.
+ * @return INDEX_BLACK_WINS, INDEX_WHITE_WINS, INDEX_DRAW, INDEX_FORBIDDEN or INDEX_UNFINISHED.
+*/
+unsigned char index_outcome(unsigned char state, unsigned char winner) {
+    if (state == GAME_STATE_FORBIDDEN) {
+        return INDEX_FORBIDDEN;
+    }
+    if (state != GAME_STATE_FINISHED) {
+        return INDEX_UNFINISHED;
+    }
+    return winner == BLACK_STONE ? INDEX_BLACK_WINS : winner == WHITE_STONE ? INDEX_WHITE_WINS : INDEX_DRAW;
+}
+
+/**
+ * Orders entries by key, and then by game.
+ * @param a The first entry.
+ * @param b The second entry.
+ * @return The order.
+*/
+int static compare_entries(const void* a, const void* b) {
+    const index_entry* x = a;
+    const index_entry* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return x->game < y->game ? -1 : x->game > y->game;
+}
+
+/**
+ * Appends a variable-length integer to a buffer: 7 bits a byte, lowest first, with the top
+ * bit set on every byte but the last.
+ * @param b The buffer.
+ * @param value The integer.
+ * @return Whether there was enough memory.
+*/
+bool static put_varint(buffer* b, uint64_t value) {
+    if (b->length + 10 > b->capacity) {
+        size_t capacity = b->capacity == 0 ? 1 << 16 : b->capacity * 2;
+        unsigned char* bytes = realloc(b->bytes, capacity);
+        if (bytes == NULL) {
+            return false;
+        }
+        b->bytes = bytes;
+        b->capacity = capacity;
+    }
+    while (value >= 0x80) {
+        b->bytes[b->length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    b->bytes[b->length++] = (unsigned char)value;
+    return true;
+}
+
+/**
+ * Reads a variable-length integer.
+ * @param next The next byte to read, which is moved past the integer.
+ * @param end The end of the bytes that may be read.
+ * @param value Where to put the integer.
+ * @return Whether there was a whole integer before the end.
+*/
+bool static get_varint(const unsigned char** next, const unsigned char* end, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *next < end; shift += 7) {
+        unsigned char byte = *(*next)++;
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Encodes the keys and their games, and fills in the block directory.
+ * @param entries The entries, sorted and without duplicates.
+ * @param count The number of entries.
+ * @param data The buffer to encode into.
+ * @param blocks The block directory, one for every INDEX_BLOCK keys.
+ * @return The number of keys, or 0 if there was not enough memory.
+*/
+uint64_t static encode(const index_entry* entries, size_t count, buffer* data, index_block* blocks) {
+    uint64_t keys = 0;
+    uint64_t previous = 0;
+    buffer postings = {NULL, 0, 0};
+    size_t i = 0;
+    while (i < count) {
+        uint64_t key = entries[i].key;
+        uint32_t game = 0;
+        postings.length = 0;
+        size_t first = i;
+        for (; i < count && entries[i].key == key; i++) {
+            if (!put_varint(&postings, entries[i].game - game)) {
+                free(postings.bytes);
+                return 0;
+            }
+            game = entries[i].game;
+        }
+
+        bool ok = true;
+        if (keys % INDEX_BLOCK == 0) {
+            blocks[keys / INDEX_BLOCK].first = key;
+            blocks[keys / INDEX_BLOCK].offset = data->length;
+        } else {
+            ok = put_varint(data, key - previous);
+        }
+        ok = ok && put_varint(data, i - first) && put_varint(data, postings.length);
+        while (ok && data->length + postings.length > data->capacity) {
+            unsigned char* bytes = realloc(data->bytes, data->capacity * 2);
+            ok = bytes != NULL;
+            if (ok) {
+                data->bytes = bytes;
+                data->capacity *= 2;
+            }
+        }
+        if (!ok) {
+            free(postings.bytes);
+            return 0;
+        }
+        memcpy(data->bytes + data->length, postings.bytes, postings.length);
+        data->length += postings.length;
+        previous = key;
+        keys++;
+    }
+    free(postings.bytes);
+    return keys;
+}
+
+/**
+ * Writes an index: sorts the entries, encodes them and writes the index to a temporary file,
+ * which is forced to the disk and renamed over the path.
+ * @param path The path to the index.
+ * @param games The games, by number.
+ * @param game_count The number of games.
+ * @param names The names of the games, each ending in a null, which the games point into.
+ * @param names_length The length of the names.
+ * @param entries The positions reached by every game, which are sorted.
+ * @param count The number of entries.
+ * @return Whether the index was written.
+*/
+bool index_write(const char* path, const index_game* games, size_t game_count, const char* names, size_t names_length, index_entry* entries, size_t count) {
+    qsort(entries, count, sizeof(index_entry), compare_entries);
+    size_t distinct = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (distinct == 0 || compare_entries(&entries[i], &entries[distinct - 1]) != 0) {
+            entries[distinct++] = entries[i];
+        }
+    }
+
+    index_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.block_keys = INDEX_BLOCK;
+    header.games = game_count;
+    header.occurrences = distinct;
+    header.names_length = names_length;
+
+    buffer data = {NULL, 0, 0};
+    index_block* blocks = malloc((distinct / INDEX_BLOCK + 1) * sizeof(index_block));
+    header.keys = blocks == NULL ? 0 : encode(entries, distinct, &data, blocks);
+    if (blocks == NULL || (distinct > 0 && header.keys == 0)) {
+        free(blocks);
+        free(data.bytes);
+        return false;
+    }
+    header.blocks = (header.keys + INDEX_BLOCK - 1) / INDEX_BLOCK;
+    header.data_length = data.length;
+
+    char* temporary = malloc(strlen(path) + 5);
+    FILE* fp = NULL;
+    if (temporary != NULL) {
+        sprintf(temporary, "%s.tmp", path);
+        fp = fopen(temporary, "wb");
+    }
+    bool ok = fp != NULL &&
+        fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(games, sizeof(index_game), game_count, fp) == game_count &&
+        fwrite(blocks, sizeof(index_block), header.blocks, fp) == header.blocks &&
+        fwrite(data.bytes, 1, data.length, fp) == data.length &&
+        fwrite(names, 1, names_length, fp) == names_length &&
+        fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    if (fp != NULL) {
+        ok = fclose(fp) == 0 && ok && rename(temporary, path) == 0;
+        if (!ok) {
+            unlink(temporary);
+        }
+    }
+    free(temporary);
+    free(blocks);
+    free(data.bytes);
+    return ok;
+}
+
+/**
+ * Opens an index by mapping it.
+ * @param path The path to the index.
+ * @return The index, or NULL if it could not be opened or mapped or is not an index of this
+ *         version.
+*/
+index_file* index_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    index_header h;
+    if (fstat(fd, &st) != 0 || pread(fd, &h, sizeof(h), 0) != sizeof(h) ||
+        memcmp(h.magic, INDEX_MAGIC, sizeof(h.magic)) != 0 || h.version != INDEX_VERSION ||
+        h.block_keys != INDEX_BLOCK || h.blocks != (h.keys + INDEX_BLOCK - 1) / INDEX_BLOCK ||
+        h.games > UINT32_MAX || h.blocks > (uint64_t)st.st_size || h.data_length > (uint64_t)st.st_size ||
+        (uint64_t)st.st_size != sizeof(h) + h.games * sizeof(index_game) + h.blocks * sizeof(index_block) +
+            h.data_length + h.names_length) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    index_file* f = map == MAP_FAILED ? NULL : malloc(sizeof(index_file));
+    if (f == NULL) {
+        if (map != MAP_FAILED) {
+            munmap(map, st.st_size);
+        }
+        close(fd);
+        return NULL;
+    }
+
+    f->fd = fd;
+    f->length = st.st_size;
+    f->header = map;
+    f->games = (const index_game*)(f->header + 1);
+    f->blocks = (const index_block*)(f->games + h.games);
+    f->data = (const unsigned char*)(f->blocks + h.blocks);
+    f->names = (const char*)(f->data + h.data_length);
+    return f;
+}
+
+/**
+ * Closes an index.
+ * @param f The index, or NULL.
+*/
+void index_close(index_file* f) {
+    if (f == NULL) {
+        return;
+    }
+
+    munmap((void*)f->header, f->length);
+    close(f->fd);
+    free(f);
+}
+
+/**
+ * Looks up a position: finds the block its key would be in by binary search, and decodes the
+ * block up to the key.
+ * @param f The index.
+ * @param key The key of the position.
+ * @param p Where to put the games that reached it, to read with index_next().
+ * @return Whether any game reached it.
+*/
+bool index_find(const index_file* f, uint64_t key, index_postings* p) {
+    uint64_t lo = 0;
+    uint64_t hi = f->header->blocks;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (f->blocks[mid].first <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) {
+        return false;
+    }
+
+    uint64_t block = lo - 1;
+    uint64_t start = f->blocks[block].offset;
+    uint64_t stop = block + 1 < f->header->blocks ? f->blocks[block + 1].offset : f->header->data_length;
+    if (start > stop || stop > f->header->data_length) {
+        return false;
+    }
+    const unsigned char* next = f->data + start;
+    const unsigned char* end = f->data + stop;
+    uint64_t current = f->blocks[block].first;
+    for (int i = 0; i < INDEX_BLOCK && next < end; i++) {
+        uint64_t delta = 0;
+        uint64_t count;
+        uint64_t length;
+        if ((i > 0 && !get_varint(&next, end, &delta)) || !get_varint(&next, end, &count) ||
+            !get_varint(&next, end, &length) || length > (uint64_t)(end - next)) {
+            return false;
+        }
+        current += delta;
+        if (current == key) {
+            p->next = next;
+            p->end = next + length;
+            p->remaining = count;
+            p->game = 0;
+            return count > 0;
+        }
+        if (current > key) {
+            return false;
+        }
+        next += length;
+    }
+    return false;
+}
+
+/**
+ * Reads the next game that reached a position, in order of their numbers.
+ * @param p The games, as found by index_find().
+ * @param game Where to put the number of the game.
+ * @return Whether there was another game.
+*/
+bool index_next(index_postings* p, uint32_t* game) {
+    uint64_t delta;
+    if (p->remaining == 0 || !get_varint(&p->next, p->end, &delta) || p->game + delta > UINT32_MAX) {
+        return false;
+    }
+    p->remaining--;
+    p->game += delta;
+    *game = p->game;
+    return true;
+}
+
+/**
+ * Gets the name of a game: the path it was read from.
+ * @param f The index.
+ * @param game The number of the game.
+ * @return The name, or an empty string if the game or its name is not in the index.
+*/
+const char* index_name(const index_file* f, uint32_t game) {
+    if (game >= f->header->games) {
+        return "";
+    }
+    uint64_t offset = f->games[game].name;
+    if (offset >= f->header->names_length || memchr(f->names + offset, '\0', f->header->names_length - offset) == NULL) {
+        return "";
+    }
+    return f->names + offset;
+}
@@ -0,0 +1,74 @@
+#ifndef _INDEX_H_
+#define _INDEX_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parse.h"
+#define INDEX_MAGIC "GMKINDX"
+#define INDEX_VERSION 1
+#define INDEX_BLOCK 64
+#define INDEX_BLACK_WINS 0
+#define INDEX_WHITE_WINS 1
+#define INDEX_DRAW 2
+#define INDEX_FORBIDDEN 3
+#define INDEX_UNFINISHED 4
+#define INDEX_OUTCOMES 5
+
+typedef struct {
+    uint64_t key;
+    uint32_t game;
+} index_entry;
+
+typedef struct {
+    uint64_t name;
+    uint16_t moves;
+    unsigned char type;
+    unsigned char size;
+    unsigned char outcome;
+    unsigned char reserved[3];
+} index_game;
+
+typedef struct {
+    uint64_t first;
+    uint64_t offset;
+} index_block;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_keys;
+    uint64_t games;
+    uint64_t keys;
+    uint64_t occurrences;
+    uint64_t blocks;
+    uint64_t data_length;
+    uint64_t names_length;
+    uint64_t reserved[2];
+} index_header;
+
+typedef struct {
+    int fd;
+    size_t length;
+    const index_header* header;
+    const index_game* games;
+    const index_block* blocks;
+    const unsigned char* data;
+    const char* names;
+} index_file;
+
+typedef struct {
+    const unsigned char* next;
+    const unsigned char* end;
+    uint64_t remaining;
+    uint32_t game;
+} index_postings;
+
+void index_keys(const parse_record* r, uint64_t* keys);
+unsigned char index_outcome(unsigned char state, unsigned char winner);
+bool index_write(const char* path, const index_game* games, size_t game_count, const char* names, size_t names_length, index_entry* entries, size_t count);
+index_file* index_open(const char* path);
+void index_close(index_file* f);
+bool index_find(const index_file* f, uint64_t key, index_postings* p);
+bool index_next(index_postings* p, uint32_t* game);
+const char* index_name(const index_file* f, uint32_t game);
+#endif
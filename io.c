@@ -9,57 +9,29 @@
 #include "io.h"
 #include "error-codes.h"
 #include "board.h"
+#include "parse.h"
 
 /**
- * Imports a game from a file.
+ * Imports a game from a file, which may be a .gmk file, an autosave journal, an SGF record or
+ * a RenLib library.
  * @param path The path to the file.
- * @return The game.
+ * @param err Where to put what was wrong with the file, or NULL.
+ * @return The game, or NULL if the file could not be read.
  */
-game* game_import(const char* path) {
-    FILE* fp = fopen(path, "r");
-    if (fp == NULL) {
-        exit(FILE_INPUT_ERR);
-    }
-
-    char magic[3];
-    fgets(magic, 3, fp);
-    if (magic[0] != 'G' || magic[1] != 'A') {
-        fclose(fp);
-        exit(FILE_INPUT_ERR);
-    }
-
-    unsigned int board_size;
-    int game_type;
-    int game_state;
-    int winner;
-    fscanf(fp, "%u\n%d\n%d\n%d\n", &board_size, &game_type, &game_state, &winner);
-
-    game* g = game_create(board_size, game_type);
-    g->state = GAME_STATE_PLAYING;
-    g->winner = winner;
-
-    while (!feof(fp)) {
-        char x;
-        int y;
-        fscanf(fp, "%c%d\n", &x, &y);
-        game_place_stone(g, x - 'A', y - 1);
-    }
-
-    g->state = game_state;
-
-    fclose(fp);
-    return g;
+game* game_import(const char* path, parse_error* err) {
+    return parse_file(path, err);
 }
 
 /**
  * Exports a game to a file.
  * @param g The game.
  * @param path The path to the file.
+ * @return SUCCESS, or FILE_OUTPUT_ERR if the file could not be written.
  */
-void game_export(game* g, const char* path) {
+unsigned char game_export(game* g, const char* path) {
     FILE* fp = fopen(path, "w");
     if (fp == NULL) {
-      exit(FILE_OUTPUT_ERR);
+      return FILE_OUTPUT_ERR;
     }
 
     fprintf(fp, "GA\n%u\n%d\n%d\n%d\n", g->board->size, g->type, g->state, g->winner);
@@ -68,5 +40,5 @@ void game_export(game* g, const char* path) {
         fprintf(fp, "%c%d\n", g->moves[i].x + 'A', g->moves[i].y + 1);
     }
 
-    fclose(fp);
-}
\ No newline at end of file
+    return fclose(fp) == 0 ? SUCCESS : FILE_OUTPUT_ERR;
+}
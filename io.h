@@ -1,7 +1,8 @@
 #ifndef _IO_H_
 #define _IO_H_
 #include "game.h"
+#include "parse.h"
 
-game* game_import(const char* path);
-void game_export(game* g, const char* path);
-#endif
\ No newline at end of file
+game* game_import(const char* path, parse_error* err);
+unsigned char game_export(game* g, const char* path);
+#endif
@@ -0,0 +1,227 @@
+/**
+ * @file journal.c
+ * @author Faris Soliman
+ * This file contains the autosave journal. Instead of writing the whole game again after
+ * every move, every move is appended to the journal as game_place_stone() plays it, as a
+ * small fixed size record. Records go to the file straight away, so a crash of the program
+ * loses nothing; they are only forced to the disk with fsync every so many moves or
+ * milliseconds, whenever the game stops to wait for the human, and when the journal is
+ * closed, so a crash of the machine loses at most that much.
+ *
+ * Every record carries a checksum of its place in the journal and its contents. A record
+ * that was cut off, or garbage the file system left after the last good one, fails the check,
+ * and parse_journal() replays the journal up to the last record that passes it.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "journal.h"
+
+/**
+ * Gets the time from a monotonic clock.
+ * @return The time in milliseconds.
+*/
+long long static clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Computes the checksum of a record, FNV-1a over its index and contents. It is never the
+ * checksum of a record of zero bytes, so a block of zeros is never read as a record.
+ * @param index The index of the record in the journal.
+ * @param op The operation.
+ * @param x The first operand.
+ * @param y The second operand.
+ * @return The checksum.
+*/
+uint32_t journal_check(uint32_t index, unsigned char op, unsigned char x, unsigned char y) {
+    unsigned char bytes[7] = {index, index >> 8, index >> 16, index >> 24, op, x, y};
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 7; i++) {
+        h = (h ^ bytes[i]) * 16777619u;
+    }
+    return h == 0 ? 1 : h;
+}
+
+/**
+ * Writes all of a buffer.
+ * @param fd The file.
+ * @param data The buffer.
+ * @param length Its length.
+ * @return Whether it was all written.
+*/
+bool static write_all(int fd, const void* data, size_t length) {
+    const char* p = data;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+/**
+ * Forces the directory holding a file to the disk, so a rename in it survives a crash.
+ * @param path The path to the file.
+*/
+void static sync_directory(const char* path) {
+    char* dir = malloc(strlen(path) + 2);
+    if (dir == NULL) {
+        return;
+    }
+    strcpy(dir, path);
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else if (slash == dir) {
+        dir[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+
+    int fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+/**
+ * Writes one record.
+ * @param j The journal.
+ * @param op The operation.
+ * @param x The first operand.
+ * @param y The second operand.
+ * @return Whether it was written.
+*/
+bool static write_record(journal* j, unsigned char op, unsigned char x, unsigned char y) {
+    journal_record r = {op, x, y, 0, journal_check(j->count, op, x, y)};
+    if (!write_all(j->fd, &r, sizeof(r))) {
+        j->failed = true;
+        return false;
+    }
+    j->count++;
+    j->pending++;
+    return true;
+}
+
+/**
+ * Starts a journal for a game. The journal is written to a temporary file with the moves
+ * already played, then renamed over the path, so an existing journal, which may be the one
+ * the game was just recovered from, is only replaced once the new one is safely on the disk.
+ * @param path The path to the journal.
+ * @param g The game.
+ * @param sync_moves The most moves to append before forcing them to the disk.
+ * @param sync_ms The longest time in milliseconds to go without forcing appended moves to the
+ *        disk, checked whenever a move is appended.
+ * @return The journal, or NULL if it could not be written.
+*/
+journal* journal_open(const char* path, game* g, int sync_moves, long sync_ms) {
+    journal* j = malloc(sizeof(journal));
+    char* temporary = malloc(strlen(path) + 5);
+    if (j == NULL || temporary == NULL) {
+        free(j);
+        free(temporary);
+        return NULL;
+    }
+    sprintf(temporary, "%s.tmp", path);
+
+    j->fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    j->count = 0;
+    j->sync_moves = sync_moves < 1 ? 1 : sync_moves;
+    j->sync_ms = sync_ms;
+    j->pending = 0;
+    j->failed = false;
+    if (j->fd < 0) {
+        free(temporary);
+        free(j);
+        return NULL;
+    }
+
+    journal_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = JOURNAL_VERSION;
+    header.size = g->board->size;
+    header.type = g->type;
+    bool ok = write_all(j->fd, &header, sizeof(header));
+    for (size_t i = 0; ok && i < g->moves_count; i++) {
+        ok = write_record(j, JOURNAL_MOVE, g->moves[i].x, g->moves[i].y);
+    }
+
+    if (!ok || fsync(j->fd) != 0 || rename(temporary, path) != 0) {
+        close(j->fd);
+        unlink(temporary);
+        free(temporary);
+        free(j);
+        return NULL;
+    }
+    sync_directory(path);
+    free(temporary);
+
+    j->pending = 0;
+    j->synced = clock_ms();
+    return j;
+}
+
+/**
+ * Appends a record, forcing the journal to the disk if enough moves or time have gone by
+ * since it last was. The time is only checked here, so a frontend that is about to wait for
+ * input calls journal_sync() itself. A failure is remembered and reported by journal_close().
+ * @param j The journal.
+ * @param op JOURNAL_MOVE with the coordinates of the move, or JOURNAL_UNDO.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+*/
+void journal_append(journal* j, unsigned char op, unsigned char x, unsigned char y) {
+    if (j->failed || !write_record(j, op, x, y)) {
+        return;
+    }
+    if (j->pending >= j->sync_moves || clock_ms() - j->synced >= j->sync_ms) {
+        journal_sync(j);
+    }
+}
+
+/**
+ * Forces the appended records to the disk.
+ * @param j The journal.
+ * @return Whether it worked.
+*/
+bool journal_sync(journal* j) {
+    if (j->pending > 0 && fsync(j->fd) != 0) {
+        j->failed = true;
+    }
+    j->pending = 0;
+    j->synced = clock_ms();
+    return !j->failed;
+}
+
+/**
+ * Ends a journal with the final state of the game, forces it to the disk and closes it.
+ * @param j The journal.
+ * @param g The game.
+ * @return Whether every record was written.
+*/
+bool journal_close(journal* j, game* g) {
+    if (j == NULL) {
+        return true;
+    }
+
+    if (!j->failed) {
+        write_record(j, JOURNAL_END, g->state, g->winner);
+    }
+    bool ok = journal_sync(j);
+    close(j->fd);
+    free(j);
+    return ok;
+}
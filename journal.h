@@ -0,0 +1,45 @@
+#ifndef _JOURNAL_H_
+#define _JOURNAL_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#define JOURNAL_MAGIC "GMKJRNL"
+#define JOURNAL_VERSION 1
+#define JOURNAL_SYNC_MOVES 16
+#define JOURNAL_SYNC_MS 1000
+#define JOURNAL_MOVE 1
+#define JOURNAL_UNDO 2
+#define JOURNAL_END 3
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    unsigned char size;
+    unsigned char type;
+    unsigned char reserved[2];
+} journal_header;
+
+typedef struct {
+    unsigned char op;
+    unsigned char x;
+    unsigned char y;
+    unsigned char reserved;
+    uint32_t check;
+} journal_record;
+
+typedef struct journal {
+    int fd;
+    uint32_t count;
+    int sync_moves;
+    long sync_ms;
+    int pending;
+    long long synced;
+    bool failed;
+} journal;
+
+uint32_t journal_check(uint32_t index, unsigned char op, unsigned char x, unsigned char y);
+journal* journal_open(const char* path, game* g, int sync_moves, long sync_ms);
+void journal_append(journal* j, unsigned char op, unsigned char x, unsigned char y);
+bool journal_sync(journal* j);
+bool journal_close(journal* j, game* g);
+#endif
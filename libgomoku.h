@@ -0,0 +1,28 @@
+#ifndef _LIBGOMOKU_H_
+#define _LIBGOMOKU_H_
+#include "analysis.h"
+#include "board.h"
+#include "broadcast.h"
+#include "cache.h"
+#include "cpu.h"
+#include "dfpn.h"
+#include "engine.h"
+#include "error-codes.h"
+#include "game.h"
+#include "hash.h"
+#include "index.h"
+#include "io.h"
+#include "journal.h"
+#include "lockstep.h"
+#include "nnue.h"
+#include "packed.h"
+#include "parse.h"
+#include "playout.h"
+#include "pool.h"
+#include "rules.h"
+#include "search.h"
+#include "shape.h"
+#include "source.h"
+#include "split.h"
+#include "symmetry.h"
+#endif
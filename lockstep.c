@@ -0,0 +1,411 @@
+/**
+ * @file lockstep.c
+ * @author Faris Soliman
+ * This file contains the batched rules, which play one move on each of LOCKSTEP_LANES boards
+ * of the same size in a single call and tell for each board what the move did, with the same
+ * checks, in the same order, as game_place_stone(). They are meant for work that plays the
+ * same kind of move on many boards at once: the last ply of perft, self-play and bulk checks.
+ *
+ * The boards are stored as a structure of arrays: the bytes of one intersection on every
+ * board are side by side, so an instruction sees that intersection on 32 boards at once. Each
+ * board is framed by LOCKSTEP_PAD rows and columns of walls, which are neither empty nor a
+ * stone, so no walk along a line needs a bound. Every board plays its own move, so the lines
+ * through the moves are first gathered into the same layout, one byte per board, and the runs
+ * and open fours of all of them are then measured without a branch, 32 boards per instruction
+ * with AVX2 and 16 with SSE2. Like the pattern scanner, the widest kernel the processor
+ * supports is picked at run time.
+*/
+#include <string.h>
+#include "board.h"
+#include "cpu.h"
+#include "game.h"
+#include "lockstep.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOCKSTEP_X86
+#include <immintrin.h>
+#endif
+
+#define CENTER (RULES_REACH + 1)
+
+typedef void (*lockstep_measure)(unsigned char lines[DIRECTIONS][LOCKSTEP_LINE][LOCKSTEP_LANES],
+    const unsigned char* stone, unsigned char* runs, unsigned char* fours);
+
+// The lines of rules.c, walked the same way.
+static const signed char line_dx[DIRECTIONS] = {1, 0, 1, 1};
+static const signed char line_dy[DIRECTIONS] = {0, 1, 1, -1};
+
+/**
+ * Gets the index of an intersection in the padded grid.
+ * @param l The boards.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The index.
+*/
+static inline int cell_index(const lockstep* l, int x, int y) {
+    return (y + LOCKSTEP_PAD) * l->stride + x + LOCKSTEP_PAD;
+}
+
+/**
+ * Measures the lines of the boards one at a time. A line holds the intersections from
+ * RULES_REACH + 1 before the move to RULES_REACH after it. The run through the move is
+ * counted up to RULES_REACH either way, like line_run() does. An open four is a run of four
+ * with the intersections just after it and just before it empty, like line_open_fours()
+ * counts them; only runs ending from the move to three after it can
+ * count, since the move is a stone and ends or continues every other run.
+ * @param lines The lines, by direction, intersection and board.
+ * @param stone The color that moved on every board.
+ * @param runs Where to put the longest run through every move.
+ * @param fours Where to put the number of open fours of every move.
+*/
+void static measure_scalar(unsigned char lines[DIRECTIONS][LOCKSTEP_LINE][LOCKSTEP_LANES], const unsigned char* stone,
+    unsigned char* runs, unsigned char* fours) {
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        unsigned char s = stone[lane];
+        runs[lane] = 0;
+        fours[lane] = 0;
+        for (int d = 0; d < DIRECTIONS; d++) {
+            unsigned char (*line)[LOCKSTEP_LANES] = lines[d];
+            int run = 1;
+            for (int k = 1; k <= RULES_REACH && line[CENTER + k][lane] == s; k++) {
+                run++;
+            }
+            for (int k = 1; k <= RULES_REACH && line[CENTER - k][lane] == s; k++) {
+                run++;
+            }
+            runs[lane] = run > runs[lane] ? run : runs[lane];
+            for (int j = CENTER; j < CENTER + 4; j++) {
+                fours[lane] += line[j][lane] == s && line[j - 1][lane] == s && line[j - 2][lane] == s &&
+                    line[j - 3][lane] == s && line[j + 1][lane] == EMPTY_INTERSECTION &&
+                    line[j - 4][lane] == EMPTY_INTERSECTION;
+            }
+        }
+    }
+}
+
+#ifdef LOCKSTEP_X86
+/**
+ * Measures the lines of 16 boards, as measure_scalar() does. Every comparison gives 0xFF for
+ * true, which is -1 as a byte, so counts are kept by subtracting them.
+ * @param lines The lines, by direction, intersection and board.
+ * @param stone The color that moved on every board.
+ * @param runs Where to put the longest run through every move.
+ * @param fours Where to put the number of open fours of every move.
+ * @param lane The first of the 16 boards.
+*/
+__attribute__((target("sse2"), always_inline))
+static inline void measure16_sse2(unsigned char lines[DIRECTIONS][LOCKSTEP_LINE][LOCKSTEP_LANES], const unsigned char* stone,
+    unsigned char* runs, unsigned char* fours, int lane) {
+    __m128i s = _mm_loadu_si128((const __m128i*) (stone + lane));
+    __m128i zero = _mm_setzero_si128();
+    __m128i best = zero;
+    __m128i count = zero;
+    for (int d = 0; d < DIRECTIONS; d++) {
+        __m128i own[LOCKSTEP_LINE];
+        __m128i empty[LOCKSTEP_LINE];
+        #pragma GCC unroll 10
+        for (int j = 0; j < LOCKSTEP_LINE; j++) {
+            __m128i c = _mm_loadu_si128((const __m128i*) (lines[d][j] + lane));
+            own[j] = _mm_cmpeq_epi8(c, s);
+            empty[j] = _mm_cmpeq_epi8(c, zero);
+        }
+
+        __m128i run = _mm_set1_epi8(1);
+        __m128i after = own[CENTER + 1];
+        __m128i before = own[CENTER - 1];
+        #pragma GCC unroll 4
+        for (int k = 1; k <= RULES_REACH; k++) {
+            if (k > 1) {
+                after = _mm_and_si128(after, own[CENTER + k]);
+                before = _mm_and_si128(before, own[CENTER - k]);
+            }
+            run = _mm_sub_epi8(_mm_sub_epi8(run, after), before);
+        }
+        best = _mm_max_epu8(best, run);
+
+        #pragma GCC unroll 4
+        for (int j = CENTER; j < CENTER + 4; j++) {
+            __m128i four = _mm_and_si128(_mm_and_si128(own[j], own[j - 1]), _mm_and_si128(own[j - 2], own[j - 3]));
+            __m128i open = _mm_and_si128(empty[j + 1], empty[j - 4]);
+            count = _mm_sub_epi8(count, _mm_and_si128(four, open));
+        }
+    }
+    _mm_storeu_si128((__m128i*) (runs + lane), best);
+    _mm_storeu_si128((__m128i*) (fours + lane), count);
+}
+
+/**
+ * Measures the lines of the boards, 16 at a time.
+ * @param lines The lines, by direction, intersection and board.
+ * @param stone The color that moved on every board.
+ * @param runs Where to put the longest run through every move.
+ * @param fours Where to put the number of open fours of every move.
+*/
+__attribute__((target("sse2")))
+void static measure_sse2(unsigned char lines[DIRECTIONS][LOCKSTEP_LINE][LOCKSTEP_LANES], const unsigned char* stone,
+    unsigned char* runs, unsigned char* fours) {
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane += 16) {
+        measure16_sse2(lines, stone, runs, fours, lane);
+    }
+}
+
+/**
+ * Measures the lines of the boards, all 32 at a time, as measure_sse2() does.
+ * @param lines The lines, by direction, intersection and board.
+ * @param stone The color that moved on every board.
+ * @param runs Where to put the longest run through every move.
+ * @param fours Where to put the number of open fours of every move.
+*/
+__attribute__((target("avx2")))
+void static measure_avx2(unsigned char lines[DIRECTIONS][LOCKSTEP_LINE][LOCKSTEP_LANES], const unsigned char* stone,
+    unsigned char* runs, unsigned char* fours) {
+    __m256i s = _mm256_loadu_si256((const __m256i*) stone);
+    __m256i zero = _mm256_setzero_si256();
+    __m256i best = zero;
+    __m256i count = zero;
+    for (int d = 0; d < DIRECTIONS; d++) {
+        __m256i own[LOCKSTEP_LINE];
+        __m256i empty[LOCKSTEP_LINE];
+        #pragma GCC unroll 10
+        for (int j = 0; j < LOCKSTEP_LINE; j++) {
+            __m256i c = _mm256_loadu_si256((const __m256i*) lines[d][j]);
+            own[j] = _mm256_cmpeq_epi8(c, s);
+            empty[j] = _mm256_cmpeq_epi8(c, zero);
+        }
+
+        __m256i run = _mm256_set1_epi8(1);
+        __m256i after = own[CENTER + 1];
+        __m256i before = own[CENTER - 1];
+        #pragma GCC unroll 4
+        for (int k = 1; k <= RULES_REACH; k++) {
+            if (k > 1) {
+                after = _mm256_and_si256(after, own[CENTER + k]);
+                before = _mm256_and_si256(before, own[CENTER - k]);
+            }
+            run = _mm256_sub_epi8(_mm256_sub_epi8(run, after), before);
+        }
+        best = _mm256_max_epu8(best, run);
+
+        #pragma GCC unroll 4
+        for (int j = CENTER; j < CENTER + 4; j++) {
+            __m256i four = _mm256_and_si256(_mm256_and_si256(own[j], own[j - 1]), _mm256_and_si256(own[j - 2], own[j - 3]));
+            __m256i open = _mm256_and_si256(empty[j + 1], empty[j - 4]);
+            count = _mm256_sub_epi8(count, _mm256_and_si256(four, open));
+        }
+    }
+    _mm256_storeu_si256((__m256i*) runs, best);
+    _mm256_storeu_si256((__m256i*) fours, count);
+}
+#endif
+
+typedef struct {
+    const char* name;
+    lockstep_measure measure;
+} kernel_entry;
+
+static const kernel_entry kernels[] = {
+#ifdef LOCKSTEP_X86
+    {"avx2", measure_avx2},
+    {"sse2", measure_sse2},
+#endif
+    {"scalar", measure_scalar},
+};
+
+static const void* active = NULL;
+
+/**
+ * Gets the kernel in use, picking the widest one the processor supports the first time.
+ * @return The kernel.
+*/
+static const kernel_entry* kernel_select(void) {
+    return cpu_select(&active, kernels, sizeof(kernels) / sizeof(kernels[0]), sizeof(kernels[0]));
+}
+
+/**
+ * Gets the name of the kernel the batched rules dispatch to.
+ * @return The kernel name, "avx2", "sse2" or "scalar".
+*/
+const char* lockstep_kernel(void) {
+    return kernel_select()->name;
+}
+
+/**
+ * Forces the batched rules to use a kernel, mostly for benchmarks and cross checks.
+ * @param name The kernel name.
+ * @return Whether the kernel exists and is supported by the processor.
+*/
+bool lockstep_use_kernel(const char* name) {
+    return cpu_use(&active, kernels, sizeof(kernels) / sizeof(kernels[0]), sizeof(kernels[0]), name);
+}
+
+/**
+ * Sets up empty boards, with black to move on every one.
+ * @param l The boards.
+ * @param size The board size, up to PATTERN_MAX_SIZE.
+ * @param type The rules, GAME_FREESTYLE or GAME_RENJU.
+ * @return Whether the size fits.
+*/
+bool lockstep_init(lockstep* l, unsigned char size, unsigned char type) {
+    if (size < 1 || size > PATTERN_MAX_SIZE) {
+        return false;
+    }
+
+    l->size = size;
+    l->stride = size + LOCKSTEP_PAD;
+    memset(l->cells, LOCKSTEP_WALL, sizeof(l->cells));
+    for (int y = 0; y < size; y++) {
+        memset(l->cells[cell_index(l, 0, y)], EMPTY_INTERSECTION, (size_t)size * LOCKSTEP_LANES);
+    }
+    memset(l->type, type, sizeof(l->type));
+    memset(l->stone, BLACK_STONE, sizeof(l->stone));
+    memset(l->state, GAME_STATE_PLAYING, sizeof(l->state));
+    memset(l->winner, EMPTY_INTERSECTION, sizeof(l->winner));
+    memset(l->moves, 0, sizeof(l->moves));
+    return true;
+}
+
+/**
+ * Copies the position of a game onto a board.
+ * @param l The boards.
+ * @param lane The board, or LOCKSTEP_ALL for every board.
+ * @param g The game, of the size of the boards.
+ * @return Whether the sizes match.
+*/
+bool lockstep_load(lockstep* l, int lane, game* g) {
+    if (g->board->size != l->size) {
+        return false;
+    }
+
+    int first = lane == LOCKSTEP_ALL ? 0 : lane;
+    int count = lane == LOCKSTEP_ALL ? LOCKSTEP_LANES : 1;
+    const unsigned char* grid = g->board->grid;
+    for (int y = 0; y < l->size; y++) {
+        for (int x = 0; x < l->size; x++) {
+            memset(l->cells[cell_index(l, x, y)] + first, grid[y * l->size + x], count);
+        }
+    }
+    memset(l->type + first, g->type, count);
+    memset(l->stone + first, g->stone, count);
+    memset(l->state + first, g->state, count);
+    memset(l->winner + first, g->winner, count);
+    for (int i = first; i < first + count; i++) {
+        l->moves[i] = g->moves_count;
+    }
+    return true;
+}
+
+/**
+ * Gets an intersection of a board.
+ * @param l The boards.
+ * @param lane The board.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The stone there, or EMPTY_INTERSECTION.
+*/
+unsigned char lockstep_get(const lockstep* l, int lane, unsigned char x, unsigned char y) {
+    return l->cells[cell_index(l, x, y)][lane];
+}
+
+/**
+ * Plays a move on every board for the color to move there, and ends the game the move ends,
+ * as game_place_stone() would.
+ * @param l The boards.
+ * @param x The x coordinate of the move on every board, or LOCKSTEP_PASS to leave it be.
+ * @param y The y coordinate of the move on every board.
+ * @param outcomes Where to put what the move did on every board: LOCKSTEP_PLAYING if the game
+ *        goes on, LOCKSTEP_FIVE if the move won it, LOCKSTEP_FORBIDDEN if it lost it,
+ *        LOCKSTEP_DRAW if it filled the board, LOCKSTEP_ILLEGAL if it could not be played and
+ *        LOCKSTEP_IDLE if the board was left be.
+*/
+void lockstep_play(lockstep* l, const unsigned char* x, const unsigned char* y, unsigned char* outcomes) {
+    unsigned char lines[DIRECTIONS][LOCKSTEP_LINE][LOCKSTEP_LANES];
+    unsigned char stone[LOCKSTEP_LANES];
+    unsigned char runs[LOCKSTEP_LANES];
+    unsigned char fours[LOCKSTEP_LANES];
+    int steps[DIRECTIONS];
+    for (int d = 0; d < DIRECTIONS; d++) {
+        steps[d] = line_dy[d] * l->stride + line_dx[d];
+    }
+
+    // Place the stones and gather the lines through them. A board left be gets lines of walls.
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        stone[lane] = l->stone[lane];
+        if (x[lane] == LOCKSTEP_PASS) {
+            outcomes[lane] = LOCKSTEP_IDLE;
+        } else if (x[lane] >= l->size || y[lane] >= l->size || l->state[lane] != GAME_STATE_PLAYING ||
+            l->cells[cell_index(l, x[lane], y[lane])][lane] != EMPTY_INTERSECTION) {
+            outcomes[lane] = LOCKSTEP_ILLEGAL;
+        } else {
+            outcomes[lane] = LOCKSTEP_PLAYING;
+        }
+        if (outcomes[lane] != LOCKSTEP_PLAYING) {
+            for (int d = 0; d < DIRECTIONS; d++) {
+                for (int j = 0; j < LOCKSTEP_LINE; j++) {
+                    lines[d][j][lane] = LOCKSTEP_WALL;
+                }
+            }
+            continue;
+        }
+
+        int index = cell_index(l, x[lane], y[lane]);
+        l->cells[index][lane] = stone[lane];
+        l->moves[lane]++;
+        for (int d = 0; d < DIRECTIONS; d++) {
+            const unsigned char (*p)[LOCKSTEP_LANES] = l->cells + index - CENTER * steps[d];
+            for (int j = 0; j < LOCKSTEP_LINE; j++, p += steps[d]) {
+                lines[d][j][lane] = (*p)[lane];
+            }
+        }
+    }
+
+    kernel_select()->measure(lines, stone, runs, fours);
+
+    // The same checks, in the same order, as game_place_stone().
+    int cells = l->size * l->size;
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if (outcomes[lane] != LOCKSTEP_PLAYING) {
+            continue;
+        }
+        bool renju_black = l->type[lane] == GAME_RENJU && stone[lane] == BLACK_STONE;
+        if (renju_black && runs[lane] >= 6) {
+            outcomes[lane] = LOCKSTEP_FORBIDDEN;
+            l->state[lane] = GAME_STATE_FORBIDDEN;
+            l->winner[lane] = WHITE_STONE;
+        } else if (runs[lane] >= 5) {
+            outcomes[lane] = LOCKSTEP_FIVE;
+            l->state[lane] = GAME_STATE_FINISHED;
+            l->winner[lane] = stone[lane];
+        } else if (l->moves[lane] == cells) {
+            outcomes[lane] = LOCKSTEP_DRAW;
+            l->state[lane] = GAME_STATE_FINISHED;
+        } else if (renju_black && fours[lane] > 1) {
+            outcomes[lane] = LOCKSTEP_FORBIDDEN;
+            l->state[lane] = GAME_STATE_FORBIDDEN;
+            l->winner[lane] = WHITE_STONE;
+        } else {
+            l->stone[lane] = stone[lane] == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+        }
+    }
+}
+
+/**
+ * Takes back the moves of a call to lockstep_play(), with the game going on again where one
+ * ended.
+ * @param l The boards.
+ * @param x The x coordinates the moves were played with.
+ * @param y The y coordinates the moves were played with.
+ * @param outcomes The outcomes the moves had.
+*/
+void lockstep_undo(lockstep* l, const unsigned char* x, const unsigned char* y, const unsigned char* outcomes) {
+    for (int lane = 0; lane < LOCKSTEP_LANES; lane++) {
+        if (outcomes[lane] == LOCKSTEP_ILLEGAL || outcomes[lane] == LOCKSTEP_IDLE) {
+            continue;
+        }
+        unsigned char* cell = &l->cells[cell_index(l, x[lane], y[lane])][lane];
+        l->stone[lane] = *cell;
+        l->state[lane] = GAME_STATE_PLAYING;
+        l->winner[lane] = EMPTY_INTERSECTION;
+        l->moves[lane]--;
+        *cell = EMPTY_INTERSECTION;
+    }
+}
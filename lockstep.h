@@ -0,0 +1,39 @@
+#ifndef _LOCKSTEP_H_
+#define _LOCKSTEP_H_
+#include <stdbool.h>
+#include "game.h"
+#include "pattern.h"
+#include "rules.h"
+#define LOCKSTEP_LANES 32
+#define LOCKSTEP_ALL (-1)
+#define LOCKSTEP_PAD (RULES_REACH + 1)
+#define LOCKSTEP_LINE (2 * RULES_REACH + 2)
+#define LOCKSTEP_CELLS ((PATTERN_MAX_SIZE + 2 * LOCKSTEP_PAD) * (PATTERN_MAX_SIZE + LOCKSTEP_PAD))
+#define LOCKSTEP_WALL 3
+#define LOCKSTEP_PASS 255
+#define LOCKSTEP_PLAYING 0
+#define LOCKSTEP_FIVE 1
+#define LOCKSTEP_FORBIDDEN 2
+#define LOCKSTEP_DRAW 3
+#define LOCKSTEP_ILLEGAL 4
+#define LOCKSTEP_IDLE 5
+
+typedef struct {
+    unsigned char size;
+    unsigned char stride;
+    unsigned char cells[LOCKSTEP_CELLS][LOCKSTEP_LANES];
+    unsigned char type[LOCKSTEP_LANES];
+    unsigned char stone[LOCKSTEP_LANES];
+    unsigned char state[LOCKSTEP_LANES];
+    unsigned char winner[LOCKSTEP_LANES];
+    unsigned short moves[LOCKSTEP_LANES];
+} lockstep;
+
+bool lockstep_init(lockstep* l, unsigned char size, unsigned char type);
+bool lockstep_load(lockstep* l, int lane, game* g);
+unsigned char lockstep_get(const lockstep* l, int lane, unsigned char x, unsigned char y);
+void lockstep_play(lockstep* l, const unsigned char* x, const unsigned char* y, unsigned char* outcomes);
+void lockstep_undo(lockstep* l, const unsigned char* x, const unsigned char* y, const unsigned char* outcomes);
+const char* lockstep_kernel(void);
+bool lockstep_use_kernel(const char* name);
+#endif
@@ -0,0 +1,411 @@
+/**
+ * @file lookup.c
+ * @author Faris Soliman
+ * This file is a tool that builds a position index of a corpus of saved games and looks up
+ * positions in it. With -o, it takes the same paths as corpus, parses the games in batches on
+ * a thread pool, and writes the index of every position they reached. Otherwise, it looks up
+ * the position of a saved game, or the one after a list of moves, and prints the games that
+ * passed through it, in any rotation or reflection, with the counts of their outcomes.
+ *
+ * Games are numbered in the order they were read, so the index is the same for any number of
+ * threads, and a game is named by the path it was read from.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "board.h"
+#include "error-codes.h"
+#include "game.h"
+#include "index.h"
+#include "parse.h"
+#include "pool.h"
+#include "source.h"
+#define LOOKUP_BATCH 256
+#define LOOKUP_LIST 20
+
+typedef struct {
+    int count;
+    char* paths[LOOKUP_BATCH];
+    char* data[LOOKUP_BATCH];
+    size_t lengths[LOOKUP_BATCH];
+    bool readable[LOOKUP_BATCH];
+    index_game games[LOOKUP_BATCH];
+    size_t starts[LOOKUP_BATCH + 1];
+    uint64_t* keys;
+    bool failed;
+} batch;
+
+typedef struct {
+    pool* p;
+    batch** batches;
+    size_t count;
+    size_t capacity;
+    batch* current;
+    unsigned long missing;
+} builder;
+
+/**
+ * The pool job: parses a batch of games and gets the keys of their positions.
+ * @param arg The batch.
+ * @param worker The number of the worker running the job.
+*/
+void static run_batch(void* arg, int worker) {
+    batch* b = arg;
+    parse_record* r = malloc(sizeof(parse_record));
+    size_t capacity = 0;
+    b->starts[0] = 0;
+
+    for (int i = 0; i < b->count; i++) {
+        if (b->data[i] == NULL) {
+            b->data[i] = source_read_file(b->paths[i], &b->lengths[i]);
+        }
+        b->readable[i] = r != NULL && b->data[i] != NULL && parse_buffer(b->data[i], b->lengths[i], r, NULL);
+        b->starts[i + 1] = b->starts[i];
+        free(b->data[i]);
+        b->data[i] = NULL;
+        if (!b->readable[i]) {
+            continue;
+        }
+
+        if (b->starts[i] + r->count > capacity) {
+            capacity = (b->starts[i] + r->count) * 2;
+            uint64_t* keys = realloc(b->keys, capacity * sizeof(uint64_t));
+            if (keys == NULL) {
+                b->failed = true;
+                break;
+            }
+            b->keys = keys;
+        }
+        index_keys(r, b->keys + b->starts[i]);
+        b->starts[i + 1] += r->count;
+        b->games[i].moves = r->count;
+        b->games[i].type = r->type;
+        b->games[i].size = r->size;
+        b->games[i].outcome = index_outcome(r->state, r->winner);
+    }
+    b->failed = b->failed || r == NULL;
+    free(r);
+}
+
+/**
+ * Adds a game to the batch being filled, handing the batch to the pool once it is full.
+ * @param arg The builder.
+ * @param path The path of the game.
+ * @param data The contents of the game if it is already in memory, or NULL to read the path.
+ * @param length The length of the contents.
+*/
+void static add_game(void* arg, char* path, char* data, size_t length) {
+    builder* bl = arg;
+    if (bl->current == NULL) {
+        if (bl->count == bl->capacity) {
+            bl->capacity = bl->capacity == 0 ? 64 : bl->capacity * 2;
+            bl->batches = realloc(bl->batches, bl->capacity * sizeof(batch*));
+        }
+        bl->current = bl->batches == NULL ? NULL : calloc(1, sizeof(batch));
+        if (bl->current == NULL) {
+            exit(NULL_POINTER_ERR);
+        }
+        bl->batches[bl->count++] = bl->current;
+    }
+
+    batch* b = bl->current;
+    b->paths[b->count] = path;
+    b->data[b->count] = data;
+    b->lengths[b->count] = length;
+    b->count++;
+    if (b->count == LOOKUP_BATCH) {
+        pool_submit(bl->p, run_batch, b);
+        bl->current = NULL;
+    }
+}
+
+/**
+ * Reports a path that cannot be read.
+ * @param arg The builder.
+ * @param path The path.
+ * @param reason Why it cannot be read.
+*/
+void static read_error(void* arg, const char* path, unsigned char reason) {
+    builder* bl = arg;
+    if (reason == SOURCE_TRUNCATED) {
+        fprintf(stderr, "Cannot read all of %s\n", path);
+    } else {
+        fprintf(stderr, "Cannot read %s\n", path);
+    }
+    if (reason == SOURCE_MISSING) {
+        bl->missing++;
+    }
+}
+
+/**
+ * Builds an index of the saved games on the command line.
+ * @param threads The number of workers.
+ * @param path The path to write the index to.
+ * @param paths The paths to read.
+ * @param count The number of paths.
+ * @return The exit code.
+*/
+int static build(int threads, const char* path, char** paths, int count) {
+    builder bl = {pool_create(threads), NULL, 0, 0, NULL, 0};
+    if (bl.p == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    source_visitor v = {add_game, read_error, &bl};
+    for (int i = 0; i < count; i++) {
+        if (!source_walk(paths[i], true, &v)) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    if (bl.current != NULL) {
+        pool_submit(bl.p, run_batch, bl.current);
+    }
+    pool_wait(bl.p);
+    pool_delete(bl.p);
+
+    // Number the games in the order they were read, and gather their names and positions.
+    size_t games = 0;
+    size_t names_length = 0;
+    size_t entries_count = 0;
+    unsigned long read = bl.missing;
+    for (size_t i = 0; i < bl.count; i++) {
+        batch* b = bl.batches[i];
+        if (b->failed) {
+            return NULL_POINTER_ERR;
+        }
+        read += b->count;
+        for (int j = 0; j < b->count; j++) {
+            if (b->readable[j]) {
+                games++;
+                names_length += strlen(b->paths[j]) + 1;
+            }
+        }
+        entries_count += b->starts[b->count];
+    }
+    index_game* table = calloc(games > 0 ? games : 1, sizeof(index_game));
+    char* names = malloc(names_length > 0 ? names_length : 1);
+    index_entry* entries = malloc((entries_count > 0 ? entries_count : 1) * sizeof(index_entry));
+    if (table == NULL || names == NULL || entries == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    uint32_t id = 0;
+    size_t name = 0;
+    size_t n = 0;
+    for (size_t i = 0; i < bl.count; i++) {
+        batch* b = bl.batches[i];
+        for (int j = 0; j < b->count; j++) {
+            if (b->readable[j]) {
+                table[id] = b->games[j];
+                table[id].name = name;
+                strcpy(names + name, b->paths[j]);
+                name += strlen(b->paths[j]) + 1;
+                for (size_t k = b->starts[j]; k < b->starts[j + 1]; k++) {
+                    entries[n].key = b->keys[k];
+                    entries[n].game = id;
+                    n++;
+                }
+                id++;
+            }
+            free(b->paths[j]);
+        }
+        free(b->keys);
+        free(b);
+    }
+    free(bl.batches);
+
+    bool written = index_write(path, table, games, names, names_length, entries, entries_count);
+    free(table);
+    free(names);
+    free(entries);
+    index_file* f = written ? index_open(path) : NULL;
+    if (f == NULL) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return FILE_OUTPUT_ERR;
+    }
+
+    printf("Games:               %lu\n", read);
+    printf("Unreadable:          %lu\n", read - (unsigned long)games);
+    printf("Positions:           %llu\n", (unsigned long long)f->header->keys);
+    printf("Occurrences:         %llu\n", (unsigned long long)f->header->occurrences);
+    printf("Index:               %zu bytes written to %s\n", f->length, path);
+    index_close(f);
+    return SUCCESS;
+}
+
+/**
+ * Reads the moves of a query: a saved game, or a list of moves from the empty board.
+ * @param args The saved game, or the moves.
+ * @param count The number of arguments.
+ * @param type The rule set for a list of moves.
+ * @param size The board size for a list of moves.
+ * @param r Where to put the game.
+ * @return SUCCESS, FILE_INPUT_ERR if the saved game cannot be read, or INPUT_ERR if a move
+ *         cannot be played.
+*/
+int static read_query(char** args, int count, unsigned char type, unsigned char size, parse_record* r) {
+    if (count == 1 && source_is_game(args[0])) {
+        size_t length;
+        char* data = source_read_file(args[0], &length);
+        bool ok = data != NULL && parse_buffer(data, length, r, NULL);
+        free(data);
+        if (!ok) {
+            fprintf(stderr, "Cannot read %s\n", args[0]);
+            return FILE_INPUT_ERR;
+        }
+        return SUCCESS;
+    }
+
+    unsigned char taken[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE] = {0};
+    r->type = type;
+    r->size = size;
+    r->count = 0;
+    for (int i = 0; i < count; i++) {
+        char* end;
+        long y = strtol(args[i] + 1, &end, 10) - 1;
+        int x = args[i][0] - 'A';
+        if (x < 0 || x >= size || y < 0 || y >= size || *end != '\0' || end == args[i] + 1 || taken[y * size + x]) {
+            fprintf(stderr, "Cannot play %s\n", args[i]);
+            return INPUT_ERR;
+        }
+        taken[y * size + x] = 1;
+        r->x[r->count] = x;
+        r->y[r->count] = y;
+        r->count++;
+    }
+    return SUCCESS;
+}
+
+/**
+ * Looks up a position and prints the games that reached it.
+ * @param path The path to the index.
+ * @param r The moves leading to the position.
+ * @param limit The most games to list.
+ * @param quiet Whether to leave out the time the lookup took.
+ * @return The exit code.
+*/
+int static query(const char* path, const parse_record* r, int limit, bool quiet) {
+    uint64_t* keys = malloc((r->count > 0 ? r->count : 1) * sizeof(uint64_t));
+    uint32_t* found = malloc((limit > 0 ? limit : 1) * sizeof(uint32_t));
+    if (keys == NULL || found == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    index_keys(r, keys);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    index_file* f = index_open(path);
+    if (f == NULL) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        free(found);
+        free(keys);
+        return FILE_INPUT_ERR;
+    }
+    unsigned long outcomes[INDEX_OUTCOMES] = {0};
+    unsigned long games = 0;
+    index_postings p;
+    uint32_t game;
+    if (r->count > 0 && index_find(f, keys[r->count - 1], &p)) {
+        while (index_next(&p, &game) && game < f->header->games) {
+            if (games < (unsigned long)limit) {
+                found[games] = game;
+            }
+            games++;
+            outcomes[f->games[game].outcome % INDEX_OUTCOMES]++;
+        }
+    }
+    struct timespec stop;
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+
+    printf("Position:            %s %ux%u, %zu %s, %s to move\n", r->type == GAME_RENJU ? "renju" : "freestyle",
+        r->size, r->size, r->count, r->count == 1 ? "move" : "moves", r->count % 2 == 0 ? "black" : "white");
+    printf("Games:               %lu\n", games);
+    printf("Black wins:          %lu\n", outcomes[INDEX_BLACK_WINS]);
+    printf("White wins:          %lu\n", outcomes[INDEX_WHITE_WINS]);
+    printf("Draws:               %lu\n", outcomes[INDEX_DRAW]);
+    printf("Forbidden moves:     %lu\n", outcomes[INDEX_FORBIDDEN]);
+    printf("Unfinished:          %lu\n", outcomes[INDEX_UNFINISHED]);
+    if (games > 0 && limit > 0) {
+        static const char* results[INDEX_OUTCOMES] = {"black wins", "white wins", "draw", "forbidden move", "unfinished"};
+        printf("\n");
+        for (unsigned long i = 0; i < games && i < (unsigned long)limit; i++) {
+            const index_game* g = &f->games[found[i]];
+            printf("%s: %s after %u moves\n", index_name(f, found[i]), results[g->outcome % INDEX_OUTCOMES], g->moves);
+        }
+        if (games > (unsigned long)limit) {
+            printf("... and %lu more\n", games - limit);
+        }
+    }
+    if (!quiet) {
+        printf("\nLookup:              %.3f ms\n", (stop.tv_sec - start.tv_sec) * 1000.0 + (stop.tv_nsec - start.tv_nsec) / 1e6);
+    }
+
+    index_close(f);
+    free(found);
+    free(keys);
+    return SUCCESS;
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    const char* output = NULL;
+    unsigned char type = GAME_FREESTYLE;
+    int size = 15;
+    int limit = LOOKUP_LIST;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-r") == 0) {
+            type = GAME_RENJU;
+            first++;
+            continue;
+        }
+        if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+            continue;
+        }
+        if (strcmp(argv[first], "-j") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            threads = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+            output = argv[first + 1];
+        } else if (strcmp(argv[first], "-s") == 0 && first + 1 < argc && atoi(argv[first + 1]) >= 5 &&
+            atoi(argv[first + 1]) <= PATTERN_MAX_SIZE) {
+            size = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-l") == 0 && first + 1 < argc && atoi(argv[first + 1]) >= 0) {
+            limit = atoi(argv[first + 1]);
+        } else {
+            first = argc;
+            break;
+        }
+        first += 2;
+    }
+    if (output != NULL && first < argc) {
+        return build(threads, output, argv + first, argc - first);
+    }
+    if (output != NULL || first + 1 >= argc) {
+        fprintf(stdout, "usage: %s [-j threads] -o games.idx <saved-match.gmk|directory|archive.tar>...\n", argv[0]);
+        fprintf(stdout, "       %s [-r] [-s size] [-l limit] [-q] games.idx <saved-match.gmk|moves...>\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    parse_record* r = malloc(sizeof(parse_record));
+    if (r == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    int status = read_query(argv + first + 1, argc - first - 1, type, size, r);
+    if (status == SUCCESS) {
+        status = query(argv[first], r, limit, quiet);
+    }
+    free(r);
+    return status;
+}
@@ -0,0 +1,752 @@
+/**
+ * @file mine.c
+ * @author Faris Soliman
+ * This file is a tool that mines a corpus of saved games for puzzles: positions where the side
+ * to move had a forced win by threats, whether the game went on to play it or missed it. It
+ * takes the same paths as corpus. Every position of every game is given to the df-pn solver
+ * in dfpn.c with a small node budget, fours only first and, unless -f is given, fours and
+ * threes after that. A win of at least MINE_MIN_LINE plies, so more than a five to make, is a
+ * puzzle; it counts as played if the move the game played also wins.
+ *
+ * The puzzles are written to a directory as saved games stopped at the position, together
+ * with an index in the format tactics reads, so the directory is a suite of its own: every
+ * line has the game, the kind of win and the winning moves, then a comment with the canonical
+ * hash of the position, whether the win was played, the length of the line and where the
+ * position comes from. A position that is a rotation or reflection of one already written is
+ * left out, so each puzzle is there once.
+ *
+ * The mining is a pipeline like the one of dataset: games are read in batches and mined by a
+ * thread pool, each worker with a solver of its own, and a writer thread writes the puzzles of
+ * the batches in the order they were read. The same position turns up in many games, the
+ * openings most of all, so the workers share a lossy table of solved positions, by their own
+ * hash rather than the canonical one, since a budget may prove a position in one orientation
+ * and not in another. What is written is the same for any number of threads.
+ *
+ * With -c, the writer saves a checkpoint of how far it got every MINE_CHECKPOINT_MS and at the
+ * end; a run given the same checkpoint skips the games the checkpoint covers, cuts the index
+ * back to where it was and goes on numbering the puzzles from there. With -l, a run stops
+ * after a number of games, so a large corpus can be mined a night at a time.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "dfpn.h"
+#include "error-codes.h"
+#include "game.h"
+#include "hash.h"
+#include "parse.h"
+#include "pool.h"
+#include "search.h"
+#include "source.h"
+#include "symmetry.h"
+#define MINE_BATCH 16
+#define MINE_QUEUE 8
+#define MINE_NODES 2000
+#define MINE_MIN_LINE 3
+#define MINE_CACHE (1 << 20)
+#define MINE_CHECKPOINT_MS 1000
+#define MINE_VERSION 2
+#define MINE_NAME "puzzle-%06lu.gmk"
+#define MINE_INDEX "puzzles.txt"
+#define MINE_NONE 0xFF
+
+typedef struct miner miner;
+
+typedef struct {
+    uint64_t canonical;
+    int game;
+    int ply;
+    unsigned char kind;
+    unsigned char length;
+    unsigned char x;
+    unsigned char y;
+    unsigned char played_x;
+    unsigned char played_y;
+    bool played;
+} puzzle;
+
+typedef struct {
+    miner* m;
+    unsigned long seq;
+    int count;
+    char* paths[MINE_BATCH];
+    char* data[MINE_BATCH];
+    size_t lengths[MINE_BATCH];
+    parse_record* records;
+    puzzle* puzzles;
+    size_t puzzles_count;
+    size_t puzzles_capacity;
+    unsigned long unreadable;
+    unsigned long positions;
+    unsigned long searched;
+    bool failed;
+} batch;
+
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} solved_slot;
+
+typedef struct {
+    uint64_t* keys;
+    size_t mask;
+    size_t count;
+} key_set;
+
+struct miner {
+    bool threes;
+    unsigned long nodes;
+    const char* directory;
+    const char* checkpoint;
+    dfpn** solvers;
+    solved_slot* cache;
+    FILE* index;
+    pool* p;
+    batch* current;
+    unsigned long read;
+    unsigned long skip;
+    unsigned long limit;
+    unsigned long submitted;
+    unsigned long missing;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    batch* slots[MINE_QUEUE];
+    unsigned long next;
+    bool closing;
+    key_set seen;
+    unsigned long games;
+    unsigned long unreadable;
+    unsigned long positions;
+    unsigned long searched;
+    unsigned long puzzles;
+    unsigned long played;
+    long long saved;
+    bool failed;
+    bool write_failed;
+};
+
+/**
+ * Adds a key to a set, growing the set when it is half full.
+ * @param s The set.
+ * @param key The key, which is not 0.
+ * @return Whether the key was not in the set yet, or false if the set could not grow.
+*/
+bool static set_add(key_set* s, uint64_t key) {
+    if (s->count * 2 >= s->mask + 1) {
+        key_set grown = {calloc((s->mask + 1) * 2, sizeof(uint64_t)), s->mask * 2 + 1, 0};
+        if (grown.keys == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i <= s->mask; i++) {
+            if (s->keys[i] != 0) {
+                set_add(&grown, s->keys[i]);
+            }
+        }
+        free(s->keys);
+        *s = grown;
+    }
+
+    size_t i = key & s->mask;
+    while (s->keys[i] != 0) {
+        if (s->keys[i] == key) {
+            return false;
+        }
+        i = (i + 1) & s->mask;
+    }
+    s->keys[i] = key;
+    s->count++;
+    return true;
+}
+
+/**
+ * Looks up a solved position in the shared table. A slot keeps its data and the data mixed
+ * with the key, so a slot torn by two workers writing it at once does not match either key.
+ * @param m The miner.
+ * @param key The hash of the position.
+ * @param data Where to put what was found.
+ * @return Whether the position is in the table.
+*/
+bool static cache_get(miner* m, uint64_t key, uint64_t* data) {
+    solved_slot* slot = &m->cache[key & (MINE_CACHE - 1)];
+    uint64_t check = __atomic_load_n(&slot->check, __ATOMIC_RELAXED);
+    *data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED);
+    return *data != 0 && (check ^ *data) == key;
+}
+
+/**
+ * Puts a solved position in the shared table, over whatever was in its slot.
+ * @param m The miner.
+ * @param key The hash of the position.
+ * @param data What was found, which is not 0.
+*/
+void static cache_put(miner* m, uint64_t key, uint64_t data) {
+    solved_slot* slot = &m->cache[key & (MINE_CACHE - 1)];
+    __atomic_store_n(&slot->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->data, data, __ATOMIC_RELAXED);
+}
+
+/**
+ * Packs what the solver found for the shared table.
+ * @param kind DFPN_VCF or DFPN_VCT, or MINE_NONE for no win.
+ * @param x The x coordinate of the first move of the win.
+ * @param y The y coordinate of the first move of the win.
+ * @param length The length of the winning line.
+ * @return The packed result, never 0.
+*/
+uint64_t static pack(unsigned char kind, unsigned char x, unsigned char y, unsigned char length) {
+    return 1 | (uint64_t)kind << 8 | (uint64_t)x << 16 | (uint64_t)y << 24 | (uint64_t)length << 32;
+}
+
+/**
+ * Gets the key of a position, in the shared table or among the puzzles written. A hash only
+ * covers the stones, whose indices depend on the size of the board, so the rule set and the
+ * size go into the key, as they do in the position index.
+ * @param g The game at the position.
+ * @param hash The hash of the position.
+ * @return The key.
+*/
+uint64_t static position_key(const game* g, uint64_t hash) {
+    return hash ^ hash_rules(g->type) ^ hash_key(EMPTY_INTERSECTION, g->board->size);
+}
+
+/**
+ * Solves a position for the side to move, or finds it in the shared table.
+ * @param b The batch, which counts the positions searched.
+ * @param d The solver of the worker.
+ * @param g The game.
+ * @return The packed result.
+*/
+uint64_t static solve(batch* b, dfpn* d, game* g) {
+    miner* m = b->m;
+    uint64_t key = position_key(g, game_hash(g));
+    uint64_t data;
+    if (cache_get(m, key, &data)) {
+        return data;
+    }
+
+    b->searched++;
+    unsigned char kind = DFPN_VCF;
+    dfpn_result r = dfpn_attack(d, g, DFPN_VCF, m->nodes, 0);
+    if (r.result != DFPN_WIN && m->threes) {
+        kind = DFPN_VCT;
+        r = dfpn_attack(d, g, DFPN_VCT, m->nodes, 0);
+    }
+    if (r.result == DFPN_WIN && r.length >= MINE_MIN_LINE) {
+        data = pack(kind, r.line[0][0], r.line[0][1], r.length > 255 ? 255 : r.length);
+    } else {
+        data = pack(MINE_NONE, 0, 0, 0);
+    }
+    cache_put(m, key, data);
+    return data;
+}
+
+/**
+ * Looks for a puzzle in a position of a game, and adds it to the batch if there is one.
+ * @param b The batch.
+ * @param d The solver of the worker.
+ * @param g The game at the position.
+ * @param number The number of the game in the batch.
+ * @param r The game's moves, the one after the position being the one played from it.
+ * @return Whether there was enough memory.
+*/
+bool static examine(batch* b, dfpn* d, game* g, int number, const parse_record* r) {
+    uint64_t data = solve(b, d, g);
+    unsigned char kind = (data >> 8) & 0xFF;
+    if (kind == MINE_NONE) {
+        return true;
+    }
+
+    if (b->puzzles_count == b->puzzles_capacity) {
+        size_t capacity = b->puzzles_capacity == 0 ? 16 : b->puzzles_capacity * 2;
+        puzzle* puzzles = realloc(b->puzzles, capacity * sizeof(puzzle));
+        if (puzzles == NULL) {
+            return false;
+        }
+        b->puzzles = puzzles;
+        b->puzzles_capacity = capacity;
+    }
+    puzzle* p = &b->puzzles[b->puzzles_count++];
+    p->canonical = position_key(g, game_canonical_hash(g, NULL));
+    p->game = number;
+    p->ply = g->moves_count;
+    p->kind = kind;
+    p->length = (data >> 32) & 0xFF;
+    p->x = (data >> 16) & 0xFF;
+    p->y = (data >> 24) & 0xFF;
+    p->played_x = SEARCH_NO_MOVE;
+    p->played_y = SEARCH_NO_MOVE;
+    p->played = false;
+
+    // The move the game played wins too if the other side is then lost.
+    if ((size_t)p->ply < r->count) {
+        unsigned char px = r->x[p->ply];
+        unsigned char py = r->y[p->ply];
+        if (px == p->x && py == p->y) {
+            p->played = true;
+        } else if (game_place_stone(g, px, py) == SUCCESS) {
+            p->played = g->state == GAME_STATE_PLAYING && dfpn_solve(d, g, kind, b->m->nodes, 0).result == DFPN_LOSS;
+            game_undo(g);
+            if (p->played) {
+                p->played_x = px;
+                p->played_y = py;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Mines every position of a game the rules accept, up to the last one still in play.
+ * @param b The batch.
+ * @param d The solver of the worker.
+ * @param number The number of the game in the batch.
+*/
+void static mine_game(batch* b, dfpn* d, int number) {
+    const parse_record* r = &b->records[number];
+    game* g = game_create(r->size, r->type);
+    if (g == NULL) {
+        b->failed = true;
+        return;
+    }
+    for (size_t i = 0; g->state == GAME_STATE_PLAYING; i++) {
+        b->positions++;
+        if (!examine(b, d, g, number, r)) {
+            b->failed = true;
+            break;
+        }
+        if (i == r->count || game_place_stone(g, r->x[i], r->y[i]) != SUCCESS) {
+            break;
+        }
+    }
+    game_delete(g);
+}
+
+/**
+ * Hands a mined batch to the writer, waiting while it is more than MINE_QUEUE batches ahead of
+ * the one the writer needs next.
+ * @param b The batch.
+*/
+void static push_batch(batch* b) {
+    miner* m = b->m;
+    pthread_mutex_lock(&m->lock);
+    while (b->seq >= m->next + MINE_QUEUE) {
+        pthread_cond_wait(&m->space, &m->lock);
+    }
+    m->slots[b->seq % MINE_QUEUE] = b;
+    pthread_cond_signal(&m->ready);
+    pthread_mutex_unlock(&m->lock);
+}
+
+/**
+ * The pool job: mines a batch of games, then hands it to the writer.
+ * @param arg The batch.
+ * @param worker The number of the worker running the job, which picks its solver.
+*/
+void static run_batch(void* arg, int worker) {
+    batch* b = arg;
+    b->records = malloc(MINE_BATCH * sizeof(parse_record));
+    if (b->records == NULL) {
+        b->failed = true;
+    }
+
+    for (int i = 0; i < b->count; i++) {
+        if (b->records != NULL && b->data[i] != NULL && parse_buffer(b->data[i], b->lengths[i], &b->records[i], NULL)) {
+            mine_game(b, b->m->solvers[worker], i);
+        } else {
+            b->unreadable++;
+        }
+        free(b->data[i]);
+    }
+    push_batch(b);
+}
+
+/**
+ * Saves how far the writer got, to a temporary file first so a checkpoint is never half
+ * written.
+ * @param m The miner.
+ * @return Whether it was saved.
+*/
+bool static save_checkpoint(miner* m) {
+    if (fflush(m->index) != 0) {
+        return false;
+    }
+    char temporary[strlen(m->checkpoint) + 5];
+    sprintf(temporary, "%s.tmp", m->checkpoint);
+    FILE* fp = fopen(temporary, "w");
+    if (fp == NULL) {
+        return false;
+    }
+    fprintf(fp, "mine %d\n%s %lu\n", MINE_VERSION, m->threes ? "vct" : "vcf", m->nodes);
+    fprintf(fp, "%lu %lu %lu %lu %lu %ld\n", m->games, m->unreadable, m->positions, m->puzzles, m->played,
+        ftell(m->index));
+    bool written = fclose(fp) == 0 && rename(temporary, m->checkpoint) == 0;
+    if (!written) {
+        remove(temporary);
+    }
+    m->saved = search_clock();
+    return written;
+}
+
+/**
+ * Writes the puzzles of a batch that are not rotations or reflections of puzzles written
+ * before, each to its own file and a line of the index.
+ * @param m The miner.
+ * @param b The batch.
+*/
+void static write_puzzles(miner* m, batch* b) {
+    for (size_t i = 0; i < b->puzzles_count; i++) {
+        const puzzle* p = &b->puzzles[i];
+        if (!set_add(&m->seen, p->canonical)) {
+            m->failed = m->failed || m->seen.keys == NULL;
+            continue;
+        }
+
+        char name[32];
+        char path[strlen(m->directory) + sizeof(name) + 1];
+        sprintf(name, MINE_NAME, ++m->puzzles);
+        sprintf(path, "%s/%s", m->directory, name);
+        const parse_record* r = &b->records[p->game];
+        FILE* fp = fopen(path, "w");
+        if (fp == NULL) {
+            m->write_failed = true;
+            continue;
+        }
+        fprintf(fp, "GA\n%u\n%d\n%d\n%d\n", r->size, r->type, GAME_STATE_STOPPED, EMPTY_INTERSECTION);
+        for (int k = 0; k < p->ply; k++) {
+            fprintf(fp, "%c%d\n", r->x[k] + 'A', r->y[k] + 1);
+        }
+        m->write_failed = fclose(fp) != 0 || m->write_failed;
+
+        fprintf(m->index, "%s %s %c%d", name, p->kind == DFPN_VCF ? "vcf" : "vct", p->x + 'A', p->y + 1);
+        if (p->played_x != SEARCH_NO_MOVE) {
+            fprintf(m->index, " %c%d", p->played_x + 'A', p->played_y + 1);
+        }
+        fprintf(m->index, "  # %016llx %s, %d plies, %s move %d\n", (unsigned long long)p->canonical,
+            p->played ? "played" : "missed", p->length, b->paths[p->game], p->ply + 1);
+        m->played += p->played;
+    }
+}
+
+/**
+ * The body of the writer thread: writes the puzzles of the batches in the order they were
+ * read, until the reader is done and every batch it read has been written.
+ * @param arg The miner.
+ * @return Nothing.
+*/
+void static* write_batches(void* arg) {
+    miner* m = arg;
+    pthread_mutex_lock(&m->lock);
+    while (true) {
+        while (m->slots[m->next % MINE_QUEUE] == NULL && !(m->closing && m->next == m->submitted)) {
+            pthread_cond_wait(&m->ready, &m->lock);
+        }
+        batch* b = m->slots[m->next % MINE_QUEUE];
+        if (b == NULL) {
+            break;
+        }
+        m->slots[m->next % MINE_QUEUE] = NULL;
+        m->next++;
+        pthread_cond_broadcast(&m->space);
+        pthread_mutex_unlock(&m->lock);
+
+        if (b->records != NULL) {
+            write_puzzles(m, b);
+        }
+        m->games += b->count;
+        m->unreadable += b->unreadable;
+        m->positions += b->positions;
+        m->searched += b->searched;
+        m->failed = m->failed || b->failed;
+        if (m->checkpoint != NULL && search_clock() - m->saved >= MINE_CHECKPOINT_MS && !save_checkpoint(m)) {
+            m->write_failed = true;
+        }
+        for (int i = 0; i < b->count; i++) {
+            free(b->paths[i]);
+        }
+        free(b->records);
+        free(b->puzzles);
+        free(b);
+
+        pthread_mutex_lock(&m->lock);
+    }
+    pthread_mutex_unlock(&m->lock);
+    return NULL;
+}
+
+/**
+ * Hands the batch being filled to the pool.
+ * @param m The miner.
+*/
+void static submit_batch(miner* m) {
+    batch* b = m->current;
+    m->current = NULL;
+    pthread_mutex_lock(&m->lock);
+    b->seq = m->submitted++;
+    pthread_mutex_unlock(&m->lock);
+    if (!pool_submit(m->p, run_batch, b)) {
+        exit(NULL_POINTER_ERR);
+    }
+}
+
+/**
+ * Reads a game into the batch being filled, handing the batch to the pool once it is full.
+ * The games a checkpoint covers and the games past the limit are passed over.
+ * @param arg The miner.
+ * @param path The path of the game.
+ * @param data The contents of the game if it is already in memory, or NULL to read the path.
+ * @param length The length of the contents.
+*/
+void static add_game(void* arg, char* path, char* data, size_t length) {
+    miner* m = arg;
+    m->read++;
+    if (m->read <= m->skip || (m->limit > 0 && m->read > m->skip + m->limit)) {
+        free(path);
+        free(data);
+        return;
+    }
+    if (m->current == NULL) {
+        m->current = calloc(1, sizeof(batch));
+        if (m->current == NULL) {
+            exit(NULL_POINTER_ERR);
+        }
+        m->current->m = m;
+    }
+
+    if (data == NULL) {
+        data = source_read_file(path, &length);
+    }
+    batch* b = m->current;
+    b->paths[b->count] = path;
+    b->data[b->count] = data;
+    b->lengths[b->count] = length;
+    b->count++;
+    if (b->count == MINE_BATCH) {
+        submit_batch(m);
+    }
+}
+
+/**
+ * Reports a path that cannot be read.
+ * @param arg The miner.
+ * @param path The path.
+ * @param reason Why it cannot be read.
+*/
+void static read_error(void* arg, const char* path, unsigned char reason) {
+    miner* m = arg;
+    if (reason == SOURCE_TRUNCATED) {
+        fprintf(stderr, "Cannot read all of %s\n", path);
+    } else {
+        fprintf(stderr, "Cannot read %s\n", path);
+    }
+    if (reason == SOURCE_MISSING) {
+        m->missing++;
+    }
+}
+
+/**
+ * Picks up from a checkpoint: the counts, the games to pass over, and the index, which is cut
+ * back to where the checkpoint was saved and read for the puzzles already written.
+ * @param m The miner.
+ * @param index The path of the index.
+ * @return SUCCESS, or the exit code if the checkpoint does not fit the run.
+*/
+int static resume(miner* m, const char* index) {
+    FILE* fp = fopen(m->checkpoint, "r");
+    if (fp == NULL) {
+        return errno == ENOENT ? SUCCESS : FILE_INPUT_ERR;
+    }
+    int version = 0;
+    char mode[8] = "";
+    unsigned long nodes = 0;
+    long offset = 0;
+    int fields = fscanf(fp, "mine %d %7s %lu %lu %lu %lu %lu %lu %ld", &version, mode, &nodes, &m->games,
+        &m->unreadable, &m->positions, &m->puzzles, &m->played, &offset);
+    fclose(fp);
+    if (fields != 9 || version != MINE_VERSION) {
+        fprintf(stderr, "Cannot read the checkpoint %s\n", m->checkpoint);
+        return FILE_INPUT_ERR;
+    }
+    if (strcmp(mode, m->threes ? "vct" : "vcf") != 0 || nodes != m->nodes) {
+        fprintf(stderr, "The checkpoint %s is for -n %lu%s\n", m->checkpoint, nodes, strcmp(mode, "vcf") == 0 ? " -f" : "");
+        return ARGUMENT_ERR;
+    }
+
+    if (truncate(index, offset) != 0) {
+        fprintf(stderr, "Cannot read %s\n", index);
+        return FILE_INPUT_ERR;
+    }
+    fp = fopen(index, "r");
+    char line[4096];
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        char* comment = strstr(line, "# ");
+        unsigned long long key;
+        if (comment != NULL && sscanf(comment, "# %16llx", &key) == 1 && !set_add(&m->seen, key)) {
+            m->failed = m->failed || m->seen.keys == NULL;
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+    m->skip = m->games;
+    return SUCCESS;
+}
+
+/**
+ * The main function: mines the saved games given on the command line for puzzles.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    miner* m = calloc(1, sizeof(miner));
+    if (m == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    m->threes = true;
+    m->nodes = MINE_NODES;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-f") == 0) {
+            m->threes = false;
+            first++;
+        } else if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+        } else if (strcmp(argv[first], "-j") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            threads = atoi(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-n") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            m->nodes = strtoul(argv[first + 1], NULL, 10);
+            first += 2;
+        } else if (strcmp(argv[first], "-l") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            m->limit = strtoul(argv[first + 1], NULL, 10);
+            first += 2;
+        } else if (strcmp(argv[first], "-c") == 0 && first + 1 < argc) {
+            m->checkpoint = argv[first + 1];
+            first += 2;
+        } else if (strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+            m->directory = argv[first + 1];
+            first += 2;
+        } else {
+            first = argc;
+        }
+    }
+    if (first >= argc || m->directory == NULL) {
+        fprintf(stdout, "usage: %s [-j threads] [-n nodes] [-f] [-c checkpoint] [-l games] [-q] -o directory "
+            "<saved-match.gmk|directory|archive.tar>...\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // Set up the output, picking up from the checkpoint if there is one.
+    char index[strlen(m->directory) + sizeof(MINE_INDEX) + 1];
+    sprintf(index, "%s/%s", m->directory, MINE_INDEX);
+    m->seen.keys = calloc(1024, sizeof(uint64_t));
+    m->seen.mask = 1023;
+    m->cache = calloc(MINE_CACHE, sizeof(solved_slot));
+    m->solvers = calloc(threads, sizeof(dfpn*));
+    if (m->seen.keys == NULL || m->cache == NULL || m->solvers == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    if (mkdir(m->directory, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Cannot write %s\n", m->directory);
+        return FILE_OUTPUT_ERR;
+    }
+    bool resumed = false;
+    if (m->checkpoint != NULL) {
+        int status = resume(m, index);
+        if (status != SUCCESS) {
+            return status;
+        }
+        resumed = m->skip > 0;
+    }
+    m->index = fopen(index, resumed ? "a" : "w");
+    if (m->index == NULL) {
+        fprintf(stderr, "Cannot write %s\n", index);
+        return FILE_OUTPUT_ERR;
+    }
+
+    // Each worker gets a table sized to the budget, since the solver clears it on every solve.
+    size_t bytes = 4 * m->nodes * sizeof(dfpn_entry);
+    for (int i = 0; i < threads; i++) {
+        if ((m->solvers[i] = dfpn_create(bytes)) == NULL) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->ready, NULL);
+    pthread_cond_init(&m->space, NULL);
+    m->p = pool_create(threads);
+    pthread_t writer;
+    if (m->p == NULL || pthread_create(&writer, NULL, write_batches, m) != 0) {
+        return NULL_POINTER_ERR;
+    }
+
+    // Read everything, handing the games to the pool in batches, then let the writer finish.
+    unsigned long before = m->positions;
+    long long start = search_clock();
+    m->saved = start;
+    source_visitor v = {add_game, read_error, m};
+    for (int i = first; i < argc; i++) {
+        if (!source_walk(argv[i], true, &v)) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    if (m->current != NULL) {
+        submit_batch(m);
+    }
+    pool_wait(m->p);
+    pool_delete(m->p);
+    pthread_mutex_lock(&m->lock);
+    m->closing = true;
+    pthread_cond_signal(&m->ready);
+    pthread_mutex_unlock(&m->lock);
+    pthread_join(writer, NULL);
+    long long elapsed = search_clock() - start;
+
+    if (m->failed) {
+        return NULL_POINTER_ERR;
+    }
+    bool written = !m->write_failed && (m->checkpoint == NULL || save_checkpoint(m));
+    if (fclose(m->index) != 0 || !written) {
+        fprintf(stderr, "Cannot write %s\n", m->directory);
+        return FILE_OUTPUT_ERR;
+    }
+
+    if (resumed) {
+        printf("Resumed after:       %lu games\n", m->skip);
+    }
+    printf("Games:               %lu\n", m->games + m->missing);
+    printf("Unreadable:          %lu\n", m->unreadable + m->missing);
+    printf("Positions:           %lu\n", m->positions);
+    printf("Puzzles:             %lu, %lu played and %lu missed, in %s\n", m->puzzles, m->played,
+        m->puzzles - m->played, m->directory);
+    if (!quiet) {
+        unsigned long mined = m->positions - before;
+        printf("\n%lu positions in %lld ms, %.0f positions/sec, %lu searched\n", mined, elapsed,
+            elapsed > 0 ? mined * 1000.0 / elapsed : 0.0, m->searched);
+    }
+
+    for (int i = 0; i < threads; i++) {
+        dfpn_delete(m->solvers[i]);
+    }
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->ready);
+    pthread_cond_destroy(&m->space);
+    free(m->solvers);
+    free(m->cache);
+    free(m->seen.keys);
+    free(m);
+    return SUCCESS;
+}
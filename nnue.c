@@ -0,0 +1,375 @@
+/**
+ * @file nnue.c
+ * @author Faris Soliman
+ * This file contains the neural network evaluator, an efficiently updatable network in the
+ * style of the ones chess engines use. Its first layer has one input for every intersection
+ * and color, seen from each side: "my stone here" and "their stone here", plus one input for
+ * playing black and one for renju. Only the inputs of the stones on the board are ever set, so
+ * the first layer of each side is a sum of weight columns, which is kept in an accumulator and
+ * updated with one column add or subtract whenever a stone is placed or taken back.
+ *
+ * An evaluation clips both accumulators to 0..127, the side to move first, and runs them
+ * through a small layer of 32 clipped neurons and a linear output, all in 8-bit weights and
+ * 32-bit sums. Like the pattern scanner, the layers are written for AVX2 and plain C, and the
+ * widest kernel the processor supports is picked at run time.
+ *
+ * The weights are stored as an nnue_weights struct in native byte order, which is mapped with
+ * mmap and used in place, so loading a network costs nothing and every process using the same
+ * file shares its pages.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "cpu.h"
+#include "game.h"
+#include "nnue.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NNUE_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*nnue_column)(int16_t* values, const int16_t* column);
+typedef int32_t (*nnue_forward)(const nnue_weights* w, const int16_t* own, const int16_t* other);
+
+/**
+ * Starts a network with every weight zero.
+ * @param w The weights.
+ * @param output_scale The score of an output of 1.0.
+*/
+void nnue_init(nnue_weights* w, int32_t output_scale) {
+    memset(w, 0, sizeof(nnue_weights));
+    memcpy(w->header.magic, NNUE_MAGIC, sizeof(w->header.magic));
+    w->header.version = NNUE_VERSION;
+    w->header.inputs = NNUE_INPUTS;
+    w->header.hidden = NNUE_HIDDEN;
+    w->header.layer = NNUE_LAYER;
+    w->header.output_scale = output_scale;
+}
+
+/**
+ * Writes a network to a temporary file next to its path, then renames it over the path.
+ * @param path The path to the network.
+ * @param w The weights.
+ * @return Whether the network is in place.
+*/
+bool nnue_write(const char* path, const nnue_weights* w) {
+    char* temporary = malloc(strlen(path) + 5);
+    if (temporary == NULL) {
+        return false;
+    }
+    sprintf(temporary, "%s.tmp", path);
+
+    FILE* fp = fopen(temporary, "wb");
+    bool ok = fp != NULL && fwrite(w, sizeof(nnue_weights), 1, fp) == 1 && fflush(fp) == 0;
+    ok = fp != NULL && fclose(fp) == 0 && ok && rename(temporary, path) == 0;
+    if (!ok) {
+        unlink(temporary);
+    }
+    free(temporary);
+    return ok;
+}
+
+/**
+ * Opens a network by mapping it.
+ * @param path The path to the network.
+ * @return The network, or NULL if it could not be opened or mapped or was written for other
+ *         layer sizes.
+*/
+nnue_network* nnue_load(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    nnue_header header;
+    if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, NNUE_MAGIC, sizeof(header.magic)) != 0 || header.version != NNUE_VERSION ||
+        header.inputs != NNUE_INPUTS || header.hidden != NNUE_HIDDEN || header.layer != NNUE_LAYER ||
+        (size_t)st.st_size != sizeof(nnue_weights)) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    nnue_network* n = map == MAP_FAILED ? NULL : malloc(sizeof(nnue_network));
+    if (n == NULL) {
+        if (map != MAP_FAILED) {
+            munmap(map, st.st_size);
+        }
+        return NULL;
+    }
+
+    n->w = map;
+    n->length = st.st_size;
+    return n;
+}
+
+/**
+ * Closes a network.
+ * @param n The network, or NULL.
+*/
+void nnue_close(nnue_network* n) {
+    if (n == NULL) {
+        return;
+    }
+
+    munmap((void*)n->w, n->length);
+    free(n);
+}
+
+/**
+ * Gets the input of a stone as one side sees it. Intersections are numbered on the largest
+ * board, so every board size shares the weights of its top left corner.
+ * @param perspective The side, 0 for black and 1 for white.
+ * @param stone The color of the stone.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The input.
+*/
+int nnue_feature(unsigned char perspective, unsigned char stone, unsigned char x, unsigned char y) {
+    bool own = stone - BLACK_STONE == perspective;
+    return (own ? 0 : NNUE_CELLS) + y * PATTERN_MAX_SIZE + x;
+}
+
+/**
+ * Clips an accumulator value to the input range of the second layer.
+ * @param v The value.
+ * @return The value clipped to 0..NNUE_CLIP.
+*/
+static inline uint8_t clip(int32_t v) {
+    return v < 0 ? 0 : v > NNUE_CLIP ? NNUE_CLIP : v;
+}
+
+/**
+ * Adds a weight column to an accumulator.
+ * @param values The accumulator.
+ * @param column The column.
+*/
+void static add_scalar(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        values[i] += column[i];
+    }
+}
+
+/**
+ * Subtracts a weight column from an accumulator.
+ * @param values The accumulator.
+ * @param column The column.
+*/
+void static sub_scalar(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        values[i] -= column[i];
+    }
+}
+
+/**
+ * Runs the layers after the accumulators.
+ * @param w The weights.
+ * @param own The accumulator of the side to move.
+ * @param other The accumulator of the other side.
+ * @return The raw output, NNUE_SCALE_FEATURE * NNUE_SCALE_WEIGHT for 1.0.
+*/
+int32_t static forward_scalar(const nnue_weights* w, const int16_t* own, const int16_t* other) {
+    uint8_t input[2 * NNUE_HIDDEN];
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        input[i] = clip(own[i]);
+        input[NNUE_HIDDEN + i] = clip(other[i]);
+    }
+
+    int32_t out = w->output_bias;
+    for (int j = 0; j < NNUE_LAYER; j++) {
+        int32_t sum = w->hidden_bias[j];
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++) {
+            sum += w->hidden_weights[j][i] * input[i];
+        }
+        out += w->output_weights[j] * clip(sum >> NNUE_SHIFT);
+    }
+    return out;
+}
+
+#ifdef NNUE_X86
+/**
+ * Adds a weight column to an accumulator, 16 values at a time.
+ * @param values The accumulator.
+ * @param column The column.
+*/
+__attribute__((target("avx2")))
+void static add_avx2(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (values + i));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (column + i));
+        _mm256_storeu_si256((__m256i*) (values + i), _mm256_add_epi16(v, c));
+    }
+}
+
+/**
+ * Subtracts a weight column from an accumulator, 16 values at a time.
+ * @param values The accumulator.
+ * @param column The column.
+*/
+__attribute__((target("avx2")))
+void static sub_avx2(int16_t* values, const int16_t* column) {
+    for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (values + i));
+        __m256i c = _mm256_loadu_si256((const __m256i*) (column + i));
+        _mm256_storeu_si256((__m256i*) (values + i), _mm256_sub_epi16(v, c));
+    }
+}
+
+/**
+ * Clips 32 accumulator values to bytes, in order.
+ * @param values The values.
+ * @return The clipped values.
+*/
+__attribute__((target("avx2"), always_inline))
+static inline __m256i clip_avx2(const int16_t* values) {
+    __m256i lo = _mm256_loadu_si256((const __m256i*) values);
+    __m256i hi = _mm256_loadu_si256((const __m256i*) (values + 16));
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xD8);
+    return _mm256_max_epi8(packed, _mm256_setzero_si256());
+}
+
+/**
+ * Runs the layers after the accumulators with byte dot products: every multiply-add of 32
+ * clipped inputs and 32 weights gives 16 sums of two products, which cannot overflow since
+ * both factors are at most 127, and which are then widened and added up in 32 bits.
+ * @param w The weights.
+ * @param own The accumulator of the side to move.
+ * @param other The accumulator of the other side.
+ * @return The raw output, NNUE_SCALE_FEATURE * NNUE_SCALE_WEIGHT for 1.0.
+*/
+__attribute__((target("avx2")))
+int32_t static forward_avx2(const nnue_weights* w, const int16_t* own, const int16_t* other) {
+    __m256i input[2 * NNUE_HIDDEN / 32];
+    for (int i = 0; i < NNUE_HIDDEN / 32; i++) {
+        input[i] = clip_avx2(own + 32 * i);
+        input[NNUE_HIDDEN / 32 + i] = clip_avx2(other + 32 * i);
+    }
+
+    __m256i ones = _mm256_set1_epi16(1);
+    int32_t out = w->output_bias;
+    for (int j = 0; j < NNUE_LAYER; j++) {
+        __m256i sum = _mm256_setzero_si256();
+        for (int i = 0; i < 2 * NNUE_HIDDEN / 32; i++) {
+            __m256i weights = _mm256_loadu_si256((const __m256i*) (w->hidden_weights[j] + 32 * i));
+            __m256i pairs = _mm256_maddubs_epi16(input[i], weights);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+        }
+        __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+        half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+        int32_t total = w->hidden_bias[j] + _mm_cvtsi128_si32(half);
+        out += w->output_weights[j] * clip(total >> NNUE_SHIFT);
+    }
+    return out;
+}
+#endif
+
+typedef struct {
+    const char* name;
+    nnue_column add;
+    nnue_column sub;
+    nnue_forward forward;
+} kernel_entry;
+
+static const kernel_entry kernels[] = {
+#ifdef NNUE_X86
+    {"avx2", add_avx2, sub_avx2, forward_avx2},
+#endif
+    {"scalar", add_scalar, sub_scalar, forward_scalar},
+};
+
+static const void* active = NULL;
+
+/**
+ * Gets the kernel in use, picking the widest one the processor supports the first time.
+ * @return The kernel.
+*/
+static const kernel_entry* kernel_select(void) {
+    return cpu_select(&active, kernels, sizeof(kernels) / sizeof(kernels[0]), sizeof(kernels[0]));
+}
+
+/**
+ * Gets the name of the kernel the evaluator dispatches to.
+ * @return The kernel name, "avx2" or "scalar".
+*/
+const char* nnue_kernel(void) {
+    return kernel_select()->name;
+}
+
+/**
+ * Forces the evaluator to use a kernel, mostly for benchmarks and cross checks.
+ * @param name The kernel name.
+ * @return Whether the kernel exists and is supported by the processor.
+*/
+bool nnue_use_kernel(const char* name) {
+    return cpu_use(&active, kernels, sizeof(kernels) / sizeof(kernels[0]), sizeof(kernels[0]), name);
+}
+
+/**
+ * Computes both accumulators of a position from scratch.
+ * @param s The accumulators to set up.
+ * @param n The network.
+ * @param b The board.
+ * @param game_type The rule set.
+*/
+void nnue_refresh(nnue_state* s, const nnue_network* n, board* b, unsigned char game_type) {
+    const kernel_entry* k = kernel_select();
+    s->net = n;
+    for (int p = 0; p < 2; p++) {
+        memcpy(s->values[p], n->w->feature_bias, sizeof(s->values[p]));
+        if (p == 0) {
+            k->add(s->values[p], n->w->feature_weights[NNUE_FEATURE_BLACK]);
+        }
+        if (game_type == GAME_RENJU) {
+            k->add(s->values[p], n->w->feature_weights[NNUE_FEATURE_RENJU]);
+        }
+    }
+    for (unsigned char y = 0; y < b->size; y++) {
+        for (unsigned char x = 0; x < b->size; x++) {
+            unsigned char stone = b->grid[y * b->size + x];
+            if (stone != EMPTY_INTERSECTION) {
+                nnue_update(s, x, y, stone, 1);
+            }
+        }
+    }
+}
+
+/**
+ * Puts a stone into or takes it out of both accumulators.
+ * @param s The accumulators.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @param stone The color of the stone.
+ * @param sign 1 when the stone is placed, -1 when it is taken back.
+*/
+void nnue_update(nnue_state* s, unsigned char x, unsigned char y, unsigned char stone, int sign) {
+    const kernel_entry* k = kernel_select();
+    nnue_column apply = sign > 0 ? k->add : k->sub;
+    for (int p = 0; p < 2; p++) {
+        apply(s->values[p], s->net->w->feature_weights[nnue_feature(p, stone, x, y)]);
+    }
+}
+
+/**
+ * Evaluates a position from one color's point of view.
+ * @param s The accumulators of the position.
+ * @param stone The color to move, which the network scores for.
+ * @return The score, positive when the color is better, within NNUE_MAX_SCORE.
+*/
+int nnue_evaluate(const nnue_state* s, unsigned char stone) {
+    const nnue_weights* w = s->net->w;
+    int p = stone - BLACK_STONE;
+    int32_t out = kernel_select()->forward(w, s->values[p], s->values[1 - p]);
+    long long score = (long long)out * w->header.output_scale / (NNUE_SCALE_FEATURE * NNUE_SCALE_WEIGHT);
+    return score > NNUE_MAX_SCORE ? NNUE_MAX_SCORE : score < -NNUE_MAX_SCORE ? -NNUE_MAX_SCORE : score;
+}
@@ -0,0 +1,63 @@
+#ifndef _NNUE_H_
+#define _NNUE_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+#include "pattern.h"
+#define NNUE_MAGIC "GMKNNUE"
+#define NNUE_VERSION 1
+#define NNUE_CELLS (PATTERN_MAX_SIZE * PATTERN_MAX_SIZE)
+#define NNUE_FEATURE_BLACK (2 * NNUE_CELLS)
+#define NNUE_FEATURE_RENJU (2 * NNUE_CELLS + 1)
+#define NNUE_INPUTS (2 * NNUE_CELLS + 2)
+#define NNUE_HIDDEN 128
+#define NNUE_LAYER 32
+#define NNUE_CLIP 127
+#define NNUE_SCALE_FEATURE 127
+#define NNUE_SCALE_WEIGHT 64
+#define NNUE_SHIFT 6
+#define NNUE_OUTPUT_SCALE 400
+#define NNUE_MAX_SCORE 100000
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t inputs;
+    uint32_t hidden;
+    uint32_t layer;
+    int32_t output_scale;
+    uint32_t reserved[9];
+} nnue_header;
+
+typedef struct {
+    nnue_header header;
+    int16_t feature_weights[NNUE_INPUTS][NNUE_HIDDEN];
+    int16_t feature_bias[NNUE_HIDDEN];
+    int8_t hidden_weights[NNUE_LAYER][2 * NNUE_HIDDEN];
+    int32_t hidden_bias[NNUE_LAYER];
+    int8_t output_weights[NNUE_LAYER];
+    int32_t output_bias;
+} nnue_weights;
+
+typedef struct {
+    const nnue_weights* w;
+    size_t length;
+} nnue_network;
+
+typedef struct {
+    const nnue_network* net;
+    int16_t values[2][NNUE_HIDDEN];
+} nnue_state;
+
+void nnue_init(nnue_weights* w, int32_t output_scale);
+bool nnue_write(const char* path, const nnue_weights* w);
+nnue_network* nnue_load(const char* path);
+void nnue_close(nnue_network* n);
+int nnue_feature(unsigned char perspective, unsigned char stone, unsigned char x, unsigned char y);
+void nnue_refresh(nnue_state* s, const nnue_network* n, board* b, unsigned char game_type);
+void nnue_update(nnue_state* s, unsigned char x, unsigned char y, unsigned char stone, int sign);
+int nnue_evaluate(const nnue_state* s, unsigned char stone);
+const char* nnue_kernel(void);
+bool nnue_use_kernel(const char* name);
+#endif
@@ -0,0 +1,421 @@
+/**
+ * @file packed.c
+ * @author Faris Soliman
+ * This file contains the packed position: a board at two bits per intersection, with its size,
+ * rule set and color to move in one more byte, 92 bytes for any board up to 19x19 instead of
+ * the byte per intersection of a board grid. Bits past the last intersection are always zero,
+ * so two packed positions are equal exactly when their bytes are, and they sort, compare and
+ * hash as plain bytes.
+ *
+ * Large sets of positions are kept on the disk as sorted arrays without duplicates behind a
+ * small header, which are mapped with mmap and searched in place. Sets too big to sort in
+ * memory are sorted in parts, written one file per part and merged.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "error-codes.h"
+#include "game.h"
+#include "hash.h"
+#include "packed.h"
+
+typedef struct {
+    FILE* file;
+    char* temporary;
+    packed_header header;
+    packed_position last;
+} packed_writer;
+
+/**
+ * Starts a packed position.
+ * @param p The position.
+ * @param size The board size.
+ * @param game_type The rule set.
+ * @param stone The color to move.
+*/
+void packed_init(packed_position* p, unsigned char size, unsigned char game_type, unsigned char stone) {
+    memset(p, 0, sizeof(packed_position));
+    p->meta = (size & PACKED_SIZE_MASK) | (game_type == GAME_RENJU ? PACKED_RENJU : 0);
+    packed_set_stone(p, stone);
+}
+
+/**
+ * Gets the board size of a packed position.
+ * @param p The position.
+ * @return The board size.
+*/
+unsigned char packed_size(const packed_position* p) {
+    return p->meta & PACKED_SIZE_MASK;
+}
+
+/**
+ * Gets the rule set of a packed position.
+ * @param p The position.
+ * @return GAME_FREESTYLE or GAME_RENJU.
+*/
+unsigned char packed_type(const packed_position* p) {
+    return p->meta & PACKED_RENJU ? GAME_RENJU : GAME_FREESTYLE;
+}
+
+/**
+ * Gets the color to move in a packed position.
+ * @param p The position.
+ * @return BLACK_STONE or WHITE_STONE.
+*/
+unsigned char packed_stone(const packed_position* p) {
+    return p->meta & PACKED_WHITE ? WHITE_STONE : BLACK_STONE;
+}
+
+/**
+ * Sets the color to move in a packed position.
+ * @param p The position.
+ * @param stone BLACK_STONE or WHITE_STONE.
+*/
+void packed_set_stone(packed_position* p, unsigned char stone) {
+    p->meta = (p->meta & ~PACKED_WHITE) | (stone == WHITE_STONE ? PACKED_WHITE : 0);
+}
+
+/**
+ * Gets the stone on an intersection of a packed position.
+ * @param p The position.
+ * @param index The index of the intersection in the board grid.
+ * @return The stone, or EMPTY_INTERSECTION.
+*/
+unsigned char packed_get(const packed_position* p, int index) {
+    return (p->cells[index >> 2] >> ((index & 3) * 2)) & 3;
+}
+
+/**
+ * Puts a stone on, or takes it off, an intersection of a packed position.
+ * @param p The position.
+ * @param index The index of the intersection in the board grid.
+ * @param stone The stone, or EMPTY_INTERSECTION.
+*/
+void packed_set(packed_position* p, int index, unsigned char stone) {
+    int shift = (index & 3) * 2;
+    p->cells[index >> 2] = (p->cells[index >> 2] & ~(3 << shift)) | (stone & 3) << shift;
+}
+
+/**
+ * Packs a board, four intersections to a byte.
+ * @param p Where to put the packed position.
+ * @param b The board.
+ * @param game_type The rule set.
+ * @param stone The color to move.
+*/
+void packed_pack(packed_position* p, board* b, unsigned char game_type, unsigned char stone) {
+    packed_init(p, b->size, game_type, stone);
+    const unsigned char* g = b->grid;
+    int cells = b->size * b->size;
+    int full = cells / 4;
+    for (int i = 0; i < full; i++, g += 4) {
+        uint32_t v = g[0] | g[1] << 8 | g[2] << 16 | (uint32_t)g[3] << 24;
+        p->cells[i] = (v | v >> 6 | v >> 12 | v >> 18) & 0xFF;
+    }
+    for (int i = full * 4; i < cells; i++) {
+        packed_set(p, i, b->grid[i]);
+    }
+}
+
+/**
+ * Unpacks a packed position onto a board of its size.
+ * @param p The position.
+ * @param b The board.
+ * @return SUCCESS, BOARD_SIZE_ERR if the board is not the size of the position, or
+ *         STONE_TYPE_ERR if the position holds something that is not a stone.
+*/
+unsigned char packed_unpack(const packed_position* p, board* b) {
+    if (b->size != packed_size(p)) {
+        return BOARD_SIZE_ERR;
+    }
+
+    unsigned char* g = b->grid;
+    int cells = b->size * b->size;
+    int full = cells / 4;
+    unsigned char invalid = 0;
+    for (int i = 0; i < full; i++, g += 4) {
+        unsigned char v = p->cells[i];
+        invalid |= v & v >> 1 & 0x55;
+        g[0] = v & 3;
+        g[1] = v >> 2 & 3;
+        g[2] = v >> 4 & 3;
+        g[3] = v >> 6;
+    }
+    for (int i = full * 4; i < cells; i++) {
+        b->grid[i] = packed_get(p, i);
+        invalid |= b->grid[i] == 3;
+    }
+    return invalid ? STONE_TYPE_ERR : SUCCESS;
+}
+
+/**
+ * Checks if two packed positions are the same.
+ * @param a The first position.
+ * @param b The second position.
+ * @return Whether they are the same.
+*/
+bool packed_equal(const packed_position* a, const packed_position* b) {
+    return memcmp(a, b, sizeof(packed_position)) == 0;
+}
+
+/**
+ * Orders two packed positions, by their bytes.
+ * @param a The first position.
+ * @param b The second position.
+ * @return Less than, equal to or greater than 0 as a sorts before, with or after b.
+*/
+int packed_compare(const packed_position* a, const packed_position* b) {
+    return memcmp(a, b, sizeof(packed_position));
+}
+
+/**
+ * Hashes a packed position.
+ * @param p The position.
+ * @return The hash.
+*/
+uint64_t packed_hash(const packed_position* p) {
+    return hash_bytes(p, sizeof(packed_position));
+}
+
+/**
+ * Compares two packed positions for qsort().
+ * @param a The first position.
+ * @param b The second position.
+ * @return The order.
+*/
+int static compare_positions(const void* a, const void* b) {
+    return packed_compare(a, b);
+}
+
+/**
+ * Sorts packed positions and drops the duplicates.
+ * @param positions The positions.
+ * @param count The number of positions.
+ * @return The number of distinct positions, which are now at the front.
+*/
+size_t packed_sort(packed_position* positions, size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    qsort(positions, count, sizeof(packed_position), compare_positions);
+    size_t n = 1;
+    for (size_t i = 1; i < count; i++) {
+        if (!packed_equal(&positions[i], &positions[n - 1])) {
+            positions[n++] = positions[i];
+        }
+    }
+    return n;
+}
+
+/**
+ * Starts writing a sorted array to a temporary file next to its path.
+ * @param w The writer.
+ * @param path The path to the array.
+ * @return Whether the file could be created.
+*/
+bool static writer_open(packed_writer* w, const char* path) {
+    w->temporary = malloc(strlen(path) + 5);
+    if (w->temporary == NULL) {
+        return false;
+    }
+    sprintf(w->temporary, "%s.tmp", path);
+
+    memset(&w->header, 0, sizeof(packed_header));
+    memcpy(w->header.magic, PACKED_MAGIC, sizeof(w->header.magic));
+    w->header.version = PACKED_VERSION;
+    w->header.record_size = sizeof(packed_position);
+    w->file = fopen(w->temporary, "wb");
+    if (w->file == NULL || fwrite(&w->header, sizeof(packed_header), 1, w->file) != 1) {
+        if (w->file != NULL) {
+            fclose(w->file);
+            unlink(w->temporary);
+        }
+        free(w->temporary);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the next position of a sorted array. A position equal to the last one is skipped.
+ * @param w The writer.
+ * @param p The position.
+ * @return Whether it was written, or false if it was out of order or could not be written.
+*/
+bool static writer_add(packed_writer* w, const packed_position* p) {
+    if (w->header.count > 0) {
+        int order = packed_compare(p, &w->last);
+        if (order == 0) {
+            return true;
+        }
+        if (order < 0) {
+            return false;
+        }
+    }
+    if (fwrite(p, sizeof(packed_position), 1, w->file) != 1) {
+        return false;
+    }
+    w->last = *p;
+    w->header.count++;
+    return true;
+}
+
+/**
+ * Finishes a sorted array: fills in the count, forces it to the disk and renames it over the
+ * path, or throws it away.
+ * @param w The writer.
+ * @param path The path to the array.
+ * @param ok Whether every position was written.
+ * @return Whether the array is in place.
+*/
+bool static writer_close(packed_writer* w, const char* path, bool ok) {
+    ok = ok && fseek(w->file, 0, SEEK_SET) == 0 &&
+        fwrite(&w->header, sizeof(packed_header), 1, w->file) == 1 &&
+        fflush(w->file) == 0 && fsync(fileno(w->file)) == 0;
+    ok = fclose(w->file) == 0 && ok && rename(w->temporary, path) == 0;
+    if (!ok) {
+        unlink(w->temporary);
+    }
+    free(w->temporary);
+    return ok;
+}
+
+/**
+ * Writes a sorted array of packed positions, as left by packed_sort().
+ * @param path The path to the array.
+ * @param positions The positions, in order.
+ * @param count The number of positions.
+ * @return Whether it was written, or false if the positions are out of order.
+*/
+bool packed_write(const char* path, const packed_position* positions, size_t count) {
+    packed_writer w;
+    if (!writer_open(&w, path)) {
+        return false;
+    }
+    bool ok = true;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = writer_add(&w, &positions[i]);
+    }
+    return writer_close(&w, path, ok);
+}
+
+/**
+ * Opens a sorted array of packed positions by mapping it.
+ * @param path The path to the array.
+ * @return The array, or NULL if it could not be opened or mapped or is not an array of this
+ *         version.
+*/
+packed_file* packed_open(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    packed_header header;
+    if (fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, PACKED_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != PACKED_VERSION || header.record_size != sizeof(packed_position) ||
+        (uint64_t)st.st_size != sizeof(packed_header) + header.count * sizeof(packed_position)) {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    packed_file* f = map == MAP_FAILED ? NULL : malloc(sizeof(packed_file));
+    if (f == NULL) {
+        if (map != MAP_FAILED) {
+            munmap(map, st.st_size);
+        }
+        close(fd);
+        return NULL;
+    }
+
+    f->fd = fd;
+    f->length = st.st_size;
+    f->header = map;
+    f->positions = (const packed_position*)((char*)map + sizeof(packed_header));
+    f->count = header.count;
+    return f;
+}
+
+/**
+ * Closes a sorted array of packed positions.
+ * @param f The array, or NULL.
+*/
+void packed_close(packed_file* f) {
+    if (f == NULL) {
+        return;
+    }
+
+    munmap(f->header, f->length);
+    close(f->fd);
+    free(f);
+}
+
+/**
+ * Looks up a position in a sorted array by binary search.
+ * @param f The array.
+ * @param p The position.
+ * @param index Where to put its index in the array, or NULL.
+ * @return Whether the position is in the array.
+*/
+bool packed_find(const packed_file* f, const packed_position* p, uint64_t* index) {
+    uint64_t lo = 0;
+    uint64_t hi = f->count;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        int order = packed_compare(&f->positions[mid], p);
+        if (order == 0) {
+            if (index != NULL) {
+                *index = mid;
+            }
+            return true;
+        }
+        if (order < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+/**
+ * Merges sorted arrays of packed positions into one, dropping the positions they share.
+ * @param path The path to the merged array, which may not be one of the inputs.
+ * @param inputs The arrays to merge.
+ * @param count The number of arrays.
+ * @return Whether the merged array was written, or false if an input is out of order.
+*/
+bool packed_merge(const char* path, packed_file** inputs, int count) {
+    uint64_t* next = calloc(count > 0 ? count : 1, sizeof(uint64_t));
+    packed_writer w;
+    if (next == NULL || !writer_open(&w, path)) {
+        free(next);
+        return false;
+    }
+
+    bool ok = true;
+    while (ok) {
+        int smallest = -1;
+        for (int i = 0; i < count; i++) {
+            if (next[i] < inputs[i]->count && (smallest < 0 ||
+                packed_compare(&inputs[i]->positions[next[i]], &inputs[smallest]->positions[next[smallest]]) < 0)) {
+                smallest = i;
+            }
+        }
+        if (smallest < 0) {
+            break;
+        }
+        ok = writer_add(&w, &inputs[smallest]->positions[next[smallest]]);
+        next[smallest]++;
+    }
+    free(next);
+    return writer_close(&w, path, ok);
+}
@@ -0,0 +1,54 @@
+#ifndef _PACKED_H_
+#define _PACKED_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "board.h"
+#include "pattern.h"
+#define PACKED_BYTES ((PATTERN_MAX_SIZE * PATTERN_MAX_SIZE + 3) / 4)
+#define PACKED_SIZE_MASK 0x1F
+#define PACKED_RENJU 0x20
+#define PACKED_WHITE 0x40
+#define PACKED_MAGIC "GMKPACK"
+#define PACKED_VERSION 1
+
+typedef struct {
+    unsigned char meta;
+    unsigned char cells[PACKED_BYTES];
+} packed_position;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t count;
+    uint64_t reserved[2];
+} packed_header;
+
+typedef struct {
+    int fd;
+    size_t length;
+    packed_header* header;
+    const packed_position* positions;
+    uint64_t count;
+} packed_file;
+
+void packed_init(packed_position* p, unsigned char size, unsigned char game_type, unsigned char stone);
+unsigned char packed_size(const packed_position* p);
+unsigned char packed_type(const packed_position* p);
+unsigned char packed_stone(const packed_position* p);
+void packed_set_stone(packed_position* p, unsigned char stone);
+unsigned char packed_get(const packed_position* p, int index);
+void packed_set(packed_position* p, int index, unsigned char stone);
+void packed_pack(packed_position* p, board* b, unsigned char game_type, unsigned char stone);
+unsigned char packed_unpack(const packed_position* p, board* b);
+bool packed_equal(const packed_position* a, const packed_position* b);
+int packed_compare(const packed_position* a, const packed_position* b);
+uint64_t packed_hash(const packed_position* p);
+size_t packed_sort(packed_position* positions, size_t count);
+bool packed_write(const char* path, const packed_position* positions, size_t count);
+packed_file* packed_open(const char* path);
+void packed_close(packed_file* f);
+bool packed_find(const packed_file* f, const packed_position* p, uint64_t* index);
+bool packed_merge(const char* path, packed_file** inputs, int count);
+#endif
@@ -0,0 +1,651 @@
+/**
+ * @file parse.c
+ * @author Faris Soliman
+ * This file contains the saved game parser. It reads a game straight out of a buffer, which is
+ * usually a file mapped with mmap, without copying it or going through stdio for every move.
+ * Besides the .gmk files game_export() writes it reads autosave journals, and the main line of
+ * SGF records (GM[4]) and of RenLib libraries, so games from other programs can be imported too.
+ *
+ * Nothing here exits the program. Bad input, which third party files have plenty of, is
+ * reported in a parse_error: the line it was found on, what was wrong with it and the code
+ * from error-codes.h a program would exit with. For a RenLib library or a journal, which are
+ * binary, the line is the number of the record in the file instead.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "error-codes.h"
+#include "journal.h"
+#include "parse.h"
+#define RENLIB_HEADER 20
+#define RENLIB_SIZE 15
+#define RENLIB_DOWN 0x80
+#define RENLIB_OLD_COMMENT 0x20
+#define RENLIB_COMMENT 0x08
+#define RENLIB_EXTENSION 0x01
+#define RENLIB_EXTENSION_LENGTH 4
+
+typedef struct {
+    const char* p;
+    const char* end;
+    int line;
+} scanner;
+
+/**
+ * Fills in an error.
+ * @param err Where to put the error, or NULL.
+ * @param code The code from error-codes.h.
+ * @param line The line the error was found on.
+ * @param reason What was wrong.
+ * @return false, so the caller can return the result.
+*/
+bool static fail(parse_error* err, int code, int line, const char* reason) {
+    if (err != NULL) {
+        err->code = code;
+        err->line = line;
+        snprintf(err->reason, sizeof(err->reason), "%s", reason);
+    }
+    return false;
+}
+
+/**
+ * Skips spaces, tabs and line breaks, counting the lines.
+ * @param s The scanner.
+*/
+void static skip_space(scanner* s) {
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\t' || *s->p == '\r' || *s->p == '\n')) {
+        if (*s->p == '\n') {
+            s->line++;
+        }
+        s->p++;
+    }
+}
+
+/**
+ * Reads a decimal number.
+ * @param s The scanner, moved past the number.
+ * @param value Where to put the number.
+ * @return Whether there was a number.
+*/
+bool static read_number(scanner* s, int* value) {
+    skip_space(s);
+    if (s->p == s->end || *s->p < '0' || *s->p > '9') {
+        return false;
+    }
+
+    int v = 0;
+    while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+        if (v < 1000) {
+            v = v * 10 + (*s->p - '0');
+        }
+        s->p++;
+    }
+    *value = v;
+    return true;
+}
+
+/**
+ * Starts a record.
+ * @param r The record.
+ * @param format The format it is read from.
+ * @param taken The occupancy of the board, which is cleared.
+*/
+void static start_record(parse_record* r, unsigned char format, unsigned char* taken) {
+    memset(taken, 0, PARSE_MAX_MOVES);
+    r->format = format;
+    r->size = 15;
+    r->type = GAME_FREESTYLE;
+    r->state = GAME_STATE_STOPPED;
+    r->winner = EMPTY_INTERSECTION;
+    r->count = 0;
+}
+
+/**
+ * Adds a move to a record after checking it is on the board and on an empty intersection.
+ * @param r The record.
+ * @param taken The occupancy of the board.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @param line The line the move is on.
+ * @param err Where to put the error.
+ * @return Whether the move is valid.
+*/
+bool static add_move(parse_record* r, unsigned char* taken, int x, int y, int line, parse_error* err) {
+    if (x < 0 || x >= r->size || y < 0 || y >= r->size) {
+        return fail(err, COORDINATE_ERR, line, "move is off the board");
+    }
+    if (taken[y * r->size + x]) {
+        return fail(err, INPUT_ERR, line, "intersection is already taken");
+    }
+
+    taken[y * r->size + x] = 1;
+    r->x[r->count] = x;
+    r->y[r->count] = y;
+    r->line[r->count] = line;
+    r->count++;
+    return true;
+}
+
+/**
+ * Works out the format of a saved game from how it starts.
+ * @param data The saved game.
+ * @param length Its length in bytes.
+ * @return One of the PARSE_FORMAT values.
+*/
+int parse_detect(const char* data, size_t length) {
+    if (length >= RENLIB_HEADER && (unsigned char)data[0] == 0xFF && memcmp(data + 1, "RenLib", 6) == 0) {
+        return PARSE_FORMAT_RENLIB;
+    }
+    if (length >= sizeof(journal_header) && memcmp(data, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0) {
+        return PARSE_FORMAT_JOURNAL;
+    }
+
+    scanner s = {data, data + length, 1};
+    if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        s.p += 3;
+    }
+    skip_space(&s);
+    if (s.end - s.p >= 2 && s.p[0] == 'G' && s.p[1] == 'A') {
+        return PARSE_FORMAT_GMK;
+    }
+    if (s.p < s.end && *s.p == '(') {
+        return PARSE_FORMAT_SGF;
+    }
+    return PARSE_FORMAT_UNKNOWN;
+}
+
+/**
+ * Parses a saved game in the format game_export() writes: the magic GA, the board size, the
+ * game type, the game state and the winner, then one move per line such as H8.
+ * @param data The saved game.
+ * @param length Its length in bytes.
+ * @param r Where to put the game.
+ * @param err Where to put the error, or NULL.
+ * @return Whether the game could be parsed.
+*/
+bool parse_gmk(const char* data, size_t length, parse_record* r, parse_error* err) {
+    unsigned char taken[PARSE_MAX_MOVES];
+    start_record(r, PARSE_FORMAT_GMK, taken);
+
+    scanner s = {data, data + length, 1};
+    if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        s.p += 3;
+    }
+    skip_space(&s);
+    if (s.end - s.p < 2 || s.p[0] != 'G' || s.p[1] != 'A') {
+        return fail(err, FILE_INPUT_ERR, s.line, "missing GA magic");
+    }
+    s.p += 2;
+
+    int size, type, state, winner;
+    if (!read_number(&s, &size)) {
+        return fail(err, FILE_INPUT_ERR, s.line, "missing board size");
+    }
+    if (size != 15 && size != 17 && size != 19) {
+        return fail(err, BOARD_SIZE_ERR, s.line, "board size is not 15, 17 or 19");
+    }
+    if (!read_number(&s, &type) || (type != GAME_FREESTYLE && type != GAME_RENJU)) {
+        return fail(err, FILE_INPUT_ERR, s.line, "missing or unknown game type");
+    }
+    if (!read_number(&s, &state) || state > GAME_STATE_FINISHED) {
+        return fail(err, FILE_INPUT_ERR, s.line, "missing or unknown game state");
+    }
+    if (!read_number(&s, &winner) || winner > WHITE_STONE) {
+        return fail(err, STONE_TYPE_ERR, s.line, "missing or unknown winner");
+    }
+    r->size = size;
+    r->type = type;
+    r->state = state;
+    r->winner = winner;
+
+    for (skip_space(&s); s.p < s.end; skip_space(&s)) {
+        int line = s.line;
+        char column = *s.p++;
+        if (column >= 'a' && column <= 'z') {
+            column += 'A' - 'a';
+        }
+        int row;
+        if (column < 'A' || column > 'Z' || !read_number(&s, &row) ||
+            (s.p < s.end && *s.p != ' ' && *s.p != '\t' && *s.p != '\r' && *s.p != '\n')) {
+            return fail(err, FORMAL_COORDINATE_ERR, line, "move is not a letter and a number");
+        }
+        if (!add_move(r, taken, column - 'A', row - 1, line, err)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads one SGF property value, which starts with [ and ends with an unescaped ].
+ * @param s The scanner, on the [.
+ * @param value Where to put the start of the value.
+ * @param length Where to put the length of the value, escapes included.
+ * @return Whether the value is closed.
+*/
+bool static sgf_value(scanner* s, const char** value, size_t* length) {
+    s->p++;
+    *value = s->p;
+    while (s->p < s->end && *s->p != ']') {
+        if (*s->p == '\\' && s->p + 1 < s->end) {
+            s->p++;
+        }
+        if (*s->p == '\n') {
+            s->line++;
+        }
+        s->p++;
+    }
+    if (s->p == s->end) {
+        return false;
+    }
+    *length = s->p - *value;
+    s->p++;
+    return true;
+}
+
+/**
+ * Checks if a value contains a word, ignoring case.
+ * @param value The value.
+ * @param length Its length.
+ * @param word The word, in lower case.
+ * @return Whether the word is in the value.
+*/
+bool static contains_word(const char* value, size_t length, const char* word) {
+    size_t n = strlen(word);
+    for (size_t i = 0; i + n <= length; i++) {
+        size_t j = 0;
+        while (j < n && (value[i + j] | 0x20) == word[j]) {
+            j++;
+        }
+        if (j == n) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Handles one property of an SGF node.
+ * @param r The record.
+ * @param taken The occupancy of the board.
+ * @param id The property identifier, upper case letters only.
+ * @param value The first value.
+ * @param length The length of the first value.
+ * @param line The line the property is on.
+ * @param err Where to put the error.
+ * @return Whether the property is valid.
+*/
+bool static sgf_property(parse_record* r, unsigned char* taken, const char* id, const char* value, size_t length, int line, parse_error* err) {
+    if (strcmp(id, "B") == 0 || strcmp(id, "W") == 0) {
+        unsigned char stone = r->count % 2 == 0 ? BLACK_STONE : WHITE_STONE;
+        if ((id[0] == 'B') != (stone == BLACK_STONE)) {
+            return fail(err, STONE_TYPE_ERR, line, "move is out of turn");
+        }
+        if (length == 0) {
+            return fail(err, INPUT_ERR, line, "passes are not supported");
+        }
+        if (length != 2 || value[0] < 'a' || value[0] > 'z' || value[1] < 'a' || value[1] > 'z') {
+            return fail(err, FORMAL_COORDINATE_ERR, line, "move is not two letters");
+        }
+        // SGF counts rows from the top of the board, the game from the bottom.
+        return add_move(r, taken, value[0] - 'a', r->size - 1 - (value[1] - 'a'), line, err);
+    }
+
+    if (strcmp(id, "SZ") == 0) {
+        int size = 0;
+        size_t i = 0;
+        while (i < length && value[i] >= '0' && value[i] <= '9' && size < 1000) {
+            size = size * 10 + (value[i++] - '0');
+        }
+        if (i < length && value[i] == ':') {
+            int rows = 0;
+            for (i++; i < length && value[i] >= '0' && value[i] <= '9' && rows < 1000; i++) {
+                rows = rows * 10 + (value[i] - '0');
+            }
+            if (rows != size) {
+                return fail(err, BOARD_SIZE_ERR, line, "board is not square");
+            }
+        }
+        if (size != 15 && size != 17 && size != 19) {
+            return fail(err, BOARD_SIZE_ERR, line, "board size is not 15, 17 or 19");
+        }
+        if (r->count > 0) {
+            return fail(err, BOARD_SIZE_ERR, line, "board size comes after the moves");
+        }
+        r->size = size;
+    } else if (strcmp(id, "GM") == 0) {
+        if (length > 0 && (length != 1 || value[0] != '4')) {
+            return fail(err, FILE_INPUT_ERR, line, "record is not a game of gomoku");
+        }
+    } else if (strcmp(id, "RU") == 0) {
+        r->type = contains_word(value, length, "renju") ? GAME_RENJU : GAME_FREESTYLE;
+    } else if (strcmp(id, "RE") == 0 && length > 0) {
+        if (value[0] == 'B' || value[0] == 'b') {
+            r->state = GAME_STATE_FINISHED;
+            r->winner = BLACK_STONE;
+        } else if (value[0] == 'W' || value[0] == 'w') {
+            r->state = GAME_STATE_FINISHED;
+            r->winner = WHITE_STONE;
+        } else if (value[0] == '0' || value[0] == 'D' || value[0] == 'd') {
+            r->state = GAME_STATE_FINISHED;
+            r->winner = EMPTY_INTERSECTION;
+        }
+    } else if (strcmp(id, "AB") == 0 || strcmp(id, "AW") == 0 || strcmp(id, "AE") == 0) {
+        return fail(err, INPUT_ERR, line, "setup stones are not supported");
+    }
+    return true;
+}
+
+/**
+ * Parses the main line of an SGF record: the first game of the collection, following the
+ * first variation wherever the game tree branches. The record ends at the end of the first
+ * variation, so the rest of the tree is not even looked at. A record without RE is read as
+ * stopped, one without SZ as played on the 15 by 15 board and one without an RU that mentions
+ * renju as freestyle.
+ * @param data The saved game.
+ * @param length Its length in bytes.
+ * @param r Where to put the game.
+ * @param err Where to put the error, or NULL.
+ * @return Whether the game could be parsed.
+*/
+bool parse_sgf(const char* data, size_t length, parse_record* r, parse_error* err) {
+    unsigned char taken[PARSE_MAX_MOVES];
+    start_record(r, PARSE_FORMAT_SGF, taken);
+
+    scanner s = {data, data + length, 1};
+    if (length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        s.p += 3;
+    }
+    skip_space(&s);
+    if (s.p == s.end || *s.p != '(') {
+        return fail(err, FILE_INPUT_ERR, s.line, "missing ( at the start of the game tree");
+    }
+    s.p++;
+
+    bool node = false;
+    for (skip_space(&s); s.p < s.end; skip_space(&s)) {
+        char c = *s.p;
+        if (c == ')') {
+            return true;
+        }
+        if (c == '(') {
+            s.p++;
+            continue;
+        }
+        if (c == ';') {
+            node = true;
+            s.p++;
+            continue;
+        }
+        if (!node || c < 'A' || c > 'Z') {
+            return fail(err, FILE_INPUT_ERR, s.line, "unexpected character");
+        }
+
+        // Old versions of the format allow lower case letters in identifiers, which are dropped.
+        int line = s.line;
+        char id[3];
+        int n = 0;
+        while (s.p < s.end && ((*s.p >= 'A' && *s.p <= 'Z') || (*s.p >= 'a' && *s.p <= 'z'))) {
+            if (*s.p >= 'A' && *s.p <= 'Z') {
+                if (n < 2) {
+                    id[n] = *s.p;
+                }
+                n++;
+            }
+            s.p++;
+        }
+        id[n <= 2 ? n : 0] = '\0';
+
+        skip_space(&s);
+        if (s.p == s.end || *s.p != '[') {
+            return fail(err, FILE_INPUT_ERR, line, "property has no value");
+        }
+        const char* value = NULL;
+        size_t value_length = 0;
+        bool first = true;
+        while (s.p < s.end && *s.p == '[') {
+            const char* v;
+            size_t l;
+            if (!sgf_value(&s, &v, &l)) {
+                return fail(err, FILE_INPUT_ERR, line, "property value is not closed");
+            }
+            if (first) {
+                value = v;
+                value_length = l;
+                first = false;
+            }
+            skip_space(&s);
+        }
+        if (!sgf_property(r, taken, id, value, value_length, line, err)) {
+            return false;
+        }
+    }
+    return fail(err, FILE_INPUT_ERR, s.line, "game tree is not closed");
+}
+
+/**
+ * Parses the main line of a RenLib library: the first move at every branch of the opening
+ * tree, from the root down to the first leaf. RenLib only knows the 15 by 15 board and renju,
+ * and a library holds no result, so the game is read as a stopped game of renju. Comments and
+ * marks on the moves are skipped.
+ * @param data The library.
+ * @param length Its length in bytes.
+ * @param r Where to put the game.
+ * @param err Where to put the error, or NULL.
+ * @return Whether the game could be parsed.
+*/
+bool parse_renlib(const char* data, size_t length, parse_record* r, parse_error* err) {
+    unsigned char taken[PARSE_MAX_MOVES];
+    start_record(r, PARSE_FORMAT_RENLIB, taken);
+    r->size = RENLIB_SIZE;
+    r->type = GAME_RENJU;
+
+    if (length < RENLIB_HEADER || (unsigned char)data[0] != 0xFF || memcmp(data + 1, "RenLib", 6) != 0) {
+        return fail(err, FILE_INPUT_ERR, 0, "missing RenLib header");
+    }
+
+    const unsigned char* p = (const unsigned char*)data + RENLIB_HEADER;
+    const unsigned char* end = (const unsigned char*)data + length;
+    int record = 0;
+    bool down = true;
+    while (down && p < end) {
+        record++;
+        if (end - p < 2) {
+            return fail(err, FILE_INPUT_ERR, record, "record is cut off");
+        }
+        unsigned char position = p[0];
+        unsigned char flags = p[1];
+        p += 2;
+
+        // A comment is a string ending in a zero byte, padded to an even length.
+        if (flags & (RENLIB_COMMENT | RENLIB_OLD_COMMENT)) {
+            const unsigned char* start = p;
+            while (p < end && *p != 0) {
+                p++;
+            }
+            if (p == end) {
+                return fail(err, FILE_INPUT_ERR, record, "comment is not closed");
+            }
+            p++;
+            if ((p - start) % 2 != 0 && p < end) {
+                p++;
+            }
+        }
+        if (flags & RENLIB_EXTENSION) {
+            if (end - p < RENLIB_EXTENSION_LENGTH) {
+                return fail(err, FILE_INPUT_ERR, record, "record is cut off");
+            }
+            p += RENLIB_EXTENSION_LENGTH;
+        }
+
+        // Position 0 is the empty board at the root, or a node without a move.
+        if (position != 0) {
+            int x = (position & 0x0F) - 1;
+            int row = position >> 4;
+            if (!add_move(r, taken, x, RENLIB_SIZE - 1 - row, record, err)) {
+                return false;
+            }
+        }
+        down = flags & RENLIB_DOWN;
+    }
+    return true;
+}
+
+/**
+ * Recovers the game in an autosave journal written by journal.c. The records are replayed up
+ * to the first one that is cut off, fails its checksum or is not a valid move, which is where
+ * the program writing the journal crashed; that and what follows it is dropped rather than
+ * reported. A journal without its closing record is read as a stopped game.
+ * @param data The journal.
+ * @param length Its length in bytes.
+ * @param r Where to put the game.
+ * @param err Where to put the error, or NULL.
+ * @return Whether the journal header is valid.
+*/
+bool parse_journal(const char* data, size_t length, parse_record* r, parse_error* err) {
+    unsigned char taken[PARSE_MAX_MOVES];
+    start_record(r, PARSE_FORMAT_JOURNAL, taken);
+
+    journal_header header;
+    if (length < sizeof(header)) {
+        return fail(err, FILE_INPUT_ERR, 0, "missing journal header");
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0 || header.version != JOURNAL_VERSION) {
+        return fail(err, FILE_INPUT_ERR, 0, "missing journal header or unknown version");
+    }
+    if (header.size != 15 && header.size != 17 && header.size != 19) {
+        return fail(err, BOARD_SIZE_ERR, 0, "board size is not 15, 17 or 19");
+    }
+    if (header.type != GAME_FREESTYLE && header.type != GAME_RENJU) {
+        return fail(err, FILE_INPUT_ERR, 0, "unknown game type");
+    }
+    r->size = header.size;
+    r->type = header.type;
+
+    size_t records = (length - sizeof(header)) / sizeof(journal_record);
+    for (size_t i = 0; i < records; i++) {
+        journal_record record;
+        memcpy(&record, data + sizeof(header) + i * sizeof(record), sizeof(record));
+        if (record.check != journal_check(i, record.op, record.x, record.y)) {
+            break;
+        }
+        if (record.op == JOURNAL_MOVE) {
+            if (!add_move(r, taken, record.x, record.y, i + 1, NULL)) {
+                break;
+            }
+        } else if (record.op == JOURNAL_UNDO && r->count > 0) {
+            r->count--;
+            taken[r->y[r->count] * r->size + r->x[r->count]] = 0;
+        } else if (record.op == JOURNAL_END && record.x <= GAME_STATE_FINISHED && record.y <= WHITE_STONE) {
+            r->state = record.x;
+            r->winner = record.y;
+            break;
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parses a saved game in any of the formats, which is worked out from how it starts.
+ * @param data The saved game.
+ * @param length Its length in bytes.
+ * @param r Where to put the game.
+ * @param err Where to put the error, or NULL.
+ * @return Whether the game could be parsed.
+*/
+bool parse_buffer(const char* data, size_t length, parse_record* r, parse_error* err) {
+    switch (parse_detect(data, length)) {
+    case PARSE_FORMAT_GMK:
+        return parse_gmk(data, length, r, err);
+    case PARSE_FORMAT_SGF:
+        return parse_sgf(data, length, r, err);
+    case PARSE_FORMAT_RENLIB:
+        return parse_renlib(data, length, r, err);
+    case PARSE_FORMAT_JOURNAL:
+        return parse_journal(data, length, r, err);
+    default:
+        return fail(err, FILE_INPUT_ERR, 1, "not a .gmk, journal, SGF or RenLib file");
+    }
+}
+
+/**
+ * Builds a game from a parsed record by playing its moves. The state and winner are the ones
+ * the record gives, like game_import() always did, unless the moves themselves end the game,
+ * as they do in a journal cut off right after the winning move. A move after the game ended
+ * is an error.
+ * @param r The record.
+ * @param err Where to put the error, or NULL.
+ * @return The game, or NULL if a move comes after the end of the game or the game cannot be
+ *         allocated.
+*/
+game* parse_game(const parse_record* r, parse_error* err) {
+    game* g = game_create(r->size, r->type);
+    if (g == NULL) {
+        fail(err, NULL_POINTER_ERR, 0, "game cannot be allocated");
+        return NULL;
+    }
+    g->state = GAME_STATE_PLAYING;
+    g->winner = r->winner;
+
+    for (size_t i = 0; i < r->count; i++) {
+        if (g->state != GAME_STATE_PLAYING) {
+            game_delete(g);
+            fail(err, INPUT_ERR, r->line[i], "move comes after the end of the game");
+            return NULL;
+        }
+        unsigned char status = game_place_stone(g, r->x[i], r->y[i]);
+        if (status != SUCCESS) {
+            game_delete(g);
+            fail(err, status, r->line[i], "move cannot be played");
+            return NULL;
+        }
+    }
+
+    if (g->state == GAME_STATE_PLAYING) {
+        g->state = r->state;
+    }
+    return g;
+}
+
+/**
+ * Reads a saved game in any of the formats from a file, which is mapped rather than read.
+ * @param path The path to the file.
+ * @param err Where to put the error, or NULL.
+ * @return The game, or NULL if the file could not be read or parsed.
+*/
+game* parse_file(const char* path, parse_error* err) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fail(err, FILE_INPUT_ERR, 0, "file cannot be opened");
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        fail(err, FILE_INPUT_ERR, 0, "file is empty or not a regular file");
+        return NULL;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fail(err, FILE_INPUT_ERR, 0, "file cannot be mapped");
+        return NULL;
+    }
+
+    parse_record r;
+    game* g = NULL;
+    if (parse_buffer(map, st.st_size, &r, err)) {
+        g = parse_game(&r, err);
+    }
+    munmap(map, st.st_size);
+    return g;
+}
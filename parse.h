@@ -0,0 +1,41 @@
+#ifndef _PARSE_H_
+#define _PARSE_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include "game.h"
+#include "pattern.h"
+#define PARSE_MAX_MOVES (PATTERN_MAX_SIZE * PATTERN_MAX_SIZE)
+#define PARSE_REASON_LENGTH 64
+#define PARSE_FORMAT_UNKNOWN 0
+#define PARSE_FORMAT_GMK 1
+#define PARSE_FORMAT_SGF 2
+#define PARSE_FORMAT_RENLIB 3
+#define PARSE_FORMAT_JOURNAL 4
+
+typedef struct {
+    int code;
+    int line;
+    char reason[PARSE_REASON_LENGTH];
+} parse_error;
+
+typedef struct {
+    unsigned char format;
+    unsigned char size;
+    unsigned char type;
+    unsigned char state;
+    unsigned char winner;
+    size_t count;
+    unsigned char x[PARSE_MAX_MOVES];
+    unsigned char y[PARSE_MAX_MOVES];
+    int line[PARSE_MAX_MOVES];
+} parse_record;
+
+int parse_detect(const char* data, size_t length);
+bool parse_gmk(const char* data, size_t length, parse_record* r, parse_error* err);
+bool parse_sgf(const char* data, size_t length, parse_record* r, parse_error* err);
+bool parse_renlib(const char* data, size_t length, parse_record* r, parse_error* err);
+bool parse_journal(const char* data, size_t length, parse_record* r, parse_error* err);
+bool parse_buffer(const char* data, size_t length, parse_record* r, parse_error* err);
+game* parse_game(const parse_record* r, parse_error* err);
+game* parse_file(const char* path, parse_error* err);
+#endif
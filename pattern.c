@@ -0,0 +1,466 @@
+/**
+ * @file pattern.c
+ * @author Faris Soliman
+ * This file contains the whole board pattern scanner. Instead of walking the lines through
+ * a single move like the rule checks in rules.c do, it classifies every intersection along
+ * all four directions for both colors in one pass.
+ *
+ * The board is copied into a padded buffer where every row is followed by one wall cell and
+ * six rows of walls are added above and below, so a line that leaves the board always runs
+ * into a wall. A black stone weighs 1, a white stone 8 and a wall 9, so the byte sum of a
+ * window holds the black count in its low three bits and the white count in the next three,
+ * and a window is clean for one color exactly when the other color's field is zero. That
+ * makes the scan a handful of byte adds, masks and maxes per 16 or 32 intersections.
+*/
+#include <string.h>
+#include "board.h"
+#include "cpu.h"
+#include "pattern.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PATTERN_X86
+#include <immintrin.h>
+#endif
+
+#define BLACK_WEIGHT 0x01
+#define WHITE_WEIGHT 0x08
+#define WALL_WEIGHT 0x09
+#define PAD_ROWS 6
+#define SCAN_BUFFER ((PATTERN_MAX_SIZE + 2 * PAD_ROWS) * (PATTERN_MAX_SIZE + 1) + 64)
+
+const signed char pattern_dx[DIRECTIONS] = {1, 0, 1, -1};
+const signed char pattern_dy[DIRECTIONS] = {0, 1, 1, 1};
+
+static const unsigned char weights[3] = {0, BLACK_WEIGHT, WHITE_WEIGHT};
+
+typedef void (*scan_kernel)(const unsigned char* val, unsigned char* black, unsigned char* white, int first, int last, int delta);
+
+/**
+ * Classifies a line through one intersection.
+ * @param best The most own stones found in a clean window of five, counting the intersection itself.
+ * @param windows The number of clean windows of five that reach that count.
+ * @param run The most own stones found in a clean window of six, counting the intersection itself.
+ * @return The pattern code.
+*/
+unsigned char pattern_classify(unsigned char best, unsigned char windows, unsigned char run) {
+    if (run >= 6) {
+        return PATTERN_OVERLINE;
+    }
+    if (best >= 5) {
+        return PATTERN_FIVE;
+    }
+    if (best == 4) {
+        return windows > 1 ? PATTERN_OPEN_FOUR : PATTERN_FOUR;
+    }
+    if (best == 3) {
+        return windows > 1 ? PATTERN_OPEN_THREE : PATTERN_THREE;
+    }
+    if (best == 2) {
+        return PATTERN_TWO;
+    }
+    return PATTERN_NONE;
+}
+
+/**
+ * Classifies one color from the window sums around an intersection.
+ * @param w5 The sums of the five windows of five through the intersection, in any order.
+ * @param w6 The sums of the six windows of six through the intersection, in any order.
+ * @param shift Where the color's count sits in the sums, 0 for black and 3 for white.
+ * @param empty Whether the intersection is empty.
+ * @return The pattern code.
+*/
+unsigned char static classify_scalar(const unsigned char* w5, const unsigned char* w6, int shift, unsigned char empty) {
+    unsigned char other = 0x38 >> shift;
+    unsigned char count[5];
+    unsigned char best = 0;
+    unsigned char run = 0;
+    unsigned char windows = 0;
+
+    for (int k = 0; k < 5; k++) {
+        count[k] = (w5[k] & other) ? 0 : (w5[k] >> shift) & 7;
+        if (count[k] > best) {
+            best = count[k];
+        }
+    }
+    for (int k = 0; k < 5; k++) {
+        if (count[k] == best) {
+            windows++;
+        }
+    }
+    for (int k = 0; k < 6; k++) {
+        unsigned char c = (w6[k] & other) ? 0 : (w6[k] >> shift) & 7;
+        if (c > run) {
+            run = c;
+        }
+    }
+    return pattern_classify(best + empty, windows, run + empty);
+}
+
+/**
+ * Scans one direction without vector instructions.
+ * @param val The weighted padded board.
+ * @param black The black pattern codes, indexed from the first intersection.
+ * @param white The white pattern codes, indexed from the first intersection.
+ * @param first The padded index of the first intersection.
+ * @param last One past the padded index of the last intersection.
+ * @param delta The index step along the direction.
+*/
+void static scan_scalar(const unsigned char* val, unsigned char* black, unsigned char* white, int first, int last, int delta) {
+    for (int q = first; q < last; q++) {
+        const unsigned char* cell = val + q - 5 * delta;
+        unsigned char w5[5];
+        unsigned char w6[6];
+
+        // Window k starts k steps before q, so it covers cells 5 - k to 9 - k here.
+        w5[4] = cell[delta] + cell[2 * delta] + cell[3 * delta] + cell[4 * delta] + cell[5 * delta];
+        for (int k = 3; k >= 0; k--) {
+            w5[k] = w5[k + 1] + cell[(9 - k) * delta] - cell[(4 - k) * delta];
+        }
+        for (int k = 0; k < 5; k++) {
+            w6[k] = w5[k] + cell[(10 - k) * delta];
+        }
+        w6[5] = w5[4] + cell[0];
+
+        black[q - first] = classify_scalar(w5, w6, 0, val[q] == 0);
+        white[q - first] = classify_scalar(w5, w6, 3, val[q] == 0);
+    }
+}
+
+#ifdef PATTERN_X86
+/**
+ * Classifies one color from the window sums around 16 intersections.
+ * @param w5 The sums of the five windows of five.
+ * @param w6 The sums of the six windows of six.
+ * @param white Whether to classify white instead of black.
+ * @param empty 1 in every lane whose intersection is empty.
+ * @return The pattern codes.
+*/
+__attribute__((target("sse2"), always_inline))
+static inline __m128i classify_sse2(const __m128i* w5, const __m128i* w6, bool white, __m128i empty) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i seven = _mm_set1_epi8(7);
+    const __m128i other = _mm_set1_epi8(white ? 0x07 : 0x38);
+    __m128i count[5];
+    __m128i best = zero;
+    __m128i run = zero;
+    __m128i windows = zero;
+
+    #pragma GCC unroll 11
+    for (int k = 0; k < 5; k++) {
+        __m128i c = white ? _mm_and_si128(_mm_srli_epi16(w5[k], 3), seven) : _mm_and_si128(w5[k], seven);
+        count[k] = _mm_and_si128(c, _mm_cmpeq_epi8(_mm_and_si128(w5[k], other), zero));
+        best = _mm_max_epu8(best, count[k]);
+    }
+    #pragma GCC unroll 11
+    for (int k = 0; k < 5; k++) {
+        windows = _mm_sub_epi8(windows, _mm_cmpeq_epi8(count[k], best));
+    }
+    #pragma GCC unroll 11
+    for (int k = 0; k < 6; k++) {
+        __m128i c = white ? _mm_and_si128(_mm_srli_epi16(w6[k], 3), seven) : _mm_and_si128(w6[k], seven);
+        run = _mm_max_epu8(run, _mm_and_si128(c, _mm_cmpeq_epi8(_mm_and_si128(w6[k], other), zero)));
+    }
+    best = _mm_add_epi8(best, empty);
+    run = _mm_add_epi8(run, empty);
+
+    __m128i two = _mm_cmpgt_epi8(best, _mm_set1_epi8(1));
+    __m128i three = _mm_cmpgt_epi8(best, _mm_set1_epi8(2));
+    __m128i four = _mm_cmpgt_epi8(best, _mm_set1_epi8(3));
+    __m128i five = _mm_cmpgt_epi8(best, _mm_set1_epi8(4));
+    __m128i open = _mm_andnot_si128(five, _mm_and_si128(three, _mm_cmpgt_epi8(windows, _mm_set1_epi8(1))));
+    __m128i overline = _mm_cmpgt_epi8(run, _mm_set1_epi8(5));
+
+    __m128i code = _mm_and_si128(two, _mm_set1_epi8(1));
+    code = _mm_add_epi8(code, _mm_and_si128(three, _mm_set1_epi8(1)));
+    code = _mm_add_epi8(code, _mm_and_si128(four, _mm_set1_epi8(2)));
+    code = _mm_add_epi8(code, _mm_and_si128(five, _mm_set1_epi8(2)));
+    code = _mm_add_epi8(code, _mm_and_si128(open, _mm_set1_epi8(1)));
+    return _mm_or_si128(_mm_and_si128(overline, _mm_set1_epi8(PATTERN_OVERLINE)), _mm_andnot_si128(overline, code));
+}
+
+/**
+ * Scans one direction 16 intersections at a time.
+ * @param val The weighted padded board.
+ * @param black The black pattern codes, indexed from the first intersection.
+ * @param white The white pattern codes, indexed from the first intersection.
+ * @param first The padded index of the first intersection.
+ * @param last One past the padded index of the last intersection.
+ * @param delta The index step along the direction.
+*/
+__attribute__((target("sse2")))
+void static scan_sse2(const unsigned char* val, unsigned char* black, unsigned char* white, int first, int last, int delta) {
+    for (int q = first; q < last; q += 16) {
+        __m128i cell[11];
+        __m128i w5[5];
+        __m128i w6[6];
+        #pragma GCC unroll 11
+        for (int j = 0; j < 11; j++) {
+            cell[j] = _mm_loadu_si128((const __m128i*) (val + q + (j - 5) * delta));
+        }
+
+        w5[4] = _mm_add_epi8(_mm_add_epi8(cell[1], cell[2]), _mm_add_epi8(_mm_add_epi8(cell[3], cell[4]), cell[5]));
+        #pragma GCC unroll 11
+        for (int k = 3; k >= 0; k--) {
+            w5[k] = _mm_sub_epi8(_mm_add_epi8(w5[k + 1], cell[9 - k]), cell[4 - k]);
+        }
+        #pragma GCC unroll 11
+        for (int k = 0; k < 5; k++) {
+            w6[k] = _mm_add_epi8(w5[k], cell[10 - k]);
+        }
+        w6[5] = _mm_add_epi8(w5[4], cell[0]);
+
+        __m128i empty = _mm_and_si128(_mm_cmpeq_epi8(cell[5], _mm_setzero_si128()), _mm_set1_epi8(1));
+        _mm_storeu_si128((__m128i*) (black + q - first), classify_sse2(w5, w6, false, empty));
+        _mm_storeu_si128((__m128i*) (white + q - first), classify_sse2(w5, w6, true, empty));
+    }
+}
+
+/**
+ * Classifies one color from the window sums around 32 intersections.
+ * @param w5 The sums of the five windows of five.
+ * @param w6 The sums of the six windows of six.
+ * @param white Whether to classify white instead of black.
+ * @param empty 1 in every lane whose intersection is empty.
+ * @return The pattern codes.
+*/
+__attribute__((target("avx2"), always_inline))
+static inline __m256i classify_avx2(const __m256i* w5, const __m256i* w6, bool white, __m256i empty) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i seven = _mm256_set1_epi8(7);
+    const __m256i other = _mm256_set1_epi8(white ? 0x07 : 0x38);
+    __m256i count[5];
+    __m256i best = zero;
+    __m256i run = zero;
+    __m256i windows = zero;
+
+    #pragma GCC unroll 11
+    for (int k = 0; k < 5; k++) {
+        __m256i c = white ? _mm256_and_si256(_mm256_srli_epi16(w5[k], 3), seven) : _mm256_and_si256(w5[k], seven);
+        count[k] = _mm256_and_si256(c, _mm256_cmpeq_epi8(_mm256_and_si256(w5[k], other), zero));
+        best = _mm256_max_epu8(best, count[k]);
+    }
+    #pragma GCC unroll 11
+    for (int k = 0; k < 5; k++) {
+        windows = _mm256_sub_epi8(windows, _mm256_cmpeq_epi8(count[k], best));
+    }
+    #pragma GCC unroll 11
+    for (int k = 0; k < 6; k++) {
+        __m256i c = white ? _mm256_and_si256(_mm256_srli_epi16(w6[k], 3), seven) : _mm256_and_si256(w6[k], seven);
+        run = _mm256_max_epu8(run, _mm256_and_si256(c, _mm256_cmpeq_epi8(_mm256_and_si256(w6[k], other), zero)));
+    }
+    best = _mm256_add_epi8(best, empty);
+    run = _mm256_add_epi8(run, empty);
+
+    __m256i two = _mm256_cmpgt_epi8(best, _mm256_set1_epi8(1));
+    __m256i three = _mm256_cmpgt_epi8(best, _mm256_set1_epi8(2));
+    __m256i four = _mm256_cmpgt_epi8(best, _mm256_set1_epi8(3));
+    __m256i five = _mm256_cmpgt_epi8(best, _mm256_set1_epi8(4));
+    __m256i open = _mm256_andnot_si256(five, _mm256_and_si256(three, _mm256_cmpgt_epi8(windows, _mm256_set1_epi8(1))));
+    __m256i overline = _mm256_cmpgt_epi8(run, _mm256_set1_epi8(5));
+
+    __m256i code = _mm256_and_si256(two, _mm256_set1_epi8(1));
+    code = _mm256_add_epi8(code, _mm256_and_si256(three, _mm256_set1_epi8(1)));
+    code = _mm256_add_epi8(code, _mm256_and_si256(four, _mm256_set1_epi8(2)));
+    code = _mm256_add_epi8(code, _mm256_and_si256(five, _mm256_set1_epi8(2)));
+    code = _mm256_add_epi8(code, _mm256_and_si256(open, _mm256_set1_epi8(1)));
+    return _mm256_blendv_epi8(code, _mm256_set1_epi8(PATTERN_OVERLINE), overline);
+}
+
+/**
+ * Scans one direction 32 intersections at a time.
+ * @param val The weighted padded board.
+ * @param black The black pattern codes, indexed from the first intersection.
+ * @param white The white pattern codes, indexed from the first intersection.
+ * @param first The padded index of the first intersection.
+ * @param last One past the padded index of the last intersection.
+ * @param delta The index step along the direction.
+*/
+__attribute__((target("avx2")))
+void static scan_avx2(const unsigned char* val, unsigned char* black, unsigned char* white, int first, int last, int delta) {
+    for (int q = first; q < last; q += 32) {
+        __m256i cell[11];
+        __m256i w5[5];
+        __m256i w6[6];
+        #pragma GCC unroll 11
+        for (int j = 0; j < 11; j++) {
+            cell[j] = _mm256_loadu_si256((const __m256i*) (val + q + (j - 5) * delta));
+        }
+
+        w5[4] = _mm256_add_epi8(_mm256_add_epi8(cell[1], cell[2]), _mm256_add_epi8(_mm256_add_epi8(cell[3], cell[4]), cell[5]));
+        #pragma GCC unroll 11
+        for (int k = 3; k >= 0; k--) {
+            w5[k] = _mm256_sub_epi8(_mm256_add_epi8(w5[k + 1], cell[9 - k]), cell[4 - k]);
+        }
+        #pragma GCC unroll 11
+        for (int k = 0; k < 5; k++) {
+            w6[k] = _mm256_add_epi8(w5[k], cell[10 - k]);
+        }
+        w6[5] = _mm256_add_epi8(w5[4], cell[0]);
+
+        __m256i empty = _mm256_and_si256(_mm256_cmpeq_epi8(cell[5], _mm256_setzero_si256()), _mm256_set1_epi8(1));
+        _mm256_storeu_si256((__m256i*) (black + q - first), classify_avx2(w5, w6, false, empty));
+        _mm256_storeu_si256((__m256i*) (white + q - first), classify_avx2(w5, w6, true, empty));
+    }
+}
+#endif
+
+typedef struct {
+    const char* name;
+    scan_kernel scan;
+} kernel_entry;
+
+static const kernel_entry kernels[] = {
+#ifdef PATTERN_X86
+    {"avx2", scan_avx2},
+    {"sse2", scan_sse2},
+#endif
+    {"scalar", scan_scalar},
+};
+
+static const void* active = NULL;
+
+/**
+ * Gets the kernel in use, picking the widest one the processor supports the first time.
+ * @return The kernel.
+*/
+static const kernel_entry* kernel_select(void) {
+    return cpu_select(&active, kernels, sizeof(kernels) / sizeof(kernels[0]), sizeof(kernels[0]));
+}
+
+/**
+ * Gets the name of the kernel the scanner dispatches to.
+ * @return The kernel name, "avx2", "sse2" or "scalar".
+*/
+const char* pattern_kernel(void) {
+    return kernel_select()->name;
+}
+
+/**
+ * Forces the scanner to use a kernel, mostly for benchmarks and cross checks.
+ * @param name The kernel name.
+ * @return Whether the kernel exists and is supported by the processor.
+*/
+bool pattern_use_kernel(const char* name) {
+    return cpu_use(&active, kernels, sizeof(kernels) / sizeof(kernels[0]), sizeof(kernels[0]), name);
+}
+
+/**
+ * Scans every row, column and diagonal of a board. Afterwards each intersection holds, for
+ * both colors and all four directions, the pattern code of the line through it. Stones get
+ * the pattern they are part of, empty intersections get the pattern a stone played there
+ * would make, and intersections held by the other color get PATTERN_NONE.
+ * @param b The board to scan.
+ * @param s The scan to write to.
+*/
+void pattern_scan_board(board* b, pattern_scan* s) {
+    unsigned char val[SCAN_BUFFER];
+    int size = b->size;
+    int stride = size + 1;
+    int first = PAD_ROWS * stride;
+    int last = first + size * stride;
+    int deltas[DIRECTIONS] = {1, stride, stride + 1, stride - 1};
+    scan_kernel scan = kernel_select()->scan;
+
+    memset(val, WALL_WEIGHT, sizeof(val));
+    for (int y = 0; y < size; y++) {
+        const unsigned char* row = b->grid + y * size;
+        unsigned char* padded = val + first + y * stride;
+        for (int x = 0; x < size; x++) {
+            padded[x] = weights[row[x]];
+        }
+    }
+
+    s->size = size;
+    s->stride = stride;
+    for (int d = 0; d < DIRECTIONS; d++) {
+        scan(val, s->codes[0][d], s->codes[1][d], first, last, deltas[d]);
+    }
+}
+
+/**
+ * Brings a scan up to date after the intersection at (x, y) changed. Only the intersections
+ * within five steps along the four lines through it can see the change, so those are the
+ * only ones reclassified.
+ * @param s The scan to update.
+ * @param b The board after the change.
+ * @param x The x coordinate of the change.
+ * @param y The y coordinate of the change.
+*/
+void pattern_update(pattern_scan* s, board* b, unsigned char x, unsigned char y) {
+    int size = b->size;
+
+    for (int d = 0; d < DIRECTIONS; d++) {
+        unsigned char line[21];
+        for (int k = -10; k <= 10; k++) {
+            int cx = x + k * pattern_dx[d];
+            int cy = y + k * pattern_dy[d];
+            if (cx < 0 || cx >= size || cy < 0 || cy >= size) {
+                line[k + 10] = WALL_WEIGHT;
+            } else {
+                line[k + 10] = weights[b->grid[cy * size + cx]];
+            }
+        }
+
+        // Window j covers line cells j to j + 4 (or j + 5), and the windows through the
+        // intersection at line cell c are the ones starting from c - 4 (or c - 5) to c.
+        unsigned char w5[17];
+        unsigned char w6[16];
+        w5[0] = line[0] + line[1] + line[2] + line[3] + line[4];
+        for (int j = 1; j < 17; j++) {
+            w5[j] = w5[j - 1] + line[j + 4] - line[j - 1];
+        }
+        for (int j = 0; j < 16; j++) {
+            w6[j] = w5[j] + line[j + 5];
+        }
+
+        for (int k = -5; k <= 5; k++) {
+            int cx = x + k * pattern_dx[d];
+            int cy = y + k * pattern_dy[d];
+            if (cx < 0 || cx >= size || cy < 0 || cy >= size) {
+                continue;
+            }
+            int c = k + 10;
+            int i = cy * s->stride + cx;
+            s->codes[0][d][i] = classify_scalar(w5 + c - 4, w6 + c - 5, 0, line[c] == 0);
+            s->codes[1][d][i] = classify_scalar(w5 + c - 4, w6 + c - 5, 3, line[c] == 0);
+        }
+    }
+}
+
+/**
+ * Gets a pattern code from a scan.
+ * @param s The scan.
+ * @param stone The color to look at.
+ * @param dir The direction to look at.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The pattern code.
+*/
+unsigned char pattern_get(const pattern_scan* s, unsigned char stone, unsigned char dir, unsigned char x, unsigned char y) {
+    return s->codes[stone - BLACK_STONE][dir][y * s->stride + x];
+}
+
+/**
+ * Counts the patterns of a color. Each stone and each empty intersection is counted once
+ * per direction, stones under the pattern they are part of and empty intersections under the
+ * pattern they threaten.
+ * @param s The scan of the board.
+ * @param b The board that was scanned.
+ * @param stone The color to count.
+ * @param c The census to write to.
+*/
+void pattern_count(const pattern_scan* s, board* b, unsigned char stone, pattern_census* c) {
+    memset(c, 0, sizeof(pattern_census));
+    for (int y = 0; y < s->size; y++) {
+        for (int x = 0; x < s->size; x++) {
+            unsigned char here = b->grid[y * s->size + x];
+            unsigned short* counts = here == stone ? c->stones : (here == EMPTY_INTERSECTION ? c->threats : NULL);
+            if (counts == NULL) {
+                continue;
+            }
+            for (int d = 0; d < DIRECTIONS; d++) {
+                counts[s->codes[stone - BLACK_STONE][d][y * s->stride + x]]++;
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef _PATTERN_H_
+#define _PATTERN_H_
+#include <stdbool.h>
+#include "board.h"
+#define PATTERN_NONE 0
+#define PATTERN_TWO 1
+#define PATTERN_THREE 2
+#define PATTERN_OPEN_THREE 3
+#define PATTERN_FOUR 4
+#define PATTERN_OPEN_FOUR 5
+#define PATTERN_FIVE 6
+#define PATTERN_OVERLINE 7
+#define PATTERN_KINDS 8
+#define DIRECTION_HORIZONTAL 0
+#define DIRECTION_VERTICAL 1
+#define DIRECTION_DIAGONAL 2
+#define DIRECTION_ANTIDIAGONAL 3
+#define DIRECTIONS 4
+#define PATTERN_MAX_SIZE 19
+#define PATTERN_MAX_CELLS (PATTERN_MAX_SIZE * (PATTERN_MAX_SIZE + 1) + 32)
+
+typedef struct {
+    unsigned char size;
+    unsigned char stride;
+    unsigned char codes[2][DIRECTIONS][PATTERN_MAX_CELLS];
+} pattern_scan;
+
+typedef struct {
+    unsigned short stones[PATTERN_KINDS];
+    unsigned short threats[PATTERN_KINDS];
+} pattern_census;
+
+extern const signed char pattern_dx[DIRECTIONS];
+extern const signed char pattern_dy[DIRECTIONS];
+
+unsigned char pattern_classify(unsigned char best, unsigned char windows, unsigned char run);
+void pattern_scan_board(board* b, pattern_scan* s);
+void pattern_update(pattern_scan* s, board* b, unsigned char x, unsigned char y);
+unsigned char pattern_get(const pattern_scan* s, unsigned char stone, unsigned char dir, unsigned char x, unsigned char y);
+void pattern_count(const pattern_scan* s, board* b, unsigned char stone, pattern_census* c);
+const char* pattern_kernel(void);
+bool pattern_use_kernel(const char* name);
+#endif
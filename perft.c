@@ -0,0 +1,539 @@
+/**
+ * @file perft.c
+ * @author Faris Soliman
+ * This file is a tool that counts every legal continuation of a saved game to a given depth,
+ * playing and taking back every move with the rules in game.c. Every empty intersection is a
+ * legal move; one that ends the game is counted as a win, a forbidden move loss or a draw,
+ * and nothing is played after it. The counts only depend on the rules, so they are an oracle
+ * for changes to the rules, and the time they take is a benchmark of place and undo.
+ *
+ * The moves at the root are handed to a thread pool, each searched on its own copy of the
+ * game, and the counts of every root move are kept apart so they can be printed on their own.
+ * With -b, the moves of the last depth are played in batches with the rules of lockstep.c
+ * instead, one move on each of its boards, which gives the same counts in less time. With -f,
+ * every renju position with black to move is also checked for the search's quick test of
+ * forbidden moves, threat_forbidden(), giving the same answer as game_forbidden() everywhere,
+ * and for the rules forbidding the same moves under every symmetry of the board. With -p, the
+ * pattern codes of every position are checked against codes counted the slow way: a scan of
+ * the whole board with every kernel of pattern.c the processor runs, the scan the game keeps
+ * up to date move by move, and the census counted from them. Forcing a kernel forces it for
+ * every thread, so the positions are then counted on one thread.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "console.h"
+#include "error-codes.h"
+#include "game.h"
+#include "lockstep.h"
+#include "pattern.h"
+#include "pool.h"
+#include "search.h"
+#define PERFT_MAX_DEPTH 8
+
+typedef struct {
+    unsigned long long nodes;
+    unsigned long long black_wins;
+    unsigned long long white_wins;
+    unsigned long long forbidden;
+    unsigned long long draws;
+} perft_count;
+
+typedef struct {
+    game* root;
+    int depth;
+    unsigned char x;
+    unsigned char y;
+    bool batched;
+    bool check;
+    bool patterns;
+    bool failed;
+    perft_count counts[PERFT_MAX_DEPTH];
+    unsigned long long checked;
+    unsigned long long disagreed;
+    unsigned long long scanned;
+    unsigned long long mismatched;
+} perft_job;
+
+/**
+ * Counts a move that was just played.
+ * @param c The counts of its depth.
+ * @param state The state of the game after the move.
+ * @param winner The winner after the move.
+*/
+void static tally(perft_count* c, unsigned char state, unsigned char winner) {
+    c->nodes++;
+    if (state == GAME_STATE_FORBIDDEN) {
+        c->forbidden++;
+    } else if (state == GAME_STATE_FINISHED) {
+        if (winner == BLACK_STONE) {
+            c->black_wins++;
+        } else if (winner == WHITE_STONE) {
+            c->white_wins++;
+        } else {
+            c->draws++;
+        }
+    }
+}
+
+/**
+ * Plays a batch of moves on the boards of the batched rules, counts them and takes them back.
+ * @param l The boards.
+ * @param xs The x coordinates of the moves.
+ * @param ys The y coordinates of the moves.
+ * @param count The number of moves, up to LOCKSTEP_LANES.
+ * @param c The counts of their depth.
+*/
+void static tally_batch(lockstep* l, unsigned char* xs, unsigned char* ys, int count, perft_count* c) {
+    unsigned char outcomes[LOCKSTEP_LANES];
+    memset(xs + count, LOCKSTEP_PASS, LOCKSTEP_LANES - count);
+    lockstep_play(l, xs, ys, outcomes);
+    for (int lane = 0; lane < count; lane++) {
+        tally(c, l->state[lane], l->winner[lane]);
+    }
+    lockstep_undo(l, xs, ys, outcomes);
+}
+
+/**
+ * Counts every legal move of a position in batches, without playing them on the game.
+ * @param g The game.
+ * @param l The boards, of the size of the game.
+ * @param c The counts of the depth of the moves.
+*/
+void static perft_batched(game* g, lockstep* l, perft_count* c) {
+    unsigned char xs[LOCKSTEP_LANES];
+    unsigned char ys[LOCKSTEP_LANES];
+    int count = 0;
+    lockstep_load(l, LOCKSTEP_ALL, g);
+    unsigned char size = g->board->size;
+    for (unsigned char y = 0; y < size; y++) {
+        for (unsigned char x = 0; x < size; x++) {
+            if (board_get(g->board, x, y) != EMPTY_INTERSECTION) {
+                continue;
+            }
+            xs[count] = x;
+            ys[count] = y;
+            if (++count == LOCKSTEP_LANES) {
+                tally_batch(l, xs, ys, count, c);
+                count = 0;
+            }
+        }
+    }
+    if (count > 0) {
+        tally_batch(l, xs, ys, count, c);
+    }
+}
+
+/**
+ * Replays a game through a symmetry of the board.
+ * @param g The game.
+ * @param t The symmetry.
+ * @return The game as it would be seen through the symmetry, or NULL if it could not be
+ *         allocated or a move of it could not be played.
+*/
+game static* mirror(game* g, unsigned char t) {
+    game* m = game_create(g->board->size, g->type);
+    for (size_t i = 0; m != NULL && i < g->moves_count; i++) {
+        unsigned char x;
+        unsigned char y;
+        symmetry_apply(t, g->board->size, g->moves[i].x, g->moves[i].y, &x, &y);
+        if (game_place_stone(m, x, y) != SUCCESS || (m->state != GAME_STATE_PLAYING && i + 1 < g->moves_count)) {
+            game_delete(m);
+            m = NULL;
+        }
+    }
+    return m;
+}
+
+/**
+ * Checks the forbidden moves of a position, if black is to move in renju: that the threat
+ * map's quick test agrees with the rules on every empty intersection, and that the rules
+ * forbid the same intersections whichever way the board is turned or flipped. The last
+ * intersection is left out, since filling the board draws whatever the move makes.
+ * @param g The game.
+ * @param job The job, which counts the intersections checked and those that disagree.
+*/
+void static check_forbidden(game* g, perft_job* job) {
+    unsigned char size = g->board->size;
+    if (g->type != GAME_RENJU || g->stone != BLACK_STONE || g->moves_count + 1 >= (size_t)size * size) {
+        return;
+    }
+    game* mirrors[SYMMETRIES] = {NULL};
+    for (unsigned char t = 1; t < SYMMETRIES; t++) {
+        mirrors[t] = mirror(g, t);
+    }
+    for (unsigned char y = 0; y < size; y++) {
+        for (unsigned char x = 0; x < size; x++) {
+            if (board_get(g->board, x, y) != EMPTY_INTERSECTION) {
+                continue;
+            }
+            bool forbidden = game_forbidden(g, BLACK_STONE, x, y);
+            job->checked++;
+            job->disagreed += threat_forbidden(g->threats, g->rules, g->board, x, y) != forbidden;
+            for (unsigned char t = 1; t < SYMMETRIES; t++) {
+                unsigned char tx;
+                unsigned char ty;
+                symmetry_apply(t, size, x, y, &tx, &ty);
+                job->checked++;
+                job->disagreed += mirrors[t] == NULL || game_forbidden(mirrors[t], BLACK_STONE, tx, ty) != forbidden;
+            }
+        }
+    }
+    for (unsigned char t = 0; t < SYMMETRIES; t++) {
+        game_delete(mirrors[t]);
+    }
+}
+
+/**
+ * Counts the stones of a color in a window of a line, the slow way.
+ * @param b The board.
+ * @param stone The color.
+ * @param d The direction of the line.
+ * @param x The x coordinate of the intersection the line goes through.
+ * @param y The y coordinate of the intersection the line goes through.
+ * @param start The first intersection of the window, in steps from (x, y).
+ * @param length The length of the window.
+ * @return The number of stones of the color, or 0 if the window holds a stone of the other
+ *         color or leaves the board.
+*/
+unsigned char static window(board* b, unsigned char stone, int d, int x, int y, int start, int length) {
+    unsigned char own = 0;
+    for (int k = start; k < start + length; k++) {
+        int cx = x + k * pattern_dx[d];
+        int cy = y + k * pattern_dy[d];
+        if (cx < 0 || cx >= b->size || cy < 0 || cy >= b->size) {
+            return 0;
+        }
+        unsigned char here = b->grid[cy * b->size + cx];
+        if (here == stone) {
+            own++;
+        } else if (here != EMPTY_INTERSECTION) {
+            return 0;
+        }
+    }
+    return own;
+}
+
+/**
+ * Classifies the line through an intersection from its windows of five and six, counted one
+ * by one instead of with the sums of the scanner.
+ * @param b The board.
+ * @param stone The color to classify.
+ * @param d The direction.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The pattern code.
+*/
+unsigned char static classify_slow(board* b, unsigned char stone, int d, int x, int y) {
+    unsigned char empty = b->grid[y * b->size + x] == EMPTY_INTERSECTION;
+    unsigned char counts[5];
+    unsigned char best = 0;
+    unsigned char windows = 0;
+    unsigned char run = 0;
+    for (int k = 0; k < 5; k++) {
+        counts[k] = window(b, stone, d, x, y, -k, 5);
+        best = counts[k] > best ? counts[k] : best;
+    }
+    for (int k = 0; k < 5; k++) {
+        windows += counts[k] == best;
+    }
+    for (int k = 0; k < 6; k++) {
+        unsigned char own = window(b, stone, d, x, y, -k, 6);
+        run = own > run ? own : run;
+    }
+    return pattern_classify(best + empty, windows, run + empty);
+}
+
+/**
+ * Compares a scan of a position with the codes counted the slow way, code by code and census
+ * by census.
+ * @param slow The codes counted the slow way.
+ * @param s The scan.
+ * @param b The board.
+ * @param job The job, which counts the codes and censuses checked and those that disagree.
+*/
+void static compare_scan(const pattern_scan* slow, const pattern_scan* s, board* b, perft_job* job) {
+    for (int c = 0; c < 2; c++) {
+        for (int d = 0; d < DIRECTIONS; d++) {
+            for (int y = 0; y < b->size; y++) {
+                for (int x = 0; x < b->size; x++) {
+                    int i = y * slow->stride + x;
+                    job->scanned++;
+                    job->mismatched += s->codes[c][d][i] != slow->codes[c][d][i];
+                }
+            }
+        }
+        pattern_census expected;
+        pattern_census got;
+        pattern_count(slow, b, BLACK_STONE + c, &expected);
+        pattern_count(s, b, BLACK_STONE + c, &got);
+        job->scanned++;
+        job->mismatched += memcmp(&expected, &got, sizeof(pattern_census)) != 0;
+    }
+}
+
+/**
+ * Checks the pattern scanner on a position: every kernel the processor runs, and the scan the
+ * game keeps up to date, against the codes counted the slow way.
+ * @param g The game.
+ * @param job The job, which counts the codes and censuses checked and those that disagree.
+*/
+void static check_patterns(game* g, perft_job* job) {
+    static const char* const names[] = {"avx2", "sse2", "scalar"};
+    board* b = g->board;
+    pattern_scan slow;
+    slow.size = b->size;
+    slow.stride = b->size + 1;
+    for (int c = 0; c < 2; c++) {
+        for (int d = 0; d < DIRECTIONS; d++) {
+            for (int y = 0; y < b->size; y++) {
+                for (int x = 0; x < b->size; x++) {
+                    slow.codes[c][d][y * slow.stride + x] = classify_slow(b, BLACK_STONE + c, d, x, y);
+                }
+            }
+        }
+    }
+
+    const char* chosen = pattern_kernel();
+    for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+        if (pattern_use_kernel(names[k])) {
+            pattern_scan fast;
+            pattern_scan_board(b, &fast);
+            compare_scan(&slow, &fast, b, job);
+        }
+    }
+    pattern_use_kernel(chosen);
+    compare_scan(&slow, &g->threats->scan, b, job);
+}
+
+/**
+ * Plays and takes back every legal move of a position, and every continuation of the moves
+ * that do not end the game, down to the depth.
+ * @param g The game, which is back in the same position when this returns.
+ * @param l The boards to count the last depth on, or NULL to play it on the game.
+ * @param ply The depth of the moves to play, from 0 at the root.
+ * @param depth The number of plies to count.
+ * @param job The job, with the counts of every depth.
+ * @return Whether every move could be played.
+*/
+bool static perft(game* g, lockstep* l, int ply, int depth, perft_job* job) {
+    perft_count* counts = job->counts;
+    if (job->check) {
+        check_forbidden(g, job);
+    }
+    if (job->patterns) {
+        check_patterns(g, job);
+    }
+    if (l != NULL && ply + 1 == depth) {
+        perft_batched(g, l, &counts[ply]);
+        return true;
+    }
+
+    unsigned char size = g->board->size;
+    for (unsigned char y = 0; y < size; y++) {
+        for (unsigned char x = 0; x < size; x++) {
+            if (board_get(g->board, x, y) != EMPTY_INTERSECTION) {
+                continue;
+            }
+            if (game_place_stone(g, x, y) != SUCCESS) {
+                return false;
+            }
+            tally(&counts[ply], g->state, g->winner);
+            bool ok = g->state != GAME_STATE_PLAYING || ply + 1 >= depth || perft(g, l, ply + 1, depth, job);
+            game_undo(g);
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Counts the continuations of one root move on a copy of the game.
+ * @param arg The perft_job.
+ * @param worker The worker running the job.
+*/
+void static run_root(void* arg, int worker) {
+    perft_job* job = arg;
+    game* g = game_copy(job->root);
+    if (g == NULL || game_place_stone(g, job->x, job->y) != SUCCESS) {
+        job->failed = true;
+        game_delete(g);
+        return;
+    }
+
+    // Boards larger than the batched rules take are counted on the game.
+    lockstep* l = NULL;
+    if (job->batched && (l = malloc(sizeof(lockstep))) != NULL && !lockstep_init(l, g->board->size, g->type)) {
+        free(l);
+        l = NULL;
+    }
+
+    tally(&job->counts[0], g->state, g->winner);
+    if (g->state == GAME_STATE_PLAYING && job->depth > 1) {
+        job->failed = !perft(g, l, 1, job->depth, job);
+    }
+    free(l);
+    game_delete(g);
+}
+
+/**
+ * Adds up counts.
+ * @param total The counts to add to.
+ * @param c The counts to add.
+*/
+void static add_counts(perft_count* total, const perft_count* c) {
+    total->nodes += c->nodes;
+    total->black_wins += c->black_wins;
+    total->white_wins += c->white_wins;
+    total->forbidden += c->forbidden;
+    total->draws += c->draws;
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    bool divide = false;
+    bool batched = false;
+    bool check = false;
+    bool patterns = false;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-j") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            threads = atoi(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-d") == 0) {
+            divide = true;
+            first++;
+        } else if (strcmp(argv[first], "-b") == 0) {
+            batched = true;
+            first++;
+        } else if (strcmp(argv[first], "-f") == 0) {
+            check = true;
+            first++;
+        } else if (strcmp(argv[first], "-p") == 0) {
+            patterns = true;
+            first++;
+        } else if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+        } else {
+            first = argc;
+        }
+    }
+    int depth = first + 2 == argc ? atoi(argv[first]) : 0;
+    if (depth < 1 || depth > PERFT_MAX_DEPTH) {
+        fprintf(stdout, "usage: %s [-j threads] [-d] [-b] [-f] [-p] [-q] <depth 1-%d> <saved-match.gmk>\n", argv[0], PERFT_MAX_DEPTH);
+        return ARGUMENT_ERR;
+    }
+
+    if (patterns) {
+        threads = 1;
+    }
+
+    // Load the position. A stopped game goes on from where it stopped.
+    game* root = console_import(argv[first + 1]);
+    if (root->state == GAME_STATE_STOPPED) {
+        root->state = GAME_STATE_PLAYING;
+    }
+
+    // Hand every root move to the pool.
+    unsigned char size = root->board->size;
+    perft_job* jobs = calloc((size_t)size * size, sizeof(perft_job));
+    pool* p = pool_create(threads);
+    if (jobs == NULL || p == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    long long start = search_clock();
+    int count = 0;
+    for (unsigned char y = 0; root->state == GAME_STATE_PLAYING && y < size; y++) {
+        for (unsigned char x = 0; x < size; x++) {
+            if (board_get(root->board, x, y) != EMPTY_INTERSECTION) {
+                continue;
+            }
+            perft_job* job = &jobs[count++];
+            job->root = root;
+            job->depth = depth;
+            job->x = x;
+            job->y = y;
+            job->batched = batched;
+            job->check = check;
+            job->patterns = patterns;
+            if (!pool_submit(p, run_root, job)) {
+                return NULL_POINTER_ERR;
+            }
+        }
+    }
+    pool_wait(p);
+    pool_delete(p);
+    long long elapsed = search_clock() - start;
+
+    // Add up and print the counts.
+    perft_count total[PERFT_MAX_DEPTH];
+    memset(total, 0, sizeof(total));
+    perft_job checks;
+    memset(&checks, 0, sizeof(checks));
+    if (check) {
+        check_forbidden(root, &checks);
+    }
+    if (patterns) {
+        check_patterns(root, &checks);
+    }
+    unsigned long long checked = checks.checked;
+    unsigned long long disagreed = checks.disagreed;
+    unsigned long long scanned = checks.scanned;
+    unsigned long long mismatched = checks.mismatched;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].failed) {
+            return NULL_POINTER_ERR;
+        }
+        checked += jobs[i].checked;
+        disagreed += jobs[i].disagreed;
+        scanned += jobs[i].scanned;
+        mismatched += jobs[i].mismatched;
+        for (int d = 0; d < depth; d++) {
+            add_counts(&total[d], &jobs[i].counts[d]);
+        }
+    }
+
+    if (divide) {
+        for (int i = 0; i < count; i++) {
+            printf("%c%-3d %14llu\n", jobs[i].x + 'A', jobs[i].y + 1, jobs[i].counts[depth - 1].nodes);
+        }
+        printf("\n");
+    }
+    printf("Depth           Nodes      Black wins      White wins       Forbidden           Draws\n");
+    unsigned long long nodes = 0;
+    for (int d = 0; d < depth; d++) {
+        printf("%5d  %14llu  %14llu  %14llu  %14llu  %14llu\n", d + 1, total[d].nodes, total[d].black_wins,
+            total[d].white_wins, total[d].forbidden, total[d].draws);
+        nodes += total[d].nodes;
+    }
+    if (check) {
+        printf("\nForbidden checks:    %llu, %llu disagree\n", checked, disagreed);
+    }
+    if (patterns) {
+        printf("%sPattern checks:      %llu, %llu disagree\n", check ? "" : "\n", scanned, mismatched);
+    }
+    if (!quiet) {
+        printf("\n%llu nodes in %lld ms, %.0f nodes/sec", nodes, elapsed, elapsed > 0 ? nodes * 1000.0 / elapsed : 0.0);
+        if (batched) {
+            printf(", last depth batched with %s", lockstep_kernel());
+        }
+        printf("\n");
+    }
+
+    free(jobs);
+    game_delete(root);
+    return SUCCESS;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file playout.c
+ * @author Faris Soliman
+ * This file contains the random game generator, which plays games of random but legal moves
+ * for building synthetic corpora. A game is played on a bare grid with the rule kernels of
+ * rules.c, without the threat map, the evaluation or the hashes a game keeps, so millions of
+ * games take seconds. It ends as game_place_stone() would end it: with a five, a full board,
+ * or a forbidden move, which black only plays in renju when nothing else is left. Otherwise it
+ * is stopped at a length drawn between a minimum and a maximum.
+ *
+ * The first PLAYOUT_OPENING_MOVES moves are played near the centre, and after that most moves
+ * are played within PLAYOUT_REACH of a stone already on the board, so the games look more like
+ * real games than stones scattered over the board, and many end in a five.
+ *
+ * Every game has its own generator, seeded from the seed of the run and the number of the game,
+ * so a game is the same whatever thread plays it, and any game of a run can be played again
+ * on its own.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "board.h"
+#include "game.h"
+#include "playout.h"
+#include "rules.h"
+
+typedef struct {
+    const playout_options* o;
+    const rules_kernel* rules;
+    uint64_t state;
+    unsigned char grid[PARSE_MAX_MOVES];
+    int empty[PARSE_MAX_MOVES];
+    int where[PARSE_MAX_MOVES];
+    int empty_count;
+} playout;
+
+/**
+ * Draws the next number of a xorshift64* generator.
+ * @param p The playout.
+ * @return The number.
+*/
+uint64_t static next_random(playout* p) {
+    p->state ^= p->state >> 12;
+    p->state ^= p->state << 25;
+    p->state ^= p->state >> 27;
+    return p->state * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Draws a number below a bound.
+ * @param p The playout.
+ * @param bound The bound, above 0.
+ * @return The number.
+*/
+int static below(playout* p, int bound) {
+    return (int)((next_random(p) >> 32) * bound >> 32);
+}
+
+/**
+ * Mixes a number into a well distributed 64 bit number (the splitmix64 finalizer).
+ * @param z The number to mix.
+ * @return The mixed number.
+*/
+uint64_t static mix(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Checks if a move can be played: the intersection is empty and, for black in renju, the move
+ * is not forbidden, as game_forbidden() decides.
+ * @param p The playout.
+ * @param r The game so far.
+ * @param index The index of the intersection.
+ * @param stone The color to move.
+ * @return Whether the move can be played.
+*/
+bool static legal(playout* p, const parse_record* r, int index, unsigned char stone) {
+    if (p->grid[index] != EMPTY_INTERSECTION) {
+        return false;
+    }
+    if (r->type != GAME_RENJU || stone != BLACK_STONE) {
+        return true;
+    }
+
+    unsigned char size = r->size;
+    unsigned char x = index % size;
+    unsigned char y = index / size;
+    p->grid[index] = BLACK_STONE;
+    bool forbidden = p->rules->overline(p->grid, size, x, y, BLACK_STONE) ||
+        (!p->rules->five(p->grid, size, x, y, BLACK_STONE) && r->count + 1 < (size_t)size * size &&
+        p->rules->double_four(p->grid, size, x, y, BLACK_STONE));
+    p->grid[index] = EMPTY_INTERSECTION;
+    return !forbidden;
+}
+
+/**
+ * Chooses the next move: near the centre in the opening, near a stone on the board most of
+ * the time after it, and anywhere otherwise, or when a few tries find nothing legal there.
+ * @param p The playout.
+ * @param r The game so far.
+ * @param stone The color to move.
+ * @return The index of the intersection, which is only illegal if every empty one is.
+*/
+int static choose(playout* p, const parse_record* r, unsigned char stone) {
+    int size = r->size;
+    if (r->count < PLAYOUT_OPENING_MOVES) {
+        int side = 2 * p->o->opening + 1;
+        for (int i = 0; i < PLAYOUT_TRIES; i++) {
+            int x = size / 2 - p->o->opening + below(p, side);
+            int y = size / 2 - p->o->opening + below(p, side);
+            if (x >= 0 && x < size && y >= 0 && y < size && legal(p, r, y * size + x, stone)) {
+                return y * size + x;
+            }
+        }
+    } else if (below(p, 100) < p->o->near) {
+        int side = 2 * PLAYOUT_REACH + 1;
+        for (int i = 0; i < PLAYOUT_TRIES; i++) {
+            int m = below(p, r->count);
+            int x = r->x[m] - PLAYOUT_REACH + below(p, side);
+            int y = r->y[m] - PLAYOUT_REACH + below(p, side);
+            if (x >= 0 && x < size && y >= 0 && y < size && legal(p, r, y * size + x, stone)) {
+                return y * size + x;
+            }
+        }
+    }
+
+    for (int i = 0; i < PLAYOUT_TRIES; i++) {
+        int index = p->empty[below(p, p->empty_count)];
+        if (legal(p, r, index, stone)) {
+            return index;
+        }
+    }
+
+    // Crowded with forbidden intersections: look through all of them from a random one.
+    int start = below(p, p->empty_count);
+    for (int i = 0; i < p->empty_count; i++) {
+        int index = p->empty[(start + i) % p->empty_count];
+        if (legal(p, r, index, stone)) {
+            return index;
+        }
+    }
+    return p->empty[start];
+}
+
+/**
+ * Plays a random game.
+ * @param o The options: the board size and rules, the range of lengths to stop at, with 0 for
+ *        the maximum to play until the game ends, the distance from the centre of the opening
+ *        moves, and the percentage of moves played near a stone.
+ * @param seed The seed of the run.
+ * @param number The number of the game in the run.
+ * @param r Where to put the game, with its state and winner.
+*/
+void playout_game(const playout_options* o, uint64_t seed, uint64_t number, parse_record* r) {
+    playout p;
+    p.o = o;
+    p.rules = rules_select(o->size);
+    p.state = mix(seed ^ mix(number)) | 1;
+    int cells = o->size * o->size;
+    memset(p.grid, EMPTY_INTERSECTION, cells);
+    for (int i = 0; i < cells; i++) {
+        p.empty[i] = i;
+        p.where[i] = i;
+    }
+    p.empty_count = cells;
+
+    r->format = PARSE_FORMAT_GMK;
+    r->size = o->size;
+    r->type = o->type;
+    r->state = GAME_STATE_PLAYING;
+    r->winner = EMPTY_INTERSECTION;
+    r->count = 0;
+    int length = cells;
+    if (o->max_moves > 0) {
+        length = o->min_moves + below(&p, o->max_moves - o->min_moves + 1);
+    }
+
+    unsigned char stone = BLACK_STONE;
+    while (r->state == GAME_STATE_PLAYING) {
+        if ((int)r->count == length) {
+            r->state = GAME_STATE_STOPPED;
+            break;
+        }
+
+        int index = choose(&p, r, stone);
+        unsigned char x = index % o->size;
+        unsigned char y = index / o->size;
+        p.grid[index] = stone;
+        int last = p.empty[--p.empty_count];
+        p.empty[p.where[index]] = last;
+        p.where[last] = p.where[index];
+        r->x[r->count] = x;
+        r->y[r->count] = y;
+        r->line[r->count] = 0;
+        r->count++;
+
+        // The same checks, in the same order, as game_place_stone().
+        bool renju_black = o->type == GAME_RENJU && stone == BLACK_STONE;
+        if (renju_black && p.rules->overline(p.grid, o->size, x, y, stone)) {
+            r->state = GAME_STATE_FORBIDDEN;
+            r->winner = WHITE_STONE;
+        } else if (p.rules->five(p.grid, o->size, x, y, stone)) {
+            r->state = GAME_STATE_FINISHED;
+            r->winner = stone;
+        } else if (p.empty_count == 0) {
+            r->state = GAME_STATE_FINISHED;
+        } else if (renju_black && p.rules->double_four(p.grid, o->size, x, y, stone)) {
+            r->state = GAME_STATE_FORBIDDEN;
+            r->winner = WHITE_STONE;
+        }
+        stone = stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+    }
+}
+
+/**
+ * Writes a game in the format game_export() writes.
+ * @param r The game.
+ * @param out Where to write it, with room for PLAYOUT_TEXT bytes.
+ * @return The number of bytes written.
+*/
+size_t playout_format(const parse_record* r, char* out) {
+    size_t n = sprintf(out, "GA\n%u\n%d\n%d\n%d\n", r->size, r->type, r->state, r->winner);
+    for (size_t i = 0; i < r->count; i++) {
+        n += sprintf(out + n, "%c%d\n", r->x[i] + 'A', r->y[i] + 1);
+    }
+    return n;
+}
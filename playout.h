@@ -0,0 +1,23 @@
+#ifndef _PLAYOUT_H_
+#define _PLAYOUT_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "parse.h"
+#define PLAYOUT_OPENING_MOVES 3
+#define PLAYOUT_REACH 2
+#define PLAYOUT_TRIES 8
+#define PLAYOUT_TEXT (16 + PARSE_MAX_MOVES * 4)
+
+typedef struct {
+    unsigned char size;
+    unsigned char type;
+    int min_moves;
+    int max_moves;
+    int opening;
+    int near;
+} playout_options;
+
+void playout_game(const playout_options* o, uint64_t seed, uint64_t number, parse_record* r);
+size_t playout_format(const parse_record* r, char* out);
+#endif
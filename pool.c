@@ -0,0 +1,191 @@
+/**
+ * @file pool.c
+ * @author Faris Soliman
+ * This file contains a fixed size thread pool for the batch tools. Jobs wait in a bounded
+ * queue, so a producer that finds work faster than the workers finish it blocks instead of
+ * piling up memory. Every job is told the number of the worker running it, so it can keep
+ * per worker results without locking.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+typedef struct {
+    pool* p;
+    int worker;
+} worker_start;
+
+/**
+ * Gets the number of workers to use when the user does not say: one per online processor.
+ * @return The number of workers.
+*/
+int pool_default_threads(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/**
+ * The body of a worker thread: runs jobs until the pool closes and the queue is empty.
+ * @param arg The worker_start of the thread, which the thread frees.
+ * @return Nothing.
+*/
+void static* pool_worker(void* arg) {
+    worker_start* start = arg;
+    pool* p = start->p;
+    int worker = start->worker;
+    free(start);
+
+    pthread_mutex_lock(&p->lock);
+    while (true) {
+        while (p->head == NULL && !p->closing) {
+            pthread_cond_wait(&p->ready, &p->lock);
+        }
+        if (p->head == NULL) {
+            break;
+        }
+
+        pool_job* job = p->head;
+        p->head = job->next;
+        if (p->head == NULL) {
+            p->tail = NULL;
+        }
+        p->queued--;
+        p->running++;
+        pthread_cond_signal(&p->space);
+        pthread_mutex_unlock(&p->lock);
+
+        job->task(job->arg, worker);
+        free(job);
+
+        pthread_mutex_lock(&p->lock);
+        p->running--;
+        if (p->head == NULL && p->running == 0) {
+            pthread_cond_broadcast(&p->idle);
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/**
+ * Creates a thread pool.
+ * @param threads The number of worker threads.
+ * @return The new pool, or NULL if it or its threads could not be created.
+*/
+pool* pool_create(int threads) {
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    pool* p = malloc(sizeof(pool));
+    if (p == NULL) {
+        return NULL;
+    }
+    p->threads = malloc(sizeof(pthread_t) * threads);
+    if (p->threads == NULL) {
+        free(p);
+        return NULL;
+    }
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->ready, NULL);
+    pthread_cond_init(&p->space, NULL);
+    pthread_cond_init(&p->idle, NULL);
+    p->head = NULL;
+    p->tail = NULL;
+    p->queued = 0;
+    p->running = 0;
+    p->closing = false;
+    p->count = 0;
+
+    for (int i = 0; i < threads; i++) {
+        worker_start* start = malloc(sizeof(worker_start));
+        if (start == NULL) {
+            break;
+        }
+        start->p = p;
+        start->worker = i;
+        if (pthread_create(&p->threads[i], NULL, pool_worker, start) != 0) {
+            free(start);
+            break;
+        }
+        p->count++;
+    }
+
+    if (p->count < threads) {
+        pool_delete(p);
+        return NULL;
+    }
+    return p;
+}
+
+/**
+ * Runs the jobs still queued, stops the workers and deletes the pool.
+ * @param p The pool to delete.
+*/
+void pool_delete(pool* p) {
+    if (p == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->closing = true;
+    pthread_cond_broadcast(&p->ready);
+    pthread_mutex_unlock(&p->lock);
+    for (int i = 0; i < p->count; i++) {
+        pthread_join(p->threads[i], NULL);
+    }
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->ready);
+    pthread_cond_destroy(&p->space);
+    pthread_cond_destroy(&p->idle);
+    free(p->threads);
+    free(p);
+}
+
+/**
+ * Queues a job, waiting while the queue is full.
+ * @param p The pool.
+ * @param task The function to run.
+ * @param arg The argument to run it with.
+ * @return Whether the job was queued.
+*/
+bool pool_submit(pool* p, pool_task task, void* arg) {
+    pool_job* job = malloc(sizeof(pool_job));
+    if (job == NULL) {
+        return false;
+    }
+    job->task = task;
+    job->arg = arg;
+    job->next = NULL;
+
+    pthread_mutex_lock(&p->lock);
+    while (p->queued >= POOL_QUEUE_LIMIT) {
+        pthread_cond_wait(&p->space, &p->lock);
+    }
+    if (p->tail == NULL) {
+        p->head = job;
+    } else {
+        p->tail->next = job;
+    }
+    p->tail = job;
+    p->queued++;
+    pthread_cond_signal(&p->ready);
+    pthread_mutex_unlock(&p->lock);
+    return true;
+}
+
+/**
+ * Waits until every queued job has finished.
+ * @param p The pool.
+*/
+void pool_wait(pool* p) {
+    pthread_mutex_lock(&p->lock);
+    while (p->head != NULL || p->running > 0) {
+        pthread_cond_wait(&p->idle, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
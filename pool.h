@@ -0,0 +1,34 @@
+#ifndef _POOL_H_
+#define _POOL_H_
+#include <pthread.h>
+#include <stdbool.h>
+#define POOL_QUEUE_LIMIT 64
+
+typedef void (*pool_task)(void* arg, int worker);
+
+typedef struct pool_job {
+    pool_task task;
+    void* arg;
+    struct pool_job* next;
+} pool_job;
+
+typedef struct {
+    pthread_t* threads;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    pthread_cond_t idle;
+    pool_job* head;
+    pool_job* tail;
+    int queued;
+    int running;
+    bool closing;
+} pool;
+
+int pool_default_threads(void);
+pool* pool_create(int threads);
+void pool_delete(pool* p);
+bool pool_submit(pool* p, pool_task task, void* arg);
+void pool_wait(pool* p);
+#endif
@@ -3,13 +3,27 @@
  * @author Faris Soliman
  * This file creates and manages a renju game
 */
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "broadcast.h"
+#include "console.h"
+#include "engine.h"
 #include "game.h"
 #include "io.h"
+#include "journal.h"
 #include "error-codes.h"
 
+/**
+ * Prints how to use the program.
+ * @param name The name the program was run with.
+ */
+void static usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-o /path/to/file] [-r /path/to/file] [-b size] [-c black|white] [-t ms] [-l nodes] [-k /path/to/cache] [-n /path/to/network] [-a /path/to/journal] [-s moves] [-w ms] [-x name]\n", name);
+}
+
 /**
  * The main function.
  * @param argc The number of arguments.
@@ -19,9 +33,9 @@
 int main(int argc, char** argv) 
 {
     // Check the number of arguments.
-    if (argc < 1 || argc > 7) 
+    if (argc < 1 || argc > 25) 
     {
-        fprintf(stderr, "usage: %s [-o /path/to/file] [-r /path/to/file] [-b size]\n", argv[0]);
+        usage(argv[0]);
         return ARGUMENT_ERR;
     }
 
@@ -29,6 +43,16 @@ int main(int argc, char** argv)
     int size = 15;
     char* saveFile = NULL;
     char* loadFile = NULL;
+    unsigned char computer = EMPTY_INTERSECTION;
+    long think = ENGINE_THINK_MS;
+    unsigned long nodes = 0;
+    char* cacheFile = NULL;
+    char* networkFile = NULL;
+    char* journalFile = NULL;
+    char* broadcastName = NULL;
+    int syncMoves = JOURNAL_SYNC_MOVES;
+    long syncMs = JOURNAL_SYNC_MS;
+    bool syncSet = false;
 
     for (int i = 0; i < argc; i++) {
         if (strcmp(argv[i], "-r") == 0) {
@@ -45,7 +69,7 @@ int main(int argc, char** argv)
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-o") == 0) {
             if (i + 1 >= argc) {
-                fprintf(stderr, "usage: %s [-o /path/to/file] [-r /path/to/file] [-b size]\n", argv[0]);
+                usage(argv[0]);
                 return ARGUMENT_ERR;
             }
             saveFile = argv[i + 1];
@@ -54,7 +78,7 @@ int main(int argc, char** argv)
         else if (strcmp(argv[i], "-r") == 0) {
             if (i + 1 >= argc) 
             {
-                fprintf(stderr, "usage: %s [-o /path/to/file] [-r /path/to/file] [-b size]\n", argv[0]);
+                usage(argv[0]);
                 return ARGUMENT_ERR;
             }
             loadFile = argv[i + 1];
@@ -63,7 +87,7 @@ int main(int argc, char** argv)
         else if (strcmp(argv[i], "-b") == 0) {
             if (i + 1 >= argc) 
             {
-                fprintf(stderr, "usage: %s [-o /path/to/file] [-r /path/to/file] [-b size]\n", argv[0]);
+                usage(argv[0]);
                 return ARGUMENT_ERR;
             }
             size = atoi(argv[i + 1]);
@@ -77,20 +101,139 @@ int main(int argc, char** argv)
             }
             i++;
         } 
+        else if (strcmp(argv[i], "-c") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            if (strcmp(argv[i + 1], "black") == 0) {
+                computer = BLACK_STONE;
+            } else if (strcmp(argv[i + 1], "white") == 0) {
+                computer = WHITE_STONE;
+            } else {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "-t") == 0) {
+            if (i + 1 >= argc || atol(argv[i + 1]) <= 0) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            think = atol(argv[i + 1]);
+            i++;
+        }
+        else if (strcmp(argv[i], "-l") == 0) {
+            if (i + 1 >= argc || atol(argv[i + 1]) <= 0) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            nodes = strtoul(argv[i + 1], NULL, 10);
+            i++;
+        }
+        else if (strcmp(argv[i], "-k") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            cacheFile = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "-n") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            networkFile = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "-a") == 0) {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            journalFile = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            syncMoves = atoi(argv[i + 1]);
+            syncSet = true;
+            i++;
+        }
+        else if (strcmp(argv[i], "-w") == 0) {
+            if (i + 1 >= argc || atol(argv[i + 1]) < 0 || argv[i + 1][0] < '0' || argv[i + 1][0] > '9') {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            syncMs = atol(argv[i + 1]);
+            syncSet = true;
+            i++;
+        }
+        else if (strcmp(argv[i], "-x") == 0) {
+            if (i + 1 >= argc || argv[i + 1][0] != '/') {
+                usage(argv[0]);
+                return ARGUMENT_ERR;
+            }
+            broadcastName = argv[i + 1];
+            i++;
+        }
         else {
-            fprintf(stderr, "usage: %s [-o /path/to/file] [-r /path/to/file] [-b size]\n", argv[0]);
+            usage(argv[0]);
             return ARGUMENT_ERR;
         }
     }
 
+    // The node budget, the cache and the network are only used by the computer opponent.
+    if ((nodes > 0 || cacheFile != NULL || networkFile != NULL) && computer == EMPTY_INTERSECTION) {
+        usage(argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // How often to sync only means something with a journal.
+    if (syncSet && journalFile == NULL) {
+        usage(argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // Set up the computer opponent if necessary.
+    engine* opponent = NULL;
+    if (computer != EMPTY_INTERSECTION) {
+        opponent = engine_create(computer, think);
+        if (opponent == NULL) {
+            return NULL_POINTER_ERR;
+        }
+        engine_use_nodes(opponent, nodes);
+        if (cacheFile != NULL && !engine_use_cache(opponent, cacheFile)) {
+            engine_delete(opponent);
+            return FILE_INPUT_ERR;
+        }
+        if (networkFile != NULL && !engine_use_network(opponent, networkFile)) {
+            engine_delete(opponent);
+            return FILE_INPUT_ERR;
+        }
+    }
+
     // Create the game.
     game* game = NULL;
 
     // Load the game if necessary.
     if (loadFile != NULL) {
-        game = game_import(loadFile);
+        game = console_import(loadFile);
         if (game->state != GAME_STATE_FINISHED && game->state != GAME_STATE_FORBIDDEN) {
             board_print(game->board, true);
+            game->engine = opponent;
+            if (journalFile != NULL && (game->journal = journal_open(journalFile, game, syncMoves, syncMs)) == NULL) {
+                return FILE_OUTPUT_ERR;
+            }
+            if (broadcastName != NULL && (game->broadcast = broadcast_open(broadcastName, game)) == NULL) {
+                fprintf(stderr, errno == EBUSY ? "A game is already broadcasting as %s\n" : "Cannot broadcast as %s\n", broadcastName);
+                return FILE_OUTPUT_ERR;
+            }
             game_resume(game);
         } else {
             return RESUME_ERR;
@@ -99,14 +242,35 @@ int main(int argc, char** argv)
     else 
     {
         game = game_create(size, GAME_RENJU);
+        if (game == NULL) {
+            return NULL_POINTER_ERR;
+        }
+        game->engine = opponent;
+        if (journalFile != NULL && (game->journal = journal_open(journalFile, game, syncMoves, syncMs)) == NULL) {
+            return FILE_OUTPUT_ERR;
+        }
+        if (broadcastName != NULL && (game->broadcast = broadcast_open(broadcastName, game)) == NULL) {
+            fprintf(stderr, errno == EBUSY ? "A game is already broadcasting as %s\n" : "Cannot broadcast as %s\n", broadcastName);
+            return FILE_OUTPUT_ERR;
+        }
         board_print(game->board, true);
         game_loop(game);
     }
 
+    // Show spectators how the game ended.
+    broadcast_close(game->broadcast, game);
+
+    // Finish the journal with the final state of the game.
+    if (!journal_close(game->journal, game)) {
+        return FILE_OUTPUT_ERR;
+    }
+
     // Save the game if necessary.
     if (saveFile != NULL) 
     {
-        game_export(game, saveFile);
+        if (game_export(game, saveFile) != SUCCESS) {
+            return FILE_OUTPUT_ERR;
+        }
     }
 
     if (GAME_STATE_FINISHED == game->state) 
@@ -118,6 +282,7 @@ int main(int argc, char** argv)
 
     // Delete the game.
     game_delete(game);
+    engine_delete(opponent);
 
     return SUCCESS;
 }
\ No newline at end of file
@@ -6,11 +6,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "analysis.h"
 #include "board.h"
+#include "cache.h"
+#include "console.h"
 #include "game.h"
 #include <unistd.h>
 #include "error-codes.h"
 #include "io.h"
+#include "pool.h"
 
 /**
  * The main function.
@@ -19,29 +23,67 @@
  * @return The exit code.
 */
 int main(int argc, char** argv) {
-    // Check the number of arguments.
-    if (argc != 2) {
-        fprintf(stdout, "usage: %s <saved-match.gmk>\n", argv[0]);
+    // Check the arguments.
+    bool eval = argc == 3 && strcmp(argv[1], "--eval") == 0;
+    bool analyze = argc >= 3 && strcmp(argv[1], "--analyze") == 0;
+    int threads = pool_default_threads();
+    unsigned long maxNodes = ANALYSIS_NODES;
+    long timeMs = 0;
+    char* cacheFile = NULL;
+    bool valid = argc == 2 || eval || analyze;
+    for (int i = 2; analyze && valid && i < argc - 1; i += 2) {
+        if (i + 1 >= argc - 1 || atol(argv[i + 1]) < 0) {
+            valid = false;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && atoi(argv[i + 1]) > 0) {
+            threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-n") == 0) {
+            maxNodes = strtoul(argv[i + 1], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-t") == 0) {
+            timeMs = atol(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "-k") == 0) {
+            cacheFile = argv[i + 1];
+        }
+        else {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        fprintf(stdout, "usage: %s [--eval | --analyze [-j threads] [-n nodes] [-t ms] [-k /path/to/cache]] <saved-match.gmk>\n", argv[0]);
         return ARGUMENT_ERR;
     }
 
     // Load the saved game
-    game* savedGame = game_import(argv[1]);
+    game* savedGame = console_import(argv[argc - 1]);
 
-    if (savedGame == NULL) {
-        printf("Failed to load the saved game.\n");
-        return FILE_INPUT_ERR;
+    // Print the evaluation after every move instead of replaying the boards
+    if (eval) {
+        game_replay_eval(savedGame);
+        game_delete(savedGame);
+        return SUCCESS;
     }
 
-    game* replayGame = game_create(savedGame->board->size, savedGame->type);
-    replayGame->state = savedGame->state;
-    replayGame->winner = savedGame->winner;
+    // Analyse every move with the engine
+    if (analyze) {
+        cache* solved = NULL;
+        if (cacheFile != NULL && (solved = cache_open(cacheFile, CACHE_SLOTS)) == NULL) {
+            game_delete(savedGame);
+            return FILE_INPUT_ERR;
+        }
+        bool ok = game_replay_analyze(savedGame, threads, maxNodes, timeMs, solved);
+        cache_close(solved);
+        game_delete(savedGame);
+        return ok ? SUCCESS : NULL_POINTER_ERR;
+    }
 
     // Replay the game
     game_replay(savedGame);
 
     // Delete the game
-    game_delete(replayGame);
+    game_delete(savedGame);
 
     return SUCCESS;
-}
\ No newline at end of file
+}
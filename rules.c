@@ -0,0 +1,169 @@
+/**
+ * @file rules.c
+ * @author Faris Soliman
+ * This file contains the rule checks game_place_stone() runs on every move: whether the move
+ * makes five in a row, an overline, or more than one open four. Each check walks the four
+ * lines through the move, at most RULES_REACH intersections either way.
+ *
+ * The checks are written once, with the board size as a parameter, and compiled again for
+ * every standard size with the size as a constant, so the strides between the intersections
+ * of a line and the bounds of the walk are constants the compiler can fold and unroll. A game
+ * picks the kernel for its size once, when it is created; other sizes use the generic one.
+*/
+#include <stddef.h>
+#include "board.h"
+#include "rules.h"
+
+/**
+ * Gets the part of a line through an intersection that is on the board.
+ * @param size The board size.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @param dx The step in x, 0 or 1.
+ * @param dy The step in y, -1, 0 or 1.
+ * @param lo Where to put the first step on the board, from -RULES_REACH.
+ * @param hi Where to put the last step on the board, up to RULES_REACH.
+*/
+__attribute__((always_inline))
+static inline void line_bounds(int size, int x, int y, int dx, int dy, int* lo, int* hi) {
+    *lo = -RULES_REACH;
+    *hi = RULES_REACH;
+    if (dx == 1) {
+        *lo = -x > *lo ? -x : *lo;
+        *hi = size - 1 - x < *hi ? size - 1 - x : *hi;
+    }
+    if (dy == 1) {
+        *lo = -y > *lo ? -y : *lo;
+        *hi = size - 1 - y < *hi ? size - 1 - y : *hi;
+    } else if (dy == -1) {
+        *lo = y - (size - 1) > *lo ? y - (size - 1) : *lo;
+        *hi = y < *hi ? y : *hi;
+    }
+}
+
+/**
+ * Measures the run of a stone through a move along a line, up to RULES_REACH intersections
+ * either way. Every earlier move was checked, so there is no five or longer of the color to
+ * move anywhere else on the board: a five or overline the move makes runs through it, and
+ * the run through it is all there is to look at.
+ * @param grid The board grid.
+ * @param size The board size.
+ * @param x The x coordinate of the move.
+ * @param y The y coordinate of the move.
+ * @param dx The step in x.
+ * @param dy The step in y.
+ * @param stone The stone.
+ * @return The length of the run, counting the move.
+*/
+__attribute__((always_inline))
+static inline int line_run(const unsigned char* grid, int size, int x, int y, int dx, int dy, unsigned char stone) {
+    int lo;
+    int hi;
+    line_bounds(size, x, y, dx, dy, &lo, &hi);
+    const unsigned char* p = grid + y * size + x;
+    int step = dy * size + dx;
+    int run = 1;
+    for (int k = 1; k <= hi && p[k * step] == stone; k++) {
+        run++;
+    }
+    for (int k = -1; k >= lo && p[k * step] == stone; k--) {
+        run++;
+    }
+    return run;
+}
+
+/**
+ * Checks if an intersection of a line is on the board and empty.
+ * @param grid The board grid.
+ * @param size The board size.
+ * @param x The x coordinate of the move.
+ * @param y The y coordinate of the move.
+ * @param dx The step in x.
+ * @param dy The step in y.
+ * @param k The number of steps from the move.
+ * @return Whether the intersection is empty.
+*/
+__attribute__((always_inline))
+static inline bool line_empty(const unsigned char* grid, int size, int x, int y, int dx, int dy, int k) {
+    int cx = x + k * dx;
+    int cy = y + k * dy;
+    return cx >= 0 && cx < size && cy >= 0 && cy < size && grid[cy * size + cx] == EMPTY_INTERSECTION;
+}
+
+/**
+ * Counts the open fours of a stone on a line through a move: every time a run of the stone
+ * reaches four, it counts if the intersections just after it and just before it are empty,
+ * so the count is the same whichever way the line is walked.
+ * @param grid The board grid.
+ * @param size The board size.
+ * @param x The x coordinate of the move.
+ * @param y The y coordinate of the move.
+ * @param dx The step in x.
+ * @param dy The step in y.
+ * @param stone The stone.
+ * @return The number of open fours.
+*/
+__attribute__((always_inline))
+static inline int line_open_fours(const unsigned char* grid, int size, int x, int y, int dx, int dy, unsigned char stone) {
+    int lo;
+    int hi;
+    line_bounds(size, x, y, dx, dy, &lo, &hi);
+    const unsigned char* p = grid + (y + lo * dy) * size + x + lo * dx;
+    int count = 0;
+    int fours = 0;
+    for (int k = lo; k <= hi; k++, p += dy * size + dx) {
+        if (*p != stone) {
+            count = 0;
+        } else if (++count == 4 && line_empty(grid, size, x, y, dx, dy, k + 1) &&
+            line_empty(grid, size, x, y, dx, dy, k - 4)) {
+            fours++;
+        }
+    }
+    return fours;
+}
+
+/**
+ * Defines the checks of one kernel.
+ * @param NAME The suffix of the kernel's functions.
+ * @param SIZE The board size, a constant or the size parameter.
+*/
+#define RULES_KERNEL(NAME, SIZE) \
+    bool static five_##NAME(const unsigned char* grid, unsigned char size, unsigned char x, unsigned char y, unsigned char stone) { \
+        return line_run(grid, SIZE, x, y, 1, 0, stone) >= 5 || line_run(grid, SIZE, x, y, 0, 1, stone) >= 5 || \
+            line_run(grid, SIZE, x, y, 1, 1, stone) >= 5 || line_run(grid, SIZE, x, y, 1, -1, stone) >= 5; \
+    } \
+    bool static overline_##NAME(const unsigned char* grid, unsigned char size, unsigned char x, unsigned char y, unsigned char stone) { \
+        return line_run(grid, SIZE, x, y, 1, 0, stone) >= 6 || line_run(grid, SIZE, x, y, 0, 1, stone) >= 6 || \
+            line_run(grid, SIZE, x, y, 1, 1, stone) >= 6 || line_run(grid, SIZE, x, y, 1, -1, stone) >= 6; \
+    } \
+    bool static double_four_##NAME(const unsigned char* grid, unsigned char size, unsigned char x, unsigned char y, unsigned char stone) { \
+        return line_open_fours(grid, SIZE, x, y, 1, 0, stone) + line_open_fours(grid, SIZE, x, y, 0, 1, stone) + \
+            line_open_fours(grid, SIZE, x, y, 1, 1, stone) + line_open_fours(grid, SIZE, x, y, 1, -1, stone) > 1; \
+    }
+
+RULES_KERNEL(15, 15)
+RULES_KERNEL(17, 17)
+RULES_KERNEL(19, 19)
+RULES_KERNEL(generic, size)
+
+static const rules_kernel kernels[] = {
+    {15, "15", five_15, overline_15, double_four_15},
+    {17, "17", five_17, overline_17, double_four_17},
+    {19, "19", five_19, overline_19, double_four_19},
+    {0, "generic", five_generic, overline_generic, double_four_generic},
+};
+
+/**
+ * Gets the rule kernel for a board size.
+ * @param size The board size.
+ * @return The kernel compiled for the size, or the generic one.
+*/
+const rules_kernel* rules_select(unsigned char size) {
+    size_t n = sizeof(kernels) / sizeof(kernels[0]);
+    for (size_t i = 0; i + 1 < n; i++) {
+        if (kernels[i].size == size) {
+            return &kernels[i];
+        }
+    }
+    return &kernels[n - 1];
+}
@@ -0,0 +1,17 @@
+#ifndef _RULES_H_
+#define _RULES_H_
+#include <stdbool.h>
+#define RULES_REACH 4
+
+typedef bool (*rules_check)(const unsigned char* grid, unsigned char size, unsigned char x, unsigned char y, unsigned char stone);
+
+typedef struct {
+    unsigned char size;
+    const char* name;
+    rules_check five;
+    rules_check overline;
+    rules_check double_four;
+} rules_kernel;
+
+const rules_kernel* rules_select(unsigned char size);
+#endif
@@ -0,0 +1,274 @@
+/**
+ * @file scan.c
+ * @author Faris Soliman
+ * This file is a tool that searches a corpus of saved games for a local shape: a template of
+ * black, white, empty and any cells, such as "?X?/XOX/?X?", in any place on the board and
+ * any rotation or reflection. It takes the same paths as corpus. The games are replayed
+ * without the rules on the bitboards in shape.c by a thread pool, in batches, and every match
+ * is reported with the game, the move that completed it and the window it is in.
+ *
+ * The matches are printed in the order the games were read, whatever the number of threads.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "error-codes.h"
+#include "parse.h"
+#include "pool.h"
+#include "search.h"
+#include "shape.h"
+#include "source.h"
+#define SCAN_BATCH 256
+#define SCAN_LIST 20
+
+typedef struct {
+    int game;
+    uint16_t ply;
+    shape_match m;
+} scan_hit;
+
+typedef struct {
+    const shape* s;
+    int count;
+    char* paths[SCAN_BATCH];
+    char* data[SCAN_BATCH];
+    size_t lengths[SCAN_BATCH];
+    unsigned long unreadable;
+    unsigned long positions;
+    unsigned long matching;
+    scan_hit* hits;
+    size_t hits_count;
+    size_t hits_capacity;
+    bool failed;
+} batch;
+
+typedef struct {
+    const shape* s;
+    pool* p;
+    batch** batches;
+    size_t count;
+    size_t capacity;
+    batch* current;
+    unsigned long missing;
+} scanner;
+
+/**
+ * Replays a game and records the matches of every move.
+ * @param b The batch of the game.
+ * @param game The number of the game in the batch.
+ * @param r The game.
+ * @return Whether there was enough memory.
+*/
+bool static scan_game(batch* b, int game, const parse_record* r) {
+    shape_board board;
+    shape_match matches[SHAPE_MAX_MATCHES];
+    size_t before = b->hits_count;
+    shape_board_init(&board, r->size);
+    for (size_t i = 0; i < r->count; i++) {
+        unsigned char stone = i % 2 == 0 ? BLACK_STONE : WHITE_STONE;
+        shape_board_place(&board, r->x[i], r->y[i], stone);
+        int n = shape_new_matches(b->s, &board, r->x[i], r->y[i], stone, matches, SHAPE_MAX_MATCHES);
+        if (b->hits_count + n > b->hits_capacity) {
+            size_t capacity = (b->hits_count + n) * 2;
+            scan_hit* hits = realloc(b->hits, capacity * sizeof(scan_hit));
+            if (hits == NULL) {
+                return false;
+            }
+            b->hits = hits;
+            b->hits_capacity = capacity;
+        }
+        for (int j = 0; j < n; j++) {
+            b->hits[b->hits_count].game = game;
+            b->hits[b->hits_count].ply = i + 1;
+            b->hits[b->hits_count].m = matches[j];
+            b->hits_count++;
+        }
+    }
+    b->positions += r->count;
+    b->matching += b->hits_count > before;
+    return true;
+}
+
+/**
+ * The pool job: parses and scans a batch of games.
+ * @param arg The batch.
+ * @param worker The number of the worker running the job.
+*/
+void static run_batch(void* arg, int worker) {
+    batch* b = arg;
+    parse_record* r = malloc(sizeof(parse_record));
+    b->failed = r == NULL;
+    for (int i = 0; i < b->count; i++) {
+        if (b->data[i] == NULL) {
+            b->data[i] = source_read_file(b->paths[i], &b->lengths[i]);
+        }
+        if (r == NULL || b->data[i] == NULL || !parse_buffer(b->data[i], b->lengths[i], r, NULL)) {
+            b->unreadable++;
+        } else if (!b->failed) {
+            b->failed = !scan_game(b, i, r);
+        }
+        free(b->data[i]);
+        b->data[i] = NULL;
+    }
+    free(r);
+}
+
+/**
+ * Adds a game to the batch being filled, handing the batch to the pool once it is full.
+ * @param arg The scanner.
+ * @param path The path of the game.
+ * @param data The contents of the game if it is already in memory, or NULL to read the path.
+ * @param length The length of the contents.
+*/
+void static add_game(void* arg, char* path, char* data, size_t length) {
+    scanner* sc = arg;
+    if (sc->current == NULL) {
+        if (sc->count == sc->capacity) {
+            sc->capacity = sc->capacity == 0 ? 64 : sc->capacity * 2;
+            sc->batches = realloc(sc->batches, sc->capacity * sizeof(batch*));
+        }
+        sc->current = sc->batches == NULL ? NULL : calloc(1, sizeof(batch));
+        if (sc->current == NULL) {
+            exit(NULL_POINTER_ERR);
+        }
+        sc->current->s = sc->s;
+        sc->batches[sc->count++] = sc->current;
+    }
+
+    batch* b = sc->current;
+    b->paths[b->count] = path;
+    b->data[b->count] = data;
+    b->lengths[b->count] = length;
+    b->count++;
+    if (b->count == SCAN_BATCH) {
+        pool_submit(sc->p, run_batch, b);
+        sc->current = NULL;
+    }
+}
+
+/**
+ * Reports a path that cannot be read.
+ * @param arg The scanner.
+ * @param path The path.
+ * @param reason Why it cannot be read.
+*/
+void static read_error(void* arg, const char* path, unsigned char reason) {
+    scanner* sc = arg;
+    if (reason == SOURCE_TRUNCATED) {
+        fprintf(stderr, "Cannot read all of %s\n", path);
+    } else {
+        fprintf(stderr, "Cannot read %s\n", path);
+    }
+    if (reason == SOURCE_MISSING) {
+        sc->missing++;
+    }
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int threads = pool_default_threads();
+    int limit = SCAN_LIST;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+            continue;
+        }
+        if (strcmp(argv[first], "-j") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            threads = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-l") == 0 && first + 1 < argc && atoi(argv[first + 1]) >= 0) {
+            limit = atoi(argv[first + 1]);
+        } else {
+            first = argc;
+            break;
+        }
+        first += 2;
+    }
+    if (first + 1 >= argc) {
+        fprintf(stdout, "usage: %s [-j threads] [-l limit] [-q] <template> <saved-match.gmk|directory|archive.tar>...\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+    shape s;
+    if (!shape_parse(argv[first], &s)) {
+        fprintf(stderr, "Invalid template %s: rows of %c, %c, %c and %c separated by %c, at most %dx%d, with a stone\n",
+            argv[first], SHAPE_BLACK, SHAPE_WHITE, SHAPE_EMPTY, SHAPE_ANY, SHAPE_ROWS, SHAPE_MAX, SHAPE_MAX);
+        return INPUT_ERR;
+    }
+
+    scanner sc = {&s, pool_create(threads), NULL, 0, 0, NULL, 0};
+    if (sc.p == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    long long start = search_clock();
+    source_visitor v = {add_game, read_error, &sc};
+    for (int i = first + 1; i < argc; i++) {
+        if (!source_walk(argv[i], true, &v)) {
+            return NULL_POINTER_ERR;
+        }
+    }
+    if (sc.current != NULL) {
+        pool_submit(sc.p, run_batch, sc.current);
+    }
+    pool_wait(sc.p);
+    pool_delete(sc.p);
+    long long elapsed = search_clock() - start;
+
+    // Print the matches in the order the games were read.
+    unsigned long games = sc.missing;
+    unsigned long unreadable = sc.missing;
+    unsigned long positions = 0;
+    unsigned long matching = 0;
+    unsigned long listed = 0;
+    unsigned long hits = 0;
+    for (size_t i = 0; i < sc.count; i++) {
+        batch* b = sc.batches[i];
+        if (b->failed) {
+            return NULL_POINTER_ERR;
+        }
+        games += b->count;
+        unreadable += b->unreadable;
+        positions += b->positions;
+        matching += b->matching;
+        hits += b->hits_count;
+        for (size_t j = 0; j < b->hits_count && listed < (unsigned long)limit; j++, listed++) {
+            const scan_hit* h = &b->hits[j];
+            printf("%s: move %u, %c%d to %c%d\n", b->paths[h->game], h->ply, h->m.x + 'A', h->m.y + 1,
+                h->m.x + h->m.width - 1 + 'A', h->m.y + h->m.height);
+        }
+        for (int j = 0; j < b->count; j++) {
+            free(b->paths[j]);
+        }
+        free(b->hits);
+        free(b);
+    }
+    free(sc.batches);
+    if (hits > listed) {
+        printf("... and %lu more\n", hits - listed);
+    }
+    if (listed > 0) {
+        printf("\n");
+    }
+
+    printf("Games:               %lu\n", games);
+    printf("Unreadable:          %lu\n", unreadable);
+    printf("Positions:           %lu\n", positions);
+    printf("Matching games:      %lu\n", matching);
+    printf("Matches:             %lu\n", hits);
+    if (!quiet) {
+        printf("\n%lu positions in %lld ms, %.0f positions/sec\n", positions, elapsed,
+            elapsed > 0 ? positions * 1000.0 / elapsed : 0.0);
+    }
+    return SUCCESS;
+}
@@ -0,0 +1,645 @@
+/**
+ * @file search.c
+ * @author Faris Soliman
+ * This file contains the game tree search the computer opponent uses. It is a negamax
+ * alpha-beta search with iterative deepening and a transposition table. Moves are generated
+ * from the game's threat map: only intersections that make or block a pattern are tried,
+ * strongest first, and when a five is on the board for either color only the moves that
+ * complete or stop it are searched. Leaves are scored by the game's running evaluation.
+ *
+ * A search can be stopped from another thread, by a deadline that another thread may move,
+ * or by a node budget, which is what lets the computer think on the human's time.
+ *
+ * When a solved position cache is attached, every position is looked up there before it is
+ * searched, and every win or loss the search proves is stored there for other searches. The
+ * cache is keyed by the canonical hash, so a result proven for one position also answers its
+ * rotations and reflections.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "board.h"
+#include "cache.h"
+#include "eval.h"
+#include "game.h"
+#include "pattern.h"
+#include "search.h"
+#include "symmetry.h"
+#include "threat.h"
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+    unsigned char priority;
+    int order;
+} candidate;
+
+/**
+ * Creates a search with an empty transposition table.
+ * @param entries The number of table entries, rounded down to a power of two.
+ * @return The new search, or NULL if it could not be allocated.
+*/
+search* search_create(size_t entries) {
+    search* s = malloc(sizeof(search));
+    if (s == NULL) {
+        return NULL;
+    }
+
+    size_t size = 1;
+    while (size * 2 <= entries) {
+        size *= 2;
+    }
+    s->table = calloc(size, sizeof(search_entry));
+    if (s->table == NULL) {
+        free(s);
+        return NULL;
+    }
+
+    s->mask = size - 1;
+    s->stop = 0;
+    s->deadline = 0;
+    s->nodes = 0;
+    s->max_nodes = 0;
+    s->best_x = SEARCH_NO_MOVE;
+    s->best_y = SEARCH_NO_MOVE;
+    s->root_moves = 0;
+    s->cache = NULL;
+    s->proven = false;
+    s->report = NULL;
+    s->report_arg = NULL;
+    return s;
+}
+
+/**
+ * Deletes a search.
+ * @param s The search to delete.
+*/
+void search_delete(search* s) {
+    if (s == NULL) {
+        return;
+    }
+
+    free(s->table);
+    free(s);
+}
+
+/**
+ * Forgets everything in the transposition table.
+ * @param s The search.
+*/
+void search_clear(search* s) {
+    memset(s->table, 0, (s->mask + 1) * sizeof(search_entry));
+}
+
+/**
+ * Gets the time of a monotonic clock.
+ * @return The time in milliseconds.
+*/
+long long search_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Gets a search ready to run: clears the stop request and sets the time limit.
+ * @param s The search.
+ * @param time_ms The time the search may take in milliseconds, or 0 for no limit.
+*/
+void search_prepare(search* s, long time_ms) {
+    __atomic_store_n(&s->stop, 0, __ATOMIC_RELAXED);
+    search_set_deadline(s, time_ms > 0 ? search_clock() + time_ms : 0);
+}
+
+/**
+ * Moves the deadline of a search, which may be running on another thread.
+ * @param s The search.
+ * @param deadline The time from search_clock() at which the search stops, or 0 for none.
+*/
+void search_set_deadline(search* s, long long deadline) {
+    __atomic_store_n(&s->deadline, deadline, __ATOMIC_RELAXED);
+}
+
+/**
+ * Asks a search, which may be running on another thread, to stop as soon as it can.
+ * @param s The search.
+*/
+void search_stop(search* s) {
+    __atomic_store_n(&s->stop, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Counts a node and checks if the search has to stop. The clock and the node budget are only
+ * looked at every 1024 nodes.
+ * @param s The search.
+ * @return Whether the search has to stop.
+*/
+bool static search_aborted(search* s) {
+    s->nodes++;
+    if ((s->nodes & 1023) == 0) {
+        long long deadline = __atomic_load_n(&s->deadline, __ATOMIC_RELAXED);
+        if ((s->max_nodes != 0 && s->nodes >= s->max_nodes) || (deadline != 0 && search_clock() >= deadline)) {
+            search_stop(s);
+        }
+    }
+    return __atomic_load_n(&s->stop, __ATOMIC_RELAXED) != 0;
+}
+
+/**
+ * Converts a score to the form kept in the table, where wins count from the stored position
+ * rather than from the root.
+ * @param score The score.
+ * @param ply The distance from the root.
+ * @return The score to store.
+*/
+int static to_table(int score, int ply) {
+    if (score > SEARCH_WIN_BOUND) {
+        return score + ply;
+    }
+    if (score < -SEARCH_WIN_BOUND) {
+        return score - ply;
+    }
+    return score;
+}
+
+/**
+ * Converts a score read from the table back to the distance from the root.
+ * @param score The stored score.
+ * @param ply The distance from the root.
+ * @return The score.
+*/
+int static from_table(int score, int ply) {
+    if (score > SEARCH_WIN_BOUND) {
+        return score - ply;
+    }
+    if (score < -SEARCH_WIN_BOUND) {
+        return score + ply;
+    }
+    return score;
+}
+
+/**
+ * Looks a position up in the solved position cache.
+ * @param s The search.
+ * @param g The game.
+ * @param ply The distance from the root.
+ * @param score Where to put the score of the position.
+ * @param e Where to put the cache entry.
+ * @return Whether the position was found.
+*/
+bool static cache_probe(search* s, game* g, int ply, int* score, cache_entry* e) {
+    unsigned char t;
+    if (s->cache == NULL || !cache_lookup(s->cache, g->type, g->board->size, game_canonical_hash(g, &t), e)) {
+        return false;
+    }
+    symmetry_revert(t, g->board->size, e->x, e->y, &e->x, &e->y);
+
+    if (e->result == CACHE_WIN) {
+        *score = SEARCH_WIN - ply - e->depth;
+    } else if (e->result == CACHE_LOSS) {
+        *score = -(SEARCH_WIN - ply - e->depth);
+    } else {
+        *score = 0;
+    }
+    return true;
+}
+
+/**
+ * Stores a proven win or loss in the solved position cache. Other scores are not stored, and
+ * neither are wins and losses the search only found among the moves it looked at: the caller
+ * only passes those proven over every move that matters.
+ * @param s The search.
+ * @param g The game.
+ * @param ply The distance from the root.
+ * @param score The score of the position.
+ * @param flag Whether the score is exact or a bound.
+ * @param x The x coordinate of the best move.
+ * @param y The y coordinate of the best move.
+*/
+void static cache_save(search* s, game* g, int ply, int score, unsigned char flag, unsigned char x, unsigned char y) {
+    if (s->cache == NULL) {
+        return;
+    }
+
+    cache_entry e;
+    if (score > SEARCH_WIN_BOUND && flag != SEARCH_UPPER) {
+        e.result = CACHE_WIN;
+        e.depth = SEARCH_WIN - ply - score;
+    } else if (score < -SEARCH_WIN_BOUND && flag != SEARCH_LOWER) {
+        e.result = CACHE_LOSS;
+        e.depth = SEARCH_WIN - ply + score;
+    } else {
+        return;
+    }
+    e.proof = CACHE_BY_SEARCH;
+    unsigned char t;
+    uint64_t hash = game_canonical_hash(g, &t);
+    symmetry_apply(t, g->board->size, x, y, &e.x, &e.y);
+    cache_store(s->cache, g->type, g->board->size, hash, &e);
+}
+
+/**
+ * Generates the moves worth searching, strongest first. The move from the table, if any, is
+ * put in front.
+ * @param g The game.
+ * @param list The array to fill, with room for every intersection.
+ * @param tx The x coordinate of the table move, or SEARCH_NO_MOVE.
+ * @param ty The y coordinate of the table move.
+ * @param width The most moves to keep, or 0 to keep all of them.
+ * @param complete Where to put whether no move that matters was left out: the moves are every
+ *        legal move, or every move that makes or stops a five when there is one. May be NULL.
+ * @return The number of moves.
+*/
+int static generate_moves(game* g, candidate* list, unsigned char tx, unsigned char ty, int width, bool* complete) {
+    unsigned char size = g->board->size;
+    // Filling the board draws whatever the move makes, so the last intersection is never left
+    // out; game_place_stone() still ends the game on an overline there.
+    bool renju_black = g->type == GAME_RENJU && g->stone == BLACK_STONE && g->moves_count + 1 < (size_t)size * size;
+    int lx = g->moves_count > 0 ? g->moves[g->moves_count - 1].x : size / 2;
+    int ly = g->moves_count > 0 ? g->moves[g->moves_count - 1].y : size / 2;
+    int n = 0;
+    bool skipped = false;
+
+    for (unsigned char y = 0; y < size; y++) {
+        for (unsigned char x = 0; x < size; x++) {
+            if (g->board->grid[y * size + x] != EMPTY_INTERSECTION) {
+                continue;
+            }
+            // A forbidden move loses on the spot, so leaving it out leaves out nothing. The
+            // threat map's test is the rules' own, so no legal move is left out with it.
+            unsigned char priority = threat_priority(g->threats, g->stone, x, y);
+            if (renju_black && threat_forbidden(g->threats, g->rules, g->board, x, y)) {
+                continue;
+            }
+            if (priority < 2) {
+                skipped = true;
+                continue;
+            }
+
+            // Between equal priorities, prefer the intersection with more going on for both
+            // colors, then the one closer to the last move.
+            int distance = abs(x - lx) > abs(y - ly) ? abs(x - lx) : abs(y - ly);
+            int order = priority * 256 +
+                (threat_best(g->threats, BLACK_STONE, x, y) + threat_best(g->threats, WHITE_STONE, x, y)) * 16 +
+                (distance < 15 ? 15 - distance : 0);
+
+            // Insertion sort, keeping equal orders in board order.
+            int i = n++;
+            while (i > 0 && list[i - 1].order < order) {
+                list[i] = list[i - 1];
+                i--;
+            }
+            list[i].x = x;
+            list[i].y = y;
+            list[i].priority = priority;
+            list[i].order = order;
+        }
+    }
+
+    // Nothing near any stone, which on an empty board means opening in the centre.
+    if (n == 0) {
+        if (complete != NULL) {
+            *complete = g->moves_count > 0;
+        }
+        if (g->moves_count == 0) {
+            list[0].x = size / 2;
+            list[0].y = size / 2;
+            list[0].priority = 0;
+            list[0].order = 0;
+            return 1;
+        }
+        for (unsigned char y = 0; y < size; y++) {
+            for (unsigned char x = 0; x < size; x++) {
+                if (g->board->grid[y * size + x] == EMPTY_INTERSECTION) {
+                    list[n].x = x;
+                    list[n].y = y;
+                    list[n].priority = 0;
+                    list[n].order = 0;
+                    n++;
+                }
+            }
+        }
+        return n;
+    }
+
+    // A five to make or to stop leaves no choice: any other move loses to the five.
+    if (list[0].priority >= 2 * PATTERN_FIVE) {
+        int forced = 1;
+        while (forced < n && list[forced].priority == list[0].priority) {
+            forced++;
+        }
+        n = forced;
+        skipped = false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (list[i].x == tx && list[i].y == ty) {
+            candidate m = list[i];
+            memmove(&list[1], &list[0], i * sizeof(candidate));
+            list[0] = m;
+            break;
+        }
+    }
+
+    if (width > 0 && n > width) {
+        n = width;
+        skipped = true;
+    }
+    if (complete != NULL) {
+        *complete = !skipped;
+    }
+    return n;
+}
+
+int static negamax(search* s, game* g, int depth, int alpha, int beta, int ply);
+
+/**
+ * Plays a move, scores the position after it from the mover's side, and takes it back. Whether
+ * the score is proven is left in s->proven.
+ * @param s The search.
+ * @param g The game.
+ * @param m The move.
+ * @param depth The depth left before the move.
+ * @param alpha The lower bound.
+ * @param beta The upper bound.
+ * @param ply The distance of the position before the move from the root.
+ * @return The score.
+*/
+int static search_move(search* s, game* g, candidate* m, int depth, int alpha, int beta, int ply) {
+    unsigned char mover = g->stone;
+    int score;
+
+    game_place_stone(g, m->x, m->y);
+    s->proven = true;
+    if (g->state == GAME_STATE_PLAYING) {
+        score = -negamax(s, g, depth - 1, -beta, -alpha, ply + 1);
+    } else if (g->winner == mover) {
+        score = SEARCH_WIN - ply - 1;
+    } else if (g->winner == EMPTY_INTERSECTION) {
+        score = 0;
+    } else {
+        score = -(SEARCH_WIN - ply - 1);
+    }
+    game_undo(g);
+    return score;
+}
+
+/**
+ * Searches a position.
+ * @param s The search.
+ * @param g The game, which is back in the same position when this returns.
+ * @param depth The depth left.
+ * @param alpha The lower bound.
+ * @param beta The upper bound.
+ * @param ply The distance from the root.
+ * @return The score from the side of the color to move, or 0 if the search was stopped. Whether
+ *         it is proven is left in s->proven.
+*/
+int static negamax(search* s, game* g, int depth, int alpha, int beta, int ply) {
+    s->proven = false;
+    if (search_aborted(s)) {
+        return 0;
+    }
+
+    uint64_t key = game_hash(g);
+    search_entry* entry = &s->table[key & s->mask];
+    unsigned char tx = SEARCH_NO_MOVE;
+    unsigned char ty = SEARCH_NO_MOVE;
+    if (entry->key == key) {
+        tx = entry->x;
+        ty = entry->y;
+        if (ply > 0 && entry->depth >= depth) {
+            int score = from_table(entry->score, ply);
+            if (entry->flag == SEARCH_EXACT ||
+                (entry->flag == SEARCH_LOWER && score >= beta) ||
+                (entry->flag == SEARCH_UPPER && score <= alpha)) {
+                return score;
+            }
+        }
+    }
+
+    cache_entry solved;
+    int solved_score;
+    if (ply > 0 && cache_probe(s, g, ply, &solved_score, &solved)) {
+        s->proven = true;
+        return solved_score;
+    }
+
+    if (depth == 0) {
+        return game_evaluate(g);
+    }
+
+    candidate list[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    bool complete;
+    int n = generate_moves(g, list, tx, ty, SEARCH_WIDTH, &complete);
+    if (ply == 0) {
+        s->root_moves = n;
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    // A win is proven by one proven winning move; a loss only if every move that matters was
+    // searched and proven to lose. Only the first kind can come of a cutoff.
+    int original_alpha = alpha;
+    int best = -SEARCH_INF;
+    candidate* best_move = &list[0];
+    bool best_proven = false;
+    bool all_proven = complete;
+    for (int i = 0; i < n; i++) {
+        int score = search_move(s, g, &list[i], depth, alpha, beta, ply);
+        if (__atomic_load_n(&s->stop, __ATOMIC_RELAXED)) {
+            s->proven = false;
+            return 0;
+        }
+        all_proven = all_proven && s->proven;
+        if (score > best) {
+            best = score;
+            best_move = &list[i];
+            best_proven = s->proven;
+            if (score > alpha) {
+                alpha = score;
+            }
+            if (alpha >= beta) {
+                all_proven = all_proven && i == n - 1;
+                break;
+            }
+        }
+    }
+    bool proven = best > SEARCH_WIN_BOUND ? best_proven : best < -SEARCH_WIN_BOUND && all_proven;
+
+    if (ply == 0) {
+        s->best_x = best_move->x;
+        s->best_y = best_move->y;
+    }
+
+    entry->key = key;
+    entry->score = to_table(best, ply);
+    entry->depth = depth;
+    entry->flag = best <= original_alpha ? SEARCH_UPPER : best >= beta ? SEARCH_LOWER : SEARCH_EXACT;
+    entry->x = best_move->x;
+    entry->y = best_move->y;
+    if (proven) {
+        cache_save(s, g, ply, best, entry->flag, best_move->x, best_move->y);
+    }
+    s->proven = proven;
+    return best;
+}
+
+/**
+ * Searches for the best move of the color to move, deepening one ply at a time until the
+ * depth limit, a proven result, or a stop. The game must be in play, and it is back in the
+ * same position when this returns. Call search_prepare() first. If the search has a report
+ * function, it is called with the result of every iteration as it completes.
+ * @param s The search.
+ * @param g The game.
+ * @param max_depth The deepest iteration to run.
+ * @param max_nodes The node budget, or 0 for none.
+ * @return The result of the deepest completed iteration, or of the cache if the position is
+ *         solved there. The move is SEARCH_NO_MOVE if no iteration completed or there is no
+ *         move.
+*/
+search_result search_run(search* s, game* g, int max_depth, unsigned long max_nodes) {
+    search_result result = {SEARCH_NO_MOVE, SEARCH_NO_MOVE, 0, 0, 0};
+    s->nodes = 0;
+    s->max_nodes = max_nodes;
+    if (g->state != GAME_STATE_PLAYING) {
+        return result;
+    }
+
+    // A position some earlier search solved needs no search.
+    cache_entry solved;
+    if (cache_probe(s, g, 0, &result.score, &solved) && solved.x < g->board->size && solved.y < g->board->size &&
+        board_get(g->board, solved.x, solved.y) == EMPTY_INTERSECTION) {
+        result.x = solved.x;
+        result.y = solved.y;
+        result.depth = solved.depth;
+        return result;
+    }
+    result.score = 0;
+
+    // The moves tried are not part of the game, so keep them out of its autosave journal and
+    // its broadcast.
+    struct journal* journal = g->journal;
+    struct broadcast* broadcast = g->broadcast;
+    g->journal = NULL;
+    g->broadcast = NULL;
+    for (int depth = 1; depth <= max_depth; depth++) {
+        s->best_x = SEARCH_NO_MOVE;
+        s->best_y = SEARCH_NO_MOVE;
+        int score = negamax(s, g, depth, -SEARCH_INF, SEARCH_INF, 0);
+        if (__atomic_load_n(&s->stop, __ATOMIC_RELAXED)) {
+            break;
+        }
+
+        result.x = s->best_x;
+        result.y = s->best_y;
+        result.score = score;
+        result.depth = depth;
+        result.nodes = s->nodes;
+        if (s->report != NULL) {
+            s->report(s->report_arg, &result);
+        }
+        if (s->root_moves <= 1 || score > SEARCH_WIN_BOUND || score < -SEARCH_WIN_BOUND) {
+            break;
+        }
+    }
+    g->journal = journal;
+    g->broadcast = broadcast;
+
+    result.nodes = s->nodes;
+    return result;
+}
+
+/**
+ * Lists the moves a search of the position would try at the root, in the order it would try
+ * them, for a search split across processes.
+ * @param g The game.
+ * @param first_x The x coordinate of the move to put in front, such as the best move of the
+ *        last iteration, or SEARCH_NO_MOVE.
+ * @param first_y The y coordinate of the move to put in front.
+ * @param xs Where to put the x coordinates, with room for every intersection.
+ * @param ys Where to put the y coordinates, with room for every intersection.
+ * @return The number of moves.
+*/
+int search_root_moves(game* g, unsigned char first_x, unsigned char first_y, unsigned char* xs, unsigned char* ys) {
+    if (g->state != GAME_STATE_PLAYING) {
+        return 0;
+    }
+
+    candidate list[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    int n = generate_moves(g, list, first_x, first_y, SEARCH_WIDTH, NULL);
+    for (int i = 0; i < n; i++) {
+        xs[i] = list[i].x;
+        ys[i] = list[i].y;
+    }
+    return n;
+}
+
+/**
+ * Searches one root move with a window, as a search of the whole position would: the score is
+ * from the side of the color to move before the move, and wins count from the root. The game
+ * must be in play, and it is back in the same position when this returns. Call
+ * search_prepare() first.
+ * @param s The search.
+ * @param g The game.
+ * @param x The x coordinate of the move.
+ * @param y The y coordinate of the move.
+ * @param depth The depth of the search of the position, counting the move.
+ * @param alpha The lower bound.
+ * @param beta The upper bound.
+ * @param result Where to put the move, the score, the depth and the nodes searched.
+ * @return Whether the search completed rather than being stopped.
+*/
+bool search_root_move(search* s, game* g, unsigned char x, unsigned char y, int depth, int alpha, int beta, search_result* result) {
+    candidate m = {x, y, 0, 0};
+    s->nodes = 0;
+    s->max_nodes = 0;
+
+    struct journal* journal = g->journal;
+    struct broadcast* broadcast = g->broadcast;
+    g->journal = NULL;
+    g->broadcast = NULL;
+    result->score = search_move(s, g, &m, depth, alpha, beta, 0);
+    g->journal = journal;
+    g->broadcast = broadcast;
+
+    result->x = x;
+    result->y = y;
+    result->depth = depth;
+    result->nodes = s->nodes;
+    return !__atomic_load_n(&s->stop, __ATOMIC_RELAXED);
+}
+
+/**
+ * Guesses the move the color to move will play: the best move the table remembers for the
+ * position, or else the strongest generated move.
+ * @param s The search.
+ * @param g The game.
+ * @param x Where to put the x coordinate.
+ * @param y Where to put the y coordinate.
+ * @return Whether there is a move to guess.
+*/
+bool search_predict(search* s, game* g, unsigned char* x, unsigned char* y) {
+    if (g->state != GAME_STATE_PLAYING) {
+        return false;
+    }
+
+    uint64_t key = game_hash(g);
+    search_entry* entry = &s->table[key & s->mask];
+    if (entry->key == key && entry->x < g->board->size && entry->y < g->board->size &&
+        board_get(g->board, entry->x, entry->y) == EMPTY_INTERSECTION) {
+        *x = entry->x;
+        *y = entry->y;
+        return true;
+    }
+
+    candidate list[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    if (generate_moves(g, list, SEARCH_NO_MOVE, SEARCH_NO_MOVE, 1, NULL) == 0) {
+        return false;
+    }
+    *x = list[0].x;
+    *y = list[0].y;
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef _SEARCH_H_
+#define _SEARCH_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "cache.h"
+#include "game.h"
+#define SEARCH_MAX_DEPTH 32
+#define SEARCH_WIDTH 16
+#define SEARCH_TABLE_SIZE (1 << 20)
+#define SEARCH_WIN (EVAL_WIN * 2)
+#define SEARCH_WIN_BOUND (SEARCH_WIN - 1000)
+#define SEARCH_INF (EVAL_WIN * 3)
+#define SEARCH_NO_MOVE 255
+#define SEARCH_EXACT 0
+#define SEARCH_LOWER 1
+#define SEARCH_UPPER 2
+
+typedef struct {
+    uint64_t key;
+    int score;
+    signed char depth;
+    unsigned char flag;
+    unsigned char x;
+    unsigned char y;
+} search_entry;
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+    int score;
+    int depth;
+    unsigned long nodes;
+} search_result;
+
+typedef struct {
+    search_entry* table;
+    size_t mask;
+    int stop;
+    long long deadline;
+    unsigned long nodes;
+    unsigned long max_nodes;
+    unsigned char best_x;
+    unsigned char best_y;
+    int root_moves;
+    bool proven;
+    cache* cache;
+    void (*report)(void* arg, const search_result* r);
+    void* report_arg;
+} search;
+
+search* search_create(size_t entries);
+void search_delete(search* s);
+void search_clear(search* s);
+long long search_clock(void);
+void search_prepare(search* s, long time_ms);
+void search_set_deadline(search* s, long long deadline);
+void search_stop(search* s);
+search_result search_run(search* s, game* g, int max_depth, unsigned long max_nodes);
+bool search_predict(search* s, game* g, unsigned char* x, unsigned char* y);
+int search_root_moves(game* g, unsigned char first_x, unsigned char first_y, unsigned char* xs, unsigned char* ys);
+bool search_root_move(search* s, game* g, unsigned char x, unsigned char y, int depth, int alpha, int beta, search_result* result);
+#endif
@@ -0,0 +1,186 @@
+/**
+ * @file shape.c
+ * @author Faris Soliman
+ * This file contains the shape matcher, which finds a local configuration of stones on a
+ * board: a template of up to SHAPE_MAX by SHAPE_MAX cells, each black, white, empty or any,
+ * in any place and any of the 8 rotations and reflections of the board.
+ *
+ * A board is kept as two bitboards with a 32-bit word per row, and every orientation of a
+ * template as three masks per row of the cells that have to be black, white and empty, so a
+ * row of a template is checked against a row of the board in a few word operations. The
+ * matcher is meant for games being replayed: stones are only ever added, so a match can only
+ * appear when a stone is played on one of its black or white cells, and only the windows
+ * around the last move are checked. Every match is found once, on the move that completes it.
+*/
+#include <string.h>
+#include "board.h"
+#include "shape.h"
+
+/**
+ * Parses a template: rows of cells from the top of the board down, separated by slashes, with
+ * SHAPE_BLACK, SHAPE_WHITE, SHAPE_EMPTY and SHAPE_ANY for the cells. Orientations that are
+ * the same as an earlier one, because the template is symmetric, are left out.
+ * @param text The template.
+ * @param s Where to put the shape.
+ * @return Whether the template was valid: rows of the same length, no bigger than SHAPE_MAX by
+ *         SHAPE_MAX, with at least one stone.
+*/
+bool shape_parse(const char* text, shape* s) {
+    char cells[SHAPE_MAX][SHAPE_MAX];
+    int width = 0;
+    int height = 0;
+    int column = 0;
+    bool stones = false;
+    for (const char* c = text;; c++) {
+        if (*c == SHAPE_ROWS || *c == '\0') {
+            if (column == 0 || (height > 0 && column != width) || height == SHAPE_MAX) {
+                return false;
+            }
+            width = column;
+            height++;
+            column = 0;
+            if (*c == '\0') {
+                break;
+            }
+        } else if ((*c == SHAPE_BLACK || *c == SHAPE_WHITE || *c == SHAPE_EMPTY || *c == SHAPE_ANY) && column < SHAPE_MAX &&
+            height < SHAPE_MAX) {
+            stones = stones || *c == SHAPE_BLACK || *c == SHAPE_WHITE;
+            cells[height][column++] = *c;
+        } else {
+            return false;
+        }
+    }
+    if (!stones) {
+        return false;
+    }
+
+    // The top row is the highest on the board, so it is row height - 1 of the masks.
+    int side = width > height ? width : height;
+    s->count = 0;
+    for (int t = 0; t < SYMMETRIES; t++) {
+        shape_orientation o;
+        memset(&o, 0, sizeof(o));
+        unsigned char min_x = SHAPE_MAX;
+        unsigned char min_y = SHAPE_MAX;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int r = 0; r < height; r++) {
+                for (int c = 0; c < width; c++) {
+                    unsigned char tx;
+                    unsigned char ty;
+                    symmetry_apply(t, side, c, height - 1 - r, &tx, &ty);
+                    if (pass == 0) {
+                        min_x = tx < min_x ? tx : min_x;
+                        min_y = ty < min_y ? ty : min_y;
+                        continue;
+                    }
+                    tx -= min_x;
+                    ty -= min_y;
+                    o.width = tx + 1 > o.width ? tx + 1 : o.width;
+                    o.height = ty + 1 > o.height ? ty + 1 : o.height;
+                    if (cells[r][c] == SHAPE_BLACK) {
+                        o.black[ty] |= 1u << tx;
+                    } else if (cells[r][c] == SHAPE_WHITE) {
+                        o.white[ty] |= 1u << tx;
+                    } else if (cells[r][c] == SHAPE_EMPTY) {
+                        o.empty[ty] |= 1u << tx;
+                    }
+                }
+            }
+        }
+        o.transform = t;
+
+        bool seen = false;
+        for (int i = 0; i < s->count && !seen; i++) {
+            const shape_orientation* p = &s->orientations[i];
+            seen = p->width == o.width && p->height == o.height && memcmp(p->black, o.black, sizeof(o.black)) == 0 &&
+                memcmp(p->white, o.white, sizeof(o.white)) == 0 && memcmp(p->empty, o.empty, sizeof(o.empty)) == 0;
+        }
+        if (!seen) {
+            s->orientations[s->count++] = o;
+        }
+    }
+    return true;
+}
+
+/**
+ * Clears a board.
+ * @param b The board.
+ * @param size The board size.
+*/
+void shape_board_init(shape_board* b, unsigned char size) {
+    memset(b, 0, sizeof(shape_board));
+    b->size = size;
+}
+
+/**
+ * Puts a stone on a board.
+ * @param b The board.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @param stone BLACK_STONE or WHITE_STONE.
+*/
+void shape_board_place(shape_board* b, unsigned char x, unsigned char y, unsigned char stone) {
+    if (stone == BLACK_STONE) {
+        b->black[y] |= 1u << x;
+    } else {
+        b->white[y] |= 1u << x;
+    }
+}
+
+/**
+ * Checks an orientation of a template at one place on a board.
+ * @param o The orientation.
+ * @param b The board.
+ * @param x The x coordinate of the lowest, leftmost cell of the window.
+ * @param y The y coordinate of the window.
+ * @return Whether the window matches.
+*/
+bool static matches_at(const shape_orientation* o, const shape_board* b, int x, int y) {
+    for (int r = 0; r < o->height; r++) {
+        uint32_t black = b->black[y + r] >> x;
+        uint32_t white = b->white[y + r] >> x;
+        if ((black & o->black[r]) != o->black[r] || (white & o->white[r]) != o->white[r] ||
+            ((black | white) & o->empty[r]) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Finds the matches a move has just completed: every window of every orientation that has a
+ * cell of the color of the stone on the move, and matches with the stone on the board.
+ * @param s The shape.
+ * @param b The board, with the stone on it.
+ * @param x The x coordinate of the move.
+ * @param y The y coordinate of the move.
+ * @param stone The color of the stone.
+ * @param matches Where to put the matches.
+ * @param max The most matches to put there, SHAPE_MAX_MATCHES for all of them.
+ * @return The number of matches found.
+*/
+int shape_new_matches(const shape* s, const shape_board* b, unsigned char x, unsigned char y, unsigned char stone, shape_match* matches, int max) {
+    int count = 0;
+    for (int i = 0; i < s->count; i++) {
+        const shape_orientation* o = &s->orientations[i];
+        const uint32_t* cells = stone == BLACK_STONE ? o->black : o->white;
+        for (int r = 0; r < o->height; r++) {
+            int oy = y - r;
+            if (oy < 0 || oy + o->height > b->size) {
+                continue;
+            }
+            for (uint32_t bits = cells[r]; bits != 0; bits &= bits - 1) {
+                int ox = x - __builtin_ctz(bits);
+                if (ox >= 0 && ox + o->width <= b->size && matches_at(o, b, ox, oy) && count < max) {
+                    matches[count].x = ox;
+                    matches[count].y = oy;
+                    matches[count].width = o->width;
+                    matches[count].height = o->height;
+                    matches[count].transform = o->transform;
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,47 @@
+#ifndef _SHAPE_H_
+#define _SHAPE_H_
+#include <stdbool.h>
+#include <stdint.h>
+#include "pattern.h"
+#include "symmetry.h"
+#define SHAPE_MAX 7
+#define SHAPE_MAX_MATCHES (SYMMETRIES * SHAPE_MAX * SHAPE_MAX)
+#define SHAPE_BLACK 'X'
+#define SHAPE_WHITE 'O'
+#define SHAPE_EMPTY '.'
+#define SHAPE_ANY '?'
+#define SHAPE_ROWS '/'
+
+typedef struct {
+    unsigned char width;
+    unsigned char height;
+    unsigned char transform;
+    uint32_t black[SHAPE_MAX];
+    uint32_t white[SHAPE_MAX];
+    uint32_t empty[SHAPE_MAX];
+} shape_orientation;
+
+typedef struct {
+    int count;
+    shape_orientation orientations[SYMMETRIES];
+} shape;
+
+typedef struct {
+    unsigned char size;
+    uint32_t black[PATTERN_MAX_SIZE];
+    uint32_t white[PATTERN_MAX_SIZE];
+} shape_board;
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+    unsigned char width;
+    unsigned char height;
+    unsigned char transform;
+} shape_match;
+
+bool shape_parse(const char* text, shape* s);
+void shape_board_init(shape_board* b, unsigned char size);
+void shape_board_place(shape_board* b, unsigned char x, unsigned char y, unsigned char stone);
+int shape_new_matches(const shape* s, const shape_board* b, unsigned char x, unsigned char y, unsigned char stone, shape_match* matches, int max);
+#endif
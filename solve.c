@@ -0,0 +1,122 @@
+/**
+ * @file solve.c
+ * @author Faris Soliman
+ * This file is a tool that solves the position of a saved game with the df-pn solver in
+ * dfpn.c, under the rules the game was saved with. It proves a win for the side to move, or
+ * a win for the other side against every move, by threats: fours, and open threes unless -f
+ * asks for fours only. It prints the result and the winning line, and with -v, the proof and
+ * disproof numbers of the attacker at the root every second while it runs. With -k, it shares
+ * the wins it proves with later runs and the computer opponent through a solved position cache.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "console.h"
+#include "dfpn.h"
+#include "error-codes.h"
+#include "game.h"
+
+/**
+ * Prints the progress of the solver.
+ * @param arg Unused.
+ * @param p The progress.
+*/
+void static report(void* arg, const dfpn_progress* p) {
+    fprintf(stderr, "%8lld ms %12lu nodes %10.0f nodes/sec  %s attacks  proof %u disproof %u  table %zu/%zu\n",
+        p->elapsed_ms, p->nodes, p->elapsed_ms > 0 ? p->nodes * 1000.0 / p->elapsed_ms : 0.0,
+        p->attacker == BLACK_STONE ? "black" : "white", p->proof, p->disproof, p->used, p->capacity);
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    unsigned char mode = DFPN_VCT;
+    long megabytes = DFPN_MEMORY >> 20;
+    unsigned long max_nodes = 0;
+    long time_ms = 0;
+    bool verbose = false;
+    bool quiet = false;
+    const char* cache_path = NULL;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-f") == 0) {
+            mode = DFPN_VCF;
+            first++;
+        } else if (strcmp(argv[first], "-k") == 0 && first + 1 < argc) {
+            cache_path = argv[first + 1];
+            first += 2;
+        } else if (strcmp(argv[first], "-m") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            megabytes = atol(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-n") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            max_nodes = strtoul(argv[first + 1], NULL, 10);
+            first += 2;
+        } else if (strcmp(argv[first], "-t") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            time_ms = atol(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-v") == 0) {
+            verbose = true;
+            first++;
+        } else if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+        } else {
+            first = argc;
+        }
+    }
+    if (first + 1 != argc) {
+        fprintf(stdout, "usage: %s [-f] [-k /path/to/cache] [-m megabytes] [-n nodes] [-t ms] [-v] [-q] <saved-match.gmk>\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // Load the position. A stopped game goes on from where it stopped.
+    game* g = console_import(argv[first]);
+    if (g->state == GAME_STATE_STOPPED) {
+        g->state = GAME_STATE_PLAYING;
+    }
+    dfpn* d = dfpn_create((size_t)megabytes << 20);
+    if (d == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    if (cache_path != NULL && !dfpn_use_cache(d, cache_path)) {
+        dfpn_delete(d);
+        game_delete(g);
+        return FILE_INPUT_ERR;
+    }
+    if (verbose) {
+        d->report = report;
+    }
+
+    dfpn_result r = dfpn_solve(d, g, mode, max_nodes, time_ms);
+
+    printf("Position:            %s, %s to move, %s\n", g->type == GAME_RENJU ? "renju" : "freestyle",
+        g->stone == BLACK_STONE ? "black" : "white", mode == DFPN_VCF ? "fours only" : "fours and threes");
+    if (r.result == DFPN_UNKNOWN) {
+        printf("Result:              no threat win found\n");
+    } else {
+        printf("Result:              %s wins (%s)\n", r.winner == BLACK_STONE ? "black" : "white",
+            r.result == DFPN_WIN ? "side to move" : "against every move");
+        printf("Line:               ");
+        for (int i = 0; i < r.length; i++) {
+            printf(" %c%d", r.line[i][0] + 'A', r.line[i][1] + 1);
+        }
+        printf("\n");
+    }
+    printf("Nodes:               %lu\n", r.nodes);
+    printf("Table:               %zu of %zu entries used, %lu collections\n", d->used, d->mask + 1, d->collections);
+    if (!quiet) {
+        printf("\n%lu nodes in %lld ms, %.0f nodes/sec\n", r.nodes, r.elapsed_ms,
+            r.elapsed_ms > 0 ? r.nodes * 1000.0 / r.elapsed_ms : 0.0);
+    }
+
+    dfpn_delete(d);
+    game_delete(g);
+    return SUCCESS;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file source.c
+ * @author Faris Soliman
+ * This file contains the reading of saved games in bulk for the batch tools. A path given by
+ * the user can be a saved game in any format parse_buffer() reads, a directory, which is
+ * searched for them, or an uncompressed tar archive of them. Directories are walked in name
+ * order, so every run hands out the same games in the same order.
+ *
+ * Games are handed to a visitor as they are found: a file by its path, to be read by whoever
+ * processes it, and a member of an archive by its contents, since it has no path of its own.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "source.h"
+
+/**
+ * Checks if a name ends with a suffix.
+ * @param name The name.
+ * @param suffix The suffix.
+ * @return Whether it does.
+*/
+bool static ends_with(const char* name, const char* suffix) {
+    size_t n = strlen(name);
+    size_t s = strlen(suffix);
+    return n >= s && strcmp(name + n - s, suffix) == 0;
+}
+
+/**
+ * Checks if a name is that of a saved game: a .gmk file, an autosave journal, an SGF record or
+ * a RenLib library.
+ * @param name The name.
+ * @return Whether it is.
+*/
+bool source_is_game(const char* name) {
+    return ends_with(name, ".gmk") || ends_with(name, ".gmj") || ends_with(name, ".sgf") || ends_with(name, ".lib");
+}
+
+/**
+ * Reads a whole saved game into memory.
+ * @param path The path to the file.
+ * @param length Where to put the length.
+ * @return The contents, or NULL if the file could not be read or is longer than
+ *         SOURCE_MAX_FILE.
+*/
+char* source_read_file(const char* path, size_t* length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    char* data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size < SOURCE_MAX_FILE) {
+        data = malloc(st.st_size + 1);
+    }
+    if (data != NULL) {
+        size_t done = 0;
+        while (done < (size_t)st.st_size) {
+            ssize_t n = read(fd, data + done, st.st_size - done);
+            if (n <= 0) {
+                break;
+            }
+            done += n;
+        }
+        *length = done;
+    }
+    close(fd);
+    return data;
+}
+
+/**
+ * Reads the saved game members of an uncompressed tar archive.
+ * @param path The path to the archive.
+ * @param v The visitor.
+ * @param ok Where to put whether the archive could be read to its end.
+ * @return Whether there was enough memory.
+*/
+bool static walk_archive(const char* path, const source_visitor* v, bool* ok) {
+    *ok = false;
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return true;
+    }
+
+    unsigned char header[512];
+    bool memory = true;
+    while (fread(header, 1, sizeof(header), fp) == sizeof(header)) {
+        if (header[0] == '\0') {
+            *ok = true;
+            break;
+        }
+
+        char name[320];
+        size_t size = strtoul((const char*)header + 124, NULL, 8);
+        if (memcmp(header + 257, "ustar", 5) == 0 && header[345] != '\0') {
+            snprintf(name, sizeof(name), "%.155s/%.100s", header + 345, header);
+        } else {
+            snprintf(name, sizeof(name), "%.100s", header);
+        }
+
+        size_t padded = (size + 511) / 512 * 512;
+        bool regular = header[156] == '0' || header[156] == '\0';
+        if (regular && source_is_game(name) && size < SOURCE_MAX_FILE) {
+            char* data = malloc(padded + 1);
+            char* member = malloc(strlen(path) + strlen(name) + 2);
+            if (data == NULL || member == NULL) {
+                free(data);
+                free(member);
+                memory = false;
+                break;
+            }
+            if (fread(data, 1, padded, fp) != padded) {
+                free(data);
+                free(member);
+                break;
+            }
+            sprintf(member, "%s/%s", path, name);
+            v->game(v->arg, member, data, size);
+        } else if (fseek(fp, padded, SEEK_CUR) != 0) {
+            break;
+        }
+    }
+    fclose(fp);
+    return memory;
+}
+
+/**
+ * Walks a path: a directory is searched for saved games in name order, a .tar file is read as
+ * an archive, and anything else is taken as a saved game. Every game is handed to the game
+ * function of the visitor, which then owns the path and contents it is given: a file comes
+ * with its path and no contents, and a member of an archive with the path of the archive and
+ * its name in it, joined by a slash, and its contents. Every path that cannot be read is
+ * handed to its error function with SOURCE_MISSING, SOURCE_UNREADABLE or SOURCE_TRUNCATED.
+ * @param path The path.
+ * @param top Whether the path was given by the user, rather than found in a directory. Files
+ *        found in directories are only taken if their names are those of saved games.
+ * @param v The visitor.
+ * @return Whether there was enough memory.
+*/
+bool source_walk(const char* path, bool top, const source_visitor* v) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        v->error(v->arg, path, SOURCE_MISSING);
+        return true;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        struct dirent** entries;
+        int n = scandir(path, &entries, NULL, alphasort);
+        if (n < 0) {
+            v->error(v->arg, path, SOURCE_UNREADABLE);
+            return true;
+        }
+        bool memory = true;
+        for (int i = 0; i < n; i++) {
+            const char* name = entries[i]->d_name;
+            if (memory && strcmp(name, ".") != 0 && strcmp(name, "..") != 0) {
+                char* child = malloc(strlen(path) + strlen(name) + 2);
+                if (child == NULL) {
+                    memory = false;
+                } else {
+                    sprintf(child, "%s/%s", path, name);
+                    memory = source_walk(child, false, v);
+                    free(child);
+                }
+            }
+            free(entries[i]);
+        }
+        free(entries);
+        return memory;
+    }
+
+    if (ends_with(path, ".tar")) {
+        bool ok;
+        bool memory = walk_archive(path, v, &ok);
+        if (!ok) {
+            v->error(v->arg, path, SOURCE_TRUNCATED);
+        }
+        return memory;
+    }
+
+    if (top || source_is_game(path)) {
+        char* copy = malloc(strlen(path) + 1);
+        if (copy == NULL) {
+            return false;
+        }
+        strcpy(copy, path);
+        v->game(v->arg, copy, NULL, 0);
+    }
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef _SOURCE_H_
+#define _SOURCE_H_
+#include <stdbool.h>
+#include <stddef.h>
+#define SOURCE_MAX_FILE (1 << 20)
+#define SOURCE_MISSING 1
+#define SOURCE_UNREADABLE 2
+#define SOURCE_TRUNCATED 3
+
+typedef struct {
+    void (*game)(void* arg, char* path, char* data, size_t length);
+    void (*error)(void* arg, const char* path, unsigned char reason);
+    void* arg;
+} source_visitor;
+
+bool source_is_game(const char* name);
+char* source_read_file(const char* path, size_t* length);
+bool source_walk(const char* path, bool top, const source_visitor* v);
+#endif
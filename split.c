@@ -0,0 +1,664 @@
+/**
+ * @file split.c
+ * @author Faris Soliman
+ * This file contains the search of one position spread over worker processes, on this
+ * machine or others, that each run an ordinary search and talk to a coordinator over a socket.
+ *
+ * The coordinator deepens one ply at a time like search_run(), and splits every iteration at
+ * the root, the young brothers wait way: the first move, the best of the last iteration, is
+ * searched alone with the full window, and only then are the other moves handed out, one to
+ * each worker that is free, with a null window around the best score so far. A move that
+ * fails high is searched again, before any new move, with the full window if it beat the best
+ * score the null window was set at, and with a new null window if the best score has moved on
+ * since. Of moves with the same score the first one wins, whatever order the results come
+ * in. Moves are handed out one at a time as workers finish, so a worker that gets easy
+ * moves takes more of them, and the move of a worker that goes away is handed to another.
+ *
+ * The protocol is lines of text. A worker greets the coordinator with "split <version>", and
+ * answers every "search <move> <type> <size> <depth> <alpha> <beta> <ms> <count> <moves>..."
+ * with "result <move> <score> <nodes> <complete>", where the moves are pairs of coordinates,
+ * the moves of the game followed by the root move to search. A worker keeps its search and its
+ * game from one request to the next, so it only plays the moves that changed and its table
+ * carries over from one iteration to the next.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "split.h"
+#define WAITING 0
+#define RUNNING 1
+#define DONE 2
+
+typedef struct {
+    unsigned char x[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    unsigned char y[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    unsigned char state[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    bool research[PATTERN_MAX_SIZE * PATTERN_MAX_SIZE];
+    int count;
+    int alpha;
+    int best;
+    unsigned long nodes;
+    bool stopped;
+} iteration;
+
+/**
+ * Sends all of a buffer on a socket, without a signal if the other end has gone.
+ * @param fd The socket.
+ * @param data The buffer.
+ * @param length Its length.
+ * @return Whether it was all sent.
+*/
+bool static send_all(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= n;
+    }
+    return true;
+}
+
+/**
+ * Splits an address into a host and a port.
+ * @param address "host:port", or one of them alone.
+ * @param host Where to put the host, with room for the address, or an empty string if there
+ *        is no colon.
+ * @param port Where to put the port, or the whole address if there is no colon.
+*/
+void static split_address(const char* address, char* host, const char** port) {
+    const char* colon = strrchr(address, ':');
+    if (colon == NULL) {
+        host[0] = '\0';
+        *port = address;
+        return;
+    }
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+    *port = colon + 1;
+}
+
+/**
+ * Opens a socket for workers to be reached at.
+ * @param address "host:port", or a port to listen on every address.
+ * @return The listening socket, or -1 if it could not be opened.
+*/
+int split_listen(const char* address) {
+    char host[256];
+    if (strlen(address) >= sizeof(host)) {
+        return -1;
+    }
+    const char* port;
+    split_address(address, host, &port);
+
+    struct addrinfo hints;
+    struct addrinfo* list;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if (getaddrinfo(host[0] == '\0' ? NULL : host, port, &hints, &list) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* a = list; a != NULL && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, SPLIT_MAX_WORKERS) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    return fd;
+}
+
+/**
+ * Connects to a worker.
+ * @param address "host:port", or "host" for the default port.
+ * @return The socket, or -1 if it could not connect.
+*/
+int split_connect(const char* address) {
+    char host[256];
+    if (strlen(address) >= sizeof(host)) {
+        return -1;
+    }
+    const char* port;
+    split_address(address, host, &port);
+    if (host[0] == '\0') {
+        strcpy(host, address);
+        port = SPLIT_PORT;
+    }
+
+    struct addrinfo hints;
+    struct addrinfo* list;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &list) != 0) {
+        return -1;
+    }
+
+    int fd = -1;
+    for (struct addrinfo* a = list; a != NULL && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(list);
+    return fd;
+}
+
+/**
+ * Reads a number from a request.
+ * @param p The place to read from, moved past the number.
+ * @param value Where to put the number.
+ * @return Whether there was a number.
+*/
+bool static read_number(char** p, long* value) {
+    char* end;
+    *value = strtol(*p, &end, 10);
+    if (end == *p) {
+        return false;
+    }
+    *p = end;
+    return true;
+}
+
+/**
+ * Brings the game of a worker to the position of a request, taking back only the moves that
+ * differ and playing the rest.
+ * @param g Where the game is, replaced if the rules or the board size differ.
+ * @param type The rules.
+ * @param size The board size.
+ * @param p The moves of the request, moved past them.
+ * @param count The number of moves.
+ * @return Whether every move could be played and the game is still in play.
+*/
+bool static set_position(game** g, unsigned char type, unsigned char size, char** p, long count) {
+    if (*g == NULL || (*g)->type != type || (*g)->board->size != size) {
+        game_delete(*g);
+        *g = game_create(size, type);
+        if (*g == NULL) {
+            return false;
+        }
+    }
+
+    size_t same = 0;
+    for (long i = 0; i < count; i++) {
+        long x;
+        long y;
+        if (!read_number(p, &x) || !read_number(p, &y) || x < 0 || x >= size || y < 0 || y >= size) {
+            return false;
+        }
+        if (i == (long)same && same < (*g)->moves_count && (*g)->moves[same].x == x && (*g)->moves[same].y == y) {
+            same++;
+            continue;
+        }
+        while ((*g)->moves_count > same) {
+            game_undo(*g);
+        }
+        if ((*g)->state != GAME_STATE_PLAYING || board_get((*g)->board, x, y) != EMPTY_INTERSECTION) {
+            return false;
+        }
+        game_place_stone(*g, x, y);
+        same++;
+    }
+    while ((*g)->moves_count > same) {
+        game_undo(*g);
+    }
+    return (*g)->state == GAME_STATE_PLAYING;
+}
+
+/**
+ * Serves a coordinator as a worker, until it closes the connection.
+ * @param fd The socket to the coordinator, closed when this returns.
+ * @param entries The number of entries of the transposition table of the worker.
+ * @return Whether the coordinator closed the connection, rather than sending a request that
+ *         could not be understood or the worker running out of memory.
+*/
+bool split_serve(int fd, size_t entries) {
+    search* s = search_create(entries);
+    char* line = malloc(SPLIT_LINE);
+    int in = dup(fd);
+    FILE* requests = in < 0 ? NULL : fdopen(in, "r");
+    game* g = NULL;
+    char greeting[32];
+    int length = sprintf(greeting, "split %d\n", SPLIT_VERSION);
+    bool ok = s != NULL && line != NULL && requests != NULL && send_all(fd, greeting, length);
+
+    while (ok && fgets(line, SPLIT_LINE, requests) != NULL) {
+        char* p = line;
+        long move, type, size, depth, alpha, beta, time_ms, count, x, y;
+        if (strncmp(p, "search ", 7) != 0) {
+            ok = false;
+            break;
+        }
+        p += 7;
+        ok = read_number(&p, &move) && read_number(&p, &type) && read_number(&p, &size) && read_number(&p, &depth) &&
+            read_number(&p, &alpha) && read_number(&p, &beta) && read_number(&p, &time_ms) && read_number(&p, &count) &&
+            (type == GAME_FREESTYLE || type == GAME_RENJU) && size > 0 && size <= PATTERN_MAX_SIZE && depth > 0 &&
+            depth <= SEARCH_MAX_DEPTH && count >= 0 && count < size * size && set_position(&g, type, size, &p, count) &&
+            read_number(&p, &x) && read_number(&p, &y) && x >= 0 && x < size && y >= 0 && y < size &&
+            board_get(g->board, x, y) == EMPTY_INTERSECTION;
+        if (!ok) {
+            break;
+        }
+
+        search_result r;
+        search_prepare(s, time_ms);
+        bool complete = search_root_move(s, g, x, y, depth, alpha, beta, &r);
+        char reply[96];
+        length = sprintf(reply, "result %ld %d %lu %d\n", move, r.score, r.nodes, complete ? 1 : 0);
+        ok = send_all(fd, reply, length);
+    }
+
+    if (requests != NULL) {
+        fclose(requests);
+    } else if (in >= 0) {
+        close(in);
+    }
+    close(fd);
+    game_delete(g);
+    free(line);
+    search_delete(s);
+    return ok;
+}
+
+/**
+ * Creates a coordinator with no workers.
+ * @return The coordinator, or NULL if it could not be allocated.
+*/
+split* split_create(void) {
+    split* sp = calloc(1, sizeof(split));
+    return sp;
+}
+
+/**
+ * Deletes a coordinator, closing the connections to its workers, which makes them stop, and
+ * waiting for the workers it started.
+ * @param sp The coordinator.
+*/
+void split_delete(split* sp) {
+    if (sp == NULL) {
+        return;
+    }
+
+    // A shutdown reaches the worker even if a copy of the socket was inherited by a process
+    // forked since, where a close would not.
+    for (int i = 0; i < sp->count; i++) {
+        if (sp->workers[i].fd >= 0) {
+            shutdown(sp->workers[i].fd, SHUT_RDWR);
+            close(sp->workers[i].fd);
+        }
+    }
+    for (int i = 0; i < sp->count; i++) {
+        if (sp->workers[i].pid > 0) {
+            waitpid(sp->workers[i].pid, NULL, 0);
+        }
+    }
+    free(sp);
+}
+
+/**
+ * Drops a worker that went away or broke the protocol. Its move goes back to be handed out
+ * again.
+ * @param sp The coordinator.
+ * @param w The worker.
+ * @param it The iteration, or NULL between iterations.
+*/
+void static drop_worker(split* sp, split_worker* w, iteration* it) {
+    if (it != NULL && w->move != SPLIT_IDLE) {
+        it->state[w->move] = WAITING;
+    }
+    shutdown(w->fd, SHUT_RDWR);
+    close(w->fd);
+    w->fd = -1;
+    w->move = SPLIT_IDLE;
+    sp->alive--;
+    sp->lost++;
+}
+
+/**
+ * Reads one line from a worker, waiting for it.
+ * @param w The worker.
+ * @param line Where to put the line, without the newline, with room for SPLIT_LINE bytes.
+ * @return Whether a whole line was read.
+*/
+bool static read_line(split_worker* w, char* line) {
+    while (true) {
+        char* newline = memchr(w->buffer, '\n', w->length);
+        if (newline != NULL) {
+            size_t n = newline - w->buffer;
+            memcpy(line, w->buffer, n);
+            line[n] = '\0';
+            w->length -= n + 1;
+            memmove(w->buffer, newline + 1, w->length);
+            return true;
+        }
+        if (w->length == SPLIT_LINE) {
+            return false;
+        }
+        ssize_t n = recv(w->fd, w->buffer + w->length, SPLIT_LINE - w->length, 0);
+        if (n <= 0) {
+            return false;
+        }
+        w->length += n;
+    }
+}
+
+/**
+ * Adds a worker, once it has greeted the coordinator with the same protocol version.
+ * @param sp The coordinator.
+ * @param fd The socket to the worker, which the coordinator owns from now on.
+ * @return Whether the worker was added.
+*/
+bool split_add_worker(split* sp, int fd) {
+    if (sp->count == SPLIT_MAX_WORKERS) {
+        close(fd);
+        return false;
+    }
+
+    split_worker* w = &sp->workers[sp->count];
+    memset(w, 0, sizeof(split_worker));
+    w->fd = fd;
+    w->move = SPLIT_IDLE;
+    char line[SPLIT_LINE];
+    int version;
+    if (!read_line(w, line) || sscanf(line, "split %d", &version) != 1 || version != SPLIT_VERSION) {
+        close(fd);
+        return false;
+    }
+    sp->count++;
+    sp->alive++;
+    return true;
+}
+
+/**
+ * Starts workers on this machine, as child processes connected by socket pairs.
+ * @param sp The coordinator.
+ * @param workers The number of workers.
+ * @param entries The number of entries of the transposition table of every worker.
+ * @return Whether every worker was started.
+*/
+bool split_spawn(split* sp, int workers, size_t entries) {
+    for (int i = 0; i < workers; i++) {
+        int fds[2];
+        if (sp->count == SPLIT_MAX_WORKERS || socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+            return false;
+        }
+        fflush(NULL);
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]);
+            close(fds[1]);
+            return false;
+        }
+        if (pid == 0) {
+            // The child keeps only its own end, so it sees the coordinator close it.
+            close(fds[0]);
+            for (int j = 0; j < sp->count; j++) {
+                if (sp->workers[j].fd >= 0) {
+                    close(sp->workers[j].fd);
+                }
+            }
+            _exit(split_serve(fds[1], entries) ? 0 : 1);
+        }
+        close(fds[1]);
+        if (!split_add_worker(sp, fds[0])) {
+            waitpid(pid, NULL, 0);
+            return false;
+        }
+        sp->workers[sp->count - 1].pid = pid;
+    }
+    return true;
+}
+
+/**
+ * Hands the next move of an iteration to a worker: a move to search again first, then the
+ * next move in order, with a null window around the best score unless it is a search again.
+ * @param sp The coordinator.
+ * @param w The worker, which is free.
+ * @param it The iteration.
+ * @param g The game.
+ * @param depth The depth of the iteration.
+ * @param deadline The time from search_clock() to stop at, or 0 for none.
+ * @return Whether a move was handed out.
+*/
+bool static dispatch(split* sp, split_worker* w, iteration* it, game* g, int depth, long long deadline) {
+    int move = -1;
+    for (int i = 0; i < it->count && move < 0; i++) {
+        if (it->state[i] == WAITING && it->research[i]) {
+            move = i;
+        }
+    }
+    for (int i = 0; i < it->count && move < 0; i++) {
+        if (it->state[i] == WAITING) {
+            move = i;
+        }
+    }
+    if (move < 0) {
+        return false;
+    }
+
+    long time_ms = 0;
+    if (deadline != 0) {
+        time_ms = deadline - search_clock();
+        if (time_ms <= 0) {
+            it->stopped = true;
+            return false;
+        }
+    }
+
+    // The young brothers wait: nothing else is handed out while the first move is searched. A
+    // move before the best one takes its place on a tie, so its window starts a point lower.
+    int lower = move < it->best ? it->alpha - 1 : it->alpha;
+    w->alpha = move == 0 ? -SEARCH_INF : lower;
+    w->beta = move == 0 || it->research[move] ? SEARCH_INF : lower + 1;
+    char line[SPLIT_LINE];
+    int n = sprintf(line, "search %d %d %d %d %d %d %ld %zu", move, g->type, g->board->size, depth, w->alpha, w->beta,
+        time_ms, g->moves_count);
+    for (size_t i = 0; i < g->moves_count; i++) {
+        n += sprintf(line + n, " %d %d", g->moves[i].x, g->moves[i].y);
+    }
+    n += sprintf(line + n, " %d %d\n", it->x[move], it->y[move]);
+
+    it->state[move] = RUNNING;
+    w->move = move;
+    if (!send_all(w->fd, line, n)) {
+        drop_worker(sp, w, it);
+        return false;
+    }
+    w->jobs++;
+    sp->jobs++;
+    return true;
+}
+
+/**
+ * Checks if a score of a move beats the best of an iteration so far. A tie goes to the move
+ * that comes first, so the best move does not depend on which worker answers first.
+ * @param it The iteration.
+ * @param move The move.
+ * @param score The score.
+ * @return Whether the move beats the best.
+*/
+bool static beats_best(const iteration* it, int move, int score) {
+    return score > it->alpha || (score == it->alpha && move < it->best);
+}
+
+/**
+ * Takes the result of a worker's move into the iteration.
+ * @param sp The coordinator.
+ * @param w The worker.
+ * @param it The iteration.
+ * @param line The result.
+*/
+void static collect(split* sp, split_worker* w, iteration* it, const char* line) {
+    int move;
+    int score;
+    unsigned long nodes;
+    int complete;
+    if (sscanf(line, "result %d %d %lu %d", &move, &score, &nodes, &complete) != 4 || move != w->move) {
+        drop_worker(sp, w, it);
+        return;
+    }
+    w->move = SPLIT_IDLE;
+    w->nodes += nodes;
+    it->nodes += nodes;
+    if (!complete) {
+        it->stopped = true;
+        it->state[move] = DONE;
+        return;
+    }
+
+    bool scout = w->beta == w->alpha + 1;
+    if (score <= w->alpha) {
+        // Below the window: no better than the best score, which has only gone up since.
+        it->state[move] = DONE;
+    } else if (scout) {
+        // Above the null window: better than the best score it was set at. If that still beats
+        // the best, the move takes the full window to get its score; if not, a new null window
+        // tells whether it beats the new best.
+        it->state[move] = WAITING;
+        it->research[move] = beats_best(it, move, w->beta);
+        sp->researches += it->research[move];
+    } else {
+        it->state[move] = DONE;
+        if (beats_best(it, move, score)) {
+            it->alpha = score;
+            it->best = move;
+        }
+    }
+}
+
+/**
+ * Runs one iteration: searches every root move to a depth across the workers.
+ * @param sp The coordinator.
+ * @param it The iteration, with its moves.
+ * @param g The game.
+ * @param depth The depth.
+ * @param deadline The time from search_clock() to stop at, or 0 for none.
+ * @return Whether every move was searched.
+*/
+bool static run_iteration(split* sp, iteration* it, game* g, int depth, long long deadline) {
+    struct pollfd fds[SPLIT_MAX_WORKERS];
+    split_worker* busy[SPLIT_MAX_WORKERS];
+    it->alpha = -SEARCH_INF;
+    it->best = 0;
+    it->nodes = 0;
+    it->stopped = false;
+    memset(it->state, WAITING, it->count);
+    memset(it->research, 0, it->count * sizeof(bool));
+
+    while (true) {
+        // Hand out moves to the free workers, once the first move has its score.
+        bool first_done = it->state[0] == DONE;
+        for (int i = 0; i < sp->count && !it->stopped; i++) {
+            split_worker* w = &sp->workers[i];
+            if (w->fd >= 0 && w->move == SPLIT_IDLE && (first_done || it->state[0] == WAITING)) {
+                dispatch(sp, w, it, g, depth, deadline);
+            }
+        }
+
+        int n = 0;
+        for (int i = 0; i < sp->count; i++) {
+            if (sp->workers[i].fd >= 0 && sp->workers[i].move != SPLIT_IDLE) {
+                busy[n] = &sp->workers[i];
+                fds[n].fd = sp->workers[i].fd;
+                fds[n].events = POLLIN;
+                n++;
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        if (poll(fds, n, -1) < 0) {
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            char line[SPLIT_LINE];
+            if (read_line(busy[i], line)) {
+                collect(sp, busy[i], it, line);
+            } else {
+                drop_worker(sp, busy[i], it);
+            }
+        }
+    }
+
+    for (int i = 0; i < it->count; i++) {
+        if (it->state[i] != DONE) {
+            return false;
+        }
+    }
+    return !it->stopped;
+}
+
+/**
+ * Searches for the best move of the color to move across the workers, deepening one ply at a
+ * time until the depth limit, a proven result, the time limit, or the loss of every worker.
+ * The game must be in play, and it is not changed.
+ * @param sp The coordinator, with its workers.
+ * @param g The game.
+ * @param max_depth The deepest iteration to run.
+ * @param time_ms The time the search may take in milliseconds, or 0 for no limit.
+ * @return The result of the deepest completed iteration, with the nodes of every iteration.
+ *         The move is SEARCH_NO_MOVE if no iteration completed or there is no move.
+*/
+split_result split_run(split* sp, game* g, int max_depth, long time_ms) {
+    split_result result = {SEARCH_NO_MOVE, SEARCH_NO_MOVE, 0, 0, 0, 0};
+    long long start = search_clock();
+    long long deadline = time_ms > 0 ? start + time_ms : 0;
+    if (g->state != GAME_STATE_PLAYING) {
+        return result;
+    }
+    iteration* it = malloc(sizeof(iteration));
+    if (it == NULL) {
+        return result;
+    }
+
+    for (int depth = 1; depth <= max_depth && sp->alive > 0; depth++) {
+        it->count = search_root_moves(g, result.x, result.y, it->x, it->y);
+        if (it->count == 0) {
+            break;
+        }
+        bool complete = run_iteration(sp, it, g, depth, deadline);
+        result.nodes += it->nodes;
+        if (!complete) {
+            break;
+        }
+
+        result.x = it->x[it->best];
+        result.y = it->y[it->best];
+        result.score = it->alpha;
+        result.depth = depth;
+        if (sp->report != NULL) {
+            split_progress p = {depth, result.x, result.y, result.score, result.nodes, search_clock() - start};
+            sp->report(sp->report_arg, &p);
+        }
+        if (it->count <= 1 || result.score > SEARCH_WIN_BOUND || result.score < -SEARCH_WIN_BOUND) {
+            break;
+        }
+    }
+
+    free(it);
+    result.elapsed_ms = search_clock() - start;
+    return result;
+}
@@ -0,0 +1,63 @@
+#ifndef _SPLIT_H_
+#define _SPLIT_H_
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "game.h"
+#include "search.h"
+#define SPLIT_VERSION 1
+#define SPLIT_MAX_WORKERS 64
+#define SPLIT_LINE 4096
+#define SPLIT_PORT "7149"
+#define SPLIT_IDLE (-1)
+
+typedef struct {
+    int depth;
+    unsigned char x;
+    unsigned char y;
+    int score;
+    unsigned long nodes;
+    long long elapsed_ms;
+} split_progress;
+
+typedef struct {
+    int fd;
+    pid_t pid;
+    char buffer[SPLIT_LINE];
+    size_t length;
+    int move;
+    int alpha;
+    int beta;
+    unsigned long jobs;
+    unsigned long nodes;
+} split_worker;
+
+typedef struct {
+    split_worker workers[SPLIT_MAX_WORKERS];
+    int count;
+    int alive;
+    unsigned long jobs;
+    unsigned long researches;
+    unsigned long lost;
+    void (*report)(void* arg, const split_progress* p);
+    void* report_arg;
+} split;
+
+typedef struct {
+    unsigned char x;
+    unsigned char y;
+    int score;
+    int depth;
+    unsigned long nodes;
+    long long elapsed_ms;
+} split_result;
+
+int split_listen(const char* address);
+int split_connect(const char* address);
+bool split_serve(int fd, size_t entries);
+split* split_create(void);
+void split_delete(split* sp);
+bool split_add_worker(split* sp, int fd);
+bool split_spawn(split* sp, int workers, size_t entries);
+split_result split_run(split* sp, game* g, int max_depth, long time_ms);
+#endif
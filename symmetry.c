@@ -0,0 +1,58 @@
+/**
+ * @file symmetry.c
+ * @author Faris Soliman
+ * This file contains the 8 symmetries of a square board: the identity, the rotations and the
+ * reflections. A symmetry is a combination of the three flags in symmetry.h, applied in the
+ * order transpose, flip x, flip y, which gives every one of the 8 exactly once.
+*/
+#include "symmetry.h"
+
+/**
+ * Maps an intersection through a symmetry.
+ * @param t The symmetry.
+ * @param size The size of the board.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @param tx Where to put the mapped x coordinate.
+ * @param ty Where to put the mapped y coordinate.
+*/
+void symmetry_apply(unsigned char t, unsigned char size, unsigned char x, unsigned char y, unsigned char* tx, unsigned char* ty) {
+    if (t & SYMMETRY_TRANSPOSE) {
+        unsigned char swap = x;
+        x = y;
+        y = swap;
+    }
+    if (t & SYMMETRY_FLIP_X) {
+        x = size - 1 - x;
+    }
+    if (t & SYMMETRY_FLIP_Y) {
+        y = size - 1 - y;
+    }
+    *tx = x;
+    *ty = y;
+}
+
+/**
+ * Maps an intersection back through a symmetry, undoing symmetry_apply().
+ * @param t The symmetry.
+ * @param size The size of the board.
+ * @param x The mapped x coordinate.
+ * @param y The mapped y coordinate.
+ * @param ox Where to put the original x coordinate.
+ * @param oy Where to put the original y coordinate.
+*/
+void symmetry_revert(unsigned char t, unsigned char size, unsigned char x, unsigned char y, unsigned char* ox, unsigned char* oy) {
+    if (t & SYMMETRY_FLIP_X) {
+        x = size - 1 - x;
+    }
+    if (t & SYMMETRY_FLIP_Y) {
+        y = size - 1 - y;
+    }
+    if (t & SYMMETRY_TRANSPOSE) {
+        unsigned char swap = x;
+        x = y;
+        y = swap;
+    }
+    *ox = x;
+    *oy = y;
+}
@@ -0,0 +1,11 @@
+#ifndef _SYMMETRY_H_
+#define _SYMMETRY_H_
+#define SYMMETRIES 8
+#define SYMMETRY_IDENTITY 0
+#define SYMMETRY_FLIP_X 1
+#define SYMMETRY_FLIP_Y 2
+#define SYMMETRY_TRANSPOSE 4
+
+void symmetry_apply(unsigned char t, unsigned char size, unsigned char x, unsigned char y, unsigned char* tx, unsigned char* ty);
+void symmetry_revert(unsigned char t, unsigned char size, unsigned char x, unsigned char y, unsigned char* ox, unsigned char* oy);
+#endif
@@ -0,0 +1,375 @@
+/**
+ * @file tactics.c
+ * @author Faris Soliman
+ * This file is a tool that runs a suite of tactical positions through the search or the df-pn
+ * solver and reports which it solves, and how many nodes and how much time it took to solve
+ * each, so a change to either can be judged by what it solves in a given budget rather than
+ * by how many nodes it visits in a second.
+ *
+ * A suite is a text file with one position on every line: a saved game, relative to the suite,
+ * the kind of the position, and the moves that solve it. Everything from a '#' on is a comment,
+ * and blank lines are skipped, so the index of the puzzles mine writes is a suite too. The
+ * search solves a position when the best move of its last iteration is one of them, and it took
+ * the nodes and time of the iteration from which every best move was one of them. The solver
+ * solves a position when it proves a win that starts with one of them, and it does not try the
+ * positions of the kind "defend", since it only proves wins.
+ *
+ * A position the search solves in some nodes is solved by every search given at least as many,
+ * so one run gives the solve rate of every smaller budget, which is printed after the table.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "dfpn.h"
+#include "error-codes.h"
+#include "game.h"
+#include "io.h"
+#include "search.h"
+#define TACTICS_TIME_MS 1000
+#define TACTICS_LINE 1024
+#define TACTICS_MAX_ANSWERS 16
+#define TACTICS_SEARCH 0
+#define TACTICS_VCF 1
+#define TACTICS_VCT 2
+
+typedef struct {
+    int count;
+    unsigned char x[TACTICS_MAX_ANSWERS];
+    unsigned char y[TACTICS_MAX_ANSWERS];
+} tactics_answers;
+
+typedef struct {
+    bool solved;
+    unsigned long nodes;
+    long long elapsed_ms;
+} tactics_result;
+
+typedef struct {
+    const tactics_answers* answers;
+    long long start;
+    bool correct;
+    unsigned long nodes;
+    long long elapsed_ms;
+} tactics_tracker;
+
+static const char* engines[] = {"search", "vcf", "vct"};
+
+/**
+ * Checks if a move solves a position.
+ * @param a The moves that solve it.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return Whether the move is one of them.
+*/
+bool static is_answer(const tactics_answers* a, unsigned char x, unsigned char y) {
+    for (int i = 0; i < a->count; i++) {
+        if (a->x[i] == x && a->y[i] == y) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Follows the iterations of the search, keeping the nodes and time of the first one of the
+ * run of iterations that found a solving move.
+ * @param arg The tactics_tracker.
+ * @param r The result of the iteration.
+*/
+void static track(void* arg, const search_result* r) {
+    tactics_tracker* t = arg;
+    bool correct = is_answer(t->answers, r->x, r->y);
+    if (correct && !t->correct) {
+        t->nodes = r->nodes;
+        t->elapsed_ms = search_clock() - t->start;
+    }
+    t->correct = correct;
+}
+
+/**
+ * Reads the moves that solve a position.
+ * @param words The moves, separated by blanks.
+ * @param size The board size.
+ * @param a Where to put them.
+ * @return Whether there is at least one and all are on the board.
+*/
+bool static read_answers(char* words, unsigned char size, tactics_answers* a) {
+    a->count = 0;
+    for (char* word = strtok(words, " \t"); word != NULL; word = strtok(NULL, " \t")) {
+        char* end;
+        long y = strtol(word + 1, &end, 10) - 1;
+        int x = word[0] - 'A';
+        if (a->count == TACTICS_MAX_ANSWERS || x < 0 || x >= size || y < 0 || y >= size || *end != '\0' ||
+            end == word + 1) {
+            return false;
+        }
+        a->x[a->count] = x;
+        a->y[a->count] = y;
+        a->count++;
+    }
+    return a->count > 0;
+}
+
+/**
+ * Runs the search on a position.
+ * @param s The search.
+ * @param g The game.
+ * @param a The moves that solve it.
+ * @param time_ms The time limit, or 0 for none.
+ * @param max_nodes The node limit, or 0 for none.
+ * @param x Where to put the x coordinate of the move found.
+ * @param y Where to put the y coordinate of the move found.
+ * @return The result.
+*/
+tactics_result static run_search(search* s, game* g, const tactics_answers* a, long time_ms, unsigned long max_nodes,
+    unsigned char* x, unsigned char* y) {
+    tactics_tracker t = {a, 0, false, 0, 0};
+    s->report = track;
+    s->report_arg = &t;
+    search_clear(s);
+    search_prepare(s, time_ms);
+    t.start = search_clock();
+    search_result r = search_run(s, g, SEARCH_MAX_DEPTH, max_nodes);
+    *x = r.x;
+    *y = r.y;
+
+    tactics_result result = {t.correct && is_answer(a, r.x, r.y), r.nodes, search_clock() - t.start};
+    if (result.solved) {
+        result.nodes = t.nodes;
+        result.elapsed_ms = t.elapsed_ms;
+    }
+    return result;
+}
+
+/**
+ * Runs the solver on a position.
+ * @param d The solver.
+ * @param g The game.
+ * @param mode DFPN_VCF or DFPN_VCT.
+ * @param a The moves that solve it.
+ * @param time_ms The time limit, or 0 for none.
+ * @param max_nodes The node limit, or 0 for none.
+ * @param x Where to put the x coordinate of the first move of a win, or SEARCH_NO_MOVE.
+ * @param y Where to put the y coordinate of the first move of a win.
+ * @return The result.
+*/
+tactics_result static run_solver(dfpn* d, game* g, unsigned char mode, const tactics_answers* a, long time_ms,
+    unsigned long max_nodes, unsigned char* x, unsigned char* y) {
+    dfpn_clear(d);
+    dfpn_result r = dfpn_solve(d, g, mode, max_nodes, time_ms);
+    *x = SEARCH_NO_MOVE;
+    *y = SEARCH_NO_MOVE;
+    if (r.result == DFPN_WIN && r.length > 0) {
+        *x = r.line[0][0];
+        *y = r.line[0][1];
+    }
+    tactics_result result = {*x != SEARCH_NO_MOVE && is_answer(a, *x, *y), r.nodes, r.elapsed_ms};
+    return result;
+}
+
+/**
+ * Prints how many positions were solved within every budget of a power of ten, up to the
+ * first at least as large as the largest any position took.
+ * @param results The results.
+ * @param count The number of results.
+ * @param nodes Whether the budgets are nodes or milliseconds.
+*/
+void static print_rates(const tactics_result* results, int count, bool nodes) {
+    unsigned long long largest = 0;
+    for (int i = 0; i < count; i++) {
+        unsigned long long spent = nodes ? results[i].nodes : (unsigned long long)results[i].elapsed_ms;
+        largest = spent > largest ? spent : largest;
+    }
+
+    printf("\n%14s  Solved\n", nodes ? "Nodes" : "Milliseconds");
+    unsigned long long budget = nodes ? 100 : 1;
+    while (true) {
+        int solved = 0;
+        for (int i = 0; i < count; i++) {
+            unsigned long long spent = nodes ? results[i].nodes : (unsigned long long)results[i].elapsed_ms;
+            solved += results[i].solved && spent <= budget;
+        }
+        printf("%14llu  %6d  %5.1f%%\n", budget, solved, count > 0 ? solved * 100.0 / count : 0.0);
+        if (budget >= largest) {
+            break;
+        }
+        budget *= 10;
+    }
+}
+
+/**
+ * The main function.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int engine = TACTICS_SEARCH;
+    long time_ms = -1;
+    unsigned long max_nodes = 0;
+    bool quiet = false;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-e") == 0 && first + 1 < argc) {
+            engine = -1;
+            for (int i = 0; i < (int)(sizeof(engines) / sizeof(engines[0])); i++) {
+                if (strcmp(argv[first + 1], engines[i]) == 0) {
+                    engine = i;
+                }
+            }
+            first = engine < 0 ? argc : first + 2;
+        } else if (strcmp(argv[first], "-t") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            time_ms = atol(argv[first + 1]);
+            first += 2;
+        } else if (strcmp(argv[first], "-n") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            max_nodes = strtoul(argv[first + 1], NULL, 10);
+            first += 2;
+        } else if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+        } else {
+            first = argc;
+        }
+    }
+    if (first + 1 != argc) {
+        fprintf(stdout, "usage: %s [-e search|vcf|vct] [-t ms] [-n nodes] [-q] <suite>\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+    if (time_ms < 0) {
+        time_ms = max_nodes > 0 ? 0 : TACTICS_TIME_MS;
+    }
+
+    FILE* in = fopen(argv[first], "r");
+    if (in == NULL) {
+        fprintf(stderr, "Cannot read %s\n", argv[first]);
+        return FILE_INPUT_ERR;
+    }
+    const char* slash = strrchr(argv[first], '/');
+    int directory = slash == NULL ? 0 : (int)(slash - argv[first] + 1);
+
+    search* s = engine == TACTICS_SEARCH ? search_create(SEARCH_TABLE_SIZE) : NULL;
+    dfpn* d = engine != TACTICS_SEARCH ? dfpn_create(DFPN_MEMORY) : NULL;
+    if (s == NULL && d == NULL) {
+        return NULL_POINTER_ERR;
+    }
+
+    // Run every position of the suite, in order.
+    printf("Position              Kind      Move  Result         Nodes%s\n", quiet ? "" : "          ms");
+    tactics_result* results = NULL;
+    int count = 0;
+    int capacity = 0;
+    int skipped = 0;
+    int unreadable = 0;
+    int status = SUCCESS;
+    char line[TACTICS_LINE];
+    for (int number = 1; fgets(line, sizeof(line), in) != NULL; number++) {
+        line[strcspn(line, "#\r\n")] = '\0';
+        char file[TACTICS_LINE];
+        char kind[TACTICS_LINE];
+        int used = 0;
+        if (line[strspn(line, " \t")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "%s %s %n", file, kind, &used) != 2) {
+            fprintf(stderr, "%s:%d: expected a game, a kind and its moves\n", argv[first], number);
+            status = INPUT_ERR;
+            break;
+        }
+
+        char path[2 * TACTICS_LINE];
+        snprintf(path, sizeof(path), "%.*s%s", directory, argv[first], file);
+        parse_error err;
+        game* g = game_import(path, &err);
+        if (g == NULL) {
+            fprintf(stderr, "%s: %s\n", path, err.reason);
+            unreadable++;
+            continue;
+        }
+        if (g->state == GAME_STATE_STOPPED) {
+            g->state = GAME_STATE_PLAYING;
+        }
+        tactics_answers answers;
+        if (!read_answers(line + used, g->board->size, &answers)) {
+            fprintf(stderr, "%s:%d: bad moves for %s\n", argv[first], number, file);
+            game_delete(g);
+            status = INPUT_ERR;
+            break;
+        }
+
+        char name[TACTICS_LINE];
+        const char* base = strrchr(file, '/') == NULL ? file : strrchr(file, '/') + 1;
+        snprintf(name, sizeof(name), "%s", base);
+        if (strlen(name) > 4 && strcmp(name + strlen(name) - 4, ".gmk") == 0) {
+            name[strlen(name) - 4] = '\0';
+        }
+        if (engine != TACTICS_SEARCH && strcmp(kind, "defend") == 0) {
+            printf("%-20s  %-8s  %4s  %-7s\n", name, kind, "-", "skipped");
+            skipped++;
+            game_delete(g);
+            continue;
+        }
+
+        if (count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            tactics_result* grown = realloc(results, capacity * sizeof(tactics_result));
+            if (grown == NULL) {
+                return NULL_POINTER_ERR;
+            }
+            results = grown;
+        }
+        unsigned char x;
+        unsigned char y;
+        tactics_result* r = &results[count++];
+        if (engine == TACTICS_SEARCH) {
+            *r = run_search(s, g, &answers, time_ms, max_nodes, &x, &y);
+        } else {
+            *r = run_solver(d, g, engine == TACTICS_VCF ? DFPN_VCF : DFPN_VCT, &answers, time_ms, max_nodes, &x, &y);
+        }
+
+        char move[8] = "-";
+        if (x != SEARCH_NO_MOVE) {
+            sprintf(move, "%c%d", x + 'A', y + 1);
+        }
+        printf("%-20s  %-8s  %4s  %-7s  %12lu", name, kind, move, r->solved ? "solved" : "failed", r->nodes);
+        if (!quiet) {
+            printf("  %10lld", r->elapsed_ms);
+        }
+        printf("\n");
+        game_delete(g);
+    }
+    fclose(in);
+
+    // Sum up, with the solve rate of every smaller budget.
+    int solved = 0;
+    for (int i = 0; i < count; i++) {
+        solved += results[i].solved;
+    }
+    printf("\nEngine:              %s\n", engines[engine]);
+    if (time_ms > 0 && max_nodes > 0) {
+        printf("Limits:              %ld ms, %lu nodes\n", time_ms, max_nodes);
+    } else if (time_ms > 0) {
+        printf("Limits:              %ld ms\n", time_ms);
+    } else {
+        printf("Limits:              %lu nodes\n", max_nodes);
+    }
+    printf("Positions:           %d\n", count);
+    if (skipped > 0) {
+        printf("Skipped:             %d\n", skipped);
+    }
+    if (unreadable > 0) {
+        printf("Unreadable:          %d\n", unreadable);
+    }
+    printf("Solved:              %d (%.1f%%)\n", solved, count > 0 ? solved * 100.0 / count : 0.0);
+    print_rates(results, count, true);
+    if (!quiet) {
+        print_rates(results, count, false);
+    }
+
+    free(results);
+    search_delete(s);
+    dfpn_delete(d);
+    return status;
+}
@@ -149,6 +149,30 @@ test-replay() {
     return 0
 }
 
+# Test one of the batch tools, named by the first argument
+test-tool() {
+    TOOL=$1
+    TESTNO=$2
+    ESTATUS=$3
+
+    printf '%s test %2d\n' "$TOOL" "$TESTNO"
+    rm -f -- output.txt stderr.txt
+
+    echo "   ./$TOOL ${args[@]} > output.txt 2> stderr.txt"
+    ./$TOOL "${args[@]}" > output.txt 2> stderr.txt
+    ASTATUS=$?
+
+    if ! checkStatus "$ESTATUS" "$ASTATUS" ||
+        ! checkFileOrEmpty "Stdout output" "output/${TOOL}-${TESTNO}.txt" "output.txt" ||
+        ! checkFileOrEmpty "Stderr output" "output/${TOOL}-stderr-${TESTNO}.txt" "stderr.txt"; then
+        FAIL=1
+        return 1
+    fi
+
+    printf '%s test %02d PASS\n' "$TOOL" "$TESTNO"
+    return 0
+}
+
 # make a fresh copy of the target programs
 make clean
 make
@@ -191,6 +215,26 @@ if [ -x gomoku ]; then
     test-gomoku 25 9
     args=(-r gmk/gomoku-26.gmk)
     test-gomoku 26 8
+    args=(-c white -l 2000)
+    test-gomoku 27 0
+    args=(-c black -t 20 -l 3000)
+    test-gomoku 28 0
+    args=(-l 1000)
+    test-gomoku 29 10
+    args=(-c white -l 0)
+    test-gomoku 30 10
+    # A journal cut off in the middle of a move gives back the moves before it.
+    rm -f journal.gmj
+    args=(-a journal.gmj)
+    test-gomoku 33 0
+    truncate -s -11 journal.gmj
+    if [ -x replay ]; then
+        args=(journal.gmj)
+        test-replay 30 0
+    fi
+    args=(-r journal.gmj)
+    test-gomoku 34 0
+    rm -f journal.gmj
 else
     fail "Since your gomoku program didn't compile, we couldn't test it"
 fi
@@ -230,11 +274,13 @@ if [ -x renju ]; then
     test-renju 26 9
     args=(-r gmk/renju-27.gmk)
     test-renju 27 8
+    args=(-c white -l 2000)
+    test-renju 28 0
 else
     fail "Since your renju program didn't compile, we couldn't test it"
 fi
 if [ -x replay ]; then
-    gcc -Wall -std=c99 -O3 -D_NOSLEEP io.c board.c game.c replay.c -o replay &> /dev/null
+    gcc -Wall -std=c99 -O3 -D_NOSLEEP io.c board.c game.c pattern.c threat.c eval.c hash.c symmetry.c search.c cache.c engine.c parse.c journal.c pool.c analysis.c rules.c packed.c source.c nnue.c dfpn.c index.c shape.c split.c playout.c lockstep.c broadcast.c cpu.c console.c replay.c -pthread -o replay &> /dev/null
     args=(gmk/gomoku-8.gmk)
     test-replay 1 0
     args=(gmk/gomoku-9.gmk)
@@ -279,9 +325,236 @@ if [ -x replay ]; then
     test-replay 21 8
     args=(gmk/renju-22.gmk extra)
     test-replay 22 10
+    args=(--eval gmk/renju-8.gmk)
+    test-replay 23 0
+    args=(gmk/replay-24.sgf)
+    test-replay 24 0
+    args=(gmk/replay-25.lib)
+    test-replay 25 0
+    args=(gmk/replay-26.gmk)
+    test-replay 26 8
+    args=(gmk/replay-27.gmj)
+    test-replay 27 0
+    args=(--analyze -j 2 -n 2000 gmk/gomoku-18.gmk)
+    test-replay 28 0
 else
     fail "Since your replay program didn't compile, we couldn't test it"
 fi
+if [ -x corpus ]; then
+    args=(gmk)
+    test-tool corpus 1 0
+    args=(-n 9 gmk)
+    test-tool corpus 2 10
+    args=(-p positions.gpk gmk)
+    test-tool corpus 3 0
+    rm -f positions.gpk
+else
+    fail "Since your corpus program didn't compile, we couldn't test it"
+fi
+if [ -x perft ]; then
+    args=(-q -d 2 gmk/perft-1.gmk)
+    test-tool perft 1 0
+    args=(-q -j 2 2 gmk/perft-2.gmk)
+    test-tool perft 2 0
+    args=(9 gmk/perft-1.gmk)
+    test-tool perft 3 10
+    args=(-q -b -d 2 gmk/perft-1.gmk)
+    test-tool perft 4 0
+    args=(-q -b -j 2 3 gmk/perft-2.gmk)
+    test-tool perft 5 0
+    # The search's quick test of forbidden moves must agree with the rules everywhere.
+    args=(-q -f 1 input/perft/forbidden-1.gmk)
+    test-tool perft 6 0
+    args=(-q -f 1 input/perft/forbidden-2.gmk)
+    test-tool perft 7 0
+    args=(-q -f 2 gmk/perft-2.gmk)
+    test-tool perft 8 0
+    args=(-q -f 1 input/perft/forbidden-3.gmk)
+    test-tool perft 9 0
+    # Every kernel of the pattern scanner must give the codes counted the slow way.
+    args=(-q -p 2 input/perft/patterns-17.gmk)
+    test-tool perft 10 0
+    args=(-q -p 2 input/perft/patterns-19.gmk)
+    test-tool perft 11 0
+    args=(-q -f -p 1 input/perft/forbidden-1.gmk)
+    test-tool perft 12 0
+else
+    fail "Since your perft program didn't compile, we couldn't test it"
+fi
+if [ -x dataset ]; then
+    args=(-j 2 -o dataset.bin gmk)
+    test-tool dataset 1 0
+    args=(-a -o dataset.bin gmk/renju-8.gmk gmk/missing.gmk)
+    test-tool dataset 2 0
+    args=(gmk)
+    test-tool dataset 3 10
+    rm -f dataset.bin
+else
+    fail "Since your dataset program didn't compile, we couldn't test it"
+fi
+if [ -x train ] && [ -x dataset ]; then
+    ./dataset -o dataset.bin gmk > /dev/null
+    args=(-q -e 2 -o network.nnue dataset.bin)
+    test-tool train 1 0
+    # Play the computer with the network just trained.
+    args=(-c white -l 2000 -n network.nnue)
+    test-gomoku 31 0
+    args=(-o network.nnue)
+    test-tool train 2 10
+    args=(-q -o network.nnue gmk/gomoku-1.gmk)
+    test-tool train 3 8
+    rm -f dataset.bin network.nnue
+else
+    fail "Since your train program didn't compile, we couldn't test it"
+fi
+if [ -x solve ]; then
+    args=(-q -f -m 1 gmk/gomoku-8.gmk)
+    test-tool solve 1 0
+    args=(-q gmk/renju-10.gmk)
+    test-tool solve 2 0
+    args=(-q -n 1000 gmk/gomoku-14.gmk)
+    test-tool solve 3 0
+    args=(-t gmk/gomoku-8.gmk)
+    test-tool solve 4 10
+    # A win proven once is read back from the cache, by the solver and by the analysis.
+    rm -f solved.cache
+    args=(-q -f -k solved.cache gmk/gomoku-8.gmk)
+    test-tool solve 5 0
+    args=(-q -f -k solved.cache gmk/gomoku-8.gmk)
+    test-tool solve 6 0
+    if [ -x replay ]; then
+        args=(--analyze -j 1 -n 1 -k solved.cache gmk/gomoku-8.gmk)
+        test-replay 29 0
+    fi
+    rm -f solved.cache
+else
+    fail "Since your solve program didn't compile, we couldn't test it"
+fi
+if [ -x lookup ]; then
+    args=(-j 2 -o games.idx gmk gmk/missing.gmk)
+    test-tool lookup 1 0
+    args=(-q -l 3 games.idx H8 H9 I8)
+    test-tool lookup 2 0
+    args=(-q games.idx gmk/renju-4.gmk)
+    test-tool lookup 3 0
+    args=(-q games.idx H8 H8)
+    test-tool lookup 4 6
+    args=(games.idx)
+    test-tool lookup 5 10
+    rm -f games.idx
+else
+    fail "Since your lookup program didn't compile, we couldn't test it"
+fi
+if [ -x scan ]; then
+    args=(-q -j 2 '?X?/XOX/?X?' gmk gmk/missing.gmk)
+    test-tool scan 1 0
+    args=(-q -l 5 XX/OO gmk/gomoku-1.gmk gmk/renju-2.gmk)
+    test-tool scan 2 0
+    args=(-q X.Z gmk)
+    test-tool scan 3 6
+    args=(-l XXX gmk)
+    test-tool scan 4 10
+else
+    fail "Since your scan program didn't compile, we couldn't test it"
+fi
+if [ -x cluster ]; then
+    args=(-q -l 1 -d 6 gmk/gomoku-12.gmk)
+    test-tool cluster 1 0
+    args=(-q -l 3 -d 6 gmk/gomoku-12.gmk)
+    test-tool cluster 2 0
+    args=(-q -l 2 gmk/gomoku-8.gmk)
+    test-tool cluster 3 0
+    args=(-l 2 -d 0 gmk/gomoku-12.gmk)
+    test-tool cluster 4 10
+    # Moves that tie must come out the same whichever worker answers first.
+    args=(-q -l 8 -d 6 gmk/gomoku-12.gmk)
+    for run in 1 2 3 4 5; do
+        test-tool cluster 5 0
+    done
+else
+    fail "Since your cluster program didn't compile, we couldn't test it"
+fi
+if [ -x generate ]; then
+    args=(-q -j 2 -n 1000 -s 7 -a games.tar)
+    test-tool generate 1 0
+    args=(-q -r -b 19 -l 20-60 -c 0 -p 50 -n 300 -o generated)
+    test-tool generate 2 0
+    args=(-q -b 13 -n 10 -o generated)
+    test-tool generate 3 10
+    rm -rf games.tar generated
+else
+    fail "Since your generate program didn't compile, we couldn't test it"
+fi
+if [ -x tactics ]; then
+    args=(-q -n 20000 suite/tactics.txt)
+    test-tool tactics 1 0
+    args=(-q -e vcf -n 100000 suite/tactics.txt)
+    test-tool tactics 2 0
+    args=(-q suite/missing.txt)
+    test-tool tactics 3 8
+    args=(-e mcts suite/tactics.txt)
+    test-tool tactics 4 10
+else
+    fail "Since your tactics program didn't compile, we couldn't test it"
+fi
+if [ -x mine ]; then
+    rm -rf puzzles resumed mine.checkpoint
+    args=(-q -f -j 2 -o puzzles gmk)
+    test-tool mine 1 0
+    checkFile "Puzzle index" output/mine-index.txt puzzles/puzzles.txt
+    args=(-q -f -l 20 -c mine.checkpoint -o resumed gmk)
+    test-tool mine 2 0
+    args=(-q -f -c mine.checkpoint -o resumed gmk gmk/missing.gmk)
+    test-tool mine 3 0
+    checkFile "Resumed puzzle index" output/mine-index.txt resumed/puzzles.txt
+    diff -r puzzles resumed > /dev/null 2>&1 || fail "FAILED - resumed puzzles don't match the puzzles mined in one run"
+    args=(-q -c mine.checkpoint -o resumed gmk)
+    test-tool mine 4 10
+    args=(-q -f gmk)
+    test-tool mine 5 10
+    # The same stone indices on two board sizes are two different positions.
+    args=(-q -f -j 2 -o sizes input/mine)
+    test-tool mine 6 0
+    checkFile "Puzzle index of two sizes" output/mine-sizes-index.txt sizes/puzzles.txt
+    rm -rf puzzles resumed sizes mine.checkpoint
+else
+    fail "Since your mine program didn't compile, we couldn't test it"
+fi
+if [ -x watch ] && [ -x gomoku ] && [ -x renju ]; then
+    # Start a spectator, then a game it waits for; the moves reach the game a second later.
+    for TESTNO in 1 2; do
+        GAME=$([ $TESTNO -eq 1 ] && echo gomoku || echo renju)
+        INPUT=$([ $TESTNO -eq 1 ] && echo input/gomoku-1.txt || echo input/renju-11.txt)
+        printf 'watch test %2d\n' "$TESTNO"
+        rm -f -- output.txt stderr.txt
+        echo "   ./watch -p -w 5000 /watch-test > output.txt 2> stderr.txt & ./$GAME -x /watch-test < $INPUT"
+        ./watch -p -w 5000 /watch-test > output.txt 2> stderr.txt &
+        WATCHER=$!
+        (sleep 1; cat "$INPUT") | ./$GAME -x /watch-test > /dev/null 2>&1
+        wait $WATCHER
+        ASTATUS=$?
+        if checkStatus 0 "$ASTATUS" &&
+            checkFileOrEmpty "Stdout output" "output/watch-${TESTNO}.txt" "output.txt" &&
+            checkFileOrEmpty "Stderr output" "output/watch-stderr-${TESTNO}.txt" "stderr.txt"; then
+            printf 'watch test %02d PASS\n' "$TESTNO"
+        else
+            FAIL=1
+        fi
+    done
+    # A second game cannot take the name of a game that is still broadcasting.
+    (sleep 2; cat input/gomoku-1.txt) | ./gomoku -x /watch-test-busy > /dev/null 2>&1 &
+    BROADCASTER=$!
+    sleep 1
+    args=(-x /watch-test-busy)
+    test-gomoku 32 7
+    wait $BROADCASTER
+    args=(-p /watch-test-missing)
+    test-tool watch 3 8
+    args=(-p watch-test)
+    test-tool watch 4 10
+else
+    fail "Since your watch program didn't compile, we couldn't test it"
+fi
 
 if [ $FAIL -ne 0 ]; then
     echo "FAILING TESTS!"
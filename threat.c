@@ -0,0 +1,172 @@
+/**
+ * @file threat.c
+ * @author Faris Soliman
+ * This file contains the threat map a game keeps next to its board. For every intersection,
+ * color and direction it holds the pattern code from pattern.c, so move ordering, hints and
+ * forbidden point display can look threats up instead of walking the board. The map is built
+ * once by a full scan and afterwards only the lines through a placed or removed stone are
+ * reclassified.
+*/
+#include <stdlib.h>
+#include "board.h"
+#include "pattern.h"
+#include "threat.h"
+
+/**
+ * Recomputes the strongest pattern of both colors at one intersection.
+ * @param t The threat map.
+ * @param i The index of the intersection in the scan.
+*/
+void static refresh_best(threat_map* t, int i) {
+    for (int c = 0; c < 2; c++) {
+        unsigned char best = PATTERN_NONE;
+        for (int d = 0; d < DIRECTIONS; d++) {
+            if (t->scan.codes[c][d][i] > best) {
+                best = t->scan.codes[c][d][i];
+            }
+        }
+        t->best[c][i] = best;
+    }
+}
+
+/**
+ * Creates a threat map for a board.
+ * @param b The board to map.
+ * @return The new threat map, or NULL if it could not be allocated.
+*/
+threat_map* threat_create(board* b) {
+    threat_map* t = malloc(sizeof(threat_map));
+    if (t == NULL) {
+        return NULL;
+    }
+
+    threat_rebuild(t, b);
+    return t;
+}
+
+/**
+ * Deletes a threat map.
+ * @param t The threat map to delete.
+*/
+void threat_delete(threat_map* t) {
+    free(t);
+}
+
+/**
+ * Rebuilds a threat map from scratch with a full board scan.
+ * @param t The threat map to rebuild.
+ * @param b The board to map.
+*/
+void threat_rebuild(threat_map* t, board* b) {
+    pattern_scan_board(b, &t->scan);
+    for (int y = 0; y < b->size; y++) {
+        for (int x = 0; x < b->size; x++) {
+            refresh_best(t, y * t->scan.stride + x);
+        }
+    }
+}
+
+/**
+ * Updates a threat map after a stone was placed on or removed from (x, y).
+ * @param t The threat map to update.
+ * @param b The board after the change.
+ * @param x The x coordinate of the stone.
+ * @param y The y coordinate of the stone.
+*/
+void threat_update(threat_map* t, board* b, unsigned char x, unsigned char y) {
+    pattern_update(&t->scan, b, x, y);
+    for (int d = 0; d < DIRECTIONS; d++) {
+        for (int k = -5; k <= 5; k++) {
+            int cx = x + k * pattern_dx[d];
+            int cy = y + k * pattern_dy[d];
+            if (cx >= 0 && cx < b->size && cy >= 0 && cy < b->size) {
+                refresh_best(t, cy * t->scan.stride + cx);
+            }
+        }
+    }
+}
+
+/**
+ * Gets the pattern a color has, or would get by playing there, along one direction.
+ * @param t The threat map.
+ * @param stone The color to look at.
+ * @param dir The direction to look at.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The pattern code.
+*/
+unsigned char threat_get(const threat_map* t, unsigned char stone, unsigned char dir, unsigned char x, unsigned char y) {
+    return t->scan.codes[stone - BLACK_STONE][dir][y * t->scan.stride + x];
+}
+
+/**
+ * Gets the strongest pattern a color has, or would get by playing there, in any direction.
+ * @param t The threat map.
+ * @param stone The color to look at.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The pattern code.
+*/
+unsigned char threat_best(const threat_map* t, unsigned char stone, unsigned char x, unsigned char y) {
+    return t->best[stone - BLACK_STONE][y * t->scan.stride + x];
+}
+
+/**
+ * Ranks an empty intersection for a color about to move. Making a pattern outranks
+ * blocking the same pattern of the opponent, and blocking outranks making anything weaker,
+ * so an own five comes first, then stopping the opponent's five, then an own open four and
+ * so on.
+ * @param t The threat map.
+ * @param stone The color to move.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return The rank, higher is more urgent.
+*/
+unsigned char threat_priority(const threat_map* t, unsigned char stone, unsigned char x, unsigned char y) {
+    int i = y * t->scan.stride + x;
+    unsigned char attack = t->best[stone - BLACK_STONE][i];
+    unsigned char defence = t->best[2 - stone][i];
+
+    // An overline only wins in freestyle, so rank it like a four rather than a five.
+    if (attack == PATTERN_OVERLINE) {
+        attack = PATTERN_FOUR;
+    }
+    if (defence == PATTERN_OVERLINE) {
+        defence = PATTERN_FOUR;
+    }
+    return attack * 2 + 1 > defence * 2 ? attack * 2 + 1 : defence * 2;
+}
+
+/**
+ * Checks if black would make a forbidden move at an empty intersection: an overline is always
+ * forbidden, and two open fours are forbidden unless the same stone makes five. A move makes
+ * an overline only where the pattern code says so, and an open four only in a direction whose
+ * code is at least a four, so the codes rule out almost every intersection; the rest are
+ * decided by the rule kernel game_place_stone() itself runs, so the answer is always the same
+ * as its own.
+ * @param t The threat map, in step with the board.
+ * @param rules The rule kernel of the game.
+ * @param b The board. The stone is put on it only while the rule checks run.
+ * @param x The x coordinate.
+ * @param y The y coordinate.
+ * @return Whether the move is forbidden.
+*/
+bool threat_forbidden(const threat_map* t, const rules_kernel* rules, board* b, unsigned char x, unsigned char y) {
+    int i = y * t->scan.stride + x;
+    bool overline = false;
+    int fours = 0;
+    for (int d = 0; d < DIRECTIONS; d++) {
+        unsigned char code = t->scan.codes[0][d][i];
+        overline = overline || code == PATTERN_OVERLINE;
+        fours += code >= PATTERN_FOUR;
+    }
+    if (!overline && fours < 2) {
+        return false;
+    }
+
+    board_set(b, x, y, BLACK_STONE);
+    bool forbidden = rules->overline(b->grid, b->size, x, y, BLACK_STONE) ||
+        (!rules->five(b->grid, b->size, x, y, BLACK_STONE) && rules->double_four(b->grid, b->size, x, y, BLACK_STONE));
+    board_clear(b, x, y);
+    return forbidden;
+}
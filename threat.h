@@ -0,0 +1,21 @@
+#ifndef _THREAT_H_
+#define _THREAT_H_
+#include <stdbool.h>
+#include "board.h"
+#include "pattern.h"
+#include "rules.h"
+
+typedef struct {
+    pattern_scan scan;
+    unsigned char best[2][PATTERN_MAX_CELLS];
+} threat_map;
+
+threat_map* threat_create(board* b);
+void threat_delete(threat_map* t);
+void threat_rebuild(threat_map* t, board* b);
+void threat_update(threat_map* t, board* b, unsigned char x, unsigned char y);
+unsigned char threat_get(const threat_map* t, unsigned char stone, unsigned char dir, unsigned char x, unsigned char y);
+unsigned char threat_best(const threat_map* t, unsigned char stone, unsigned char x, unsigned char y);
+unsigned char threat_priority(const threat_map* t, unsigned char stone, unsigned char x, unsigned char y);
+bool threat_forbidden(const threat_map* t, const rules_kernel* rules, board* b, unsigned char x, unsigned char y);
+#endif
\ No newline at end of file
@@ -0,0 +1,517 @@
+/**
+ * @file train.c
+ * @author Faris Soliman
+ * This file is a tool that trains a network for the evaluator in nnue.c from the records
+ * dataset writes. It fits the same layers in floating point, with plain stochastic gradient
+ * descent on the cross entropy between the output, read as a winning chance, and the result
+ * of the game: 1 for a win of the side to move, 0 for a loss and a half for a draw. Records of
+ * unfinished games are skipped. Only the stone planes are inputs; the last move and forbidden
+ * point planes are not.
+ *
+ * The weights are clamped while training so the quantized network cannot overflow: an
+ * accumulator holds at most a full board of columns, and the 8-bit layers are limited to what
+ * their scale can represent. The network is then quantized, written and loaded back through
+ * nnue_load(), and every position is evaluated with every kernel the processor supports to
+ * check they agree, followed by a benchmark of updates and evaluations like the ones a search
+ * makes, which -q leaves out.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "board.h"
+#include "dataset.h"
+#include "error-codes.h"
+#include "game.h"
+#include "nnue.h"
+#include "search.h"
+#define TRAIN_EPOCHS 4
+#define TRAIN_RATE 0.01f
+#define TRAIN_SEED 1
+#define TRAIN_FEATURE_LIMIT 0.5f
+#define TRAIN_WEIGHT_LIMIT (127.0f / NNUE_SCALE_WEIGHT)
+#define TRAIN_BENCH_MS 500
+
+typedef struct {
+    float feature_weights[NNUE_INPUTS][NNUE_HIDDEN];
+    float feature_bias[NNUE_HIDDEN];
+    float hidden_weights[NNUE_LAYER][2 * NNUE_HIDDEN];
+    float hidden_bias[NNUE_LAYER];
+    float output_weights[NNUE_LAYER];
+    float output_bias;
+} model;
+
+typedef struct {
+    int count[2];
+    int features[2][NNUE_CELLS + 2];
+    float acc[2 * NNUE_HIDDEN];
+    float input[2 * NNUE_HIDDEN];
+    float sums[NNUE_LAYER];
+    float hidden[NNUE_LAYER];
+} trace;
+
+/**
+ * Draws the next number of a xorshift generator.
+ * @param state The state of the generator, not zero.
+ * @return The number.
+*/
+uint64_t static next_random(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Draws a uniform number in a range.
+ * @param state The state of the generator.
+ * @param limit The bound of the range, which is -limit to limit.
+ * @return The number.
+*/
+float static uniform(uint64_t* state, float limit) {
+    return ((next_random(state) >> 40) / (float)(1 << 24) * 2 - 1) * limit;
+}
+
+/**
+ * Clamps a weight to a range.
+ * @param v The weight.
+ * @param limit The bound of the range.
+ * @return The clamped weight.
+*/
+float static clamp(float v, float limit) {
+    return v < -limit ? -limit : v > limit ? limit : v;
+}
+
+/**
+ * Checks if a plane of a record has an intersection set.
+ * @param r The record.
+ * @param plane The plane.
+ * @param index The index of the intersection.
+ * @return Whether it is set.
+*/
+bool static plane_get(const dataset_record* r, int plane, int index) {
+    return r->planes[plane][index / 8] >> (index % 8) & 1;
+}
+
+/**
+ * Lists the inputs of a record for both sides, the side to move first.
+ * @param r The record.
+ * @param t Where to put the inputs.
+*/
+void static record_features(const dataset_record* r, trace* t) {
+    for (int side = 0; side < 2; side++) {
+        int p = side == 0 ? r->stone - BLACK_STONE : 2 - r->stone;
+        int n = 0;
+        if (p == 0) {
+            t->features[side][n++] = NNUE_FEATURE_BLACK;
+        }
+        if (r->type == GAME_RENJU) {
+            t->features[side][n++] = NNUE_FEATURE_RENJU;
+        }
+        for (int y = 0; y < r->size; y++) {
+            for (int x = 0; x < r->size; x++) {
+                if (plane_get(r, DATASET_PLANE_BLACK, y * r->size + x)) {
+                    t->features[side][n++] = nnue_feature(p, BLACK_STONE, x, y);
+                } else if (plane_get(r, DATASET_PLANE_WHITE, y * r->size + x)) {
+                    t->features[side][n++] = nnue_feature(p, WHITE_STONE, x, y);
+                }
+            }
+        }
+        t->count[side] = n;
+    }
+}
+
+/**
+ * Runs the floating point network on the inputs of a trace, keeping every layer for the
+ * backward pass.
+ * @param m The model.
+ * @param t The trace, with its inputs listed.
+ * @return The output.
+*/
+float static forward(const model* m, trace* t) {
+    for (int side = 0; side < 2; side++) {
+        float* acc = t->acc + side * NNUE_HIDDEN;
+        memcpy(acc, m->feature_bias, sizeof(m->feature_bias));
+        for (int f = 0; f < t->count[side]; f++) {
+            const float* column = m->feature_weights[t->features[side][f]];
+            for (int i = 0; i < NNUE_HIDDEN; i++) {
+                acc[i] += column[i];
+            }
+        }
+    }
+    for (int i = 0; i < 2 * NNUE_HIDDEN; i++) {
+        t->input[i] = t->acc[i] < 0 ? 0 : t->acc[i] > 1 ? 1 : t->acc[i];
+    }
+
+    float out = m->output_bias;
+    for (int j = 0; j < NNUE_LAYER; j++) {
+        float sum = m->hidden_bias[j];
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++) {
+            sum += m->hidden_weights[j][i] * t->input[i];
+        }
+        t->sums[j] = sum;
+        t->hidden[j] = sum < 0 ? 0 : sum > 1 ? 1 : sum;
+        out += m->output_weights[j] * t->hidden[j];
+    }
+    return out;
+}
+
+/**
+ * Takes one gradient step on a trace.
+ * @param m The model.
+ * @param t The trace, after forward().
+ * @param gradient The gradient of the loss by the output.
+ * @param rate The learning rate.
+*/
+void static backward(model* m, const trace* t, float gradient, float rate) {
+    float d_input[2 * NNUE_HIDDEN] = {0};
+    for (int j = 0; j < NNUE_LAYER; j++) {
+        float d_sum = t->sums[j] > 0 && t->sums[j] < 1 ? gradient * m->output_weights[j] : 0;
+        m->output_weights[j] = clamp(m->output_weights[j] - rate * gradient * t->hidden[j], TRAIN_WEIGHT_LIMIT);
+        if (d_sum == 0) {
+            continue;
+        }
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++) {
+            d_input[i] += d_sum * m->hidden_weights[j][i];
+            m->hidden_weights[j][i] = clamp(m->hidden_weights[j][i] - rate * d_sum * t->input[i], TRAIN_WEIGHT_LIMIT);
+        }
+        m->hidden_bias[j] -= rate * d_sum;
+    }
+    m->output_bias -= rate * gradient;
+
+    for (int side = 0; side < 2; side++) {
+        float d_acc[NNUE_HIDDEN];
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            float a = t->acc[side * NNUE_HIDDEN + i];
+            d_acc[i] = a > 0 && a < 1 ? rate * d_input[side * NNUE_HIDDEN + i] : 0;
+            m->feature_bias[i] = clamp(m->feature_bias[i] - d_acc[i], TRAIN_FEATURE_LIMIT);
+        }
+        for (int f = 0; f < t->count[side]; f++) {
+            float* column = m->feature_weights[t->features[side][f]];
+            for (int i = 0; i < NNUE_HIDDEN; i++) {
+                column[i] = clamp(column[i] - d_acc[i], TRAIN_FEATURE_LIMIT);
+            }
+        }
+    }
+}
+
+/**
+ * Gets the target of a record.
+ * @param r The record.
+ * @return The winning chance of the side to move, or a negative number if the game is
+ *         unfinished.
+*/
+float static target(const dataset_record* r) {
+    if (r->result == DATASET_WIN) {
+        return 1;
+    }
+    if (r->result == DATASET_LOSS) {
+        return 0;
+    }
+    return r->result == DATASET_DRAW ? 0.5f : -1;
+}
+
+/**
+ * Rounds a weight to an integer.
+ * @param v The weight, already scaled.
+ * @param limit The largest magnitude the integer may have.
+ * @return The integer.
+*/
+long static quantize(float v, long limit) {
+    long q = (long)(v >= 0 ? v + 0.5f : v - 0.5f);
+    return q < -limit ? -limit : q > limit ? limit : q;
+}
+
+/**
+ * Quantizes a model into network weights.
+ * @param m The model.
+ * @param w Where to put the weights.
+*/
+void static quantize_model(const model* m, nnue_weights* w) {
+    const float a = NNUE_SCALE_FEATURE;
+    const float b = NNUE_SCALE_WEIGHT;
+    nnue_init(w, NNUE_OUTPUT_SCALE);
+    for (int f = 0; f < NNUE_INPUTS; f++) {
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            w->feature_weights[f][i] = quantize(m->feature_weights[f][i] * a, 32767);
+        }
+    }
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        w->feature_bias[i] = quantize(m->feature_bias[i] * a, 32767);
+    }
+    for (int j = 0; j < NNUE_LAYER; j++) {
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++) {
+            w->hidden_weights[j][i] = quantize(m->hidden_weights[j][i] * b, 127);
+        }
+        w->hidden_bias[j] = quantize(m->hidden_bias[j] * a * b, 1L << 30);
+        w->output_weights[j] = quantize(m->output_weights[j] * b, 127);
+    }
+    w->output_bias = quantize(m->output_bias * a * b, 1L << 30);
+}
+
+/**
+ * Sets up a board and the network's accumulators for a record.
+ * @param r The record.
+ * @param n The network.
+ * @param b The board, as large as the record's.
+ * @param s Where to put the accumulators.
+*/
+void static record_state(const dataset_record* r, const nnue_network* n, board* b, nnue_state* s) {
+    for (int y = 0; y < r->size; y++) {
+        for (int x = 0; x < r->size; x++) {
+            if (plane_get(r, DATASET_PLANE_BLACK, y * r->size + x)) {
+                board_set(b, x, y, BLACK_STONE);
+            } else if (plane_get(r, DATASET_PLANE_WHITE, y * r->size + x)) {
+                board_set(b, x, y, WHITE_STONE);
+            } else {
+                board_clear(b, x, y);
+            }
+        }
+    }
+    nnue_refresh(s, n, b, r->type);
+}
+
+/**
+ * Evaluates every record with the quantized network and every kernel, and counts how often
+ * the sign of the score matches the result of a decided game.
+ * @param n The network.
+ * @param records The records.
+ * @param count The number of records.
+ * @param agree Where to put whether the kernels agreed on every record.
+ * @param correct Where to put the number of decided records the score got right.
+ * @param decided Where to put the number of decided records.
+ * @return Whether there was enough memory.
+*/
+bool static check_network(const nnue_network* n, const dataset_record* records, size_t count, bool* agree,
+    size_t* correct, size_t* decided) {
+    board* boards[PATTERN_MAX_SIZE + 1] = {NULL};
+    const char* names[] = {"avx2", "scalar"};
+    const char* chosen = nnue_kernel();
+    nnue_state s;
+    *agree = true;
+    *correct = 0;
+    *decided = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const dataset_record* r = &records[i];
+        if (r->size < 1 || r->size > PATTERN_MAX_SIZE) {
+            continue;
+        }
+        if (boards[r->size] == NULL && (boards[r->size] = board_create(r->size)) == NULL) {
+            return false;
+        }
+        record_state(r, n, boards[r->size], &s);
+
+        int score = nnue_evaluate(&s, r->stone);
+        for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+            if (nnue_use_kernel(names[k])) {
+                *agree = *agree && nnue_evaluate(&s, r->stone) == score;
+            }
+        }
+        nnue_use_kernel(chosen);
+
+        if (r->result == DATASET_WIN || r->result == DATASET_LOSS) {
+            (*decided)++;
+            *correct += (score > 0) == (r->result == DATASET_WIN);
+        }
+    }
+    for (int size = 0; size <= PATTERN_MAX_SIZE; size++) {
+        board_delete(boards[size]);
+    }
+    return true;
+}
+
+/**
+ * Measures how fast the network keeps up with a search: from every record's position, the
+ * move played is put into the accumulators, the position after it is evaluated and the move
+ * is taken back out.
+ * @param n The network.
+ * @param records The records.
+ * @param count The number of records.
+ * @return The number of evaluations per second.
+*/
+double static bench_network(const nnue_network* n, const dataset_record* records, size_t count) {
+    board* b = board_create(PATTERN_MAX_SIZE);
+    if (b == NULL || count == 0) {
+        board_delete(b);
+        return 0;
+    }
+    nnue_state s;
+    dataset_record empty = records[0];
+    memset(empty.planes, 0, sizeof(empty.planes));
+    record_state(&empty, n, b, &s);
+
+    unsigned long evaluations = 0;
+    volatile int sink = 0;
+    long long start = search_clock();
+    long long elapsed = 0;
+    while (elapsed < TRAIN_BENCH_MS) {
+        for (size_t i = 0; i < count; i++) {
+            const dataset_record* r = &records[i];
+            unsigned char other = r->stone == BLACK_STONE ? WHITE_STONE : BLACK_STONE;
+            nnue_update(&s, r->x, r->y, r->stone, 1);
+            sink += nnue_evaluate(&s, other);
+            nnue_update(&s, r->x, r->y, r->stone, -1);
+        }
+        evaluations += count;
+        elapsed = search_clock() - start;
+    }
+    board_delete(b);
+    return evaluations * 1000.0 / elapsed;
+}
+
+/**
+ * The main function: trains a network on a dataset.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    int epochs = TRAIN_EPOCHS;
+    float rate = TRAIN_RATE;
+    uint64_t seed = TRAIN_SEED;
+    bool quiet = false;
+    const char* path = NULL;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-q") == 0) {
+            quiet = true;
+            first++;
+            continue;
+        }
+        if (strcmp(argv[first], "-e") == 0 && first + 1 < argc && atoi(argv[first + 1]) > 0) {
+            epochs = atoi(argv[first + 1]);
+        } else if (strcmp(argv[first], "-r") == 0 && first + 1 < argc && atof(argv[first + 1]) > 0) {
+            rate = atof(argv[first + 1]);
+        } else if (strcmp(argv[first], "-s") == 0 && first + 1 < argc && strtoull(argv[first + 1], NULL, 10) > 0) {
+            seed = strtoull(argv[first + 1], NULL, 10);
+        } else if (strcmp(argv[first], "-o") == 0 && first + 1 < argc) {
+            path = argv[first + 1];
+        } else {
+            first = argc;
+            break;
+        }
+        first += 2;
+    }
+    if (first + 1 != argc || path == NULL) {
+        fprintf(stdout, "usage: %s [-e epochs] [-r rate] [-s seed] [-q] -o network.nnue <dataset.bin>\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // Map the dataset.
+    int fd = open(argv[first], O_RDONLY);
+    struct stat st;
+    dataset_header header;
+    if (fd < 0 || fstat(fd, &st) != 0 || pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, DATASET_MAGIC, sizeof(header.magic)) != 0 || header.version != DATASET_VERSION ||
+        header.record_size != sizeof(dataset_record) ||
+        (uint64_t)st.st_size != sizeof(dataset_header) + header.count * sizeof(dataset_record)) {
+        fprintf(stderr, "Cannot read %s\n", argv[first]);
+        return FILE_INPUT_ERR;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot read %s\n", argv[first]);
+        return FILE_INPUT_ERR;
+    }
+    const dataset_record* records = (const dataset_record*)((char*)map + sizeof(dataset_header));
+    size_t count = header.count;
+
+    // Keep the records of finished games, in a shuffled order.
+    size_t* order = malloc(sizeof(size_t) * (count + 1));
+    model* m = malloc(sizeof(model));
+    trace* t = malloc(sizeof(trace));
+    nnue_weights* w = malloc(sizeof(nnue_weights));
+    if (order == NULL || m == NULL || t == NULL || w == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (target(&records[i]) >= 0 && records[i].size <= PATTERN_MAX_SIZE) {
+            order[used++] = i;
+        }
+    }
+    printf("Records:             %zu, %zu of finished games\n", count, used);
+
+    uint64_t state = seed;
+    for (int f = 0; f < NNUE_INPUTS; f++) {
+        for (int i = 0; i < NNUE_HIDDEN; i++) {
+            m->feature_weights[f][i] = uniform(&state, 0.05f);
+        }
+    }
+    for (int i = 0; i < NNUE_HIDDEN; i++) {
+        m->feature_bias[i] = 0.25f;
+    }
+    for (int j = 0; j < NNUE_LAYER; j++) {
+        for (int i = 0; i < 2 * NNUE_HIDDEN; i++) {
+            m->hidden_weights[j][i] = uniform(&state, 1.0f / 16);
+        }
+        m->hidden_bias[j] = 0.25f;
+        m->output_weights[j] = uniform(&state, 0.5f);
+    }
+    m->output_bias = 0;
+
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        for (size_t i = used; i > 1; i--) {
+            size_t k = next_random(&state) % i;
+            size_t swap = order[i - 1];
+            order[i - 1] = order[k];
+            order[k] = swap;
+        }
+
+        double loss = 0;
+        for (size_t i = 0; i < used; i++) {
+            const dataset_record* r = &records[order[i]];
+            float goal = target(r);
+            record_features(r, t);
+            float out = forward(m, t);
+            float p = 1 / (1 + expf(-out));
+            float q = p < 1e-6f ? 1e-6f : p > 1 - 1e-6f ? 1 - 1e-6f : p;
+            loss -= goal * logf(q) + (1 - goal) * logf(1 - q);
+            backward(m, t, p - goal, rate);
+        }
+        printf("Epoch %-3d            loss %.4f\n", epoch, used > 0 ? loss / used : 0);
+    }
+
+    // Quantize, write and load the network back as the engine would.
+    quantize_model(m, w);
+    if (!nnue_write(path, w)) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return FILE_OUTPUT_ERR;
+    }
+    nnue_network* n = nnue_load(path);
+    if (n == NULL) {
+        fprintf(stderr, "Cannot read %s\n", path);
+        return FILE_INPUT_ERR;
+    }
+    printf("Network:             %zu bytes written to %s\n", sizeof(nnue_weights), path);
+
+    bool agree;
+    size_t correct;
+    size_t decided;
+    if (!check_network(n, records, count, &agree, &correct, &decided)) {
+        return NULL_POINTER_ERR;
+    }
+    printf("Kernels:             %s\n", agree ? "agree" : "DISAGREE");
+    printf("Decided positions:   %zu of %zu called right (%.1f%%)\n", correct, decided,
+        decided > 0 ? 100.0 * correct / decided : 0.0);
+    if (!quiet) {
+        printf("Evaluations/sec:     %.0f (%s)\n", bench_network(n, records, count), nnue_kernel());
+    }
+
+    nnue_close(n);
+    munmap(map, st.st_size);
+    free(order);
+    free(m);
+    free(t);
+    free(w);
+    return agree ? SUCCESS : INPUT_ERR;
+}
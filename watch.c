@@ -0,0 +1,156 @@
+/**
+ * @file watch.c
+ * @author Faris Soliman
+ * This file is a spectator for a game that gomoku or renju is broadcasting with -x. It maps
+ * the game's ring of events, picks the game up as it is, then plays every move and undo on a
+ * game of its own and prints the board after each, until the game ends. Nothing is sent to
+ * the game, so any number of spectators can watch it at no cost to it.
+ *
+ * Every event carries the hash of the position after it, so a spectator that somehow got out
+ * of step with the game sees it at once; it picks the game up again, as it does when it falls
+ * so far behind that the game wrote over events it had not read.
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "board.h"
+#include "broadcast.h"
+#include "console.h"
+#include "error-codes.h"
+#include "game.h"
+#include "search.h"
+
+/**
+ * Waits a poll interval for the game.
+*/
+void static wait_poll(void) {
+    struct timespec ts = {0, BROADCAST_POLL_MS * 1000000L};
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * Prints how a game ended.
+ * @param state The state it ended in.
+ * @param winner The winner.
+*/
+void static print_end(unsigned char state, unsigned char winner) {
+    if (state == GAME_STATE_FORBIDDEN) {
+        printf("Game concluded, black made a forbidden move, white won.\n");
+    } else if (state == GAME_STATE_FINISHED && winner != EMPTY_INTERSECTION) {
+        printf("Game concluded, %s won.\n", winner == BLACK_STONE ? "black" : "white");
+    } else if (state == GAME_STATE_FINISHED) {
+        printf("Game concluded, the board is full, draw.\n");
+    } else {
+        printf("The game is stopped.\n");
+    }
+}
+
+/**
+ * Follows a broadcast game to its end.
+ * @param v The view of the broadcast.
+ * @param in_place Whether to print the board in place.
+ * @return The exit code.
+*/
+int static follow(broadcast_view* v, bool in_place) {
+    game* g = broadcast_sync(v);
+    if (g == NULL) {
+        return NULL_POINTER_ERR;
+    }
+    board_print(g->board, in_place);
+
+    broadcast_event e;
+    while (true) {
+        int status = broadcast_next(v, &e);
+        if (status == BROADCAST_NONE) {
+            fflush(stdout);
+            wait_poll();
+            continue;
+        }
+        if (status == BROADCAST_GONE) {
+            game_delete(g);
+            fprintf(stderr, "The game stopped broadcasting without ending\n");
+            return FILE_INPUT_ERR;
+        }
+
+        bool applied = status == BROADCAST_EVENT;
+        if (applied && e.op == BROADCAST_MOVE) {
+            applied = game_place_stone(g, e.x, e.y) == SUCCESS;
+        } else if (applied && e.op == BROADCAST_UNDO) {
+            applied = game_undo(g);
+        } else if (applied && e.op == BROADCAST_END) {
+            g->state = e.state;
+            g->winner = e.winner;
+        }
+
+        // Pick the game up again if this spectator fell behind or out of step.
+        if (!applied || game_hash(g) != e.hash || g->moves_count != e.moves) {
+            game_delete(g);
+            if ((g = broadcast_sync(v)) == NULL) {
+                return NULL_POINTER_ERR;
+            }
+            board_print(g->board, in_place);
+            printf("Picked the game up again at move %zu.\n", g->moves_count);
+            continue;
+        }
+
+        if (e.op == BROADCAST_END) {
+            print_end(e.state, e.winner);
+            break;
+        }
+        board_print(g->board, in_place);
+        if (e.op == BROADCAST_MOVE) {
+            printf("%s played %c%d.\n", e.stone == BLACK_STONE ? "Black" : "White", e.x + 'A', e.y + 1);
+        } else {
+            printf("%s took back %c%d.\n", e.stone == BLACK_STONE ? "Black" : "White", e.x + 'A', e.y + 1);
+        }
+    }
+    game_delete(g);
+    return SUCCESS;
+}
+
+/**
+ * The main function: watches the game broadcast under a name.
+ * @param argc The number of arguments.
+ * @param argv The arguments.
+ * @return The exit code.
+*/
+int main(int argc, char** argv) {
+    bool in_place = true;
+    long wait_ms = 0;
+    int first = 1;
+
+    // Check the arguments.
+    while (first < argc && argv[first][0] == '-') {
+        if (strcmp(argv[first], "-p") == 0) {
+            in_place = false;
+            first++;
+        } else if (strcmp(argv[first], "-w") == 0 && first + 1 < argc && atol(argv[first + 1]) > 0) {
+            wait_ms = atol(argv[first + 1]);
+            first += 2;
+        } else {
+            first = argc;
+        }
+    }
+    if (first != argc - 1 || argv[first][0] != '/') {
+        fprintf(stdout, "usage: %s [-p] [-w ms] /name\n", argv[0]);
+        return ARGUMENT_ERR;
+    }
+
+    // Wait for the game to start broadcasting if asked to.
+    long long start = search_clock();
+    broadcast_view* v;
+    while ((v = broadcast_attach(argv[first])) == NULL && errno == ENOENT && search_clock() - start < wait_ms) {
+        wait_poll();
+    }
+    if (v == NULL) {
+        fprintf(stderr, "Nothing is broadcast as %s\n", argv[first]);
+        return FILE_INPUT_ERR;
+    }
+
+    int status = follow(v, in_place);
+    broadcast_detach(v);
+    return status;
+}